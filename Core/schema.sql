@@ -24,6 +24,7 @@ CREATE TABLE IF NOT EXISTS Tags (
     UserId INTEGER,                      -- NULL for desktop app, user ID for web app
     CloudId TEXT,                        -- UUID for cloud sync (NULL if never synced)
     UpdatedAt TEXT NOT NULL DEFAULT (datetime('now')),
+    Hlc INTEGER NOT NULL DEFAULT 0,      -- Hybrid logical clock of the last edit (desktop sync)
     IsDeleted INTEGER NOT NULL DEFAULT 0, -- Soft delete for sync
     UNIQUE(Name, UserId),                -- Tag names unique per user
     FOREIGN KEY (UserId) REFERENCES Users(Id) ON DELETE CASCADE
@@ -40,6 +41,8 @@ CREATE TABLE IF NOT EXISTS WorkSessions (
     TagId INTEGER,                       -- Optional tag (NULL = no tag)
     CreatedAt TEXT NOT NULL DEFAULT (datetime('now')),
     UpdatedAt TEXT NOT NULL DEFAULT (datetime('now')),
+    Hlc INTEGER NOT NULL DEFAULT 0,      -- Hybrid logical clock of the last edit (desktop sync)
+    DirtyFields INTEGER NOT NULL DEFAULT 0, -- Fields edited since the last upload (desktop sync)
     UserId INTEGER,                      -- NULL for desktop app, user ID for web app
     CloudId TEXT,                        -- UUID for cloud sync (NULL if never synced)
     IsDeleted INTEGER NOT NULL DEFAULT 0, -- Soft delete for sync
@@ -54,6 +57,16 @@ CREATE TABLE IF NOT EXISTS SyncMetadata (
     Value TEXT NOT NULL
 );
 
+-- Sync outbox - records waiting to be uploaded (desktop app only)
+CREATE TABLE IF NOT EXISTS SyncOutbox (
+    Id INTEGER PRIMARY KEY AUTOINCREMENT,
+    IdempotencyKey TEXT NOT NULL UNIQUE, -- CloudId@Hlc of the queued version
+    CloudId TEXT NOT NULL UNIQUE,        -- One pending upload per record
+    DirtyFields INTEGER NOT NULL DEFAULT 0, -- Fields to send; 0 = whole record
+    Payload BLOB NOT NULL,               -- Record as a one-record compact changeset
+    CreatedAt TEXT NOT NULL DEFAULT (datetime('now'))
+);
+
 -- Index for efficient date-based queries (hierarchy navigation)
 CREATE INDEX IF NOT EXISTS idx_worksessions_date ON WorkSessions(SessionDate);
 CREATE INDEX IF NOT EXISTS idx_worksessions_user_date ON WorkSessions(UserId, SessionDate);
@@ -0,0 +1,91 @@
+#include "dynamodbdecoder.h"
+
+#include <QJsonDocument>
+#include <QTest>
+
+// The decoder against the QJsonDocument walk it replaced, on a full page
+// of sessions (DynamoDB returns at most 1 MB per Query page)
+class DynamoDbDecoderBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void decoder();
+    void jsonDocument();
+
+private:
+    QByteArray m_page;
+    int m_items = 0;
+};
+
+namespace {
+
+QString attribute(const QJsonObject &item, const QString &name, const QString &type)
+{
+    return item.value(name).toObject().value(type).toString();
+}
+
+} // namespace
+
+void DynamoDbDecoderBenchmark::initTestCase()
+{
+    QByteArray items;
+    for (m_items = 0; items.size() < 1000 * 1000 - 1024; ++m_items) {
+        if (m_items > 0)
+            items += ',';
+        items += QByteArray(R"({"CloudId":{"S":"0c6d2f0e-5d5b-4c5e-9c1a-%1"},"SessionDate":{"S":"2024-03-01"},)"
+                            R"("TimeHours":{"N":"1.25"},"Description":{"S":"Reviewed the \"sync\" changes"},)"
+                            R"("Notes":{"S":"Line one\nLine two"},"NextPlannedStage":{"S":"Merge"},)"
+                            R"("TagCloudId":{"S":"tag-1"},"CreatedAt":{"S":"2024-03-01 09:00:00"},)"
+                            R"("UpdatedAt":{"S":"2024-03-01 10:00:00"},"Hlc":{"N":"112233445566778"},)"
+                            R"("IsDeleted":{"BOOL":false}})")
+                     .replace("%1", QByteArray::number(m_items).rightJustified(12, '0'));
+    }
+    m_page = "{\"Count\":" + QByteArray::number(m_items) + ",\"Items\":[" + items
+        + "],\"LastEvaluatedKey\":{\"CloudId\":{\"S\":\"last\"}}}";
+}
+
+void DynamoDbDecoderBenchmark::decoder()
+{
+    DynamoDbDecoder decoder;
+    QBENCHMARK {
+        DynamoDbDecoder::Page page;
+        QVERIFY(decoder.decode(m_page, DynamoDbDecoder::Records::Sessions, &page));
+        QCOMPARE(page.sessions.size(), m_items);
+    }
+}
+
+void DynamoDbDecoderBenchmark::jsonDocument()
+{
+    const QString s = QStringLiteral("S");
+    const QString n = QStringLiteral("N");
+    QBENCHMARK {
+        const QJsonObject response = QJsonDocument::fromJson(m_page).object();
+        const QJsonArray items = response.value(QStringLiteral("Items")).toArray();
+        QVector<SyncSessionRecord> sessions;
+        sessions.reserve(items.size());
+        for (const QJsonValue &value : items) {
+            const QJsonObject item = value.toObject();
+            SyncSessionRecord session;
+            session.cloudId = attribute(item, QStringLiteral("CloudId"), s);
+            session.sessionDate = attribute(item, QStringLiteral("SessionDate"), s);
+            session.timeHours = attribute(item, QStringLiteral("TimeHours"), n).toDouble();
+            session.description = attribute(item, QStringLiteral("Description"), s);
+            session.notes = attribute(item, QStringLiteral("Notes"), s);
+            session.nextPlannedStage = attribute(item, QStringLiteral("NextPlannedStage"), s);
+            session.tagCloudId = attribute(item, QStringLiteral("TagCloudId"), s);
+            session.createdAt = attribute(item, QStringLiteral("CreatedAt"), s);
+            session.updatedAt = attribute(item, QStringLiteral("UpdatedAt"), s);
+            session.hlc = attribute(item, QStringLiteral("Hlc"), n).toLongLong();
+            session.isDeleted = item.value(QStringLiteral("IsDeleted")).toObject()
+                                    .value(QStringLiteral("BOOL")).toBool();
+            sessions.append(session);
+        }
+        QCOMPARE(sessions.size(), m_items);
+    }
+}
+
+QTEST_GUILESS_MAIN(DynamoDbDecoderBenchmark)
+
+#include "dynamodbdecoderbenchmark.moc"
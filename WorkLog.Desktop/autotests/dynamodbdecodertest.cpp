@@ -0,0 +1,225 @@
+#include "dynamodbdecoder.h"
+#include "hybridclock.h"
+
+#include <QTest>
+
+class DynamoDbDecoderTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void decodesQueryPage();
+    void decodesTags();
+    void unescapesStrings();
+    void skipsUnknownAttributes();
+    void skipsDeepNesting();
+    void decodesBatchGetItem();
+    void derivesMissingClock();
+    void rejectsMalformedPages_data();
+    void rejectsMalformedPages();
+    void rejectsTruncatedPages();
+    void reusesScratchAcrossPages();
+};
+
+namespace {
+
+const QByteArray QueryPage = R"({"Count":2,"Items":[
+{"CloudId":{"S":"a1"},"SessionDate":{"S":"2024-03-01"},"TimeHours":{"N":"1.5"},"Description":{"S":"Review"},"Notes":{"S":"n"},"NextPlannedStage":{"S":"Ship"},"TagCloudId":{"S":"t1"},"CreatedAt":{"S":"2024-03-01 09:00:00"},"UpdatedAt":{"S":"2024-03-01 10:00:00"},"Hlc":{"N":"123456"},"IsDeleted":{"BOOL":false}},
+{"CloudId":{"S":"a2"},"SessionDate":{"S":"2024-03-02"},"TimeHours":{"N":"2"},"Description":{"S":"Plan"},"Hlc":{"N":"7"},"IsDeleted":{"BOOL":true}}
+],"ScannedCount":2,"LastEvaluatedKey":{"CloudId":{"S":"a2"},"SessionDate":{"S":"2024-03-02"}}})";
+
+} // namespace
+
+void DynamoDbDecoderTest::decodesQueryPage()
+{
+    DynamoDbDecoder decoder;
+    DynamoDbDecoder::Page page;
+    QVERIFY2(decoder.decode(QueryPage, DynamoDbDecoder::Records::Sessions, &page),
+             qPrintable(decoder.errorString()));
+
+    QCOMPARE(page.sessions.size(), 2);
+    const SyncSessionRecord &first = page.sessions.at(0);
+    QCOMPARE(first.cloudId, QStringLiteral("a1"));
+    QCOMPARE(first.sessionDate, QStringLiteral("2024-03-01"));
+    QCOMPARE(first.timeHours, 1.5);
+    QCOMPARE(first.description, QStringLiteral("Review"));
+    QCOMPARE(first.notes, QStringLiteral("n"));
+    QCOMPARE(first.nextPlannedStage, QStringLiteral("Ship"));
+    QCOMPARE(first.tagCloudId, QStringLiteral("t1"));
+    QCOMPARE(first.createdAt, QStringLiteral("2024-03-01 09:00:00"));
+    QCOMPARE(first.updatedAt, QStringLiteral("2024-03-01 10:00:00"));
+    QCOMPARE(first.hlc, qint64(123456));
+    QVERIFY(!first.isDeleted);
+
+    const SyncSessionRecord &second = page.sessions.at(1);
+    QCOMPARE(second.cloudId, QStringLiteral("a2"));
+    QCOMPARE(second.timeHours, 2.0);
+    QCOMPARE(second.hlc, qint64(7));
+    QVERIFY(second.isDeleted);
+    QVERIFY(second.notes.isEmpty());
+
+    QCOMPARE(page.lastEvaluatedKey.value(QStringLiteral("CloudId")).toObject()
+                 .value(QStringLiteral("S")).toString(), QStringLiteral("a2"));
+    QVERIFY(page.unprocessedKeys.isEmpty());
+    QVERIFY(page.tags.isEmpty());
+}
+
+void DynamoDbDecoderTest::decodesTags()
+{
+    const QByteArray data = R"({"Items":[{"CloudId":{"S":"t1"},"Name":{"S":"Client"},"UpdatedAt":{"S":"2024-01-01 00:00:00"},"Hlc":{"N":"42"},"IsDeleted":{"BOOL":true}}],"Count":1})";
+    DynamoDbDecoder decoder;
+    DynamoDbDecoder::Page page;
+    QVERIFY2(decoder.decode(data, DynamoDbDecoder::Records::Tags, &page), qPrintable(decoder.errorString()));
+
+    QCOMPARE(page.tags.size(), 1);
+    QCOMPARE(page.tags.at(0).cloudId, QStringLiteral("t1"));
+    QCOMPARE(page.tags.at(0).name, QStringLiteral("Client"));
+    QCOMPARE(page.tags.at(0).hlc, qint64(42));
+    QVERIFY(page.tags.at(0).isDeleted);
+    QVERIFY(page.lastEvaluatedKey.isEmpty());
+}
+
+void DynamoDbDecoderTest::unescapesStrings()
+{
+    const QByteArray data = R"({"Items":[{"CloudId":{"S":"e1"},
+        "Description":{"S":"q\"b\\s\/n\nt\tr\rb\bf\f"},
+        "Notes":{"S":"caf\u00e9 \u20ac \ud83d\ude00"},
+        "NextPlannedStage":{"S":"lone \ud800 low \udc00 bad \uzzzz"}}]})";
+    DynamoDbDecoder decoder;
+    DynamoDbDecoder::Page page;
+    QVERIFY2(decoder.decode(data, DynamoDbDecoder::Records::Sessions, &page), qPrintable(decoder.errorString()));
+
+    QCOMPARE(page.sessions.size(), 1);
+    const SyncSessionRecord &session = page.sessions.at(0);
+    QCOMPARE(session.description, QStringLiteral("q\"b\\s/n\nt\tr\rb\bf\f"));
+    QCOMPARE(session.notes, QString::fromUtf8("caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80"));
+    const QString replacement(QChar(0xFFFD));
+    QCOMPARE(session.nextPlannedStage, QStringLiteral("lone %1 low %1 bad %1zzzz").arg(replacement));
+}
+
+void DynamoDbDecoderTest::skipsUnknownAttributes()
+{
+    const QByteArray data = R"({"ConsumedCapacity":{"TableName":"s","CapacityUnits":0.5},
+        "Items":[{"Extra":{"M":{"a":{"L":[{"N":"1"},{"S":"}]"},{"NULL":true},{"BS":["AA=="]}]}}},
+                  "CloudId":{"S":"u1"},"Flags":{"SS":["x","y"]},"Nothing":{"NULL":true},
+                  "Description":{"S":"kept"},"Number":{"N":"-1.5e3"}}],
+        "Count":1,"ScannedCount":10})";
+    DynamoDbDecoder decoder;
+    DynamoDbDecoder::Page page;
+    QVERIFY2(decoder.decode(data, DynamoDbDecoder::Records::Sessions, &page), qPrintable(decoder.errorString()));
+
+    QCOMPARE(page.sessions.size(), 1);
+    QCOMPARE(page.sessions.at(0).cloudId, QStringLiteral("u1"));
+    QCOMPARE(page.sessions.at(0).description, QStringLiteral("kept"));
+}
+
+void DynamoDbDecoderTest::skipsDeepNesting()
+{
+    // Far deeper than a recursive parser could follow on the stack
+    const int depth = 100000;
+    QByteArray nested;
+    for (int i = 0; i < depth; ++i)
+        nested += R"({"L":[)";
+    nested += R"({"S":"leaf"})";
+    for (int i = 0; i < depth; ++i)
+        nested += "]}";
+
+    const QByteArray data = R"({"Items":[{"Deep":)" + nested + R"(,"CloudId":{"S":"d1"}}]})";
+    DynamoDbDecoder decoder;
+    DynamoDbDecoder::Page page;
+    QVERIFY2(decoder.decode(data, DynamoDbDecoder::Records::Sessions, &page), qPrintable(decoder.errorString()));
+    QCOMPARE(page.sessions.size(), 1);
+    QCOMPARE(page.sessions.at(0).cloudId, QStringLiteral("d1"));
+
+    // Cut short inside the item
+    DynamoDbDecoder::Page truncated;
+    QVERIFY(!decoder.decode(data.left(data.size() - 4), DynamoDbDecoder::Records::Sessions, &truncated));
+    QVERIFY(!decoder.errorString().isEmpty());
+}
+
+void DynamoDbDecoderTest::decodesBatchGetItem()
+{
+    const QByteArray data = R"({"Responses":{"WorkSessions":[
+            {"CloudId":{"S":"b1"},"Hlc":{"N":"1"}},
+            {"CloudId":{"S":"b2"},"Hlc":{"N":"2"}}]},
+        "UnprocessedKeys":{"WorkSessions":{"Keys":[{"CloudId":{"S":"b3"}},{"CloudId":{"S":"b4"}}],
+                                           "ProjectionExpression":"CloudId"}}})";
+    DynamoDbDecoder decoder;
+    DynamoDbDecoder::Page page;
+    QVERIFY2(decoder.decode(data, DynamoDbDecoder::Records::Sessions, &page), qPrintable(decoder.errorString()));
+
+    QCOMPARE(page.sessions.size(), 2);
+    QCOMPARE(page.sessions.at(1).cloudId, QStringLiteral("b2"));
+    QCOMPARE(page.unprocessedKeys.size(), 2);
+    QCOMPARE(page.unprocessedKeys.at(1).toObject().value(QStringLiteral("CloudId")).toObject()
+                 .value(QStringLiteral("S")).toString(), QStringLiteral("b4"));
+    QVERIFY(page.lastEvaluatedKey.isEmpty());
+}
+
+void DynamoDbDecoderTest::derivesMissingClock()
+{
+    const QByteArray data = R"({"Items":[{"CloudId":{"S":"w1"},"UpdatedAt":{"S":"2024-03-01 10:00:00"}}]})";
+    DynamoDbDecoder decoder;
+    DynamoDbDecoder::Page page;
+    QVERIFY(decoder.decode(data, DynamoDbDecoder::Records::Sessions, &page));
+    QCOMPARE(page.sessions.size(), 1);
+    QCOMPARE(page.sessions.at(0).hlc, HybridClock::fromTimestamp(QStringLiteral("2024-03-01 10:00:00")));
+}
+
+void DynamoDbDecoderTest::rejectsMalformedPages_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("not an object") << QByteArray("[]");
+    QTest::newRow("missing colon") << QByteArray(R"({"Items" []})");
+    QTest::newRow("missing comma") << QByteArray(R"({"Count":1 "Items":[]})");
+    QTest::newRow("unterminated string") << QByteArray(R"({"Items":[{"CloudId":{"S":"abc}}]})");
+    QTest::newRow("trailing backslash") << QByteArray(R"({"Items":[{"CloudId":{"S":"abc\)");
+    QTest::newRow("trailing data") << QByteArray(R"({"Items":[]} x)");
+    QTest::newRow("bad boolean") << QByteArray(R"({"Items":[{"IsDeleted":{"BOOL":yes}}]})");
+    QTest::newRow("stray bracket") << QByteArray(R"({"Other":]})");
+    QTest::newRow("nul in nested value") << QByteArray(R"({"Items":[{"X":{"L":[)") + QByteArray(1, '\0')
+                                              + QByteArray("]}}]}");
+    QTest::newRow("nul as value") << QByteArray(R"({"Other":)") + QByteArray(1, '\0') + QByteArray("}");
+    QTest::newRow("control byte in nested value") << QByteArray("{\"Other\":[1,\x01]}");
+    QTest::newRow("malformed key") << QByteArray(R"({"LastEvaluatedKey":[1]})");
+}
+
+void DynamoDbDecoderTest::rejectsMalformedPages()
+{
+    QFETCH(QByteArray, data);
+
+    DynamoDbDecoder decoder;
+    DynamoDbDecoder::Page page;
+    QVERIFY(!decoder.decode(data, DynamoDbDecoder::Records::Sessions, &page));
+    QVERIFY(!decoder.errorString().isEmpty());
+}
+
+void DynamoDbDecoderTest::rejectsTruncatedPages()
+{
+    // Every cut of a well-formed page fails, wherever it lands
+    DynamoDbDecoder decoder;
+    for (int size = 0; size < QueryPage.size(); ++size) {
+        DynamoDbDecoder::Page page;
+        if (decoder.decode(QueryPage.left(size), DynamoDbDecoder::Records::Sessions, &page))
+            QFAIL(qPrintable(QStringLiteral("A page cut to %1 bytes was accepted").arg(size)));
+        QVERIFY(!decoder.errorString().isEmpty());
+    }
+}
+
+void DynamoDbDecoderTest::reusesScratchAcrossPages()
+{
+    DynamoDbDecoder decoder;
+    DynamoDbDecoder::Page bad;
+    QVERIFY(!decoder.decode(QByteArray("{"), DynamoDbDecoder::Records::Sessions, &bad));
+
+    DynamoDbDecoder::Page page;
+    QVERIFY(decoder.decode(QueryPage, DynamoDbDecoder::Records::Sessions, &page));
+    QVERIFY(decoder.errorString().isEmpty());
+    QCOMPARE(page.sessions.size(), 2);
+}
+
+QTEST_GUILESS_MAIN(DynamoDbDecoderTest)
+
+#include "dynamodbdecodertest.moc"
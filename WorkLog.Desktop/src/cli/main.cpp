@@ -0,0 +1,506 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDate>
+#include <QTextStream>
+#include <QTimer>
+
+#include "diagnostics.h"
+#include "tracer.h"
+#include "databasemanager.h"
+#include "hierarchysnapshot.h"
+#include "databasebackup.h"
+#include "sessionexporter.h"
+#include "sessionimporter.h"
+#ifdef ENABLE_SYNC
+#include "syncmanager.h"
+#endif
+
+namespace {
+
+QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+QTextStream &err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+int fail(const QString &message)
+{
+    err() << message << Qt::endl;
+    return 1;
+}
+
+QString formatHours(double hours)
+{
+    return QString::number(hours, 'f', 2);
+}
+
+// Reads an ISO date option, falling back when the option was not given
+bool dateOption(const QCommandLineParser &parser, const QString &name,
+                const QDate &fallback, QDate *date)
+{
+    if (!parser.isSet(name)) {
+        *date = fallback;
+        return true;
+    }
+    *date = QDate::fromString(parser.value(name), Qt::ISODate);
+    if (!date->isValid()) {
+        fail(QStringLiteral("Invalid date for --%1: %2 (expected YYYY-MM-DD)").arg(name, parser.value(name)));
+        return false;
+    }
+    return true;
+}
+
+int findOrCreateTag(DatabaseManager &db, const QString &name)
+{
+    const int id = db.getTagIdByName(name);
+    return id > 0 ? id : db.createTag(name);
+}
+
+void addCommandOptions(QCommandLineParser &parser, const QString &command)
+{
+    if (command == QLatin1String("add")) {
+        parser.addOptions({
+            {QStringLiteral("date"), QStringLiteral("Session date (default: today)."), QStringLiteral("YYYY-MM-DD")},
+            {QStringLiteral("hours"), QStringLiteral("Time spent, in hours."), QStringLiteral("hours")},
+            {QStringLiteral("description"), QStringLiteral("What was worked on."), QStringLiteral("text")},
+            {QStringLiteral("notes"), QStringLiteral("Additional notes."), QStringLiteral("text")},
+            {QStringLiteral("next"), QStringLiteral("Next planned stage."), QStringLiteral("text")},
+            {QStringLiteral("tag"), QStringLiteral("Tag name; created if it does not exist."), QStringLiteral("name")},
+        });
+    } else if (command == QLatin1String("list")) {
+        parser.addOptions({
+            {QStringLiteral("from"), QStringLiteral("First day to list (default: today)."), QStringLiteral("YYYY-MM-DD")},
+            {QStringLiteral("to"), QStringLiteral("Last day to list (default: --from)."), QStringLiteral("YYYY-MM-DD")},
+        });
+    } else if (command == QLatin1String("report")) {
+        parser.addOption({QStringLiteral("date"),
+                          QStringLiteral("Report on the week, month and year containing this day (default: today)."),
+                          QStringLiteral("YYYY-MM-DD")});
+    } else if (command == QLatin1String("export")) {
+        parser.addPositionalArgument(QStringLiteral("file"), QStringLiteral("Output file."));
+        parser.addOptions({
+            {QStringLiteral("format"), QStringLiteral("csv, ndjson or binary (default: csv)."), QStringLiteral("format")},
+            {QStringLiteral("from"), QStringLiteral("First day to export."), QStringLiteral("YYYY-MM-DD")},
+            {QStringLiteral("to"), QStringLiteral("Last day to export."), QStringLiteral("YYYY-MM-DD")},
+        });
+    } else if (command == QLatin1String("import")) {
+        parser.addPositionalArgument(QStringLiteral("file"), QStringLiteral("CSV or NDJSON file."));
+        parser.addOptions({
+            {QStringLiteral("format"), QStringLiteral("csv or ndjson (default: from the file extension)."), QStringLiteral("format")},
+            {QStringLiteral("dry-run"), QStringLiteral("Validate without writing anything.")},
+        });
+    } else if (command == QLatin1String("tag")) {
+        parser.addPositionalArgument(QStringLiteral("action"),
+                                     QStringLiteral("rename <tag> <name>, merge <target> <source>... or split <tag> <name>."));
+        parser.addOptions({
+            {QStringLiteral("from"), QStringLiteral("split: first day to move (default: open)."), QStringLiteral("YYYY-MM-DD")},
+            {QStringLiteral("to"), QStringLiteral("split: last day to move (default: open)."), QStringLiteral("YYYY-MM-DD")},
+        });
+    } else if (command == QLatin1String("backup")) {
+        parser.addOptions({
+            {QStringLiteral("dir"), QStringLiteral("Backup directory (default: backups next to the database)."), QStringLiteral("path")},
+            {QStringLiteral("keep"), QStringLiteral("Number of backups to keep (default: 7)."), QStringLiteral("count")},
+        });
+    } else if (command == QLatin1String("restore")) {
+        parser.addPositionalArgument(QStringLiteral("file"), QStringLiteral("Backup file."));
+    } else if (command == QLatin1String("archive")) {
+        parser.addOption({QStringLiteral("restore"),
+                          QStringLiteral("Move an archived year back instead."),
+                          QStringLiteral("year")});
+    } else if (command == QLatin1String("sync")) {
+        parser.addOption({QStringLiteral("verify"),
+                          QStringLiteral("Compare every session instead of trusting the stored digests.")});
+    }
+}
+
+int runAdd(const QCommandLineParser &parser, DatabaseManager &db)
+{
+    QDate date;
+    if (!dateOption(parser, QStringLiteral("date"), QDate::currentDate(), &date))
+        return 1;
+
+    bool ok = false;
+    const double hours = parser.value(QStringLiteral("hours")).toDouble(&ok);
+    if (!ok || hours <= 0.0 || hours > 24.0)
+        return fail(QStringLiteral("--hours must be a number between 0 and 24"));
+
+    const QString description = parser.value(QStringLiteral("description")).trimmed();
+    if (description.isEmpty())
+        return fail(QStringLiteral("--description is required"));
+
+    int tagId = -1;
+    if (parser.isSet(QStringLiteral("tag"))) {
+        tagId = findOrCreateTag(db, parser.value(QStringLiteral("tag")).trimmed());
+        if (tagId <= 0)
+            return fail(QStringLiteral("Could not create tag %1").arg(parser.value(QStringLiteral("tag"))));
+    }
+
+    if (!db.createSession(date, hours, description,
+                          parser.value(QStringLiteral("notes")),
+                          parser.value(QStringLiteral("next")), tagId)) {
+        return fail(QStringLiteral("Failed to add session"));
+    }
+
+    out() << "Added " << formatHours(hours) << "h on " << date.toString(Qt::ISODate) << Qt::endl;
+    return 0;
+}
+
+int runList(const QCommandLineParser &parser, DatabaseManager &db)
+{
+    QDate from;
+    QDate to;
+    if (!dateOption(parser, QStringLiteral("from"), QDate::currentDate(), &from)
+        || !dateOption(parser, QStringLiteral("to"), from, &to)) {
+        return 1;
+    }
+    if (to < from)
+        return fail(QStringLiteral("--to is before --from"));
+
+    double total = 0.0;
+    for (QDate date = from; date <= to; date = date.addDays(1)) {
+        // A year at a time: readers keep only a few archives open
+        if (date == from || (date.month() == 1 && date.day() == 1))
+            db.attachYears(date.year(), date.year());
+        const QVariantList sessions = db.getSessionsForDate(date);
+        for (const QVariant &value : sessions) {
+            const QVariantMap session = value.toMap();
+            const double hours = session.value(QStringLiteral("timeHours")).toDouble();
+            const QString tagName = session.value(QStringLiteral("tagName")).toString();
+            total += hours;
+
+            out() << date.toString(Qt::ISODate) << "  "
+                  << formatHours(hours).rightJustified(6) << "h  ";
+            if (!tagName.isEmpty())
+                out() << '[' << tagName << "]  ";
+            out() << session.value(QStringLiteral("description")).toString() << Qt::endl;
+        }
+    }
+
+    out() << "Total: " << formatHours(total) << "h" << Qt::endl;
+    return 0;
+}
+
+int runReport(const QCommandLineParser &parser, DatabaseManager &db)
+{
+    QDate date;
+    if (!dateOption(parser, QStringLiteral("date"), QDate::currentDate(), &date))
+        return 1;
+
+    const int year = date.year();
+    const int month = date.month();
+    const int week = HierarchySnapshot::weekNumber(date);
+    db.attachYears(year, year);
+
+    out() << "Day " << date.toString(Qt::ISODate) << ": "
+          << formatHours(db.getTotalHoursForDate(date)) << "h" << Qt::endl;
+
+    out() << "Week " << week << ", " << year << ": "
+          << formatHours(db.getTotalHoursForWeek(year, week)) << "h" << Qt::endl;
+    const QVariantList tagTotals = db.getTagTotalsForWeek(year, week);
+    for (const QVariant &value : tagTotals) {
+        const QVariantMap item = value.toMap();
+        out() << "  " << item.value(QStringLiteral("tagName")).toString().leftJustified(24)
+              << formatHours(item.value(QStringLiteral("totalHours")).toDouble()).rightJustified(8) << "h"
+              << Qt::endl;
+    }
+
+    out() << "Month " << date.toString(QStringLiteral("yyyy-MM")) << ": "
+          << formatHours(db.getTotalHoursForMonth(year, month)) << "h (average "
+          << formatHours(db.getAverageHoursPerWeekForMonth(year, month)) << "h/week)" << Qt::endl;
+
+    out() << "Year " << year << ": "
+          << formatHours(db.getTotalHoursForYear(year)) << "h (average "
+          << formatHours(db.getAverageHoursPerWeekForYear(year)) << "h/week)" << Qt::endl;
+    return 0;
+}
+
+int runExport(const QCommandLineParser &parser, DatabaseManager &db)
+{
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() < 2)
+        return fail(QStringLiteral("export: missing output file"));
+
+    bool ok = true;
+    const SessionExporter::Format format = parser.isSet(QStringLiteral("format"))
+        ? SessionExporter::formatFromString(parser.value(QStringLiteral("format")), &ok)
+        : SessionExporter::Csv;
+    if (!ok)
+        return fail(QStringLiteral("Unknown export format: %1").arg(parser.value(QStringLiteral("format"))));
+
+    QDate from;
+    QDate to;
+    if (!dateOption(parser, QStringLiteral("from"), QDate(), &from)
+        || !dateOption(parser, QStringLiteral("to"), QDate(), &to)) {
+        return 1;
+    }
+
+    SessionExporter exporter(db.databasePath(), arguments.at(1), format);
+    exporter.setDateRange(from, to);
+    if (!exporter.run())
+        return fail(exporter.errorString());
+
+    out() << "Exported " << exporter.rowsWritten() << " sessions to " << arguments.at(1) << Qt::endl;
+    return 0;
+}
+
+int runImport(const QCommandLineParser &parser, DatabaseManager &db)
+{
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() < 2)
+        return fail(QStringLiteral("import: missing input file"));
+
+    const QString path = arguments.at(1);
+    bool ok = true;
+    const SessionImporter::Format format = parser.isSet(QStringLiteral("format"))
+        ? SessionImporter::formatFromString(parser.value(QStringLiteral("format")), &ok)
+        : SessionImporter::formatForPath(path, &ok);
+    if (!ok)
+        return fail(QStringLiteral("Cannot tell the format of %1; pass --format").arg(path));
+
+    SessionImporter importer(db.databasePath(), path, format);
+    importer.setDryRun(parser.isSet(QStringLiteral("dry-run")));
+
+    QString message;
+    QObject::connect(&importer, &SessionImporter::finished, [&message](bool, const QString &text) {
+        message = text;
+    });
+    const bool success = importer.run();
+
+    const QStringList rowErrors = importer.rowErrors();
+    for (const QString &error : rowErrors)
+        err() << error << Qt::endl;
+
+    if (!success)
+        return fail(message);
+    out() << message << Qt::endl;
+    return importer.rowsRejected() > 0 ? 2 : 0;
+}
+
+int runTag(const QCommandLineParser &parser, DatabaseManager &db)
+{
+    const QStringList arguments = parser.positionalArguments();
+    const QString action = arguments.value(1);
+
+    // Every action names existing tags first
+    QList<int> tagIds;
+    for (int i = 2; i < arguments.size(); ++i) {
+        if (action == QLatin1String("merge") || i == 2) {
+            const int id = db.getTagIdByName(arguments.at(i));
+            if (id <= 0)
+                return fail(QStringLiteral("No such tag: %1").arg(arguments.at(i)));
+            tagIds.append(id);
+        }
+    }
+
+    if (action == QLatin1String("rename")) {
+        if (arguments.size() != 4)
+            return fail(QStringLiteral("tag rename: expected the tag and its new name"));
+        if (!db.renameTag(tagIds.first(), arguments.at(3)))
+            return fail(QStringLiteral("Could not rename tag %1").arg(arguments.at(2)));
+        out() << "Renamed " << arguments.at(2) << " to " << arguments.at(3).trimmed() << Qt::endl;
+        return 0;
+    }
+
+    if (action == QLatin1String("merge")) {
+        if (arguments.size() < 4)
+            return fail(QStringLiteral("tag merge: expected the target tag and at least one source"));
+        QVariantList sourceIds;
+        for (int i = 1; i < tagIds.size(); ++i)
+            sourceIds.append(tagIds.at(i));
+        const int moved = db.mergeTags(sourceIds, tagIds.first());
+        if (moved < 0)
+            return fail(QStringLiteral("Could not merge into %1").arg(arguments.at(2)));
+        out() << "Moved " << moved << " sessions to " << arguments.at(2) << Qt::endl;
+        return 0;
+    }
+
+    if (action == QLatin1String("split")) {
+        if (arguments.size() != 4)
+            return fail(QStringLiteral("tag split: expected the tag and the new tag's name"));
+        QDate from;
+        QDate to;
+        if (!dateOption(parser, QStringLiteral("from"), QDate(), &from)
+            || !dateOption(parser, QStringLiteral("to"), QDate(), &to)) {
+            return 1;
+        }
+        const int moved = db.splitTag(tagIds.first(), arguments.at(3), from, to);
+        if (moved < 0)
+            return fail(QStringLiteral("Could not split tag %1").arg(arguments.at(2)));
+        out() << "Moved " << moved << " sessions to " << arguments.at(3).trimmed() << Qt::endl;
+        return 0;
+    }
+
+    return fail(QStringLiteral("tag: expected rename, merge or split"));
+}
+
+int runBackup(const QCommandLineParser &parser, DatabaseManager &db)
+{
+    DatabaseBackup backup(db.databasePath(), parser.value(QStringLiteral("dir")));
+    if (parser.isSet(QStringLiteral("keep"))) {
+        bool ok = false;
+        const int keep = parser.value(QStringLiteral("keep")).toInt(&ok);
+        if (!ok || keep < 1)
+            return fail(QStringLiteral("Invalid value for --keep: %1").arg(parser.value(QStringLiteral("keep"))));
+        backup.setKeep(keep);
+    }
+    if (!backup.run())
+        return fail(backup.errorString());
+
+    out() << "Backed up to " << backup.outputPath() << Qt::endl;
+    return 0;
+}
+
+// Runs before the database is opened; the desktop app must not have it open either
+int runRestore(const QCommandLineParser &parser, const QString &databasePath)
+{
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() < 2)
+        return fail(QStringLiteral("restore: missing backup file"));
+
+    QString error;
+    if (!DatabaseBackup::stageRestore(arguments.at(1), databasePath, &error)
+        || !DatabaseBackup::applyStagedRestore(databasePath, &error)) {
+        return fail(error);
+    }
+    out() << "Restored " << databasePath << " from " << arguments.at(1) << Qt::endl;
+    return 0;
+}
+
+int runArchive(const QCommandLineParser &parser, DatabaseManager &db)
+{
+    if (parser.isSet(QStringLiteral("restore"))) {
+        bool ok = false;
+        const int year = parser.value(QStringLiteral("restore")).toInt(&ok);
+        if (!ok || !db.archivedYears().contains(year))
+            return fail(QStringLiteral("No archived year: %1").arg(parser.value(QStringLiteral("restore"))));
+        if (!db.restoreYear(year))
+            return fail(QStringLiteral("Could not restore %1").arg(year));
+        out() << "Restored " << year << Qt::endl;
+        return 0;
+    }
+
+    const int archived = db.archiveClosedYears();
+    if (archived < 0)
+        return fail(QStringLiteral("Could not archive every closed year"));
+    out() << "Archived " << archived << " years" << Qt::endl;
+    return 0;
+}
+
+#ifdef ENABLE_SYNC
+int runSync(const QCommandLineParser &parser, QCoreApplication &app, DatabaseManager &db)
+{
+    SyncManager syncManager(&db);
+    if (!syncManager.isConfigured())
+        return fail(QStringLiteral("Sync is not configured; set it up in the desktop app first"));
+
+    QObject::connect(&syncManager, &SyncManager::errorOccurred, &app, [&app](const QString &error) {
+        err() << error << Qt::endl;
+        app.exit(1);
+    });
+    QObject::connect(&syncManager, &SyncManager::syncCompleted, &app,
+                     [&app](bool success, const QString &message) {
+        (success ? out() : err()) << message << Qt::endl;
+        app.exit(success ? 0 : 1);
+    });
+
+    // One line per phase on stderr, so stdout stays the result only
+    QString lastPhase;
+    QObject::connect(&syncManager, &SyncManager::progressChanged, &app, [&syncManager, &lastPhase]() {
+        const QString phase = syncManager.syncPhase();
+        if (!phase.isEmpty() && phase != lastPhase)
+            err() << phase << "..." << Qt::endl;
+        lastPhase = phase;
+    });
+
+    // Started from the event loop so early failures can still exit it
+    QTimer::singleShot(0, &syncManager, parser.isSet(QStringLiteral("verify"))
+                                            ? &SyncManager::verify : &SyncManager::sync);
+    return app.exec();
+}
+#endif
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Same names as the desktop app, so both find the same database
+    QCoreApplication::setOrganizationName(QStringLiteral("WorkLog"));
+    QCoreApplication::setOrganizationDomain(QStringLiteral("worklog.local"));
+    QCoreApplication::setApplicationName(QStringLiteral("Work Log"));
+    QCoreApplication::setApplicationVersion(QStringLiteral("1.0.0"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Work Log command line client"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOption({QStringLiteral("database"),
+                      QStringLiteral("Database file (default: the desktop app's database)."),
+                      QStringLiteral("path")});
+    parser.addPositionalArgument(QStringLiteral("command"),
+                                 QStringLiteral("add, list, report, export, import, tag, archive, backup, restore or sync."));
+
+    // Options depend on the command, so peek at it before the real parse
+    parser.parse(app.arguments());
+    const QString command = parser.positionalArguments().value(0);
+    if (!command.isEmpty()) {
+        parser.clearPositionalArguments();
+        parser.addPositionalArgument(command, QStringLiteral("Command to run."), command);
+        addCommandOptions(parser, command);
+    }
+    parser.process(app);
+
+    if (command.isEmpty())
+        parser.showHelp(1);
+
+    Diagnostics::instance()->installExitDump();
+    Tracer::initializeFromEnvironment();
+
+    const QString databasePath = parser.isSet(QStringLiteral("database"))
+        ? parser.value(QStringLiteral("database")) : DatabaseManager::defaultDatabasePath();
+    if (command == QLatin1String("restore"))
+        return runRestore(parser, databasePath);
+
+    DatabaseManager db;
+    if (!db.initialize(databasePath))
+        return fail(QStringLiteral("Failed to open database"));
+
+    int result = 1;
+    if (command == QLatin1String("add")) {
+        result = runAdd(parser, db);
+    } else if (command == QLatin1String("list")) {
+        result = runList(parser, db);
+    } else if (command == QLatin1String("report")) {
+        result = runReport(parser, db);
+    } else if (command == QLatin1String("export")) {
+        result = runExport(parser, db);
+    } else if (command == QLatin1String("import")) {
+        result = runImport(parser, db);
+    } else if (command == QLatin1String("tag")) {
+        result = runTag(parser, db);
+    } else if (command == QLatin1String("archive")) {
+        result = runArchive(parser, db);
+    } else if (command == QLatin1String("backup")) {
+        result = runBackup(parser, db);
+#ifdef ENABLE_SYNC
+    } else if (command == QLatin1String("sync")) {
+        result = runSync(parser, app, db);
+#endif
+    } else {
+        result = fail(QStringLiteral("Unknown command: %1").arg(command));
+    }
+
+    // Diagnostics and tracing flush on aboutToQuit, which only an event loop emits
+    if (command != QLatin1String("sync")) {
+        QTimer::singleShot(0, &app, &QCoreApplication::quit);
+        app.exec();
+    }
+    return result;
+}
@@ -0,0 +1,159 @@
+#include "backupmanager.h"
+#include "connectionpool.h"
+#include "databasebackup.h"
+#include "databasemanager.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QThread>
+#include <QDebug>
+
+namespace {
+
+// After the database opens, so startup work goes first
+constexpr int AutomaticDelayMs = 5 * 60 * 1000;
+constexpr qint64 AutomaticIntervalMs = 24 * 60 * 60 * 1000LL;
+
+} // namespace
+
+BackupManager::BackupManager(DatabaseManager *db, QObject *parent)
+    : QObject(parent)
+    , m_database(db)
+{
+    m_automaticTimer.setSingleShot(true);
+    connect(&m_automaticTimer, &QTimer::timeout, this, &BackupManager::backupNow);
+    connect(m_database, &DatabaseManager::opened, this, [this]() {
+        emit backupsChanged();
+        scheduleAutomaticBackup();
+    });
+    if (m_database->isOpen())
+        scheduleAutomaticBackup();
+}
+
+BackupManager::~BackupManager()
+{
+    if (m_thread) {
+        if (m_backup)
+            m_backup->cancel();
+        m_thread->quit();
+        m_thread->wait();
+    }
+}
+
+QString BackupManager::directory() const
+{
+    return DatabaseBackup::defaultDirectory(m_database->databasePath());
+}
+
+QVariantList BackupManager::backups() const
+{
+    QVariantList results;
+    if (m_database->databasePath().isEmpty())
+        return results;
+
+    const QStringList paths = DatabaseBackup::backups(directory());
+    for (const QString &path : paths) {
+        const QFileInfo info(path);
+        QVariantMap entry;
+        entry[QStringLiteral("fileName")] = info.fileName();
+        entry[QStringLiteral("path")] = path;
+        entry[QStringLiteral("createdAt")] = info.lastModified();
+        entry[QStringLiteral("size")] = info.size();
+        results.append(entry);
+    }
+    return results;
+}
+
+void BackupManager::scheduleAutomaticBackup()
+{
+    // A day after the newest backup, but never right at startup
+    const QStringList paths = DatabaseBackup::backups(directory());
+    qint64 delay = AutomaticDelayMs;
+    if (!paths.isEmpty()) {
+        const qint64 age = QFileInfo(paths.first()).lastModified().msecsTo(QDateTime::currentDateTime());
+        delay = qMax<qint64>(delay, AutomaticIntervalMs - age);
+    }
+    m_automaticTimer.start(int(qMin<qint64>(delay, AutomaticIntervalMs)));
+}
+
+bool BackupManager::backupNow()
+{
+    if (isBackingUp()) {
+        emit errorOccurred(tr("Backup already in progress"));
+        return false;
+    }
+    if (!m_database->isOpen()) {
+        emit errorOccurred(tr("The database is not open"));
+        return false;
+    }
+    m_automaticTimer.stop();
+
+    auto *backup = new DatabaseBackup(m_database->databasePath(), directory());
+
+    auto *thread = new QThread(this);
+    thread->setObjectName(QStringLiteral("backup"));
+    backup->moveToThread(thread);
+
+    connect(thread, &QThread::started, backup, &DatabaseBackup::run);
+    connect(backup, &DatabaseBackup::progress, this, &BackupManager::onProgress);
+    connect(backup, &DatabaseBackup::finished, this, &BackupManager::onFinished);
+    connect(backup, &DatabaseBackup::finished, thread, &QThread::quit);
+    connect(thread, &QThread::finished, backup, &QObject::deleteLater);
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+
+    m_backup = backup;
+    m_thread = thread;
+    m_isBackingUp = true;
+    m_pagesCopied = 0;
+    m_totalPages = 0;
+
+    thread->start(QThread::LowPriority);
+
+    emit backingUpChanged();
+    emit progressChanged();
+    return true;
+}
+
+void BackupManager::cancel()
+{
+    if (m_backup)
+        m_backup->cancel();
+}
+
+void BackupManager::restoreBackup(const QString &path)
+{
+    if (m_isRestoring)
+        return;
+
+    m_isRestoring = true;
+    emit restoringChanged();
+
+    // Unpacking and checking a large backup takes a while
+    const QString databasePath = m_database->databasePath();
+    ConnectionPool::run([this, path, databasePath]() {
+        QString error;
+        const bool ok = DatabaseBackup::stageRestore(path, databasePath, &error);
+        QMetaObject::invokeMethod(this, [this, ok, error]() {
+            m_isRestoring = false;
+            emit restoringChanged();
+            emit restoreStaged(ok, ok ? tr("Backup verified. Restart Work Log to finish restoring it.") : error);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void BackupManager::onProgress(qint64 pagesCopied, qint64 totalPages)
+{
+    m_pagesCopied = pagesCopied;
+    m_totalPages = totalPages;
+    emit progressChanged();
+}
+
+void BackupManager::onFinished(bool success, const QString &message)
+{
+    m_isBackingUp = false;
+    scheduleAutomaticBackup();
+
+    emit backingUpChanged();
+    emit backupsChanged();
+    emit backupCompleted(success, message);
+}
@@ -0,0 +1,67 @@
+#ifndef BACKUPMANAGER_H
+#define BACKUPMANAGER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVariantList>
+
+class DatabaseManager;
+class DatabaseBackup;
+class QThread;
+
+// Runs DatabaseBackup on a worker thread for QML, once a day on its own
+// and whenever asked. Restores are verified in the background and take
+// effect the next time the app starts.
+class BackupManager : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool isBackingUp READ isBackingUp NOTIFY backingUpChanged)
+    Q_PROPERTY(bool isRestoring READ isRestoring NOTIFY restoringChanged)
+    Q_PROPERTY(qint64 pagesCopied READ pagesCopied NOTIFY progressChanged)
+    Q_PROPERTY(qint64 totalPages READ totalPages NOTIFY progressChanged)
+    Q_PROPERTY(QVariantList backups READ backups NOTIFY backupsChanged)
+
+public:
+    explicit BackupManager(DatabaseManager *db, QObject *parent = nullptr);
+    ~BackupManager();
+
+    bool isBackingUp() const { return m_isBackingUp; }
+    bool isRestoring() const { return m_isRestoring; }
+    qint64 pagesCopied() const { return m_pagesCopied; }
+    qint64 totalPages() const { return m_totalPages; }
+    // fileName, path, createdAt and size of each backup, newest first
+    QVariantList backups() const;
+
+    Q_INVOKABLE bool backupNow();
+    Q_INVOKABLE void cancel();
+    Q_INVOKABLE void restoreBackup(const QString &path);
+
+signals:
+    void backingUpChanged();
+    void restoringChanged();
+    void progressChanged();
+    void backupsChanged();
+    void backupCompleted(bool success, const QString &message);
+    void restoreStaged(bool success, const QString &message);
+    void errorOccurred(const QString &error);
+
+private slots:
+    void onProgress(qint64 pagesCopied, qint64 totalPages);
+    void onFinished(bool success, const QString &message);
+
+private:
+    QString directory() const;
+    void scheduleAutomaticBackup();
+
+    DatabaseManager *m_database;
+    QPointer<DatabaseBackup> m_backup;
+    QPointer<QThread> m_thread;
+    QTimer m_automaticTimer;
+    bool m_isBackingUp = false;
+    bool m_isRestoring = false;
+    qint64 m_pagesCopied = 0;
+    qint64 m_totalPages = 0;
+};
+
+#endif // BACKUPMANAGER_H
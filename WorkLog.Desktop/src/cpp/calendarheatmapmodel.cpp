@@ -0,0 +1,217 @@
+#include "calendarheatmapmodel.h"
+#include "databasemanager.h"
+#include "diagnostics.h"
+#include "connectionpool.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+#include <cmath>
+
+CalendarHeatmapModel::CalendarHeatmapModel(DatabaseManager *db, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_database(db)
+    , m_year(QDate::currentDate().year())
+    , m_firstDay(m_year, 1, 1)
+    , m_dayCount(m_firstDay.daysInYear())
+{
+    connect(m_database, &DatabaseManager::datesChanged, this, &CalendarHeatmapModel::onDatesChanged);
+    connect(m_database, &DatabaseManager::dataChanged, this, &CalendarHeatmapModel::onDataChanged);
+    connect(m_database, &DatabaseManager::opened, this, &CalendarHeatmapModel::refresh);
+    refresh();
+}
+
+int CalendarHeatmapModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return weekCount() * 7;
+}
+
+QVariant CalendarHeatmapModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+
+    const int day = index.row() - leadingCells();
+    const bool inYear = day >= 0 && day < m_dayCount;
+
+    switch (role) {
+    case DateRole:
+        return inYear ? m_firstDay.addDays(day) : QDate();
+    case HoursRole:
+        return inYear ? m_hours[day] : 0.0;
+    case LevelRole:
+        return inYear ? level(m_hours[day]) : 0;
+    case InYearRole:
+        return inYear;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> CalendarHeatmapModel::roleNames() const
+{
+    return {
+        {DateRole, "date"},
+        {HoursRole, "hours"},
+        {LevelRole, "level"},
+        {InYearRole, "inYear"}
+    };
+}
+
+void CalendarHeatmapModel::setYear(int year)
+{
+    if (m_year == year || year <= 0)
+        return;
+
+    beginResetModel();
+    m_year = year;
+    m_firstDay = QDate(year, 1, 1);
+    m_dayCount = m_firstDay.daysInYear();
+    m_hours.fill(0.0);
+    endResetModel();
+    updateTotals();
+
+    emit yearChanged();
+    refresh();
+}
+
+int CalendarHeatmapModel::weekCount() const
+{
+    return (leadingCells() + m_dayCount + 6) / 7;
+}
+
+int CalendarHeatmapModel::leadingCells() const
+{
+    // Monday-based, as in the hierarchy's weeks
+    return m_firstDay.dayOfWeek() - 1;
+}
+
+int CalendarHeatmapModel::level(double hours) const
+{
+    if (hours <= 0.0 || m_maxHours <= 0.0)
+        return 0;
+    return qBound(1, int(std::ceil(4.0 * hours / m_maxHours)), 4);
+}
+
+bool CalendarHeatmapModel::updateTotals()
+{
+    double maxHours = 0.0;
+    double totalHours = 0.0;
+    for (int i = 0; i < m_dayCount; ++i) {
+        maxHours = qMax(maxHours, m_hours[i]);
+        totalHours += m_hours[i];
+    }
+
+    const bool maxChanged = !qFuzzyCompare(1.0 + maxHours, 1.0 + m_maxHours);
+    if (maxChanged || !qFuzzyCompare(1.0 + totalHours, 1.0 + m_totalHours)) {
+        m_maxHours = maxHours;
+        m_totalHours = totalHours;
+        emit totalsChanged();
+    }
+    return maxChanged;
+}
+
+void CalendarHeatmapModel::refresh()
+{
+    if (!m_database->isOpen()) {
+        // Until the database is open the snapshot has the daily totals
+        const HierarchySnapshot &snapshot = m_database->snapshot();
+        for (int i = 0; i < m_dayCount; ++i)
+            m_hours[i] = snapshot.totalHoursForDate(m_firstDay.addDays(i));
+        updateTotals();
+        if (rowCount() > 0)
+            emit dataChanged(index(0), index(rowCount() - 1), {HoursRole, LevelRole});
+        return;
+    }
+
+    // One grouped query on a pooled reader; a newer refresh (or another
+    // year) supersedes any still in flight
+    const quint64 generation = ++m_refreshGeneration;
+    const QDate first = m_firstDay;
+    const int dayCount = m_dayCount;
+
+    ConnectionPool::run([this, generation, first, dayCount]() {
+        const DiagnosticsTimer timer("model.CalendarHeatmapModel.refresh");
+        std::array<double, MaxDays> hours {};
+
+        QSqlQuery query(ConnectionPool::reader());
+        query.setForwardOnly(true);
+        // Archived days come from their stored totals, not the archive
+        query.prepare(QStringLiteral(R"(
+            SELECT SessionDate, SUM(Hours)
+            FROM (
+                SELECT SessionDate, TimeHours AS Hours FROM main.WorkSessions
+                WHERE SessionDate BETWEEN :first AND :last AND IsDeleted = 0
+                UNION ALL
+                SELECT SessionDate, TotalHours FROM ArchivedDays
+                WHERE SessionDate BETWEEN :first AND :last
+            )
+            GROUP BY SessionDate
+        )"));
+        query.bindValue(QStringLiteral(":first"), first.toString(Qt::ISODate));
+        query.bindValue(QStringLiteral(":last"), first.addDays(dayCount - 1).toString(Qt::ISODate));
+        if (query.exec()) {
+            while (query.next()) {
+                const qint64 day = first.daysTo(QDate::fromString(query.value(0).toString(), Qt::ISODate));
+                if (day >= 0 && day < dayCount)
+                    hours[day] = query.value(1).toDouble();
+            }
+        } else {
+            qWarning() << "Failed to load heatmap:" << query.lastError().text();
+        }
+
+        QMetaObject::invokeMethod(this, [this, generation, hours]() {
+            if (generation != m_refreshGeneration)
+                return;
+
+            m_hours = hours;
+            updateTotals();
+            if (rowCount() > 0)
+                emit dataChanged(index(0), index(rowCount() - 1), {HoursRole, LevelRole});
+        }, Qt::QueuedConnection);
+    });
+}
+
+void CalendarHeatmapModel::onDatesChanged(const QList<QDate> &dates)
+{
+    m_datesHandled = true;
+    if (!m_database->isOpen())
+        return;
+
+    const DiagnosticsTimer timer("model.CalendarHeatmapModel.updateDates");
+    QVector<int> changedRows;
+    for (const QDate &date : dates) {
+        const qint64 day = m_firstDay.daysTo(date);
+        if (day < 0 || day >= m_dayCount)
+            continue;
+
+        const double hours = m_database->getTotalHoursForDate(date);
+        if (qFuzzyCompare(1.0 + hours, 1.0 + m_hours[day]))
+            continue;
+        m_hours[day] = hours;
+        changedRows.append(leadingCells() + int(day));
+    }
+    if (changedRows.isEmpty())
+        return;
+
+    // A new busiest day rescales every cell's level
+    if (updateTotals()) {
+        emit dataChanged(index(0), index(rowCount() - 1), {HoursRole, LevelRole});
+        return;
+    }
+    for (int row : qAsConst(changedRows))
+        emit dataChanged(index(row), index(row), {HoursRole, LevelRole});
+}
+
+void CalendarHeatmapModel::onDataChanged()
+{
+    // Changes without dates (import, sync) need the whole year again
+    if (m_datesHandled) {
+        m_datesHandled = false;
+        return;
+    }
+    refresh();
+}
@@ -0,0 +1,76 @@
+#ifndef CALENDARHEATMAPMODEL_H
+#define CALENDARHEATMAPMODEL_H
+
+#include <QAbstractListModel>
+#include <QDate>
+
+#include <array>
+
+class DatabaseManager;
+
+// Daily hours of one year for a heatmap. The totals come from a single
+// grouped query into a flat array; session edits then update only the
+// cells of the dates they touched. Rows run column by column, seven per
+// week, starting on the Monday on or before January 1st, so a GridView
+// with flow TopToBottom and seven rows lays out the calendar directly.
+// Rows outside the year have an invalid date.
+class CalendarHeatmapModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int year READ year WRITE setYear NOTIFY yearChanged)
+    Q_PROPERTY(double maxHours READ maxHours NOTIFY totalsChanged)
+    Q_PROPERTY(double totalHours READ totalHours NOTIFY totalsChanged)
+    Q_PROPERTY(int weekCount READ weekCount NOTIFY yearChanged)
+
+public:
+    enum Roles {
+        DateRole = Qt::UserRole + 1,
+        HoursRole,
+        // 0 for no hours, then 1-4 by quarter of the busiest day
+        LevelRole,
+        InYearRole
+    };
+
+    explicit CalendarHeatmapModel(DatabaseManager *db, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int year() const { return m_year; }
+    void setYear(int year);
+    double maxHours() const { return m_maxHours; }
+    double totalHours() const { return m_totalHours; }
+    int weekCount() const;
+
+    Q_INVOKABLE void refresh();
+
+signals:
+    void yearChanged();
+    void totalsChanged();
+
+private slots:
+    void onDatesChanged(const QList<QDate> &dates);
+    void onDataChanged();
+
+private:
+    static constexpr int MaxDays = 366;
+
+    int leadingCells() const;
+    int level(double hours) const;
+    // Recomputes the maximum and total; true if the maximum moved
+    bool updateTotals();
+
+    DatabaseManager *m_database;
+    int m_year;
+    QDate m_firstDay;
+    int m_dayCount = 0;
+    std::array<double, MaxDays> m_hours {};
+    double m_maxHours = 0.0;
+    double m_totalHours = 0.0;
+    quint64 m_refreshGeneration = 0;
+    // The dataChanged() that follows datesChanged() is already handled
+    bool m_datesHandled = false;
+};
+
+#endif // CALENDARHEATMAPMODEL_H
@@ -0,0 +1,125 @@
+#include "connectionpool.h"
+#include "yeararchive.h"
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <QDebug>
+
+namespace {
+
+// Milliseconds a connection waits on a lock before giving up
+constexpr int BusyTimeoutMs = 5000;
+// Upper bound on background reader threads
+constexpr int MaxReaderThreads = 4;
+
+QMutex s_pathMutex;
+QString s_databasePath;
+QAtomicInt s_nextReaderId = 1;
+
+struct ReaderConnection {
+    QString name;
+
+    ~ReaderConnection()
+    {
+        {
+            QSqlDatabase db = QSqlDatabase::database(name, false);
+            if (db.isOpen())
+                db.close();
+        }
+        QSqlDatabase::removeDatabase(name);
+        YearArchive::release(name);
+    }
+};
+
+QThreadStorage<ReaderConnection *> s_readers;
+QThreadPool *s_threadPool = nullptr;
+
+} // namespace
+
+void ConnectionPool::setDatabasePath(const QString &path)
+{
+    QMutexLocker locker(&s_pathMutex);
+    s_databasePath = path;
+}
+
+QString ConnectionPool::databasePath()
+{
+    QMutexLocker locker(&s_pathMutex);
+    return s_databasePath;
+}
+
+bool ConnectionPool::configureWriter(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+
+    if (!query.exec(QStringLiteral("PRAGMA journal_mode=WAL")) || !query.next()
+        || query.value(0).toString().compare(QLatin1String("wal"), Qt::CaseInsensitive) != 0) {
+        qWarning() << "Failed to enable WAL journal:" << query.lastError().text();
+        return false;
+    }
+
+    // Durable across application crashes; only an OS crash can lose the
+    // last commits, which sync would restore anyway.
+    query.exec(QStringLiteral("PRAGMA synchronous=NORMAL"));
+    query.exec(QStringLiteral("PRAGMA busy_timeout=%1").arg(BusyTimeoutMs));
+    return true;
+}
+
+QSqlDatabase ConnectionPool::reader()
+{
+    if (ReaderConnection *connection = s_readers.localData()) {
+        QSqlDatabase db = QSqlDatabase::database(connection->name, false);
+        // Years archived or asked for since its last query
+        YearArchive::applyReader(db);
+        return db;
+    }
+
+    auto *connection = new ReaderConnection;
+    connection->name = QStringLiteral("worklog-reader-%1").arg(s_nextReaderId.fetchAndAddRelaxed(1));
+    s_readers.setLocalData(connection);
+
+    QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection->name);
+    db.setDatabaseName(databasePath());
+    db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=%1").arg(BusyTimeoutMs));
+
+    if (!db.open()) {
+        qWarning() << "Failed to open reader connection:" << db.lastError().text();
+        return db;
+    }
+    YearArchive::applyReader(db);
+    return db;
+}
+
+void ConnectionPool::releaseReader()
+{
+    if (s_readers.hasLocalData())
+        s_readers.setLocalData(nullptr);
+}
+
+QThreadPool *ConnectionPool::threadPool()
+{
+    if (!s_threadPool) {
+        s_threadPool = new QThreadPool;
+        s_threadPool->setMaxThreadCount(qBound(2, QThread::idealThreadCount(), MaxReaderThreads));
+    }
+    return s_threadPool;
+}
+
+void ConnectionPool::run(std::function<void()> task)
+{
+    threadPool()->start(std::move(task));
+}
+
+void ConnectionPool::shutdown()
+{
+    // Deleting the pool joins its threads, which closes their readers
+    delete s_threadPool;
+    s_threadPool = nullptr;
+    releaseReader();
+}
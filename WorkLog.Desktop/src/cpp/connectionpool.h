@@ -0,0 +1,39 @@
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+#include <QSqlDatabase>
+#include <QString>
+
+#include <functional>
+
+class QThreadPool;
+
+// One writer, many readers. The writer is the application's default
+// connection and is switched to WAL so readers never block it (nor it
+// them). Every thread that reads gets its own read-only connection,
+// opened on first use and closed when the thread exits. Readers see the
+// archived years asked for last (see YearArchive).
+//
+// Background queries run on a dedicated thread pool sized to the number
+// of reader connections it may hold open.
+class ConnectionPool
+{
+public:
+    static void setDatabasePath(const QString &path);
+    static QString databasePath();
+
+    // Applies WAL, synchronous=NORMAL and a busy timeout to the writer
+    static bool configureWriter(QSqlDatabase &db);
+
+    // Read-only connection owned by the calling thread
+    static QSqlDatabase reader();
+    // Closes the calling thread's reader, if any
+    static void releaseReader();
+
+    // Pool and shutdown are meant to be used from the GUI thread
+    static QThreadPool *threadPool();
+    static void run(std::function<void()> task);
+    static void shutdown();
+};
+
+#endif // CONNECTIONPOOL_H
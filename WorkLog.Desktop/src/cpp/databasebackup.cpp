@@ -0,0 +1,483 @@
+#include "databasebackup.h"
+#include "diagnostics.h"
+#include "hierarchysnapshot.h"
+#include "yeararchive.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QThread>
+#include <QDebug>
+
+// The same library the QSQLITE plugin uses; CMakeLists.txt checks that
+#include <sqlite3.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+constexpr char Magic[] = {'W', 'L', 'B', 'K'};
+constexpr quint32 FormatVersion = 1;
+constexpr int CompressionLevel = 6;
+// Uncompressed bytes per chunk
+constexpr qint64 ChunkSize = 1024 * 1024;
+constexpr int DigestSize = 32;
+
+// Pages copied per step, and the pause that lets other work in between
+constexpr int PagesPerStep = 256;
+constexpr int StepPauseMs = 5;
+constexpr int BusyTimeoutMs = 5000;
+
+constexpr char MainEntry[] = "main";
+// Staged files are named after their target plus this; the database's
+// own is written last and marks the restore as complete
+constexpr char StagedSuffix[] = ".restore";
+constexpr char UnpackingSuffix[] = ".restoring";
+
+// Closes the handle however the function returns
+struct Connection {
+    sqlite3 *db = nullptr;
+    ~Connection() { sqlite3_close(db); }
+};
+
+QString sqliteError(sqlite3 *db)
+{
+    return db ? QString::fromUtf8(sqlite3_errmsg(db)) : QStringLiteral("out of memory");
+}
+
+bool openDatabase(const QString &path, int flags, Connection *connection, QString *errorString)
+{
+    if (sqlite3_open_v2(path.toUtf8().constData(), &connection->db, flags, nullptr) != SQLITE_OK) {
+        *errorString = sqliteError(connection->db);
+        return false;
+    }
+    sqlite3_busy_timeout(connection->db, BusyTimeoutMs);
+    return true;
+}
+
+// SQLITE_OK only while no other connection, in any process, has the
+// database open; the lock lasts until the connection closes
+int lockExclusively(const QString &path, Connection *connection)
+{
+    int result = sqlite3_open_v2(path.toUtf8().constData(), &connection->db, SQLITE_OPEN_READWRITE, nullptr);
+    if (result == SQLITE_OK)
+        result = sqlite3_exec(connection->db, "PRAGMA locking_mode=EXCLUSIVE", nullptr, nullptr, nullptr);
+    if (result == SQLITE_OK)
+        result = sqlite3_exec(connection->db, "BEGIN EXCLUSIVE", nullptr, nullptr, nullptr);
+    return result;
+}
+
+bool renameOver(const QString &from, const QString &to)
+{
+    // rename(2) replaces the target in one step
+    return std::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+}
+
+// Archives staged next to the database, whatever their year
+QStringList stagedArchives(const QString &databasePath)
+{
+    const QFileInfo info(databasePath);
+    QStringList paths;
+    const QStringList files = info.dir().entryList(
+        {QStringLiteral("%1.????.db%2").arg(info.completeBaseName(), QLatin1String(StagedSuffix))}, QDir::Files);
+    for (const QString &file : files)
+        paths.append(info.dir().filePath(file));
+    return paths;
+}
+
+void discardStaged(const QString &databasePath)
+{
+    const QStringList archives = stagedArchives(databasePath);
+    for (const QString &path : archives)
+        QFile::remove(path);
+    QFile::remove(databasePath + QLatin1String(UnpackingSuffix));
+    QFile::remove(databasePath + QLatin1String(StagedSuffix));
+}
+
+bool extractEntry(QDataStream &stream, const QString &path, QString *errorString)
+{
+    qint64 size = 0;
+    stream >> size;
+
+    QFile output(path);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *errorString = DatabaseBackup::tr("Cannot write %1: %2").arg(path, output.errorString());
+        return false;
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    qint64 written = 0;
+    for (;;) {
+        QByteArray compressed;
+        stream >> compressed;
+        if (stream.status() != QDataStream::Ok) {
+            *errorString = DatabaseBackup::tr("The backup is truncated");
+            return false;
+        }
+        if (compressed.isEmpty())
+            break;
+
+        const QByteArray chunk = qUncompress(compressed);
+        if (chunk.isEmpty()) {
+            *errorString = DatabaseBackup::tr("The backup is damaged");
+            return false;
+        }
+        hash.addData(chunk);
+        written += chunk.size();
+        if (output.write(chunk) != chunk.size()) {
+            *errorString = DatabaseBackup::tr("Cannot write %1: %2").arg(path, output.errorString());
+            return false;
+        }
+    }
+
+    char digest[DigestSize];
+    if (stream.readRawData(digest, DigestSize) != DigestSize) {
+        *errorString = DatabaseBackup::tr("The backup is truncated");
+        return false;
+    }
+    if (written != size || hash.result() != QByteArray(digest, DigestSize)) {
+        *errorString = DatabaseBackup::tr("The backup is damaged: checksum mismatch");
+        return false;
+    }
+    if (!output.flush()) {
+        *errorString = DatabaseBackup::tr("Cannot write %1: %2").arg(path, output.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool checkDatabase(const QString &path, QString *errorString)
+{
+    Connection connection;
+    if (!openDatabase(path, SQLITE_OPEN_READONLY, &connection, errorString))
+        return false;
+
+    sqlite3_stmt *statement = nullptr;
+    QString result;
+    if (sqlite3_prepare_v2(connection.db, "PRAGMA quick_check", -1, &statement, nullptr) == SQLITE_OK
+        && sqlite3_step(statement) == SQLITE_ROW) {
+        result = QString::fromUtf8(reinterpret_cast<const char *>(sqlite3_column_text(statement, 0)));
+    } else {
+        result = sqliteError(connection.db);
+    }
+    sqlite3_finalize(statement);
+
+    if (result != QLatin1String("ok")) {
+        *errorString = DatabaseBackup::tr("The backed up database is damaged: %1").arg(result);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+DatabaseBackup::DatabaseBackup(const QString &databasePath, const QString &directory, QObject *parent)
+    : QObject(parent)
+    , m_databasePath(databasePath)
+    , m_directory(directory.isEmpty() ? defaultDirectory(databasePath) : directory)
+{
+}
+
+void DatabaseBackup::setKeep(int keep)
+{
+    m_keep = qMax(1, keep);
+}
+
+void DatabaseBackup::cancel()
+{
+    m_cancelled.storeRelaxed(1);
+}
+
+QString DatabaseBackup::defaultDirectory(const QString &databasePath)
+{
+    return QFileInfo(databasePath).dir().filePath(QStringLiteral("backups"));
+}
+
+QStringList DatabaseBackup::backups(const QString &directory)
+{
+    const QDir dir(directory);
+    QStringList paths;
+    const QStringList files = dir.entryList({QStringLiteral("*.wlbak")}, QDir::Files, QDir::Name | QDir::Reversed);
+    for (const QString &file : files)
+        paths.append(dir.filePath(file));
+    return paths;
+}
+
+bool DatabaseBackup::run()
+{
+    const DiagnosticsTimer timer("backup.run");
+    m_errorString.clear();
+    m_outputPath.clear();
+
+    bool ok = QDir().mkpath(m_directory);
+    if (!ok)
+        fail(tr("Cannot create %1").arg(m_directory));
+
+    // Timestamped names sort oldest to newest
+    const QString name = QStringLiteral("%1-%2.wlbak")
+        .arg(QFileInfo(m_databasePath).completeBaseName(),
+             QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-HHmmss")));
+    const QString outputPath = QDir(m_directory).filePath(name);
+    const QString copyPath = QDir(m_directory).filePath(QStringLiteral(".%1.db").arg(name));
+
+    QList<int> archivedYears;
+    ok = ok && copyDatabase(copyPath, &archivedYears);
+    ok = ok && writeSnapshot(copyPath, archivedYears, outputPath);
+    QFile::remove(copyPath);
+
+    if (ok) {
+        m_outputPath = outputPath;
+        rotate();
+    }
+
+    const QString message = ok ? tr("Backed up to %1").arg(outputPath) : m_errorString;
+    emit finished(ok, message);
+    return ok;
+}
+
+bool DatabaseBackup::copyDatabase(const QString &copyPath, QList<int> *archivedYears)
+{
+    const DiagnosticsTimer timer("backup.copy");
+    QFile::remove(copyPath);
+
+    Connection source;
+    Connection copy;
+    QString error;
+    if (!openDatabase(m_databasePath, SQLITE_OPEN_READONLY, &source, &error))
+        return fail(tr("Failed to open database: %1").arg(error));
+    if (!openDatabase(copyPath, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, &copy, &error))
+        return fail(tr("Cannot write %1: %2").arg(copyPath, error));
+
+    // One read transaction spans every step: the copy is the database as
+    // it was at the start, and commits made meanwhile neither wait for the
+    // copy nor make it start over
+    if (sqlite3_exec(source.db, "BEGIN; SELECT COUNT(*) FROM sqlite_master", nullptr, nullptr, nullptr) != SQLITE_OK)
+        return fail(tr("Failed to read database: %1").arg(sqliteError(source.db)));
+
+    sqlite3_backup *backup = sqlite3_backup_init(copy.db, "main", source.db, "main");
+    if (!backup)
+        return fail(tr("Failed to start backup: %1").arg(sqliteError(copy.db)));
+
+    int rc = SQLITE_OK;
+    while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+        if (m_cancelled.loadRelaxed())
+            break;
+        rc = sqlite3_backup_step(backup, PagesPerStep);
+        const int totalPages = sqlite3_backup_pagecount(backup);
+        emit progress(totalPages - sqlite3_backup_remaining(backup), totalPages);
+        if (rc != SQLITE_DONE)
+            QThread::msleep(StepPauseMs);
+    }
+    sqlite3_backup_finish(backup);
+    sqlite3_exec(source.db, "COMMIT", nullptr, nullptr, nullptr);
+
+    if (m_cancelled.loadRelaxed())
+        return fail(tr("Backup cancelled"));
+    if (rc != SQLITE_DONE)
+        return fail(tr("Failed to copy database: %1").arg(QString::fromUtf8(sqlite3_errstr(rc))));
+
+    // The copy must stand alone, without a log next to it
+    sqlite3_exec(copy.db, "PRAGMA journal_mode=DELETE", nullptr, nullptr, nullptr);
+
+    // The archives the copy lists go with it
+    sqlite3_stmt *statement = nullptr;
+    if (sqlite3_prepare_v2(copy.db, "SELECT Year FROM Archives", -1, &statement, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(statement) == SQLITE_ROW)
+            archivedYears->append(sqlite3_column_int(statement, 0));
+    }
+    sqlite3_finalize(statement);
+    return true;
+}
+
+bool DatabaseBackup::writeSnapshot(const QString &copyPath, const QList<int> &archivedYears,
+                                   const QString &outputPath)
+{
+    const DiagnosticsTimer timer("backup.compress");
+
+    QSaveFile file(outputPath);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(tr("Cannot write %1: %2").arg(outputPath, file.errorString()));
+
+    QDataStream stream(&file);
+    stream.writeRawData(Magic, sizeof(Magic));
+    stream << FormatVersion;
+
+    bool ok = writeEntry(stream, QByteArray(MainEntry), copyPath);
+    for (int year : archivedYears) {
+        // Never written to once created, so read as they are
+        ok = ok && writeEntry(stream, QByteArray::number(year), YearArchive::pathForYear(m_databasePath, year));
+    }
+    stream << QByteArray();
+
+    if (!ok) {
+        file.cancelWriting();
+        return false;
+    }
+    if (stream.status() != QDataStream::Ok || !file.commit())
+        return fail(tr("Cannot write %1: %2").arg(outputPath, file.errorString()));
+    return true;
+}
+
+bool DatabaseBackup::writeEntry(QDataStream &stream, const QByteArray &name, const QString &path)
+{
+    QFile input(path);
+    if (!input.open(QIODevice::ReadOnly))
+        return fail(tr("Cannot read %1: %2").arg(path, input.errorString()));
+
+    // Name and size, the compressed chunks, an empty chunk, then the digest
+    // of the uncompressed bytes
+    stream << name << qint64(input.size());
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    for (;;) {
+        if (m_cancelled.loadRelaxed())
+            return fail(tr("Backup cancelled"));
+        const QByteArray chunk = input.read(ChunkSize);
+        if (chunk.isEmpty())
+            break;
+        hash.addData(chunk);
+        stream << qCompress(chunk, CompressionLevel);
+    }
+    if (input.error() != QFileDevice::NoError)
+        return fail(tr("Cannot read %1: %2").arg(path, input.errorString()));
+
+    stream << QByteArray();
+    const QByteArray digest = hash.result();
+    stream.writeRawData(digest.constData(), digest.size());
+    return true;
+}
+
+void DatabaseBackup::rotate()
+{
+    const QStringList paths = backups(m_directory);
+    for (int i = m_keep; i < paths.size(); ++i) {
+        if (!QFile::remove(paths.at(i)))
+            qWarning() << "Failed to remove old backup:" << paths.at(i);
+    }
+}
+
+bool DatabaseBackup::fail(const QString &message)
+{
+    qWarning() << "Backup failed:" << message;
+    m_errorString = message;
+    return false;
+}
+
+bool DatabaseBackup::stageRestore(const QString &backupPath, const QString &databasePath, QString *errorString)
+{
+    const DiagnosticsTimer timer("backup.stageRestore");
+    QString error;
+    auto fail = [&](const QString &message) {
+        qWarning() << "Restore failed:" << message;
+        discardStaged(databasePath);
+        if (errorString)
+            *errorString = message;
+        return false;
+    };
+
+    // Left over from an earlier attempt
+    discardStaged(databasePath);
+
+    QFile file(backupPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(tr("Cannot read %1: %2").arg(backupPath, file.errorString()));
+
+    QDataStream stream(&file);
+    char magic[sizeof(Magic)];
+    if (stream.readRawData(magic, sizeof(magic)) != int(sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)) != 0)
+        return fail(tr("%1 is not a Work Log backup").arg(backupPath));
+    quint32 version = 0;
+    stream >> version;
+    if (version != FormatVersion)
+        return fail(tr("Unsupported backup version: %1").arg(version));
+
+    const QString unpackedPath = databasePath + QLatin1String(UnpackingSuffix);
+    bool hasMain = false;
+    for (;;) {
+        QByteArray name;
+        stream >> name;
+        if (stream.status() != QDataStream::Ok)
+            return fail(tr("The backup is truncated"));
+        if (name.isEmpty())
+            break;
+
+        QString target;
+        if (name == MainEntry) {
+            target = unpackedPath;
+            hasMain = true;
+        } else {
+            bool ok = false;
+            const int year = name.toInt(&ok);
+            if (!ok)
+                return fail(tr("The backup is damaged"));
+            target = YearArchive::pathForYear(databasePath, year) + QLatin1String(StagedSuffix);
+        }
+        if (!extractEntry(stream, target, &error))
+            return fail(error);
+    }
+
+    if (!hasMain)
+        return fail(tr("The backup holds no database"));
+    if (!checkDatabase(unpackedPath, &error))
+        return fail(error);
+
+    // Complete and verified: from here on the next open applies it
+    if (!renameOver(unpackedPath, databasePath + QLatin1String(StagedSuffix)))
+        return fail(tr("Cannot write %1").arg(databasePath + QLatin1String(StagedSuffix)));
+    return true;
+}
+
+bool DatabaseBackup::applyStagedRestore(const QString &databasePath, QString *errorString)
+{
+    const QString stagedPath = databasePath + QLatin1String(StagedSuffix);
+    if (!QFile::exists(stagedPath)) {
+        // A restore that never finished staging
+        discardStaged(databasePath);
+        return true;
+    }
+
+    // Another process (the desktop app, while a cron job runs the CLI)
+    // may still have the database open; then the restore waits for a
+    // later open
+    Connection live;
+    const int locked = QFile::exists(databasePath) ? lockExclusively(databasePath, &live) : SQLITE_OK;
+    // A damaged database is what restores are for, and nothing can use it
+    if (locked != SQLITE_OK && locked != SQLITE_NOTADB && locked != SQLITE_CORRUPT) {
+        if (errorString)
+            *errorString = tr("%1 is in use; the backup will be restored the next time it is opened "
+                              "while nothing else has it open").arg(databasePath);
+        return false;
+    }
+
+    const DiagnosticsTimer timer("backup.applyRestore");
+    const QString suffix = QLatin1String(StagedSuffix);
+
+    // Archives first: the database, which lists them, going last keeps the
+    // restore repeatable if it stops halfway
+    const QStringList archives = stagedArchives(databasePath);
+    for (const QString &path : archives) {
+        const QString target = path.left(path.size() - suffix.size());
+        if (!renameOver(path, target)) {
+            if (errorString)
+                *errorString = tr("Cannot replace %1").arg(target);
+            return false;
+        }
+    }
+
+    // The old database's log must not be replayed into the new one
+    QFile::remove(databasePath + QStringLiteral("-wal"));
+    QFile::remove(databasePath + QStringLiteral("-shm"));
+    if (!renameOver(stagedPath, databasePath)) {
+        if (errorString)
+            *errorString = tr("Cannot replace %1").arg(databasePath);
+        return false;
+    }
+
+    // Describes the replaced database
+    QFile::remove(HierarchySnapshot::pathForDatabase(databasePath));
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef DATABASEBACKUP_H
+#define DATABASEBACKUP_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+class QDataStream;
+
+// Snapshots the database into a compressed, checksummed backup file while
+// it stays in use. SQLite's online backup API copies the pages a slice at
+// a time inside one read transaction, so the copy is the database as of
+// the start and writers (WAL) never wait on it. The copy and the year
+// archives it lists are then written as zlib chunks, each file followed
+// by its SHA-256. Only the newest backups in the directory are kept.
+//
+// Restoring is split in two: stageRestore() unpacks a backup next to the
+// database and verifies checksums and integrity, and applyStagedRestore()
+// renames the staged files into place before the database is next
+// opened. Nothing is replaced unless the whole backup checked out.
+//
+// run() is synchronous, like SessionExporter::run(), so it can be called
+// directly (CLI) or from a worker thread (BackupManager).
+class DatabaseBackup : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int DefaultKeep = 7;
+
+    DatabaseBackup(const QString &databasePath, const QString &directory, QObject *parent = nullptr);
+
+    void setKeep(int keep);
+
+    bool run();
+    void cancel();
+
+    QString outputPath() const { return m_outputPath; }
+    QString errorString() const { return m_errorString; }
+
+    static QString defaultDirectory(const QString &databasePath);
+    // Backup files in the directory, newest first
+    static QStringList backups(const QString &directory);
+
+    static bool stageRestore(const QString &backupPath, const QString &databasePath, QString *errorString);
+    // Does nothing unless a restore was staged. Fails, leaving it staged,
+    // while any other connection (in this or another process) has the
+    // database open.
+    static bool applyStagedRestore(const QString &databasePath, QString *errorString);
+
+signals:
+    void progress(qint64 pagesCopied, qint64 totalPages);
+    void finished(bool success, const QString &message);
+
+private:
+    bool copyDatabase(const QString &copyPath, QList<int> *archivedYears);
+    bool writeSnapshot(const QString &copyPath, const QList<int> &archivedYears, const QString &outputPath);
+    bool writeEntry(QDataStream &stream, const QByteArray &name, const QString &path);
+    void rotate();
+    bool fail(const QString &message);
+
+    QString m_databasePath;
+    QString m_directory;
+    int m_keep = DefaultKeep;
+    QAtomicInt m_cancelled;
+    QString m_outputPath;
+    QString m_errorString;
+};
+
+#endif // DATABASEBACKUP_H
@@ -1,24 +1,54 @@
 #include "databasemanager.h"
+#include "connectionpool.h"
+#include "diagnostics.h"
+#include "hybridclock.h"
+#include "syncrecords.h"
+#include "yeararchive.h"
+#include "databasebackup.h"
+#include "maintenancescheduler.h"
 
 #include <QStandardPaths>
 #include <QDir>
+#include <QFile>
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QDebug>
+#include <QVector>
+
+namespace {
+
+// Quiet period after the last change before the snapshot is rewritten
+constexpr int SnapshotDelayMs = 1000;
+
+} // namespace
 
 DatabaseManager::DatabaseManager(QObject *parent)
     : QObject(parent)
 {
+    m_snapshotTimer.setSingleShot(true);
+    m_snapshotTimer.setInterval(SnapshotDelayMs);
+    connect(&m_snapshotTimer, &QTimer::timeout, this, &DatabaseManager::writeSnapshot);
 }
 
 DatabaseManager::~DatabaseManager()
 {
+    // Don't lose the last edits' snapshot on quit
+    if (m_snapshotTimer.isActive()) {
+        m_snapshotTimer.stop();
+        QString errorString;
+        if (!HierarchySnapshot::write(HierarchySnapshot::pathForDatabase(m_databasePath),
+                                      ConnectionPool::reader(), &errorString)) {
+            qWarning() << "Failed to write snapshot:" << errorString;
+        }
+    }
+
+    ConnectionPool::shutdown();
     if (m_database.isOpen()) {
         m_database.close();
     }
 }
 
-bool DatabaseManager::initialize()
+QString DatabaseManager::defaultDatabasePath()
 {
     QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
     QDir dir(dataPath);
@@ -26,7 +56,26 @@ bool DatabaseManager::initialize()
         dir.mkpath(dataPath);
     }
 
-    m_databasePath = dataPath + QStringLiteral("/worklog.db");
+    return dataPath + QStringLiteral("/worklog.db");
+}
+
+bool DatabaseManager::openSnapshot(const QString &databasePath)
+{
+    const QString path = databasePath.isEmpty() ? defaultDatabasePath() : databasePath;
+    m_snapshotEnabled = true;
+    return m_snapshot.open(HierarchySnapshot::pathForDatabase(path));
+}
+
+bool DatabaseManager::initialize(const QString &databasePath)
+{
+    m_databasePath = databasePath.isEmpty() ? defaultDatabasePath() : databasePath;
+
+    // A restore verified earlier replaces the files before anything opens them
+    QString restoreError;
+    if (!DatabaseBackup::applyStagedRestore(m_databasePath, &restoreError)) {
+        qWarning() << "Failed to restore backup:" << restoreError;
+        emit errorOccurred(restoreError);
+    }
 
     m_database = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"));
     m_database.setDatabaseName(m_databasePath);
@@ -37,7 +86,45 @@ bool DatabaseManager::initialize()
         return false;
     }
 
-    return createTables();
+    // Only takes effect on a database without tables yet; existing ones
+    // are converted below, before anything else writes
+    QSqlQuery(m_database).exec(QStringLiteral("PRAGMA auto_vacuum=INCREMENTAL"));
+
+    // Readers open lazily, so WAL must be in place before the first query
+    ConnectionPool::setDatabasePath(m_databasePath);
+    ConnectionPool::configureWriter(m_database);
+
+    if (!createTables())
+        return false;
+    MaintenanceScheduler::convert(m_database);
+    YearArchive::load(m_database);
+
+    m_isOpen = true;
+    // Lookups made before the database was open found nothing
+    m_tagRegistry.invalidate();
+    m_dayCache.clear();
+    emit opened();
+
+    // Models read the database from here on
+    m_snapshot.close();
+    if (m_snapshotEnabled) {
+        connect(this, &DatabaseManager::dataChanged, &m_snapshotTimer, qOverload<>(&QTimer::start));
+        connect(this, &DatabaseManager::tagsChanged, &m_snapshotTimer, qOverload<>(&QTimer::start));
+        // Refresh it now too: the recent days move on, and the database
+        // may have changed without the app (command line client, sync)
+        m_snapshotTimer.start();
+    }
+    return true;
+}
+
+void DatabaseManager::writeSnapshot()
+{
+    const QString path = HierarchySnapshot::pathForDatabase(m_databasePath);
+    ConnectionPool::run([path]() {
+        QString errorString;
+        if (!HierarchySnapshot::write(path, ConnectionPool::reader(), &errorString))
+            qWarning() << "Failed to write snapshot:" << errorString;
+    });
 }
 
 bool DatabaseManager::createTables()
@@ -51,6 +138,7 @@ bool DatabaseManager::createTables()
             Name TEXT NOT NULL UNIQUE,
             CloudId TEXT,
             UpdatedAt TEXT NOT NULL DEFAULT (datetime('now')),
+            Hlc INTEGER NOT NULL DEFAULT 0,
             IsDeleted INTEGER NOT NULL DEFAULT 0
         )
     )");
@@ -73,6 +161,8 @@ bool DatabaseManager::createTables()
             TagId INTEGER,
             CreatedAt TEXT NOT NULL DEFAULT (datetime('now')),
             UpdatedAt TEXT NOT NULL DEFAULT (datetime('now')),
+            Hlc INTEGER NOT NULL DEFAULT 0,
+            DirtyFields INTEGER NOT NULL DEFAULT 0,
             CloudId TEXT,
             IsDeleted INTEGER NOT NULL DEFAULT 0,
             TagCloudId TEXT,
@@ -98,6 +188,61 @@ bool DatabaseManager::createTables()
         qWarning() << "Failed to create SyncMetadata table:" << query.lastError().text();
     }
 
+    // Create SyncOutbox table: records waiting to be uploaded, one per
+    // CloudId, kept until the target confirms them
+    QString createSyncOutboxTable = QStringLiteral(R"(
+        CREATE TABLE IF NOT EXISTS SyncOutbox (
+            Id INTEGER PRIMARY KEY AUTOINCREMENT,
+            IdempotencyKey TEXT NOT NULL UNIQUE,
+            CloudId TEXT NOT NULL UNIQUE,
+            DirtyFields INTEGER NOT NULL DEFAULT 0,
+            Payload BLOB NOT NULL,
+            CreatedAt TEXT NOT NULL DEFAULT (datetime('now'))
+        )
+    )");
+
+    if (!query.exec(createSyncOutboxTable)) {
+        qWarning() << "Failed to create SyncOutbox table:" << query.lastError().text();
+    }
+
+    // Years moved to archives, and the daily totals they hold
+    QString createArchivesTable = QStringLiteral(R"(
+        CREATE TABLE IF NOT EXISTS Archives (
+            Year INTEGER PRIMARY KEY,
+            Sessions INTEGER NOT NULL,
+            ArchivedAt TEXT NOT NULL DEFAULT (datetime('now'))
+        )
+    )");
+
+    if (!query.exec(createArchivesTable)) {
+        qWarning() << "Failed to create Archives table:" << query.lastError().text();
+    }
+
+    QString createArchivedDaysTable = QStringLiteral(R"(
+        CREATE TABLE IF NOT EXISTS ArchivedDays (
+            SessionDate TEXT PRIMARY KEY,
+            TotalHours REAL NOT NULL
+        )
+    )");
+
+    if (!query.exec(createArchivedDaysTable)) {
+        qWarning() << "Failed to create ArchivedDays table:" << query.lastError().text();
+    }
+
+    // Last outcome of each background maintenance task
+    QString createMaintenanceTable = QStringLiteral(R"(
+        CREATE TABLE IF NOT EXISTS Maintenance (
+            Task TEXT PRIMARY KEY,
+            FinishedAt TEXT NOT NULL,
+            DurationMs REAL NOT NULL,
+            Result TEXT
+        )
+    )");
+
+    if (!query.exec(createMaintenanceTable)) {
+        qWarning() << "Failed to create Maintenance table:" << query.lastError().text();
+    }
+
     // Migration: Add new columns for existing databases
     query.exec(QStringLiteral("ALTER TABLE WorkSessions ADD COLUMN TagId INTEGER REFERENCES Tags(Id) ON DELETE SET NULL"));
     query.exec(QStringLiteral("ALTER TABLE WorkSessions ADD COLUMN CloudId TEXT"));
@@ -106,6 +251,19 @@ bool DatabaseManager::createTables()
     query.exec(QStringLiteral("ALTER TABLE Tags ADD COLUMN CloudId TEXT"));
     query.exec(QStringLiteral("ALTER TABLE Tags ADD COLUMN UpdatedAt TEXT NOT NULL DEFAULT (datetime('now'))"));
     query.exec(QStringLiteral("ALTER TABLE Tags ADD COLUMN IsDeleted INTEGER NOT NULL DEFAULT 0"));
+    query.exec(QStringLiteral("ALTER TABLE Tags ADD COLUMN Hlc INTEGER NOT NULL DEFAULT 0"));
+    query.exec(QStringLiteral("ALTER TABLE WorkSessions ADD COLUMN Hlc INTEGER NOT NULL DEFAULT 0"));
+    query.exec(QStringLiteral("ALTER TABLE WorkSessions ADD COLUMN DirtyFields INTEGER NOT NULL DEFAULT 0"));
+
+    // Rows from before the clock get one derived from UpdatedAt (UTC)
+    query.exec(QStringLiteral("UPDATE Tags SET Hlc = (CAST(strftime('%s', UpdatedAt) AS INTEGER) * 1000) << 16 WHERE Hlc = 0"));
+    query.exec(QStringLiteral("UPDATE WorkSessions SET Hlc = (CAST(strftime('%s', UpdatedAt) AS INTEGER) * 1000) << 16 WHERE Hlc = 0"));
+
+    // Never issue a timestamp below one already stored
+    if (query.exec(QStringLiteral("SELECT MAX(Hlc) FROM (SELECT Hlc FROM Tags UNION ALL SELECT Hlc FROM WorkSessions)"))
+        && query.next()) {
+        HybridClock::observe(query.value(0).toLongLong());
+    }
 
     // Create indexes
     query.exec(QStringLiteral("CREATE INDEX IF NOT EXISTS idx_worksessions_date ON WorkSessions(SessionDate)"));
@@ -120,16 +278,143 @@ QString DatabaseManager::databasePath() const
     return m_databasePath;
 }
 
+int DatabaseManager::archiveClosedYears()
+{
+    const DiagnosticsTimer timer("db.archiveClosedYears");
+    if (m_batchDepth > 0) {
+        qWarning() << "Failed to archive: a batch is open";
+        return -1;
+    }
+
+    QList<int> years;
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral(R"(
+        SELECT DISTINCT CAST(strftime('%Y', SessionDate) AS INTEGER) AS Year
+        FROM main.WorkSessions
+        WHERE SessionDate < :first
+        ORDER BY Year ASC
+    )"));
+    // A year closes a month after it ends, so the recent days stay hot
+    const int openYear = QDate::currentDate().addMonths(-1).year();
+    query.bindValue(QStringLiteral(":first"), QDate(openYear, 1, 1).toString(Qt::ISODate));
+    if (!query.exec()) {
+        qWarning() << "Failed to find closed years:" << query.lastError().text();
+        emit errorOccurred(query.lastError().text());
+        return -1;
+    }
+    while (query.next())
+        years.append(query.value(0).toInt());
+    query.finish();
+
+    int archived = 0;
+    for (int year : qAsConst(years)) {
+        // One file per year: sessions added since join the archived ones
+        if (YearArchive::isArchived(year) && !restoreYear(year))
+            break;
+
+        QString error;
+        if (!YearArchive::archiveYear(m_database, year, &error)) {
+            qWarning() << "Failed to archive year" << year << ":" << error;
+            emit errorOccurred(error);
+            break;
+        }
+        ++archived;
+    }
+    reloadArchives();
+
+    // The freed pages go back to the file system in slices once the app
+    // is idle (MaintenanceScheduler), not here on the caller's thread
+    if (archived > 0)
+        notifyDataChanged();
+    return archived == years.size() ? archived : -1;
+}
+
+bool DatabaseManager::restoreYear(int year)
+{
+    const DiagnosticsTimer timer("db.restoreYear");
+    if (!YearArchive::isArchived(year) || !beginBatch())
+        return false;
+
+    QString error;
+    if (!YearArchive::restoreYear(m_database, year, &error)) {
+        qWarning() << "Failed to restore year" << year << ":" << error;
+        emit errorOccurred(error);
+        rollbackBatch();
+        return false;
+    }
+    m_archivesChanged = true;
+    return commitBatch();
+}
+
+QVariantList DatabaseManager::archivedYears() const
+{
+    QVariantList results;
+    const QList<int> years = YearArchive::archivedYears();
+    for (int year : years)
+        results.append(year);
+    return results;
+}
+
+void DatabaseManager::attachYears(int first, int last)
+{
+    // Days read before came without the archive
+    if (YearArchive::requireYears(first, last))
+        m_dayCache.clear();
+}
+
+bool DatabaseManager::restoreArchivedYears(const QString &condition, const QVariantMap &bindings)
+{
+    if (YearArchive::archivedYears().isEmpty())
+        return true;
+
+    // One archive at a time, so it works inside a batch too
+    QList<int> years;
+    const QList<int> archived = YearArchive::archivedYears();
+    for (int year : archived) {
+        QString error;
+        const bool read = YearArchive::queryYear(
+            m_database, year, QStringLiteral("SELECT 1 FROM WorkSessions WHERE %1 LIMIT 1").arg(condition),
+            bindings, [&years, year](const QSqlQuery &) {
+                years.append(year);
+                return true;
+            }, &error);
+        if (!read) {
+            qWarning() << "Failed to look up archived sessions:" << year << error;
+            emit errorOccurred(error);
+            return false;
+        }
+    }
+    if (years.isEmpty())
+        return true;
+
+    if (!beginBatch())
+        return false;
+    for (int year : qAsConst(years)) {
+        if (!restoreYear(year)) {
+            rollbackBatch();
+            return false;
+        }
+    }
+    return commitBatch();
+}
+
+void DatabaseManager::reloadArchives()
+{
+    YearArchive::load(m_database);
+    m_dayCache.clear();
+}
+
 bool DatabaseManager::createSession(const QDate &date, double timeHours,
                                     const QString &description,
                                     const QString &notes,
                                     const QString &nextPlannedStage,
                                     int tagId)
 {
+    const DiagnosticsTimer timer("db.createSession");
     QSqlQuery query(m_database);
     query.prepare(QStringLiteral(R"(
-        INSERT INTO WorkSessions (SessionDate, TimeHours, Description, Notes, NextPlannedStage, TagId)
-        VALUES (:date, :hours, :desc, :notes, :next, :tagId)
+        INSERT INTO WorkSessions (SessionDate, TimeHours, Description, Notes, NextPlannedStage, TagId, Hlc)
+        VALUES (:date, :hours, :desc, :notes, :next, :tagId, :hlc)
     )"));
 
     query.bindValue(QStringLiteral(":date"), date.toString(Qt::ISODate));
@@ -138,6 +423,7 @@ bool DatabaseManager::createSession(const QDate &date, double timeHours,
     query.bindValue(QStringLiteral(":notes"), notes.isEmpty() ? QVariant() : notes);
     query.bindValue(QStringLiteral(":next"), nextPlannedStage.isEmpty() ? QVariant() : nextPlannedStage);
     query.bindValue(QStringLiteral(":tagId"), tagId > 0 ? tagId : QVariant());
+    query.bindValue(QStringLiteral(":hlc"), HybridClock::now());
 
     if (!query.exec()) {
         qWarning() << "Failed to create session:" << query.lastError().text();
@@ -145,7 +431,7 @@ bool DatabaseManager::createSession(const QDate &date, double timeHours,
         return false;
     }
 
-    emit dataChanged();
+    notifyDataChanged({date});
     return true;
 }
 
@@ -155,13 +441,33 @@ bool DatabaseManager::updateSession(int id, const QDate &date, double timeHours,
                                     const QString &nextPlannedStage,
                                     int tagId)
 {
+    const DiagnosticsTimer timer("db.updateSession");
+    if (!restoreArchivedYears(QStringLiteral("Id = :id"), {{QStringLiteral(":id"), id}}))
+        return false;
+    const QDate oldDate = sessionDate(id);
     QSqlQuery query(m_database);
+    // Right-hand sides see the old row, so DirtyFields picks up exactly
+    // the fields this edit changes; sync then uploads only those
     query.prepare(QStringLiteral(R"(
         UPDATE WorkSessions
         SET SessionDate = :date, TimeHours = :hours, Description = :desc,
-            Notes = :notes, NextPlannedStage = :next, TagId = :tagId, UpdatedAt = datetime('now')
+            Notes = :notes, NextPlannedStage = :next, TagId = :tagId, UpdatedAt = datetime('now'),
+            TagCloudId = CASE WHEN TagId IS :tagId THEN TagCloudId ELSE NULL END,
+            Hlc = :hlc,
+            DirtyFields = DirtyFields
+                | (CASE WHEN SessionDate IS NOT :date THEN %1 ELSE 0 END)
+                | (CASE WHEN TimeHours IS NOT :hours THEN %2 ELSE 0 END)
+                | (CASE WHEN Description IS NOT :desc THEN %3 ELSE 0 END)
+                | (CASE WHEN Notes IS NOT :notes THEN %4 ELSE 0 END)
+                | (CASE WHEN NextPlannedStage IS NOT :next THEN %5 ELSE 0 END)
+                | (CASE WHEN TagId IS NOT :tagId THEN %6 ELSE 0 END)
         WHERE Id = :id
-    )"));
+    )").arg(SyncSessionRecord::DateDirty)
+       .arg(SyncSessionRecord::HoursDirty)
+       .arg(SyncSessionRecord::DescriptionDirty)
+       .arg(SyncSessionRecord::NotesDirty)
+       .arg(SyncSessionRecord::NextStageDirty)
+       .arg(SyncSessionRecord::TagDirty));
 
     query.bindValue(QStringLiteral(":id"), id);
     query.bindValue(QStringLiteral(":date"), date.toString(Qt::ISODate));
@@ -170,6 +476,7 @@ bool DatabaseManager::updateSession(int id, const QDate &date, double timeHours,
     query.bindValue(QStringLiteral(":notes"), notes.isEmpty() ? QVariant() : notes);
     query.bindValue(QStringLiteral(":next"), nextPlannedStage.isEmpty() ? QVariant() : nextPlannedStage);
     query.bindValue(QStringLiteral(":tagId"), tagId > 0 ? tagId : QVariant());
+    query.bindValue(QStringLiteral(":hlc"), HybridClock::now());
 
     if (!query.exec()) {
         qWarning() << "Failed to update session:" << query.lastError().text();
@@ -177,12 +484,16 @@ bool DatabaseManager::updateSession(int id, const QDate &date, double timeHours,
         return false;
     }
 
-    emit dataChanged();
+    notifyDataChanged(oldDate.isValid() && oldDate != date ? QList<QDate>{oldDate, date} : QList<QDate>{date});
     return true;
 }
 
 bool DatabaseManager::deleteSession(int id)
 {
+    const DiagnosticsTimer timer("db.deleteSession");
+    if (!restoreArchivedYears(QStringLiteral("Id = :id"), {{QStringLiteral(":id"), id}}))
+        return false;
+    const QDate date = sessionDate(id);
     QSqlQuery query(m_database);
     query.prepare(QStringLiteral("DELETE FROM WorkSessions WHERE Id = :id"));
     query.bindValue(QStringLiteral(":id"), id);
@@ -193,14 +504,287 @@ bool DatabaseManager::deleteSession(int id)
         return false;
     }
 
-    emit dataChanged();
+    notifyDataChanged(date.isValid() ? QList<QDate>{date} : QList<QDate>());
     return true;
 }
 
+int DatabaseManager::retagSessions(const QVariantList &ids, int tagId)
+{
+    const DiagnosticsTimer timer("db.retagSessions");
+    if (!beginBatch())
+        return -1;
+
+    // Sessions already on the tag keep their clock and dirty bits
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral(R"(
+        UPDATE WorkSessions
+        SET TagId = :tagId, TagCloudId = NULL, UpdatedAt = datetime('now'),
+            Hlc = :hlc, DirtyFields = DirtyFields | %1
+        WHERE Id = :id AND TagId IS NOT :tagId
+    )").arg(SyncSessionRecord::TagDirty));
+
+    QList<QDate> dates;
+    int changed = 0;
+    for (const QVariant &id : ids) {
+        if (!restoreArchivedYears(QStringLiteral("Id = :id"), {{QStringLiteral(":id"), id.toInt()}})) {
+            rollbackBatch();
+            return -1;
+        }
+        query.bindValue(QStringLiteral(":id"), id.toInt());
+        query.bindValue(QStringLiteral(":tagId"), tagId > 0 ? tagId : QVariant());
+        query.bindValue(QStringLiteral(":hlc"), HybridClock::now());
+        if (!query.exec()) {
+            qWarning() << "Failed to retag sessions:" << query.lastError().text();
+            emit errorOccurred(query.lastError().text());
+            rollbackBatch();
+            return -1;
+        }
+        if (query.numRowsAffected() > 0) {
+            dates.append(sessionDate(id.toInt()));
+            ++changed;
+        }
+    }
+
+    if (changed > 0)
+        notifyDataChanged(dates);
+    return commitBatch() ? changed : -1;
+}
+
+int DatabaseManager::moveSessions(const QVariantList &ids, const QDate &date)
+{
+    const DiagnosticsTimer timer("db.moveSessions");
+    if (!date.isValid() || !beginBatch())
+        return -1;
+
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral(R"(
+        UPDATE WorkSessions
+        SET SessionDate = :date, UpdatedAt = datetime('now'),
+            Hlc = :hlc, DirtyFields = DirtyFields | %1
+        WHERE Id = :id AND SessionDate IS NOT :date
+    )").arg(SyncSessionRecord::DateDirty));
+
+    QList<QDate> dates;
+    int changed = 0;
+    for (const QVariant &id : ids) {
+        if (!restoreArchivedYears(QStringLiteral("Id = :id"), {{QStringLiteral(":id"), id.toInt()}})) {
+            rollbackBatch();
+            return -1;
+        }
+        const QDate oldDate = sessionDate(id.toInt());
+        query.bindValue(QStringLiteral(":id"), id.toInt());
+        query.bindValue(QStringLiteral(":date"), date.toString(Qt::ISODate));
+        query.bindValue(QStringLiteral(":hlc"), HybridClock::now());
+        if (!query.exec()) {
+            qWarning() << "Failed to move sessions:" << query.lastError().text();
+            emit errorOccurred(query.lastError().text());
+            rollbackBatch();
+            return -1;
+        }
+        if (query.numRowsAffected() > 0) {
+            dates.append(oldDate);
+            ++changed;
+        }
+    }
+    dates.append(date);
+
+    if (changed > 0)
+        notifyDataChanged(dates);
+    return commitBatch() ? changed : -1;
+}
+
+int DatabaseManager::deleteSessions(const QVariantList &ids)
+{
+    const DiagnosticsTimer timer("db.deleteSessions");
+    if (!beginBatch())
+        return -1;
+
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral("DELETE FROM WorkSessions WHERE Id = :id"));
+
+    QList<QDate> dates;
+    int changed = 0;
+    for (const QVariant &id : ids) {
+        if (!restoreArchivedYears(QStringLiteral("Id = :id"), {{QStringLiteral(":id"), id.toInt()}})) {
+            rollbackBatch();
+            return -1;
+        }
+        const QDate date = sessionDate(id.toInt());
+        query.bindValue(QStringLiteral(":id"), id.toInt());
+        if (!query.exec()) {
+            qWarning() << "Failed to delete sessions:" << query.lastError().text();
+            emit errorOccurred(query.lastError().text());
+            rollbackBatch();
+            return -1;
+        }
+        if (query.numRowsAffected() > 0) {
+            dates.append(date);
+            ++changed;
+        }
+    }
+
+    if (changed > 0)
+        notifyDataChanged(dates);
+    return commitBatch() ? changed : -1;
+}
+
+bool DatabaseManager::beginBatch()
+{
+    if (m_batchDepth == 0) {
+        if (!m_database.transaction()) {
+            qWarning() << "Failed to begin batch:" << m_database.lastError().text();
+            emit errorOccurred(m_database.lastError().text());
+            return false;
+        }
+        m_batchRolledBack = false;
+    }
+    ++m_batchDepth;
+    return true;
+}
+
+bool DatabaseManager::commitBatch()
+{
+    if (m_batchDepth == 0) {
+        qWarning() << "commitBatch() without beginBatch()";
+        return false;
+    }
+    if (--m_batchDepth > 0)
+        return !m_batchRolledBack;
+
+    bool committed = false;
+    if (m_batchRolledBack) {
+        m_database.rollback();
+    } else if (m_database.commit()) {
+        committed = true;
+    } else {
+        qWarning() << "Failed to commit batch:" << m_database.lastError().text();
+        emit errorOccurred(m_database.lastError().text());
+        m_database.rollback();
+    }
+
+    if (!committed) {
+        // Tags the batch created are gone again
+        m_tagRegistry.invalidate();
+    }
+    if (m_archivesChanged) {
+        m_archivesChanged = false;
+        reloadArchives();
+    }
+    // Listeners re-read what they show, so after a rollback the held
+    // notifications are merely redundant
+    scheduleNotifications();
+    emit batchFinished();
+    return committed;
+}
+
+void DatabaseManager::rollbackBatch()
+{
+    if (m_batchDepth == 0)
+        return;
+
+    if (!m_batchRolledBack) {
+        m_batchRolledBack = true;
+        m_database.rollback();
+        // Writes the outer batches still make are discarded with it
+        if (m_batchDepth > 1)
+            m_database.transaction();
+    }
+    if (--m_batchDepth == 0) {
+        m_tagRegistry.invalidate();
+        if (m_archivesChanged) {
+            m_archivesChanged = false;
+            reloadArchives();
+        }
+        scheduleNotifications();
+        emit batchFinished();
+    }
+}
+
+void DatabaseManager::notifyDataChanged(const QList<QDate> &dates)
+{
+    // Right away, so reads before the notification see the write too
+    if (dates.isEmpty())
+        m_dayCache.clear();
+    else
+        m_dayCache.invalidate(dates);
+
+    m_pendingData = true;
+    if (dates.isEmpty())
+        m_pendingUndated = true;
+    for (const QDate &date : dates) {
+        if (date.isValid())
+            m_pendingDates.insert(date);
+    }
+    scheduleNotifications();
+}
+
+void DatabaseManager::notifyTagsChanged()
+{
+    // Session lists show tag names
+    m_dayCache.clear();
+    m_pendingTags = true;
+    scheduleNotifications();
+}
+
+void DatabaseManager::scheduleNotifications()
+{
+    // A batch schedules them when it ends
+    if (m_batchDepth > 0 || m_notificationsScheduled || !(m_pendingData || m_pendingTags))
+        return;
+
+    m_notificationsScheduled = true;
+    QMetaObject::invokeMethod(this, [this]() { emitNotifications(); }, Qt::QueuedConnection);
+}
+
+void DatabaseManager::emitNotifications()
+{
+    m_notificationsScheduled = false;
+    if (m_batchDepth > 0)
+        return;
+
+    // Listeners may write again; that is the next round
+    const bool data = m_pendingData;
+    const bool undated = m_pendingUndated;
+    const bool tags = m_pendingTags;
+    const QList<QDate> dates = m_pendingDates.values();
+    m_pendingData = false;
+    m_pendingUndated = false;
+    m_pendingTags = false;
+    m_pendingDates.clear();
+
+    // Days read while a batch was still open saw it uncommitted
+    if (undated || tags)
+        m_dayCache.clear();
+    else
+        m_dayCache.invalidate(dates);
+
+    if (tags)
+        emit tagsChanged();
+    if (data) {
+        if (!undated && !dates.isEmpty())
+            emit datesChanged(dates);
+        emit dataChanged();
+    }
+}
+
+QDate DatabaseManager::sessionDate(int id)
+{
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral("SELECT SessionDate FROM WorkSessions WHERE Id = :id"));
+    query.bindValue(QStringLiteral(":id"), id);
+
+    if (query.exec() && query.next()) {
+        return QDate::fromString(query.value(0).toString(), Qt::ISODate);
+    }
+
+    return QDate();
+}
+
 QVariantMap DatabaseManager::getSession(int id)
 {
+    const DiagnosticsTimer timer("db.getSession");
     QVariantMap result;
-    QSqlQuery query(m_database);
+    QSqlQuery query(ConnectionPool::reader());
     query.prepare(QStringLiteral(R"(
         SELECT ws.*, t.Name as TagName
         FROM WorkSessions ws
@@ -226,44 +810,70 @@ QVariantMap DatabaseManager::getSession(int id)
 
 QVariantList DatabaseManager::getSessionsForDate(const QDate &date)
 {
-    QVariantList results;
-    QSqlQuery query(m_database);
-    query.prepare(QStringLiteral(R"(
-        SELECT ws.*, t.Name as TagName
-        FROM WorkSessions ws
-        LEFT JOIN Tags t ON ws.TagId = t.Id
-        WHERE ws.SessionDate = :date AND ws.IsDeleted = 0
-        ORDER BY ws.CreatedAt ASC
-    )"));
-    query.bindValue(QStringLiteral(":date"), date.toString(Qt::ISODate));
+    const DiagnosticsTimer timer("db.getSessionsForDate");
+    return day(date).sessions;
+}
 
-    if (query.exec()) {
-        while (query.next()) {
-            QVariantMap session;
-            session[QStringLiteral("id")] = query.value(QStringLiteral("Id"));
-            session[QStringLiteral("date")] = QDate::fromString(
-                query.value(QStringLiteral("SessionDate")).toString(), Qt::ISODate);
-            session[QStringLiteral("timeHours")] = query.value(QStringLiteral("TimeHours"));
-            session[QStringLiteral("description")] = query.value(QStringLiteral("Description"));
-            session[QStringLiteral("notes")] = query.value(QStringLiteral("Notes"));
-            session[QStringLiteral("nextPlannedStage")] = query.value(QStringLiteral("NextPlannedStage"));
-            session[QStringLiteral("tagId")] = query.value(QStringLiteral("TagId"));
-            session[QStringLiteral("tagName")] = query.value(QStringLiteral("TagName"));
-            results.append(session);
+DayCache::Day DatabaseManager::day(const QDate &date)
+{
+    if (const DayCache::Day *cached = m_dayCache.find(date))
+        return *cached;
+
+    const DayCache::Day loaded = DayCache::load(date);
+    m_dayCache.insert(date, loaded);
+    return loaded;
+}
+
+void DatabaseManager::prefetchDays(const QList<QDate> &dates)
+{
+    if (!m_isOpen)
+        return;
+
+    QList<QDate> missing;
+    for (const QDate &date : dates) {
+        if (date.isValid() && !m_dayCache.contains(date) && !m_prefetching.contains(date)) {
+            missing.append(date);
+            m_prefetching.insert(date);
         }
     }
-
-    return results;
+    if (missing.isEmpty())
+        return;
+
+    const quint64 generation = m_dayCache.generation();
+    ConnectionPool::run([this, missing, generation]() {
+        QVector<DayCache::Day> days;
+        days.reserve(missing.size());
+        for (const QDate &date : missing)
+            days.append(DayCache::load(date));
+
+        QMetaObject::invokeMethod(this, [this, missing, days, generation]() {
+            for (const QDate &date : missing)
+                m_prefetching.remove(date);
+            // A write since the load started may have changed these days
+            if (generation != m_dayCache.generation())
+                return;
+            for (int i = 0; i < missing.size(); ++i) {
+                if (!m_dayCache.contains(missing.at(i)))
+                    m_dayCache.insert(missing.at(i), days.at(i));
+            }
+        }, Qt::QueuedConnection);
+    });
 }
 
 QVariantList DatabaseManager::getYears()
 {
+    const DiagnosticsTimer timer("db.getYears");
     QVariantList results;
-    QSqlQuery query(m_database);
+    QSqlQuery query(ConnectionPool::reader());
+    // Year figures come from the hot table and the archived daily totals,
+    // so listing the years opens no archive
     query.exec(QStringLiteral(R"(
         SELECT DISTINCT strftime('%Y', SessionDate) as Year
-        FROM WorkSessions
-        WHERE IsDeleted = 0
+        FROM (
+            SELECT SessionDate FROM main.WorkSessions WHERE IsDeleted = 0
+            UNION ALL
+            SELECT SessionDate FROM ArchivedDays
+        )
         ORDER BY Year ASC
     )"));
 
@@ -276,8 +886,9 @@ QVariantList DatabaseManager::getYears()
 
 QVariantList DatabaseManager::getMonthsForYear(int year)
 {
+    const DiagnosticsTimer timer("db.getMonthsForYear");
     QVariantList results;
-    QSqlQuery query(m_database);
+    QSqlQuery query(ConnectionPool::reader());
     query.prepare(QStringLiteral(R"(
         SELECT DISTINCT strftime('%m', SessionDate) as Month
         FROM WorkSessions
@@ -297,8 +908,9 @@ QVariantList DatabaseManager::getMonthsForYear(int year)
 
 QVariantList DatabaseManager::getWeeksForMonth(int year, int month)
 {
+    const DiagnosticsTimer timer("db.getWeeksForMonth");
     QVariantList results;
-    QSqlQuery query(m_database);
+    QSqlQuery query(ConnectionPool::reader());
     query.prepare(QStringLiteral(R"(
         SELECT DISTINCT strftime('%W', SessionDate) as Week
         FROM WorkSessions
@@ -321,8 +933,9 @@ QVariantList DatabaseManager::getWeeksForMonth(int year, int month)
 
 QVariantList DatabaseManager::getDaysForWeek(int year, int week)
 {
+    const DiagnosticsTimer timer("db.getDaysForWeek");
     QVariantList results;
-    QSqlQuery query(m_database);
+    QSqlQuery query(ConnectionPool::reader());
     query.prepare(QStringLiteral(R"(
         SELECT DISTINCT SessionDate
         FROM WorkSessions
@@ -345,8 +958,9 @@ QVariantList DatabaseManager::getDaysForWeek(int year, int week)
 
 QVariantList DatabaseManager::getDaysForMonth(int year, int month)
 {
+    const DiagnosticsTimer timer("db.getDaysForMonth");
     QVariantList results;
-    QSqlQuery query(m_database);
+    QSqlQuery query(ConnectionPool::reader());
     query.prepare(QStringLiteral(R"(
         SELECT DISTINCT SessionDate
         FROM WorkSessions
@@ -369,7 +983,8 @@ QVariantList DatabaseManager::getDaysForMonth(int year, int month)
 
 double DatabaseManager::getTotalHoursForWeek(int year, int week)
 {
-    QSqlQuery query(m_database);
+    const DiagnosticsTimer timer("db.getTotalHoursForWeek");
+    QSqlQuery query(ConnectionPool::reader());
     query.prepare(QStringLiteral(R"(
         SELECT IFNULL(SUM(TimeHours), 0)
         FROM WorkSessions
@@ -389,7 +1004,8 @@ double DatabaseManager::getTotalHoursForWeek(int year, int week)
 
 double DatabaseManager::getTotalHoursForMonth(int year, int month)
 {
-    QSqlQuery query(m_database);
+    const DiagnosticsTimer timer("db.getTotalHoursForMonth");
+    QSqlQuery query(ConnectionPool::reader());
     query.prepare(QStringLiteral(R"(
         SELECT IFNULL(SUM(TimeHours), 0)
         FROM WorkSessions
@@ -409,11 +1025,16 @@ double DatabaseManager::getTotalHoursForMonth(int year, int month)
 
 double DatabaseManager::getTotalHoursForYear(int year)
 {
-    QSqlQuery query(m_database);
+    const DiagnosticsTimer timer("db.getTotalHoursForYear");
+    QSqlQuery query(ConnectionPool::reader());
     query.prepare(QStringLiteral(R"(
-        SELECT IFNULL(SUM(TimeHours), 0)
-        FROM WorkSessions
-        WHERE strftime('%Y', SessionDate) = :year AND IsDeleted = 0
+        SELECT IFNULL(SUM(Hours), 0)
+        FROM (
+            SELECT TimeHours AS Hours FROM main.WorkSessions
+            WHERE strftime('%Y', SessionDate) = :year AND IsDeleted = 0
+            UNION ALL
+            SELECT TotalHours FROM ArchivedDays WHERE strftime('%Y', SessionDate) = :year
+        )
     )"));
     query.bindValue(QStringLiteral(":year"), QString::number(year));
 
@@ -426,29 +1047,23 @@ double DatabaseManager::getTotalHoursForYear(int year)
 
 double DatabaseManager::getTotalHoursForDate(const QDate &date)
 {
-    QSqlQuery query(m_database);
-    query.prepare(QStringLiteral(R"(
-        SELECT IFNULL(SUM(TimeHours), 0)
-        FROM WorkSessions
-        WHERE SessionDate = :date AND IsDeleted = 0
-    )"));
-    query.bindValue(QStringLiteral(":date"), date.toString(Qt::ISODate));
-
-    if (query.exec() && query.next()) {
-        return query.value(0).toDouble();
-    }
-
-    return 0.0;
+    const DiagnosticsTimer timer("db.getTotalHoursForDate");
+    return day(date).totalHours;
 }
 
 double DatabaseManager::getAverageHoursPerWeekForYear(int year)
 {
-    QSqlQuery query(m_database);
+    const DiagnosticsTimer timer("db.getAverageHoursPerWeekForYear");
+    QSqlQuery query(ConnectionPool::reader());
     query.prepare(QStringLiteral(R"(
-        SELECT IFNULL(SUM(TimeHours), 0) as TotalHours,
+        SELECT IFNULL(SUM(Hours), 0) as TotalHours,
                COUNT(DISTINCT strftime('%W', SessionDate)) as WeekCount
-        FROM WorkSessions
-        WHERE strftime('%Y', SessionDate) = :year AND IsDeleted = 0
+        FROM (
+            SELECT SessionDate, TimeHours AS Hours FROM main.WorkSessions
+            WHERE strftime('%Y', SessionDate) = :year AND IsDeleted = 0
+            UNION ALL
+            SELECT SessionDate, TotalHours FROM ArchivedDays WHERE strftime('%Y', SessionDate) = :year
+        )
     )"));
     query.bindValue(QStringLiteral(":year"), QString::number(year));
 
@@ -463,7 +1078,8 @@ double DatabaseManager::getAverageHoursPerWeekForYear(int year)
 
 double DatabaseManager::getAverageHoursPerWeekForMonth(int year, int month)
 {
-    QSqlQuery query(m_database);
+    const DiagnosticsTimer timer("db.getAverageHoursPerWeekForMonth");
+    QSqlQuery query(ConnectionPool::reader());
     query.prepare(QStringLiteral(R"(
         SELECT IFNULL(SUM(TimeHours), 0) as TotalHours
         FROM WorkSessions
@@ -493,8 +1109,9 @@ double DatabaseManager::getAverageHoursPerWeekForMonth(int year, int month)
 
 QVariantList DatabaseManager::getTagTotalsForWeek(int year, int week)
 {
+    const DiagnosticsTimer timer("db.getTagTotalsForWeek");
     QVariantList results;
-    QSqlQuery query(m_database);
+    QSqlQuery query(ConnectionPool::reader());
     query.prepare(QStringLiteral(R"(
         SELECT IFNULL(t.Name, 'Untagged') as TagName, SUM(w.TimeHours) as TotalHours
         FROM WorkSessions w
@@ -522,54 +1139,57 @@ QVariantList DatabaseManager::getTagTotalsForWeek(int year, int week)
 
 QVariantList DatabaseManager::getTagTotalsForDay(const QDate &date)
 {
-    QVariantList results;
-    QSqlQuery query(m_database);
-    query.prepare(QStringLiteral(R"(
-        SELECT IFNULL(t.Name, 'Untagged') as TagName, SUM(w.TimeHours) as TotalHours
-        FROM WorkSessions w
-        LEFT JOIN Tags t ON w.TagId = t.Id
-        WHERE w.SessionDate = :date AND w.IsDeleted = 0
-        GROUP BY IFNULL(t.Name, 'Untagged')
-        ORDER BY TotalHours DESC
-    )"));
-    query.bindValue(QStringLiteral(":date"), date.toString(Qt::ISODate));
-
-    if (query.exec()) {
-        while (query.next()) {
-            QVariantMap item;
-            item[QStringLiteral("tagName")] = query.value(0).toString();
-            item[QStringLiteral("totalHours")] = query.value(1).toDouble();
-            results.append(item);
-        }
-    }
-
-    return results;
+    const DiagnosticsTimer timer("db.getTagTotalsForDay");
+    return day(date).tagTotals;
 }
 
 // Tag CRUD operations
 
 int DatabaseManager::createTag(const QString &name)
 {
+    const DiagnosticsTimer timer("db.createTag");
     if (name.trimmed().isEmpty()) {
         return -1;
     }
 
+    // A tag merged away keeps its name (and its row, for sync); creating
+    // it again brings that row back
     QSqlQuery query(m_database);
-    query.prepare(QStringLiteral("INSERT INTO Tags (Name) VALUES (:name)"));
+    query.prepare(QStringLiteral(R"(
+        UPDATE Tags SET IsDeleted = 0, UpdatedAt = datetime('now'), Hlc = :hlc
+        WHERE Name = :name AND IsDeleted = 1
+    )"));
     query.bindValue(QStringLiteral(":name"), name.trimmed());
-
-    if (!query.exec()) {
+    query.bindValue(QStringLiteral(":hlc"), HybridClock::now());
+
+    int id = -1;
+    if (query.exec() && query.numRowsAffected() > 0) {
+        query.prepare(QStringLiteral("SELECT Id FROM Tags WHERE Name = :name"));
+        query.bindValue(QStringLiteral(":name"), name.trimmed());
+        if (query.exec() && query.next())
+            id = query.value(0).toInt();
+    } else {
+        query.prepare(QStringLiteral("INSERT INTO Tags (Name, Hlc) VALUES (:name, :hlc)"));
+        query.bindValue(QStringLiteral(":name"), name.trimmed());
+        query.bindValue(QStringLiteral(":hlc"), HybridClock::now());
+        if (query.exec())
+            id = query.lastInsertId().toInt();
+    }
+    if (id <= 0) {
         qWarning() << "Failed to create tag:" << query.lastError().text();
         emit errorOccurred(query.lastError().text());
         return -1;
     }
 
-    emit tagsChanged();
-    return query.lastInsertId().toInt();
+    m_tagRegistry.insert(id, name.trimmed(), m_tagRegistry.cloudIdForId(id));
+
+    notifyTagsChanged();
+    return id;
 }
 
 bool DatabaseManager::deleteTag(int id)
 {
+    const DiagnosticsTimer timer("db.deleteTag");
     QSqlQuery query(m_database);
     query.prepare(QStringLiteral("DELETE FROM Tags WHERE Id = :id"));
     query.bindValue(QStringLiteral(":id"), id);
@@ -579,17 +1199,209 @@ bool DatabaseManager::deleteTag(int id)
         emit errorOccurred(query.lastError().text());
         return false;
     }
+    m_tagRegistry.remove(id);
+
+    notifyTagsChanged();
+    notifyDataChanged(); // Sessions may have lost their tag
+    return true;
+}
+
+bool DatabaseManager::renameTag(int id, const QString &name)
+{
+    const DiagnosticsTimer timer("db.renameTag");
+    const QString trimmed = name.trimmed();
+    if (trimmed.isEmpty()) {
+        return false;
+    }
+
+    // Sessions refer to the tag by id, so none of them change
+    const int existing = m_tagRegistry.idForName(trimmed);
+    if (existing > 0 && existing != id) {
+        const QString error = tr("A tag named %1 already exists").arg(trimmed);
+        qWarning() << "Failed to rename tag:" << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    // A merged tag keeps its name, which is unique
+    if (m_tagRegistry.deletedIdForName(trimmed) > 0) {
+        const QString error = tr("%1 is the name of a deleted tag; create a tag with that name to restore it")
+                                  .arg(trimmed);
+        qWarning() << "Failed to rename tag:" << error;
+        emit errorOccurred(error);
+        return false;
+    }
+
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral("UPDATE Tags SET Name = :name, UpdatedAt = datetime('now'), Hlc = :hlc WHERE Id = :id"));
+    query.bindValue(QStringLiteral(":id"), id);
+    query.bindValue(QStringLiteral(":name"), trimmed);
+    query.bindValue(QStringLiteral(":hlc"), HybridClock::now());
+
+    if (!query.exec()) {
+        qWarning() << "Failed to rename tag:" << query.lastError().text();
+        emit errorOccurred(query.lastError().text());
+        return false;
+    }
+    m_tagRegistry.insert(id, trimmed, m_tagRegistry.cloudIdForId(id));
 
-    emit tagsChanged();
-    emit dataChanged(); // Sessions may have lost their tag
+    notifyTagsChanged();
+    notifyDataChanged(); // Session lists show tag names
     return true;
 }
 
+int DatabaseManager::mergeTags(const QVariantList &sourceIds, int targetId)
+{
+    const DiagnosticsTimer timer("db.mergeTags");
+    if (targetId <= 0) {
+        return -1;
+    }
+    // Sessions moved onto a deleted or missing tag would lose it
+    if (!m_tagRegistry.isLive(targetId)) {
+        const QString error = tr("The tag to merge into no longer exists");
+        qWarning() << "Failed to merge tags:" << error;
+        emit errorOccurred(error);
+        return -1;
+    }
+
+    QStringList placeholders;
+    QVariantMap bindings;
+    for (const QVariant &value : sourceIds) {
+        const int id = value.toInt();
+        if (id <= 0 || id == targetId)
+            continue;
+        if (!m_tagRegistry.isLive(id)) {
+            const QString error = tr("A tag to merge no longer exists");
+            qWarning() << "Failed to merge tags:" << error << id;
+            emit errorOccurred(error);
+            return -1;
+        }
+        const QString placeholder = QStringLiteral(":source%1").arg(placeholders.size());
+        placeholders.append(placeholder);
+        bindings.insert(placeholder, id);
+    }
+    if (placeholders.isEmpty()) {
+        return 0;
+    }
+    const QString sources = placeholders.join(QStringLiteral(", "));
+
+    if (!beginBatch())
+        return -1;
+
+    const QString condition = QStringLiteral("TagId IN (%1)").arg(sources);
+    if (!restoreArchivedYears(condition, bindings)) {
+        rollbackBatch();
+        return -1;
+    }
+    const int moved = retagWhere(condition, bindings, targetId);
+    if (moved < 0) {
+        rollbackBatch();
+        return -1;
+    }
+
+    // Tombstoned rather than deleted, so a sync sends the deletion instead
+    // of bringing the sources back from the cloud
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral(R"(
+        UPDATE Tags SET IsDeleted = 1, UpdatedAt = datetime('now'), Hlc = :hlc
+        WHERE Id IN (%1)
+    )").arg(sources));
+    query.bindValue(QStringLiteral(":hlc"), HybridClock::now());
+    for (auto it = bindings.cbegin(); it != bindings.cend(); ++it)
+        query.bindValue(it.key(), it.value());
+
+    if (!query.exec()) {
+        qWarning() << "Failed to merge tags:" << query.lastError().text();
+        emit errorOccurred(query.lastError().text());
+        rollbackBatch();
+        return -1;
+    }
+    for (const QVariant &value : qAsConst(bindings)) {
+        const int id = value.toInt();
+        m_tagRegistry.insert(id, m_tagRegistry.nameForId(id), m_tagRegistry.cloudIdForId(id), true);
+    }
+
+    notifyTagsChanged();
+    if (moved > 0)
+        notifyDataChanged();
+    return commitBatch() ? moved : -1;
+}
+
+int DatabaseManager::splitTag(int id, const QString &newName, const QDate &from, const QDate &to)
+{
+    const DiagnosticsTimer timer("db.splitTag");
+    if (!m_tagRegistry.isLive(id)) {
+        const QString error = tr("The tag to split no longer exists");
+        qWarning() << "Failed to split tag:" << error;
+        emit errorOccurred(error);
+        return -1;
+    }
+    if (!beginBatch())
+        return -1;
+
+    const int newId = createTag(newName);
+    if (newId <= 0) {
+        rollbackBatch();
+        return -1;
+    }
+
+    QStringList conditions{QStringLiteral("TagId = :sourceId")};
+    QVariantMap bindings{{QStringLiteral(":sourceId"), id}};
+    if (from.isValid()) {
+        conditions.append(QStringLiteral("SessionDate >= :from"));
+        bindings.insert(QStringLiteral(":from"), from.toString(Qt::ISODate));
+    }
+    if (to.isValid()) {
+        conditions.append(QStringLiteral("SessionDate <= :to"));
+        bindings.insert(QStringLiteral(":to"), to.toString(Qt::ISODate));
+    }
+
+    const QString condition = conditions.join(QStringLiteral(" AND "));
+    if (!restoreArchivedYears(condition, bindings)) {
+        rollbackBatch();
+        return -1;
+    }
+    const int moved = retagWhere(condition, bindings, newId);
+    if (moved < 0) {
+        rollbackBatch();
+        return -1;
+    }
+
+    if (moved > 0)
+        notifyDataChanged();
+    return commitBatch() ? moved : -1;
+}
+
+int DatabaseManager::retagWhere(const QString &condition, const QVariantMap &bindings, int tagId)
+{
+    // One statement for all of them; they share the clock reading, being
+    // one edit
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral(R"(
+        UPDATE WorkSessions
+        SET TagId = :tagId, TagCloudId = NULL, UpdatedAt = datetime('now'),
+            Hlc = :hlc, DirtyFields = DirtyFields | %1
+        WHERE IsDeleted = 0 AND TagId IS NOT :tagId AND (%2)
+    )").arg(SyncSessionRecord::TagDirty).arg(condition));
+
+    query.bindValue(QStringLiteral(":tagId"), tagId);
+    query.bindValue(QStringLiteral(":hlc"), HybridClock::now());
+    for (auto it = bindings.cbegin(); it != bindings.cend(); ++it)
+        query.bindValue(it.key(), it.value());
+
+    if (!query.exec()) {
+        qWarning() << "Failed to retag sessions:" << query.lastError().text();
+        emit errorOccurred(query.lastError().text());
+        return -1;
+    }
+    return query.numRowsAffected();
+}
+
 QVariantList DatabaseManager::getAllTags()
 {
+    const DiagnosticsTimer timer("db.getAllTags");
     QVariantList results;
-    QSqlQuery query(m_database);
-    query.exec(QStringLiteral("SELECT Id, Name FROM Tags ORDER BY Name ASC"));
+    QSqlQuery query(ConnectionPool::reader());
+    query.exec(QStringLiteral("SELECT Id, Name FROM Tags WHERE IsDeleted = 0 ORDER BY Name ASC"));
 
     while (query.next()) {
         QVariantMap tag;
@@ -607,13 +1419,10 @@ QString DatabaseManager::getTagName(int id)
         return QString();
     }
 
-    QSqlQuery query(m_database);
-    query.prepare(QStringLiteral("SELECT Name FROM Tags WHERE Id = :id"));
-    query.bindValue(QStringLiteral(":id"), id);
-
-    if (query.exec() && query.next()) {
-        return query.value(0).toString();
-    }
+    return m_tagRegistry.nameForId(id);
+}
 
-    return QString();
+int DatabaseManager::getTagIdByName(const QString &name)
+{
+    return m_tagRegistry.idForName(name);
 }
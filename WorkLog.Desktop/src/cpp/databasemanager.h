@@ -4,9 +4,15 @@
 #include <QObject>
 #include <QSqlDatabase>
 #include <QDate>
+#include <QSet>
+#include <QTimer>
 #include <QVariantList>
 #include <QVariantMap>
 
+#include "daycache.h"
+#include "hierarchysnapshot.h"
+#include "tagregistry.h"
+
 class DatabaseManager : public QObject
 {
     Q_OBJECT
@@ -15,7 +21,18 @@ public:
     explicit DatabaseManager(QObject *parent = nullptr);
     ~DatabaseManager();
 
-    bool initialize();
+    static QString defaultDatabasePath();
+
+    // Opens the database in the per-user data directory unless a path is given
+    bool initialize(const QString &databasePath = QString());
+    bool isOpen() const { return m_isOpen; }
+
+    // Maps the snapshot of the database before it is opened, so models
+    // can show the hierarchy right away. Once a snapshot was requested it
+    // is kept current from then on.
+    bool openSnapshot(const QString &databasePath = QString());
+    // Valid only until the database is open
+    const HierarchySnapshot &snapshot() const { return m_snapshot; }
 
     // Work Session CRUD operations
     Q_INVOKABLE bool createSession(const QDate &date, double timeHours,
@@ -32,15 +49,56 @@ public:
 
     Q_INVOKABLE bool deleteSession(int id);
 
+    // Bulk edits of the sessions with the given ids, each in a single
+    // transaction. Return how many sessions changed, or -1 if none did.
+    Q_INVOKABLE int retagSessions(const QVariantList &ids, int tagId);
+    Q_INVOKABLE int moveSessions(const QVariantList &ids, const QDate &date);
+    Q_INVOKABLE int deleteSessions(const QVariantList &ids);
+
+    // Writes between beginBatch() and commitBatch() share one transaction
+    // and notify once, after the commit. Batches nest, and each begin is
+    // paired with a commit or a rollback; a rollback at any depth makes
+    // the outermost commit fail. Pooled readers see the writes only once
+    // they are committed.
+    Q_INVOKABLE bool beginBatch();
+    Q_INVOKABLE bool commitBatch();
+    Q_INVOKABLE void rollbackBatch();
+    bool inBatch() const { return m_batchDepth > 0; }
+
+    // Change notifications are coalesced: whatever is reported within one
+    // event loop turn (or one batch) reaches listeners as at most one
+    // datesChanged()/dataChanged() pair and one tagsChanged(). No dates
+    // means the change is not confined to known dates.
+    void notifyDataChanged(const QList<QDate> &dates = QList<QDate>());
+    void notifyTagsChanged();
+
     Q_INVOKABLE QVariantMap getSession(int id);
 
     Q_INVOKABLE QVariantList getSessionsForDate(const QDate &date);
 
+    // Loads the days in the background, so that asking for them later is
+    // answered from the day cache
+    void prefetchDays(const QList<QDate> &dates);
+
     // Tag CRUD operations
     Q_INVOKABLE int createTag(const QString &name);
     Q_INVOKABLE bool deleteTag(int id);
+    Q_INVOKABLE bool renameTag(int id, const QString &name);
+    // Bulk tag edits in one transaction, each moving the sessions in a
+    // single statement; moved sessions are stamped and marked for upload
+    // like an edit would. Return how many sessions moved, or -1 on failure.
+    // Merging moves the sources' sessions to the target and deletes the
+    // sources.
+    Q_INVOKABLE int mergeTags(const QVariantList &sourceIds, int targetId);
+    // Moves the tag's sessions from from to to (an invalid date leaves that
+    // end open) to a new tag
+    Q_INVOKABLE int splitTag(int id, const QString &newName, const QDate &from, const QDate &to);
     Q_INVOKABLE QVariantList getAllTags();
     Q_INVOKABLE QString getTagName(int id);
+    // Case-insensitive; -1 when there is no such tag
+    Q_INVOKABLE int getTagIdByName(const QString &name);
+
+    TagRegistry &tagRegistry() { return m_tagRegistry; }
 
     // Hierarchy queries
     Q_INVOKABLE QVariantList getYears();
@@ -59,15 +117,69 @@ public:
 
     QString databasePath() const;
 
+    // Year archives (see YearArchive). A year closes a month after it
+    // ends; archiving one again takes in sessions added since.
+    // Returns the number of years archived, or -1 on failure.
+    Q_INVOKABLE int archiveClosedYears();
+    Q_INVOKABLE bool restoreYear(int year);
+    Q_INVOKABLE QVariantList archivedYears() const;
+    // Makes the archived years in the range readable through the pooled
+    // readers, for views and reports that span them. Only the
+    // YearArchive::MaxAttached archived years asked for last stay readable.
+    void attachYears(int first, int last);
+    // Moves the archived years holding sessions that match condition back
+    // into the hot table, inside the caller's batch if there is one.
+    // The conditions may only use columns of WorkSessions.
+    bool restoreArchivedYears(const QString &condition, const QVariantMap &bindings = QVariantMap());
+    // Picks up archives moved back within a transaction it did not own
+    void reloadArchives();
+
 signals:
+    void opened();
+    // Emitted right before dataChanged() when only sessions on these
+    // dates changed
+    void datesChanged(const QList<QDate> &dates);
     void dataChanged();
     void tagsChanged();
     void errorOccurred(const QString &error);
+    // The outermost batch committed or rolled back
+    void batchFinished();
+
+private slots:
+    void writeSnapshot();
 
 private:
     bool createTables();
+    QDate sessionDate(int id);
+    DayCache::Day day(const QDate &date);
+    // Moves the live sessions matching condition to tagId
+    int retagWhere(const QString &condition, const QVariantMap &bindings, int tagId);
+    void scheduleNotifications();
+    void emitNotifications();
     QString m_databasePath;
     QSqlDatabase m_database;
+    bool m_isOpen = false;
+    TagRegistry m_tagRegistry;
+    // Sessions and totals of recently viewed days
+    DayCache m_dayCache;
+    QSet<QDate> m_prefetching;
+
+    HierarchySnapshot m_snapshot;
+    bool m_snapshotEnabled = false;
+    // Rewrites are deferred until edits pause
+    QTimer m_snapshotTimer;
+
+    int m_batchDepth = 0;
+    bool m_batchRolledBack = false;
+    // A year moved back; the writer catches up after the commit
+    bool m_archivesChanged = false;
+
+    // Notifications not yet emitted
+    bool m_notificationsScheduled = false;
+    bool m_pendingData = false;
+    bool m_pendingUndated = false;
+    bool m_pendingTags = false;
+    QSet<QDate> m_pendingDates;
 };
 
 #endif // DATABASEMANAGER_H
@@ -0,0 +1,97 @@
+#include "daycache.h"
+#include "connectionpool.h"
+#include "diagnostics.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QPair>
+#include <QVariantMap>
+#include <QVector>
+#include <QDebug>
+
+#include <algorithm>
+
+DayCache::DayCache(int maxDays)
+    : m_days(maxDays)
+{
+}
+
+DayCache::Day DayCache::load(const QDate &date)
+{
+    const DiagnosticsTimer timer("db.loadDay");
+    Day day;
+    QSqlQuery query(ConnectionPool::reader());
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral(R"(
+        SELECT ws.*, t.Name as TagName
+        FROM WorkSessions ws
+        LEFT JOIN Tags t ON ws.TagId = t.Id
+        WHERE ws.SessionDate = :date AND ws.IsDeleted = 0
+        ORDER BY ws.CreatedAt ASC
+    )"));
+    query.bindValue(QStringLiteral(":date"), date.toString(Qt::ISODate));
+
+    if (!query.exec()) {
+        qWarning() << "Failed to load day:" << query.lastError().text();
+        return day;
+    }
+
+    // The tag totals add up the same rows, in first-seen order until sorted
+    QVector<QPair<QString, double>> tagHours;
+    while (query.next()) {
+        QVariantMap session;
+        session[QStringLiteral("id")] = query.value(QStringLiteral("Id"));
+        session[QStringLiteral("date")] = QDate::fromString(
+            query.value(QStringLiteral("SessionDate")).toString(), Qt::ISODate);
+        session[QStringLiteral("timeHours")] = query.value(QStringLiteral("TimeHours"));
+        session[QStringLiteral("description")] = query.value(QStringLiteral("Description"));
+        session[QStringLiteral("notes")] = query.value(QStringLiteral("Notes"));
+        session[QStringLiteral("nextPlannedStage")] = query.value(QStringLiteral("NextPlannedStage"));
+        session[QStringLiteral("tagId")] = query.value(QStringLiteral("TagId"));
+        session[QStringLiteral("tagName")] = query.value(QStringLiteral("TagName"));
+        day.sessions.append(session);
+
+        const double hours = query.value(QStringLiteral("TimeHours")).toDouble();
+        day.totalHours += hours;
+
+        QString tagName = query.value(QStringLiteral("TagName")).toString();
+        if (tagName.isEmpty())
+            tagName = QStringLiteral("Untagged");
+        auto tag = std::find_if(tagHours.begin(), tagHours.end(),
+                                [&tagName](const QPair<QString, double> &entry) { return entry.first == tagName; });
+        if (tag == tagHours.end())
+            tagHours.append({tagName, hours});
+        else
+            tag->second += hours;
+    }
+
+    std::stable_sort(tagHours.begin(), tagHours.end(),
+                     [](const QPair<QString, double> &a, const QPair<QString, double> &b) {
+        return a.second > b.second;
+    });
+    for (const auto &entry : qAsConst(tagHours)) {
+        QVariantMap item;
+        item[QStringLiteral("tagName")] = entry.first;
+        item[QStringLiteral("totalHours")] = entry.second;
+        day.tagTotals.append(item);
+    }
+    return day;
+}
+
+void DayCache::insert(const QDate &date, const Day &day)
+{
+    m_days.insert(date, new Day(day));
+}
+
+void DayCache::invalidate(const QList<QDate> &dates)
+{
+    ++m_generation;
+    for (const QDate &date : dates)
+        m_days.remove(date);
+}
+
+void DayCache::clear()
+{
+    ++m_generation;
+    m_days.clear();
+}
@@ -0,0 +1,45 @@
+#ifndef DAYCACHE_H
+#define DAYCACHE_H
+
+#include <QCache>
+#include <QDate>
+#include <QList>
+#include <QVariantList>
+
+// What the session list shows for a day: its sessions, their total and
+// the per-tag totals, for the days most recently looked at. All three come
+// from a single query. Writers drop exactly the days they changed, and
+// every drop bumps the generation, so results loaded in the background
+// before a write are recognised as stale and discarded.
+//
+// Used from the GUI thread only; load() runs on any thread.
+class DayCache
+{
+public:
+    struct Day {
+        QVariantList sessions;
+        double totalHours = 0.0;
+        QVariantList tagTotals;
+    };
+
+    explicit DayCache(int maxDays = 92);
+
+    // Reads the calling thread's pooled reader
+    static Day load(const QDate &date);
+
+    bool contains(const QDate &date) const { return m_days.contains(date); }
+    // Marks the day as most recently used; null when not cached
+    const Day *find(const QDate &date) const { return m_days.object(date); }
+    void insert(const QDate &date, const Day &day);
+
+    void invalidate(const QList<QDate> &dates);
+    void clear();
+    quint64 generation() const { return m_generation; }
+
+private:
+    // Lookups reorder the entries
+    mutable QCache<QDate, Day> m_days;
+    quint64 m_generation = 0;
+};
+
+#endif // DAYCACHE_H
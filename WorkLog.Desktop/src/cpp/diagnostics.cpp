@@ -0,0 +1,169 @@
+#include "diagnostics.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QDebug>
+
+#include <algorithm>
+
+namespace {
+
+// Percentiles are taken over the most recent samples of each operation
+constexpr int SampleCapacity = 512;
+
+double toMs(qint64 nanoseconds)
+{
+    return nanoseconds / 1000000.0;
+}
+
+qint64 percentile(QVector<qint64> samples, double fraction)
+{
+    if (samples.isEmpty())
+        return 0;
+    const int index = qMin(samples.size() - 1, int(fraction * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples.at(index);
+}
+
+} // namespace
+
+Diagnostics::Diagnostics(QObject *parent)
+    : QObject(parent)
+{
+}
+
+Diagnostics *Diagnostics::instance()
+{
+    // Intentionally never destroyed: worker threads may still record
+    // while the application object is being torn down.
+    static Diagnostics *diagnostics = new Diagnostics();
+    return diagnostics;
+}
+
+void Diagnostics::record(const char *name, qint64 nanoseconds)
+{
+    // fromRawData avoids a copy on the common path; the key is only
+    // deep-copied the first time a name is seen.
+    QMutexLocker locker(&m_mutex);
+    recordLocked(QByteArray::fromRawData(name, int(qstrlen(name))), nanoseconds);
+}
+
+void Diagnostics::record(const QString &name, qint64 nanoseconds)
+{
+    const QByteArray key = name.toUtf8();
+    QMutexLocker locker(&m_mutex);
+    recordLocked(key, nanoseconds);
+}
+
+void Diagnostics::recordLocked(const QByteArray &name, qint64 nanoseconds)
+{
+    auto it = m_timings.find(name);
+    if (it == m_timings.end()) {
+        it = m_timings.insert(QByteArray(name.constData(), name.size()), Timing());
+        it->samples.reserve(SampleCapacity);
+    }
+
+    Timing &timing = it.value();
+    ++timing.count;
+    timing.totalNs += nanoseconds;
+    timing.maxNs = qMax(timing.maxNs, nanoseconds);
+
+    if (timing.samples.size() < SampleCapacity) {
+        timing.samples.append(nanoseconds);
+    } else {
+        timing.samples[timing.nextSample] = nanoseconds;
+        timing.nextSample = (timing.nextSample + 1) % SampleCapacity;
+    }
+}
+
+void Diagnostics::add(const char *name, qint64 delta)
+{
+    const QByteArray key = QByteArray::fromRawData(name, int(qstrlen(name)));
+    QMutexLocker locker(&m_mutex);
+    auto it = m_counters.find(key);
+    if (it == m_counters.end()) {
+        m_counters.insert(QByteArray(name), delta);
+    } else {
+        it.value() += delta;
+    }
+}
+
+QVariantList Diagnostics::timings() const
+{
+    QVariantList results;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_timings.constBegin(); it != m_timings.constEnd(); ++it) {
+            const Timing &timing = it.value();
+            QVariantMap entry;
+            entry[QStringLiteral("name")] = QString::fromUtf8(it.key());
+            entry[QStringLiteral("count")] = timing.count;
+            entry[QStringLiteral("totalMs")] = toMs(timing.totalNs);
+            entry[QStringLiteral("meanMs")] = timing.count > 0 ? toMs(timing.totalNs / timing.count) : 0.0;
+            entry[QStringLiteral("p50Ms")] = toMs(percentile(timing.samples, 0.50));
+            entry[QStringLiteral("p99Ms")] = toMs(percentile(timing.samples, 0.99));
+            entry[QStringLiteral("maxMs")] = toMs(timing.maxNs);
+            results.append(entry);
+        }
+    }
+
+    // Most expensive operations first
+    std::sort(results.begin(), results.end(), [](const QVariant &a, const QVariant &b) {
+        return a.toMap().value(QStringLiteral("totalMs")).toDouble()
+             > b.toMap().value(QStringLiteral("totalMs")).toDouble();
+    });
+    return results;
+}
+
+QVariantMap Diagnostics::counters() const
+{
+    QVariantMap results;
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_counters.constBegin(); it != m_counters.constEnd(); ++it) {
+        results[QString::fromUtf8(it.key())] = it.value();
+    }
+    return results;
+}
+
+QString Diagnostics::toJson() const
+{
+    QJsonObject root;
+    root[QStringLiteral("generatedAt")] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root[QStringLiteral("timings")] = QJsonArray::fromVariantList(timings());
+    root[QStringLiteral("counters")] = QJsonObject::fromVariantMap(counters());
+    return QString::fromUtf8(QJsonDocument(root).toJson(QJsonDocument::Indented));
+}
+
+bool Diagnostics::dumpToFile(const QString &path) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write diagnostics to" << path << file.errorString();
+        return false;
+    }
+    file.write(toJson().toUtf8());
+    return file.commit();
+}
+
+void Diagnostics::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_timings.clear();
+    m_counters.clear();
+}
+
+void Diagnostics::installExitDump()
+{
+    const QString path = qEnvironmentVariable("WORKLOG_DIAGNOSTICS_FILE");
+    if (path.isEmpty() || !QCoreApplication::instance())
+        return;
+
+    connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, [this, path]() {
+        dumpToFile(path);
+    });
+}
@@ -0,0 +1,86 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include "tracer.h"
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QVector>
+
+// Process-wide hot-path counters. Every named operation records its call
+// count, total time and a ring of recent samples from which p50/p99 are
+// computed on demand. Safe to call from any thread.
+//
+// Set WORKLOG_DIAGNOSTICS_FILE=/path/to/file.json to have the collected
+// numbers written out when the application quits.
+class Diagnostics : public QObject
+{
+    Q_OBJECT
+
+public:
+    static Diagnostics *instance();
+
+    void record(const char *name, qint64 nanoseconds);
+    void record(const QString &name, qint64 nanoseconds);
+    void add(const char *name, qint64 delta = 1);
+
+    Q_INVOKABLE QVariantList timings() const;
+    Q_INVOKABLE QVariantMap counters() const;
+    Q_INVOKABLE QString toJson() const;
+    Q_INVOKABLE bool dumpToFile(const QString &path) const;
+    Q_INVOKABLE void reset();
+
+    void installExitDump();
+
+private:
+    explicit Diagnostics(QObject *parent = nullptr);
+
+    struct Timing {
+        qint64 count = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+        QVector<qint64> samples;
+        int nextSample = 0;
+    };
+
+    void recordLocked(const QByteArray &name, qint64 nanoseconds);
+
+    mutable QMutex m_mutex;
+    QHash<QByteArray, Timing> m_timings;
+    QHash<QByteArray, qint64> m_counters;
+};
+
+// Records the lifetime of the enclosing scope under the given name, and
+// as a trace span when tracing is enabled. The name must be a string literal.
+class DiagnosticsTimer
+{
+public:
+    explicit DiagnosticsTimer(const char *name)
+        : m_name(name)
+    {
+        m_timer.start();
+    }
+
+    ~DiagnosticsTimer()
+    {
+        const qint64 elapsedNs = m_timer.nsecsElapsed();
+        Diagnostics::instance()->record(m_name, elapsedNs);
+        if (Tracer::isEnabled()) {
+            const qint64 durationUs = elapsedNs / 1000;
+            Tracer::complete(m_name, Tracer::nowUs() - durationUs, durationUs);
+        }
+    }
+
+    DiagnosticsTimer(const DiagnosticsTimer &) = delete;
+    DiagnosticsTimer &operator=(const DiagnosticsTimer &) = delete;
+
+private:
+    const char *m_name;
+    QElapsedTimer m_timer;
+};
+
+#endif // DIAGNOSTICS_H
@@ -0,0 +1,176 @@
+#include "directorysyncbackend.h"
+#include "diagnostics.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+
+namespace {
+
+const QString ChangesetSuffix = QStringLiteral(".wlcs");
+
+} // namespace
+
+DirectorySyncBackend::DirectorySyncBackend(const SyncConfig &config, QObject *parent)
+    : SyncBackend(parent)
+    , m_config(config)
+{
+}
+
+QString DirectorySyncBackend::profileDirectory() const
+{
+    return QDir(m_config.syncDirectory).filePath(m_config.profileId);
+}
+
+void DirectorySyncBackend::testConnection()
+{
+    const QFileInfo info(m_config.syncDirectory);
+    if (!info.isDir()) {
+        emit connectionTested(false, tr("Folder does not exist: %1").arg(m_config.syncDirectory));
+    } else if (!info.isWritable()) {
+        emit connectionTested(false, tr("Folder is not writable: %1").arg(m_config.syncDirectory));
+    } else {
+        emit connectionTested(true, tr("Connection successful!"));
+    }
+}
+
+void DirectorySyncBackend::fetch()
+{
+    // Report asynchronously, like a network target
+    const int generation = m_generation;
+    QMetaObject::invokeMethod(this, [this, generation]() {
+        if (generation == m_generation)
+            readChangesets();
+    }, Qt::QueuedConnection);
+}
+
+void DirectorySyncBackend::upload(const SyncChangeset &changes)
+{
+    const int generation = m_generation;
+    QMetaObject::invokeMethod(this, [this, generation, changes]() {
+        if (generation == m_generation)
+            writeChangeset(changes);
+    }, Qt::QueuedConnection);
+}
+
+void DirectorySyncBackend::abort()
+{
+    ++m_generation;
+    m_folded = SyncChangeset();
+    m_foldedFiles.clear();
+}
+
+void DirectorySyncBackend::readChangesets()
+{
+    const DiagnosticsTimer timer("sync.directory.fetch");
+
+    m_folded = SyncChangeset();
+    m_foldedFiles.clear();
+
+    if (!QFileInfo(m_config.syncDirectory).isDir()) {
+        emit fetchFinished(false, tr("Folder does not exist: %1").arg(m_config.syncDirectory));
+        return;
+    }
+
+    // Changeset ids start with a UTC timestamp, so name order is upload order
+    const QDir dir(profileDirectory());
+    const QStringList files = dir.entryList(QStringList() << (QLatin1Char('*') + ChangesetSuffix),
+                                            QDir::Files, QDir::Name);
+
+    for (const QString &fileName : files) {
+        QFile file(dir.filePath(fileName));
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Skipping changeset" << fileName << ":" << file.errorString();
+            continue;
+        }
+
+        const QByteArray data = file.readAll();
+        Diagnostics::instance()->add("sync.bytesReceived", data.size());
+        emit bytesTransferred(data.size());
+
+        SyncChangeset changeset;
+        QString errorString;
+        if (!SyncChangeset::decode(data, &changeset, &errorString)) {
+            // Possibly still being copied in by a file sync client
+            qWarning() << "Skipping changeset" << fileName << ":" << errorString;
+            continue;
+        }
+
+        m_folded.merge(changeset);
+        m_foldedFiles.append(file.fileName());
+    }
+
+    emit tagsReceived(m_folded.tags);
+    emit sessionsReceived(m_folded.sessions);
+    emit fetchFinished(true, QString());
+}
+
+void DirectorySyncBackend::writeChangeset(const SyncChangeset &changes)
+{
+    const DiagnosticsTimer timer("sync.directory.upload");
+
+    const bool compact = m_foldedFiles.size() >= CompactionThreshold;
+    SyncChangeset changeset;
+    if (compact) {
+        changeset = m_folded;
+        changeset.merge(changes);
+    } else {
+        changeset = changes;
+    }
+    m_folded = SyncChangeset();
+
+    QString errorString;
+    if (!changeset.isEmpty() && !writeFile(changeset, &errorString)) {
+        m_foldedFiles.clear();
+        emit uploadFinished(false, errorString);
+        return;
+    }
+
+    // The snapshot now holds everything the folded files did
+    if (compact) {
+        for (const QString &path : qAsConst(m_foldedFiles)) {
+            if (!QFile::remove(path))
+                qWarning() << "Could not remove superseded changeset" << path;
+        }
+    }
+    m_foldedFiles.clear();
+
+    for (const SyncTagRecord &tag : changes.tags)
+        emit recordStored(tag.cloudId, tag.hlc);
+    for (const SyncSessionRecord &session : changes.sessions)
+        emit recordStored(session.cloudId, session.hlc);
+    emit uploadProgress(changes.recordCount());
+    emit uploadFinished(true, QString());
+}
+
+bool DirectorySyncBackend::writeFile(const SyncChangeset &changeset, QString *errorString)
+{
+    const QString directory = profileDirectory();
+    if (!QDir().mkpath(directory)) {
+        *errorString = tr("Could not create folder: %1").arg(directory);
+        return false;
+    }
+
+    QByteArray data;
+    {
+        const DiagnosticsTimer timer("sync.encodeChangeset");
+        data = changeset.encode();
+    }
+
+    QSaveFile file(QDir(directory).filePath(SyncChangeset::newChangesetId() + ChangesetSuffix));
+    if (!file.open(QIODevice::WriteOnly)) {
+        *errorString = file.errorString();
+        return false;
+    }
+    file.write(data);
+    if (!file.commit()) {
+        *errorString = file.errorString();
+        return false;
+    }
+
+    Diagnostics::instance()->add("sync.bytesSent", data.size());
+    emit bytesTransferred(data.size());
+    return true;
+}
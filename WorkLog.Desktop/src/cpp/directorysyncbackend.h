@@ -0,0 +1,39 @@
+#ifndef DIRECTORYSYNCBACKEND_H
+#define DIRECTORYSYNCBACKEND_H
+
+#include "syncbackend.h"
+
+#include <QStringList>
+
+// Syncs through a shared folder (a network mount, a WebDAV mount or a
+// folder kept in step by a file sync client). Every upload adds one
+// "<changesetId>.wlcs" file under <syncDirectory>/<profileId>; files are
+// never rewritten, so concurrent writers cannot clobber each other.
+class DirectorySyncBackend : public SyncBackend
+{
+    Q_OBJECT
+
+public:
+    explicit DirectorySyncBackend(const SyncConfig &config, QObject *parent = nullptr);
+
+    void testConnection() override;
+    void fetch() override;
+    void upload(const SyncChangeset &changes) override;
+    void abort() override;
+
+private:
+    QString profileDirectory() const;
+    void readChangesets();
+    void writeChangeset(const SyncChangeset &changes);
+    bool writeFile(const SyncChangeset &changeset, QString *errorString);
+
+    SyncConfig m_config;
+    // Queued work from an aborted run carries an older generation
+    int m_generation = 0;
+
+    // State folded by the last fetch, kept for compaction
+    SyncChangeset m_folded;
+    QStringList m_foldedFiles;
+};
+
+#endif // DIRECTORYSYNCBACKEND_H
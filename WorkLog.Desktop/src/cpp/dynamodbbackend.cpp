@@ -0,0 +1,932 @@
+#include "dynamodbbackend.h"
+#include "diagnostics.h"
+
+#include <QJsonDocument>
+#include <QMap>
+#include <QMessageAuthenticationCode>
+#include <QNetworkRequest>
+#include <QCryptographicHash>
+#include <QDebug>
+
+namespace {
+
+// Monotonic start time of a request, used for per-request-type timings
+const QNetworkRequest::Attribute RequestStartedAttribute =
+    static_cast<QNetworkRequest::Attribute>(QNetworkRequest::User + 1);
+// Async trace id pairing the begin/end events of a request
+const QNetworkRequest::Attribute TraceIdAttribute =
+    static_cast<QNetworkRequest::Attribute>(QNetworkRequest::User + 2);
+// Run the request belongs to, see DynamoDbBackend::abort()
+const QNetworkRequest::Attribute GenerationAttribute =
+    static_cast<QNetworkRequest::Attribute>(QNetworkRequest::User + 3);
+// Record a put or update was for, or the key prefix a digest query covers
+const QNetworkRequest::Attribute CloudIdAttribute =
+    static_cast<QNetworkRequest::Attribute>(QNetworkRequest::User + 4);
+const QNetworkRequest::Attribute HlcAttribute =
+    static_cast<QNetworkRequest::Attribute>(QNetworkRequest::User + 5);
+
+// Replays after a crash, and uploads racing another device, must never
+// overwrite a newer version of the item
+const QString NotNewerCondition = QStringLiteral("(attribute_not_exists(Hlc) OR Hlc <= :hlc)");
+
+// Compact mode: changesets are split into parts below DynamoDB's 400 KB
+// item limit
+constexpr int ChangesetPartBytes = 256 * 1024;
+
+// BatchGetItem takes at most this many keys per request
+constexpr int BatchGetKeys = 100;
+
+QJsonObject stringValue(const QString &value)
+{
+    QJsonObject attr;
+    attr[QStringLiteral("S")] = value;
+    return attr;
+}
+
+QJsonObject numberValue(double value)
+{
+    QJsonObject attr;
+    attr[QStringLiteral("N")] = QString::number(value);
+    return attr;
+}
+
+// 64-bit clocks do not survive a round trip through double
+QJsonObject integerValue(qint64 value)
+{
+    QJsonObject attr;
+    attr[QStringLiteral("N")] = QString::number(value);
+    return attr;
+}
+
+QJsonObject boolValue(bool value)
+{
+    QJsonObject attr;
+    attr[QStringLiteral("BOOL")] = value;
+    return attr;
+}
+
+QString stringAttribute(const QJsonObject &item, const QString &name)
+{
+    return item[name].toObject()[QStringLiteral("S")].toString();
+}
+
+QString numberAttribute(const QJsonObject &item, const QString &name)
+{
+    return item[name].toObject()[QStringLiteral("N")].toString();
+}
+
+QJsonObject itemFromTag(const SyncTagRecord &tag, const QString &profileId)
+{
+    QJsonObject item;
+    item[QStringLiteral("ProfileId")] = stringValue(profileId);
+    item[QStringLiteral("CloudId")] = stringValue(tag.cloudId);
+    item[QStringLiteral("Name")] = stringValue(tag.name);
+    item[QStringLiteral("UpdatedAt")] = stringValue(tag.updatedAt);
+    item[QStringLiteral("Hlc")] = integerValue(tag.hlc);
+    item[QStringLiteral("IsDeleted")] = boolValue(tag.isDeleted);
+    return item;
+}
+
+QJsonObject itemFromSession(const SyncSessionRecord &session, const QString &profileId)
+{
+    QJsonObject item;
+    item[QStringLiteral("ProfileId")] = stringValue(profileId);
+    item[QStringLiteral("CloudId")] = stringValue(session.cloudId);
+    item[QStringLiteral("SessionDate")] = stringValue(session.sessionDate);
+    item[QStringLiteral("TimeHours")] = numberValue(session.timeHours);
+    item[QStringLiteral("Description")] = stringValue(session.description);
+
+    if (!session.notes.isEmpty())
+        item[QStringLiteral("Notes")] = stringValue(session.notes);
+    if (!session.nextPlannedStage.isEmpty())
+        item[QStringLiteral("NextPlannedStage")] = stringValue(session.nextPlannedStage);
+    if (!session.tagCloudId.isEmpty())
+        item[QStringLiteral("TagCloudId")] = stringValue(session.tagCloudId);
+
+    item[QStringLiteral("CreatedAt")] = stringValue(session.createdAt);
+    item[QStringLiteral("UpdatedAt")] = stringValue(session.updatedAt);
+    item[QStringLiteral("Hlc")] = integerValue(session.hlc);
+    item[QStringLiteral("IsDeleted")] = boolValue(session.isDeleted);
+    return item;
+}
+
+bool isFetchOperation(const QString &operation)
+{
+    return operation == QLatin1String("tags")
+        || operation == QLatin1String("sessions")
+        || operation == QLatin1String("changesets")
+        || operation == QLatin1String("digests")
+        || operation == QLatin1String("batchget");
+}
+
+} // namespace
+
+DynamoDbBackend::DynamoDbBackend(const SyncConfig &config, QObject *parent)
+    : SyncBackend(parent)
+    , m_config(config)
+    , m_networkManager(new QNetworkAccessManager(this))
+{
+    connect(m_networkManager, &QNetworkAccessManager::finished,
+            this, &DynamoDbBackend::onRequestFinished);
+    m_requestClock.start();
+}
+
+void DynamoDbBackend::testConnection()
+{
+    // Try to describe the sessions table
+    QJsonObject payload;
+    payload[QStringLiteral("TableName")] = m_config.compactPayload
+        ? m_config.changesetsTableName : m_config.sessionsTableName;
+    post(QStringLiteral("DynamoDB_20120810.DescribeTable"), payload, QStringLiteral("test"));
+}
+
+void DynamoDbBackend::fetch()
+{
+    m_pendingFetches = 0;
+    m_fetchError.clear();
+    m_changesetItems = QJsonArray();
+    m_cloudState = SyncChangeset();
+    m_foldedChangesetKeys.clear();
+    m_foldedChangesets = 0;
+    m_supersededChangesets.clear();
+
+    m_cloudDigests.clear();
+    m_cloudEntries.clear();
+    m_scopeDays.clear();
+    m_uploadedDays.clear();
+    m_scoped = false;
+    m_publishDigests = false;
+
+    if (m_config.compactPayload) {
+        queryTable(m_config.changesetsTableName, QStringLiteral("changesets"));
+        return;
+    }
+
+    // Tags are few, so they always come in full
+    queryTable(m_config.tagsTableName, QStringLiteral("tags"));
+    if (!m_reconcile) {
+        queryTable(m_config.sessionsTableName, QStringLiteral("sessions"));
+    } else if (m_verify) {
+        // Everything, plus every digest item so stale ones can go
+        queryTable(m_config.sessionsTableName, QStringLiteral("sessions"));
+        queryDigests(QString());
+    } else {
+        m_scoped = true;
+        queryDigests(QStringLiteral("Y"));
+    }
+}
+
+void DynamoDbBackend::upload(const SyncChangeset &changes)
+{
+    m_pendingUploads = 0;
+    m_uploadError.clear();
+    m_uploadRecords = changes.recordCount();
+    m_putsIssued = 0;
+    m_putsStored = 0;
+    m_fallbackItems.clear();
+    m_changesetRecords = SyncChangeset();
+
+    if (m_config.compactPayload) {
+        m_changesetRecords = changes;
+        uploadChangeset(changes);
+    } else {
+        for (const SyncTagRecord &tag : changes.tags)
+            putItem(m_config.tagsTableName, itemFromTag(tag, m_config.profileId), tag.cloudId, tag.hlc);
+        for (const SyncSessionRecord &session : changes.sessions) {
+            m_uploadedDays.insert(session.sessionDate);
+            if (session.dirtyFields != 0)
+                updateSessionItem(session);
+            else
+                putItem(m_config.sessionsTableName, itemFromSession(session, m_config.profileId),
+                        session.cloudId, session.hlc);
+        }
+    }
+
+    if (m_pendingUploads == 0) {
+        // Nothing to send; still report completion asynchronously
+        const int generation = m_generation;
+        QMetaObject::invokeMethod(this, [this, generation]() {
+            if (generation == m_generation)
+                finishUpload();
+        }, Qt::QueuedConnection);
+    }
+}
+
+void DynamoDbBackend::abort()
+{
+    ++m_generation;
+
+    const QSet<QNetworkReply *> inFlight = m_inFlight;
+    m_inFlight.clear();
+    for (QNetworkReply *reply : inFlight)
+        reply->abort();
+
+    m_pendingFetches = 0;
+    m_pendingUploads = 0;
+    m_changesetItems = QJsonArray();
+    m_cloudState = SyncChangeset();
+    m_supersededChangesets.clear();
+    m_fallbackItems.clear();
+    m_changesetRecords = SyncChangeset();
+    m_publishDigests = false;
+    m_reconcile = false;
+}
+
+bool DynamoDbBackend::canUploadDuringFetch() const
+{
+    // A changeset uploaded early would only add one more to fold
+    return !m_config.compactPayload;
+}
+
+void DynamoDbBackend::reconcileWith(const SyncDigestTree &local, bool verify)
+{
+    m_reconcile = m_config.digestReconciliation && !m_config.compactPayload;
+    m_verify = verify;
+    m_localDigests = local;
+}
+
+void DynamoDbBackend::publishDigests(const SyncDigestTree &merged)
+{
+    if (!m_reconcile)
+        return;
+    m_mergedDigests = merged;
+    m_publishDigests = true;
+}
+
+void DynamoDbBackend::queryTable(const QString &tableName, const QString &operation,
+                                 const QJsonObject &exclusiveStartKey)
+{
+    QJsonObject payload;
+    payload[QStringLiteral("TableName")] = tableName;
+    payload[QStringLiteral("KeyConditionExpression")] = QStringLiteral("ProfileId = :profileId");
+
+    QJsonObject expressionValues;
+    expressionValues[QStringLiteral(":profileId")] = stringValue(m_config.profileId);
+    payload[QStringLiteral("ExpressionAttributeValues")] = expressionValues;
+    if (!exclusiveStartKey.isEmpty()) {
+        payload[QStringLiteral("ExclusiveStartKey")] = exclusiveStartKey;
+    }
+
+    post(QStringLiteral("DynamoDB_20120810.Query"), payload, operation);
+}
+
+void DynamoDbBackend::putItem(const QString &tableName, const QJsonObject &item,
+                              const QString &cloudId, qint64 hlc)
+{
+    QJsonObject payload;
+    payload[QStringLiteral("TableName")] = tableName;
+    payload[QStringLiteral("Item")] = item;
+    if (!cloudId.isEmpty()) {
+        QJsonObject values;
+        values[QStringLiteral(":hlc")] = integerValue(hlc);
+        payload[QStringLiteral("ConditionExpression")] = NotNewerCondition;
+        payload[QStringLiteral("ExpressionAttributeValues")] = values;
+    }
+
+    m_putsIssued++;
+    post(QStringLiteral("DynamoDB_20120810.PutItem"), payload, QStringLiteral("put"), cloudId, hlc);
+}
+
+void DynamoDbBackend::deleteItem(const QString &tableName, const QString &cloudId,
+                                 const QString &partition)
+{
+    QJsonObject key;
+    key[QStringLiteral("ProfileId")] = stringValue(partition.isEmpty() ? m_config.profileId : partition);
+    key[QStringLiteral("CloudId")] = stringValue(cloudId);
+
+    QJsonObject payload;
+    payload[QStringLiteral("TableName")] = tableName;
+    payload[QStringLiteral("Key")] = key;
+
+    post(QStringLiteral("DynamoDB_20120810.DeleteItem"), payload, QStringLiteral("delete"));
+}
+
+// Sends only the fields edited locally, so a change to the hours does not
+// re-upload long notes
+void DynamoDbBackend::updateSessionItem(const SyncSessionRecord &session)
+{
+    QStringList setClauses;
+    QStringList removeNames;
+    QJsonObject names;
+    QJsonObject values;
+
+    auto nameFor = [&names](const QString &attribute) {
+        const QString name = QStringLiteral("#a%1").arg(names.size());
+        names[name] = attribute;
+        return name;
+    };
+    auto set = [&](const QString &attribute, const QJsonObject &value) {
+        const QString valueName = QStringLiteral(":v%1").arg(values.size());
+        values[valueName] = value;
+        setClauses.append(nameFor(attribute) + QStringLiteral(" = ") + valueName);
+    };
+    // Empty optional fields are left out of full items, so remove them here
+    auto setOptional = [&](const QString &attribute, const QString &value) {
+        if (value.isEmpty())
+            removeNames.append(nameFor(attribute));
+        else
+            set(attribute, stringValue(value));
+    };
+
+    if (session.dirtyFields & SyncSessionRecord::DateDirty)
+        set(QStringLiteral("SessionDate"), stringValue(session.sessionDate));
+    if (session.dirtyFields & SyncSessionRecord::HoursDirty)
+        set(QStringLiteral("TimeHours"), numberValue(session.timeHours));
+    if (session.dirtyFields & SyncSessionRecord::DescriptionDirty)
+        set(QStringLiteral("Description"), stringValue(session.description));
+    if (session.dirtyFields & SyncSessionRecord::NotesDirty)
+        setOptional(QStringLiteral("Notes"), session.notes);
+    if (session.dirtyFields & SyncSessionRecord::NextStageDirty)
+        setOptional(QStringLiteral("NextPlannedStage"), session.nextPlannedStage);
+    if (session.dirtyFields & SyncSessionRecord::TagDirty)
+        setOptional(QStringLiteral("TagCloudId"), session.tagCloudId);
+    set(QStringLiteral("UpdatedAt"), stringValue(session.updatedAt));
+    set(QStringLiteral("Hlc"), integerValue(session.hlc));
+    set(QStringLiteral("IsDeleted"), boolValue(session.isDeleted));
+
+    QString expression = QStringLiteral("SET ") + setClauses.join(QStringLiteral(", "));
+    if (!removeNames.isEmpty())
+        expression += QStringLiteral(" REMOVE ") + removeNames.join(QStringLiteral(", "));
+
+    QJsonObject key;
+    key[QStringLiteral("ProfileId")] = stringValue(m_config.profileId);
+    key[QStringLiteral("CloudId")] = stringValue(session.cloudId);
+
+    QJsonObject payload;
+    payload[QStringLiteral("TableName")] = m_config.sessionsTableName;
+    payload[QStringLiteral("Key")] = key;
+    payload[QStringLiteral("UpdateExpression")] = expression;
+    // Never let a partial update create a partial item
+    values[QStringLiteral(":hlc")] = integerValue(session.hlc);
+    payload[QStringLiteral("ConditionExpression")] = QStringLiteral("attribute_exists(CloudId) AND ") + NotNewerCondition;
+    payload[QStringLiteral("ExpressionAttributeNames")] = names;
+    payload[QStringLiteral("ExpressionAttributeValues")] = values;
+
+    m_fallbackItems.insert(session.cloudId, itemFromSession(session, m_config.profileId));
+    m_putsIssued++;
+    post(QStringLiteral("DynamoDB_20120810.UpdateItem"), payload, QStringLiteral("update"),
+         session.cloudId, session.hlc);
+}
+
+void DynamoDbBackend::post(const QString &amzTarget, const QJsonObject &payload, const QString &operation,
+                           const QString &cloudId, qint64 hlc)
+{
+    QUrl url;
+    QString host;
+    if (m_config.endpoint.isEmpty()) {
+        host = QStringLiteral("dynamodb.%1.amazonaws.com").arg(m_config.awsRegion);
+        url = QUrl(QStringLiteral("https://%1").arg(host));
+    } else {
+        url = QUrl(m_config.endpoint);
+        host = url.port() > 0 ? QStringLiteral("%1:%2").arg(url.host()).arg(url.port()) : url.host();
+    }
+    QDateTime timestamp = QDateTime::currentDateTimeUtc();
+    QByteArray payloadBytes = QJsonDocument(payload).toJson(QJsonDocument::Compact);
+
+    QNetworkRequest request(url);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/x-amz-json-1.0"));
+    request.setRawHeader("X-Amz-Target", amzTarget.toLatin1());
+    request.setRawHeader("X-Amz-Date", timestamp.toString(QStringLiteral("yyyyMMddTHHmmssZ")).toLatin1());
+    request.setRawHeader("Host", host.toLatin1());
+
+    QString authHeader = signRequest(QStringLiteral("POST"), QStringLiteral("dynamodb"),
+                                     host, QStringLiteral("/"), QString::fromUtf8(payloadBytes), timestamp, amzTarget);
+    request.setRawHeader("Authorization", authHeader.toLatin1());
+
+    request.setAttribute(QNetworkRequest::User, operation);
+    request.setAttribute(RequestStartedAttribute, m_requestClock.nsecsElapsed());
+    request.setAttribute(GenerationAttribute, m_generation);
+    if (!cloudId.isEmpty()) {
+        request.setAttribute(CloudIdAttribute, cloudId);
+        request.setAttribute(HlcAttribute, hlc);
+    }
+
+    if (Tracer::isEnabled()) {
+        const quint64 traceId = Tracer::nextAsyncId();
+        request.setAttribute(TraceIdAttribute, traceId);
+        Tracer::asyncBegin("sync.request." + operation.toLatin1(), traceId);
+    }
+
+    QNetworkReply *reply = m_networkManager->post(request, payloadBytes);
+    if (operation != QLatin1String("test")) {
+        if (isFetchOperation(operation))
+            m_pendingFetches++;
+        else
+            m_pendingUploads++;
+        m_inFlight.insert(reply);
+    }
+
+    Diagnostics::instance()->add("sync.bytesSent", payloadBytes.size());
+    emit bytesTransferred(payloadBytes.size());
+}
+
+void DynamoDbBackend::onRequestFinished(QNetworkReply *reply)
+{
+    QString operation = reply->request().attribute(QNetworkRequest::User).toString();
+    QByteArray responseData = reply->readAll();
+    reply->deleteLater();
+    m_inFlight.remove(reply);
+
+    const qint64 startedAt = reply->request().attribute(RequestStartedAttribute).toLongLong();
+    Diagnostics::instance()->record(QStringLiteral("sync.request.") + operation,
+                                    m_requestClock.nsecsElapsed() - startedAt);
+    Diagnostics::instance()->add("sync.bytesReceived", responseData.size());
+
+    const QVariant traceId = reply->request().attribute(TraceIdAttribute);
+    if (traceId.isValid())
+        Tracer::asyncEnd("sync.request." + operation.toLatin1(), traceId.toULongLong());
+
+    const int generation = reply->request().attribute(GenerationAttribute).toInt();
+    if (operation != QLatin1String("test") && generation != m_generation)
+        return;
+    emit bytesTransferred(responseData.size());
+
+    if (reply->error() != QNetworkReply::NoError) {
+        QString errorMsg = reply->errorString();
+        qWarning() << "Sync request failed:" << errorMsg << responseData;
+
+        if (operation == QStringLiteral("test")) {
+            emit connectionTested(false, tr("Connection failed: %1").arg(errorMsg));
+            return;
+        }
+
+        const QString cloudId = reply->request().attribute(CloudIdAttribute).toString();
+        const QJsonObject fallbackItem = m_fallbackItems.take(cloudId);
+        const bool conditionFailed = responseData.contains("ConditionalCheckFailedException");
+        if (operation == QStringLiteral("update") && conditionFailed && !fallbackItem.isEmpty()) {
+            // The item is gone, or newer; a whole conditional put settles which
+            m_putsIssued--;
+            putItem(m_config.sessionsTableName, fallbackItem, cloudId,
+                    reply->request().attribute(HlcAttribute).toLongLong());
+        } else if (operation == QStringLiteral("put") && conditionFailed) {
+            // A newer version is already stored; this one is obsolete. The
+            // merged digests would misdescribe it, so leave them to the
+            // device that stored it.
+            m_publishDigests = false;
+            markStored(reply->request());
+        } else if (operation != QStringLiteral("delete") && operation != QStringLiteral("digest")) {
+            // A superseded changeset that survives is simply folded again,
+            // and a digest left stale differs from this device's tree, so
+            // its next sync writes it again
+            QString &error = isFetchOperation(operation) ? m_fetchError : m_uploadError;
+            if (error.isEmpty())
+                error = errorMsg;
+        }
+    } else if (operation == QStringLiteral("tags") || operation == QStringLiteral("sessions")
+               || operation == QStringLiteral("batchget")) {
+        decodePage(operation, responseData);
+    } else {
+        QJsonDocument doc = QJsonDocument::fromJson(responseData);
+        QJsonObject response = doc.object();
+        const QJsonObject lastEvaluatedKey = response[QStringLiteral("LastEvaluatedKey")].toObject();
+        const QJsonArray items = response[QStringLiteral("Items")].toArray();
+
+        if (operation == QStringLiteral("test")) {
+            emit connectionTested(true, tr("Connection successful!"));
+            return;
+        } else if (operation == QStringLiteral("changesets")) {
+            for (const QJsonValue &item : items)
+                m_changesetItems.append(item);
+            if (!lastEvaluatedKey.isEmpty())
+                queryTable(m_config.changesetsTableName, operation, lastEvaluatedKey);
+            else
+                expandChangesets();
+        } else if (operation == QStringLiteral("digests")) {
+            for (const QJsonValue &value : items) {
+                const QJsonObject item = value.toObject();
+                const QString key = stringAttribute(item, QStringLiteral("CloudId"));
+                m_cloudDigests.insert(key, stringAttribute(item, QStringLiteral("Digest")));
+                if (key.startsWith(QLatin1Char('D'))) {
+                    m_cloudEntries.insert(key.mid(1), stringAttribute(item, QStringLiteral("Entries"))
+                                                          .split(QLatin1Char(' '), Qt::SkipEmptyParts));
+                }
+            }
+            const QString prefix = reply->request().attribute(CloudIdAttribute).toString();
+            if (!lastEvaluatedKey.isEmpty())
+                queryDigests(prefix, lastEvaluatedKey);
+            else if (m_scoped)
+                compareDigests(prefix);
+        } else if (operation == QStringLiteral("put") || operation == QStringLiteral("update")) {
+            if (operation == QStringLiteral("update"))
+                m_fallbackItems.remove(reply->request().attribute(CloudIdAttribute).toString());
+            markStored(reply->request());
+        }
+    }
+
+    // A receiver may have aborted the run while handling this reply
+    if (generation != m_generation)
+        return;
+
+    // A fetch and an upload may be in flight together; each completes on
+    // its own
+    const bool fetchOperation = isFetchOperation(operation);
+    int &pending = fetchOperation ? m_pendingFetches : m_pendingUploads;
+    if (--pending > 0)
+        return;
+
+    if (fetchOperation)
+        finishFetch();
+    else
+        finishUpload();
+}
+
+void DynamoDbBackend::decodePage(const QString &operation, const QByteArray &data)
+{
+    const bool tags = operation == QLatin1String("tags");
+    DynamoDbDecoder::Page page;
+    {
+        const DiagnosticsTimer timer(tags ? "sync.decode.tags" : "sync.decode.sessions");
+        if (!m_decoder.decode(data, tags ? DynamoDbDecoder::Records::Tags
+                                         : DynamoDbDecoder::Records::Sessions, &page)) {
+            qWarning() << "Malformed sync response:" << m_decoder.errorString();
+            if (m_fetchError.isEmpty())
+                m_fetchError = tr("Malformed response from the sync target");
+            return;
+        }
+    }
+
+    const int generation = m_generation;
+    if (tags) {
+        emit tagsReceived(page.tags);
+        if (generation != m_generation)
+            return;
+        if (!page.lastEvaluatedKey.isEmpty())
+            queryTable(m_config.tagsTableName, operation, page.lastEvaluatedKey);
+        else
+            emit tagsFetched();
+        return;
+    }
+
+    emit sessionsReceived(page.sessions);
+    if (generation != m_generation)
+        return;
+    if (!page.lastEvaluatedKey.isEmpty())
+        queryTable(m_config.sessionsTableName, operation, page.lastEvaluatedKey);
+    // Keys a batch get left over when its response hit the size limit
+    if (!page.unprocessedKeys.isEmpty())
+        batchGetSessions(page.unprocessedKeys);
+}
+
+void DynamoDbBackend::markStored(const QNetworkRequest &request)
+{
+    m_putsStored++;
+    emit uploadProgress(int(qint64(m_uploadRecords) * m_putsStored / m_putsIssued));
+
+    const QVariant cloudId = request.attribute(CloudIdAttribute);
+    if (cloudId.isValid())
+        emit recordStored(cloudId.toString(), request.attribute(HlcAttribute).toLongLong());
+}
+
+void DynamoDbBackend::finishFetch()
+{
+    if (m_scoped && m_fetchError.isEmpty()) {
+        QStringList days = m_scopeDays.values();
+        days.sort();
+        emit fetchScope(days);
+    }
+    emit fetchFinished(m_fetchError.isEmpty(), m_fetchError);
+}
+
+void DynamoDbBackend::finishUpload()
+{
+    // Digests go last, once every record they describe is stored
+    if (m_publishDigests && m_uploadError.isEmpty()) {
+        m_publishDigests = false;
+        writeDigests();
+        if (m_pendingUploads > 0)
+            return;
+    }
+    m_publishDigests = false;
+
+    if (m_uploadError.isEmpty() && !m_changesetRecords.isEmpty()) {
+        // Every part is stored, so every record in the changeset is
+        for (const SyncTagRecord &tag : qAsConst(m_changesetRecords.tags))
+            emit recordStored(tag.cloudId, tag.hlc);
+        for (const SyncSessionRecord &session : qAsConst(m_changesetRecords.sessions))
+            emit recordStored(session.cloudId, session.hlc);
+    }
+    m_changesetRecords = SyncChangeset();
+
+    // Superseded changesets go only once their replacement is stored
+    if (!m_supersededChangesets.isEmpty() && m_uploadError.isEmpty()) {
+        const QStringList superseded = m_supersededChangesets;
+        m_supersededChangesets.clear();
+        for (const QString &cloudId : superseded)
+            deleteItem(m_config.changesetsTableName, cloudId);
+        return;
+    }
+
+    m_supersededChangesets.clear();
+    emit uploadFinished(m_uploadError.isEmpty(), m_uploadError);
+}
+
+QString DynamoDbBackend::digestPartition() const
+{
+    // Clients that query the profile's partition never see the digests
+    return m_config.profileId + QStringLiteral("#digest");
+}
+
+void DynamoDbBackend::queryDigests(const QString &prefix, const QJsonObject &exclusiveStartKey)
+{
+    QJsonObject expressionValues;
+    expressionValues[QStringLiteral(":profileId")] = stringValue(digestPartition());
+
+    QJsonObject payload;
+    payload[QStringLiteral("TableName")] = m_config.sessionsTableName;
+    if (prefix.isEmpty()) {
+        payload[QStringLiteral("KeyConditionExpression")] = QStringLiteral("ProfileId = :profileId");
+    } else {
+        payload[QStringLiteral("KeyConditionExpression")] =
+            QStringLiteral("ProfileId = :profileId AND begins_with(CloudId, :prefix)");
+        expressionValues[QStringLiteral(":prefix")] = stringValue(prefix);
+    }
+    payload[QStringLiteral("ExpressionAttributeValues")] = expressionValues;
+    if (!exclusiveStartKey.isEmpty())
+        payload[QStringLiteral("ExclusiveStartKey")] = exclusiveStartKey;
+
+    post(QStringLiteral("DynamoDB_20120810.Query"), payload, QStringLiteral("digests"), prefix);
+}
+
+QStringList DynamoDbBackend::cloudPeriods(const QString &keyPrefix) const
+{
+    QStringList periods;
+    for (auto it = m_cloudDigests.constBegin(); it != m_cloudDigests.constEnd(); ++it) {
+        if (it.key().startsWith(keyPrefix))
+            periods.append(it.key().mid(1));
+    }
+    return periods;
+}
+
+// Called once all digest items under prefix ("Y", "M<year>" or
+// "D<month>") are in; descends into the periods whose digests differ
+void DynamoDbBackend::compareDigests(const QString &prefix)
+{
+    const QChar level = prefix.at(0);
+    const QString parent = prefix.mid(1);
+
+    QStringList periods;
+    QChar childLevel = QLatin1Char('D');
+    if (level == QLatin1Char('Y')) {
+        if (m_cloudDigests.isEmpty()) {
+            // The target has no digests yet; fetch everything this once
+            m_scoped = false;
+            queryTable(m_config.sessionsTableName, QStringLiteral("sessions"));
+            return;
+        }
+        periods = m_localDigests.years() + cloudPeriods(QStringLiteral("Y"));
+        childLevel = QLatin1Char('M');
+    } else if (level == QLatin1Char('M')) {
+        periods = m_localDigests.months(parent) + cloudPeriods(prefix + QLatin1Char('-'));
+    } else {
+        periods = m_localDigests.days(parent) + cloudPeriods(prefix + QLatin1Char('-'));
+    }
+    periods.removeDuplicates();
+
+    QJsonArray keys;
+    for (const QString &period : qAsConst(periods)) {
+        if (m_cloudDigests.value(level + period) == QString::fromLatin1(m_localDigests.digest(period)))
+            continue;
+
+        if (level != QLatin1Char('D')) {
+            queryDigests(childLevel + period);
+            continue;
+        }
+
+        // A differing day: fetch every session the target lists for it;
+        // local ones it does not list are missing there
+        m_scopeDays.insert(period);
+        for (const QString &entry : m_cloudEntries.value(period)) {
+            QJsonObject key;
+            key[QStringLiteral("ProfileId")] = stringValue(m_config.profileId);
+            key[QStringLiteral("CloudId")] = stringValue(SyncDigestTree::cloudIdOfEntry(entry));
+            keys.append(key);
+            if (keys.size() == BatchGetKeys) {
+                batchGetSessions(keys);
+                keys = QJsonArray();
+            }
+        }
+    }
+    if (!keys.isEmpty())
+        batchGetSessions(keys);
+}
+
+void DynamoDbBackend::batchGetSessions(const QJsonArray &keys)
+{
+    QJsonObject request;
+    request[QStringLiteral("Keys")] = keys;
+    QJsonObject requestItems;
+    requestItems[m_config.sessionsTableName] = request;
+
+    QJsonObject payload;
+    payload[QStringLiteral("RequestItems")] = requestItems;
+    post(QStringLiteral("DynamoDB_20120810.BatchGetItem"), payload, QStringLiteral("batchget"));
+}
+
+void DynamoDbBackend::writeDigests()
+{
+    const DiagnosticsTimer timer("sync.writeDigests");
+
+    // A scoped sync changed only the days in scope and those it uploaded
+    // to; after a full fetch every period may have changed
+    QSet<QString> days;
+    if (m_scoped) {
+        days = m_scopeDays + m_uploadedDays;
+    } else {
+        for (const QString &year : m_mergedDigests.years()) {
+            for (const QString &month : m_mergedDigests.months(year)) {
+                for (const QString &day : m_mergedDigests.days(month))
+                    days.insert(day);
+            }
+        }
+        for (const QString &day : cloudPeriods(QStringLiteral("D")))
+            days.insert(day);
+    }
+
+    QSet<QString> months;
+    QSet<QString> years;
+    for (const QString &day : qAsConst(days)) {
+        months.insert(day.left(7));
+        years.insert(day.left(4));
+    }
+
+    auto write = [this](QChar level, const QString &period) {
+        const QString key = level + period;
+        const QString digest = QString::fromLatin1(m_mergedDigests.digest(period));
+        if (digest.isEmpty()) {
+            // Only a full fetch knows for sure which items exist
+            if (m_scoped || m_cloudDigests.contains(key))
+                deleteItem(m_config.sessionsTableName, key, digestPartition());
+        } else if (digest != m_cloudDigests.value(key)) {
+            putDigest(key, digest, level == QLatin1Char('D') ? m_mergedDigests.entries(period) : QStringList());
+        }
+    };
+    for (const QString &day : qAsConst(days))
+        write(QLatin1Char('D'), day);
+    for (const QString &month : qAsConst(months))
+        write(QLatin1Char('M'), month);
+    for (const QString &year : qAsConst(years))
+        write(QLatin1Char('Y'), year);
+}
+
+void DynamoDbBackend::putDigest(const QString &key, const QString &digest, const QStringList &entries)
+{
+    QJsonObject item;
+    item[QStringLiteral("ProfileId")] = stringValue(digestPartition());
+    item[QStringLiteral("CloudId")] = stringValue(key);
+    item[QStringLiteral("Digest")] = stringValue(digest);
+    if (!entries.isEmpty())
+        item[QStringLiteral("Entries")] = stringValue(entries.join(QLatin1Char(' ')));
+
+    QJsonObject payload;
+    payload[QStringLiteral("TableName")] = m_config.sessionsTableName;
+    payload[QStringLiteral("Item")] = item;
+    post(QStringLiteral("DynamoDB_20120810.PutItem"), payload, QStringLiteral("digest"));
+}
+
+void DynamoDbBackend::expandChangesets()
+{
+    const DiagnosticsTimer timer("sync.expandChangesets");
+
+    // Group the stored parts by changeset; ids sort chronologically
+    QMap<QString, QMap<int, QJsonObject>> partsByChangeset;
+    QMap<QString, int> partCountByChangeset;
+    for (const QJsonValue &value : qAsConst(m_changesetItems)) {
+        const QJsonObject item = value.toObject();
+        const QString changesetId = stringAttribute(item, QStringLiteral("ChangesetId"));
+        partsByChangeset[changesetId].insert(numberAttribute(item, QStringLiteral("Part")).toInt(), item);
+        partCountByChangeset[changesetId] = numberAttribute(item, QStringLiteral("PartCount")).toInt();
+    }
+    m_changesetItems = QJsonArray();
+
+    for (auto it = partsByChangeset.constBegin(); it != partsByChangeset.constEnd(); ++it) {
+        const QMap<int, QJsonObject> &parts = it.value();
+        if (parts.size() != partCountByChangeset.value(it.key())) {
+            // Still being uploaded elsewhere, or an interrupted upload
+            continue;
+        }
+
+        QByteArray data;
+        for (const QJsonObject &part : parts)
+            data.append(QByteArray::fromBase64(part[QStringLiteral("Payload")].toObject()[QStringLiteral("B")].toString().toLatin1()));
+
+        SyncChangeset changeset;
+        QString errorString;
+        if (!SyncChangeset::decode(data, &changeset, &errorString)) {
+            qWarning() << "Skipping changeset" << it.key() << ":" << errorString;
+            continue;
+        }
+
+        m_cloudState.merge(changeset);
+        ++m_foldedChangesets;
+        for (const QJsonObject &part : parts)
+            m_foldedChangesetKeys.append(stringAttribute(part, QStringLiteral("CloudId")));
+    }
+
+    emit tagsReceived(m_cloudState.tags);
+    emit sessionsReceived(m_cloudState.sessions);
+}
+
+void DynamoDbBackend::uploadChangeset(const SyncChangeset &changes)
+{
+    // Fold the history into one changeset once it grows long, so the
+    // download stays a handful of items
+    SyncChangeset changeset;
+    if (m_foldedChangesets >= CompactionThreshold) {
+        changeset = m_cloudState;
+        changeset.merge(changes);
+        m_supersededChangesets = m_foldedChangesetKeys;
+    } else {
+        changeset = changes;
+    }
+    m_cloudState = SyncChangeset();
+
+    if (changeset.isEmpty())
+        return;
+
+    QByteArray data;
+    {
+        const DiagnosticsTimer timer("sync.encodeChangeset");
+        data = changeset.encode();
+    }
+
+    const QString changesetId = SyncChangeset::newChangesetId();
+    const QString createdAt = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    const int partCount = qMax(1, int((data.size() + ChangesetPartBytes - 1) / ChangesetPartBytes));
+
+    for (int part = 0; part < partCount; ++part) {
+        QJsonObject item;
+        item[QStringLiteral("ProfileId")] = stringValue(m_config.profileId);
+        item[QStringLiteral("CloudId")] = stringValue(QStringLiteral("%1#%2").arg(changesetId).arg(part, 4, 10, QLatin1Char('0')));
+        item[QStringLiteral("ChangesetId")] = stringValue(changesetId);
+        item[QStringLiteral("Part")] = numberValue(part);
+        item[QStringLiteral("PartCount")] = numberValue(partCount);
+        item[QStringLiteral("RecordCount")] = numberValue(changeset.recordCount());
+        item[QStringLiteral("CreatedAt")] = stringValue(createdAt);
+
+        QJsonObject payloadAttr;
+        payloadAttr[QStringLiteral("B")] = QString::fromLatin1(data.mid(part * ChangesetPartBytes, ChangesetPartBytes).toBase64());
+        item[QStringLiteral("Payload")] = payloadAttr;
+
+        putItem(m_config.changesetsTableName, item);
+    }
+}
+
+// AWS Signature Version 4 implementation
+QString DynamoDbBackend::signRequest(const QString &method, const QString &service,
+                                     const QString &host, const QString &canonicalUri,
+                                     const QString &payload, const QDateTime &timestamp,
+                                     const QString &amzTarget)
+{
+    QString amzDate = timestamp.toString(QStringLiteral("yyyyMMddTHHmmssZ"));
+    QString dateStamp = timestamp.toString(QStringLiteral("yyyyMMdd"));
+
+    // Create canonical request
+    QString signedHeaders = QStringLiteral("content-type;host;x-amz-date;x-amz-target");
+    QString canonicalHeaders = QStringLiteral("content-type:application/x-amz-json-1.0\n")
+        + QStringLiteral("host:%1\n").arg(host)
+        + QStringLiteral("x-amz-date:%1\n").arg(amzDate)
+        + QStringLiteral("x-amz-target:%1\n").arg(amzTarget);
+
+    QString payloadHash = hashSha256(payload);
+    QString canonicalRequest = method + QStringLiteral("\n")
+        + canonicalUri + QStringLiteral("\n")
+        + QStringLiteral("\n")  // query string
+        + canonicalHeaders + QStringLiteral("\n")
+        + signedHeaders + QStringLiteral("\n")
+        + payloadHash;
+
+    // Create string to sign
+    QString algorithm = QStringLiteral("AWS4-HMAC-SHA256");
+    QString credentialScope = dateStamp + QStringLiteral("/") + m_config.awsRegion + QStringLiteral("/") + service + QStringLiteral("/aws4_request");
+    QString stringToSign = algorithm + QStringLiteral("\n")
+        + amzDate + QStringLiteral("\n")
+        + credentialScope + QStringLiteral("\n")
+        + hashSha256(canonicalRequest);
+
+    // Create signing key
+    QByteArray kDate = hmacSha256(QStringLiteral("AWS4%1").arg(m_config.awsSecretAccessKey).toUtf8(), dateStamp.toUtf8());
+    QByteArray kRegion = hmacSha256(kDate, m_config.awsRegion.toUtf8());
+    QByteArray kService = hmacSha256(kRegion, service.toUtf8());
+    QByteArray kSigning = hmacSha256(kService, QByteArrayLiteral("aws4_request"));
+
+    // Create signature
+    QString signature = QString::fromLatin1(hmacSha256(kSigning, stringToSign.toUtf8()).toHex());
+
+    // Create authorization header
+    QString authHeader = algorithm + QStringLiteral(" ")
+        + QStringLiteral("Credential=%1/%2, ").arg(m_config.awsAccessKeyId, credentialScope)
+        + QStringLiteral("SignedHeaders=%1, ").arg(signedHeaders)
+        + QStringLiteral("Signature=%1").arg(signature);
+
+    return authHeader;
+}
+
+QByteArray DynamoDbBackend::hmacSha256(const QByteArray &key, const QByteArray &data)
+{
+    return QMessageAuthenticationCode::hash(data, key, QCryptographicHash::Sha256);
+}
+
+QString DynamoDbBackend::hashSha256(const QString &data)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(data.toUtf8(), QCryptographicHash::Sha256).toHex());
+}
@@ -0,0 +1,120 @@
+#ifndef DYNAMODBBACKEND_H
+#define DYNAMODBBACKEND_H
+
+#include "dynamodbdecoder.h"
+#include "syncbackend.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+// Syncs against Amazon DynamoDB (or a compatible endpoint) using SigV4
+// signed JSON requests. Records are stored one item each, or as compact
+// changesets when SyncConfig::compactPayload is set.
+class DynamoDbBackend : public SyncBackend
+{
+    Q_OBJECT
+
+public:
+    explicit DynamoDbBackend(const SyncConfig &config, QObject *parent = nullptr);
+
+    void testConnection() override;
+    void fetch() override;
+    void upload(const SyncChangeset &changes) override;
+    void abort() override;
+    bool canUploadDuringFetch() const override;
+    void reconcileWith(const SyncDigestTree &local, bool verify) override;
+    void publishDigests(const SyncDigestTree &merged) override;
+
+private slots:
+    void onRequestFinished(QNetworkReply *reply);
+
+private:
+    void queryTable(const QString &tableName, const QString &operation,
+                    const QJsonObject &exclusiveStartKey = QJsonObject());
+    // Record puts (cloudId set) only replace an older version of the item
+    void putItem(const QString &tableName, const QJsonObject &item,
+                 const QString &cloudId = QString(), qint64 hlc = 0);
+    void deleteItem(const QString &tableName, const QString &cloudId,
+                    const QString &partition = QString());
+    void updateSessionItem(const SyncSessionRecord &session);
+    void post(const QString &amzTarget, const QJsonObject &payload, const QString &operation,
+              const QString &cloudId = QString(), qint64 hlc = 0);
+    void markStored(const QNetworkRequest &request);
+    // Tag and session pages skip the JSON document model
+    void decodePage(const QString &operation, const QByteArray &data);
+
+    // Digest items live in the sessions table under their own partition,
+    // keyed by level and period: "Y2024", "M2024-03", "D2024-03-15"
+    QString digestPartition() const;
+    void queryDigests(const QString &prefix, const QJsonObject &exclusiveStartKey = QJsonObject());
+    void compareDigests(const QString &prefix);
+    QStringList cloudPeriods(const QString &keyPrefix) const;
+    void batchGetSessions(const QJsonArray &keys);
+    void writeDigests();
+    void putDigest(const QString &key, const QString &digest, const QStringList &entries);
+
+    void expandChangesets();
+    void uploadChangeset(const SyncChangeset &changes);
+    void finishFetch();
+    void finishUpload();
+
+    QString signRequest(const QString &method, const QString &service,
+                       const QString &host, const QString &canonicalUri,
+                       const QString &payload, const QDateTime &timestamp,
+                       const QString &amzTarget);
+    QByteArray hmacSha256(const QByteArray &key, const QByteArray &data);
+    QString hashSha256(const QString &data);
+
+    SyncConfig m_config;
+    QNetworkAccessManager *m_networkManager;
+    QElapsedTimer m_requestClock;
+
+    int m_pendingFetches = 0;
+    int m_pendingUploads = 0;
+    QString m_fetchError;
+    QString m_uploadError;
+    // Replies of an aborted run carry an older generation and are ignored
+    int m_generation = 0;
+    QSet<QNetworkReply *> m_inFlight;
+    DynamoDbDecoder m_decoder;
+
+    // Upload progress; a put is one record, or one part of a changeset
+    int m_uploadRecords = 0;
+    int m_putsIssued = 0;
+    int m_putsStored = 0;
+
+    // Full items to put instead when a partial update finds no item
+    QHash<QString, QJsonObject> m_fallbackItems;
+    // Records of the changeset being uploaded in compact mode
+    SyncChangeset m_changesetRecords;
+
+    // Digest reconciliation. A scoped fetch only covers m_scopeDays; an
+    // unscoped one (verify, or a target without digests) covers everything.
+    bool m_reconcile = false;
+    bool m_verify = false;
+    bool m_scoped = false;
+    SyncDigestTree m_localDigests;
+    SyncDigestTree m_mergedDigests;
+    bool m_publishDigests = false;
+    // Digest by item key, and the entries of each day item, as fetched
+    QHash<QString, QString> m_cloudDigests;
+    QHash<QString, QStringList> m_cloudEntries;
+    QSet<QString> m_scopeDays;
+    QSet<QString> m_uploadedDays;
+
+    // Compact mode
+    QJsonArray m_changesetItems;
+    SyncChangeset m_cloudState;
+    QStringList m_foldedChangesetKeys;
+    int m_foldedChangesets = 0;
+    QStringList m_supersededChangesets;
+};
+
+#endif // DYNAMODBBACKEND_H
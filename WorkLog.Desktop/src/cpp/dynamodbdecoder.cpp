@@ -0,0 +1,490 @@
+#include "dynamodbdecoder.h"
+#include "hybridclock.h"
+
+#include <QJsonDocument>
+#include <QJsonParseError>
+
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+// Initial scratch capacity; it grows to the longest escaped string seen
+constexpr int ScratchBytes = 4096;
+// A page holds at most 1 MB of items, so a larger count is not trusted
+constexpr int MaxReservedItems = 100000;
+
+// A JSON string as it appears in the page, without the quotes
+struct Span {
+    const char *data = nullptr;
+    int size = 0;
+    bool escaped = false;
+};
+
+template <std::size_t N>
+bool is(const Span &span, const char (&name)[N])
+{
+    return !span.escaped && std::size_t(span.size) == N - 1 && std::memcmp(span.data, name, N - 1) == 0;
+}
+
+// One DynamoDB attribute value; only the types records use are kept
+struct AttributeValue {
+    enum Type {
+        Other,
+        String,
+        Number,
+        Bool
+    };
+
+    Type type = Other;
+    Span text;
+    bool flag = false;
+};
+
+void appendUtf8(QByteArray *out, uint codePoint)
+{
+    if (codePoint < 0x80) {
+        out->append(char(codePoint));
+    } else if (codePoint < 0x800) {
+        out->append(char(0xC0 | (codePoint >> 6)));
+        out->append(char(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        out->append(char(0xE0 | (codePoint >> 12)));
+        out->append(char(0x80 | ((codePoint >> 6) & 0x3F)));
+        out->append(char(0x80 | (codePoint & 0x3F)));
+    } else {
+        out->append(char(0xF0 | (codePoint >> 18)));
+        out->append(char(0x80 | ((codePoint >> 12) & 0x3F)));
+        out->append(char(0x80 | ((codePoint >> 6) & 0x3F)));
+        out->append(char(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+// Characters of numbers and of true, false and null
+bool isLiteral(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+        || c == '-' || c == '+' || c == '.';
+}
+
+// Four hex digits at p, or -1
+int hexQuad(const char *p, const char *end)
+{
+    if (end - p < 4)
+        return -1;
+    int value = 0;
+    for (int i = 0; i < 4; ++i) {
+        const char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value |= c - 'A' + 10;
+        else
+            return -1;
+    }
+    return value;
+}
+
+class Scanner
+{
+public:
+    Scanner(const char *begin, const char *end, QByteArray *scratch)
+        : m_begin(begin)
+        , m_pos(begin)
+        , m_end(end)
+        , m_scratch(scratch)
+    {
+    }
+
+    const char *position() const { return m_pos; }
+    bool atEnd()
+    {
+        skipSpace();
+        return m_pos >= m_end;
+    }
+    QString error() const { return m_error; }
+
+    bool fail(const char *what)
+    {
+        if (m_error.isEmpty())
+            m_error = QStringLiteral("%1 at offset %2").arg(QLatin1String(what)).arg(m_pos - m_begin);
+        return false;
+    }
+
+    void skipSpace()
+    {
+        while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+            ++m_pos;
+    }
+
+    // Consumes c if it comes next
+    bool consume(char c)
+    {
+        skipSpace();
+        if (m_pos < m_end && *m_pos == c) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool expect(char c)
+    {
+        return consume(c) || fail("Unexpected character");
+    }
+
+    bool string(Span *span)
+    {
+        if (!expect('"'))
+            return false;
+        span->data = m_pos;
+        span->escaped = false;
+        while (m_pos < m_end) {
+            if (*m_pos == '"') {
+                span->size = int(m_pos - span->data);
+                ++m_pos;
+                return true;
+            }
+            if (*m_pos == '\\') {
+                span->escaped = true;
+                if (++m_pos == m_end)
+                    break;
+            }
+            ++m_pos;
+        }
+        return fail("Unterminated string");
+    }
+
+    bool boolean(bool *value)
+    {
+        skipSpace();
+        if (m_end - m_pos >= 4 && std::memcmp(m_pos, "true", 4) == 0) {
+            m_pos += 4;
+            *value = true;
+            return true;
+        }
+        if (m_end - m_pos >= 5 && std::memcmp(m_pos, "false", 5) == 0) {
+            m_pos += 5;
+            *value = false;
+            return true;
+        }
+        return fail("Expected a boolean");
+    }
+
+    // Skips one value of any kind; containers by depth, not recursion
+    bool skipValue()
+    {
+        int depth = 0;
+        do {
+            skipSpace();
+            if (m_pos >= m_end)
+                return fail("Unexpected end");
+            const char c = *m_pos;
+            if (c == '"') {
+                Span ignored;
+                if (!string(&ignored))
+                    return false;
+            } else if (c == '{' || c == '[') {
+                ++depth;
+                ++m_pos;
+            } else if (c == '}' || c == ']' || c == ',' || c == ':') {
+                if (depth == 0)
+                    return fail("Expected a value");
+                if (c == '}' || c == ']')
+                    --depth;
+                ++m_pos;
+            } else {
+                // Number or literal; anything else (a NUL byte, say) would
+                // never be consumed
+                const char *start = m_pos;
+                while (m_pos < m_end && isLiteral(*m_pos))
+                    ++m_pos;
+                if (m_pos == start)
+                    return fail("Unexpected character");
+            }
+        } while (depth > 0);
+        return true;
+    }
+
+    // Plain strings convert straight from the page; escaped ones go
+    // through the scratch buffer, which keeps its capacity
+    QString text(const Span &span)
+    {
+        if (!span.escaped)
+            return QString::fromUtf8(span.data, span.size);
+
+        m_scratch->resize(0);
+        const char *p = span.data;
+        const char *end = span.data + span.size;
+        while (p < end) {
+            if (*p != '\\' || p + 1 >= end) {
+                m_scratch->append(*p++);
+                continue;
+            }
+            const char escape = p[1];
+            p += 2;
+            switch (escape) {
+            case 'b': m_scratch->append('\b'); break;
+            case 'f': m_scratch->append('\f'); break;
+            case 'n': m_scratch->append('\n'); break;
+            case 'r': m_scratch->append('\r'); break;
+            case 't': m_scratch->append('\t'); break;
+            case 'u': {
+                int unit = hexQuad(p, end);
+                if (unit < 0) {
+                    appendUtf8(m_scratch, 0xFFFD);
+                    break;
+                }
+                p += 4;
+                uint codePoint = uint(unit);
+                if (unit >= 0xD800 && unit < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    const int low = hexQuad(p + 2, end);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        codePoint = 0x10000 + ((uint(unit) - 0xD800) << 10) + (uint(low) - 0xDC00);
+                        p += 6;
+                    }
+                }
+                if (codePoint >= 0xD800 && codePoint < 0xE000)
+                    codePoint = 0xFFFD;
+                appendUtf8(m_scratch, codePoint);
+                break;
+            }
+            default:
+                // \" \\ \/
+                m_scratch->append(escape);
+                break;
+            }
+        }
+        return QString::fromUtf8(m_scratch->constData(), m_scratch->size());
+    }
+
+private:
+    const char *m_begin;
+    const char *m_pos;
+    const char *m_end;
+    QByteArray *m_scratch;
+    QString m_error;
+};
+
+// Calls visit(key) for each member, with the scanner at the member's value
+template <typename Visit>
+bool forEachMember(Scanner &s, Visit visit)
+{
+    if (!s.expect('{'))
+        return false;
+    if (s.consume('}'))
+        return true;
+    do {
+        Span key;
+        if (!s.string(&key) || !s.expect(':') || !visit(key))
+            return false;
+    } while (s.consume(','));
+    return s.expect('}');
+}
+
+template <typename Visit>
+bool forEachElement(Scanner &s, Visit visit)
+{
+    if (!s.expect('['))
+        return false;
+    if (s.consume(']'))
+        return true;
+    do {
+        if (!visit())
+            return false;
+    } while (s.consume(','));
+    return s.expect(']');
+}
+
+bool attributeValue(Scanner &s, AttributeValue *value)
+{
+    return forEachMember(s, [&](const Span &type) {
+        if (is(type, "S")) {
+            value->type = AttributeValue::String;
+            return s.string(&value->text);
+        }
+        if (is(type, "N")) {
+            value->type = AttributeValue::Number;
+            return s.string(&value->text);
+        }
+        if (is(type, "BOOL")) {
+            value->type = AttributeValue::Bool;
+            return s.boolean(&value->flag);
+        }
+        return s.skipValue();
+    });
+}
+
+// Small nested values (continuation keys) are kept as JSON
+bool jsonObject(Scanner &s, QJsonObject *object)
+{
+    s.skipSpace();
+    const char *begin = s.position();
+    if (!s.skipValue())
+        return false;
+
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(
+        QByteArray::fromRawData(begin, int(s.position() - begin)), &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject())
+        return s.fail("Malformed key");
+    *object = doc.object();
+    return true;
+}
+
+double toDouble(const Span &span)
+{
+    return QByteArray::fromRawData(span.data, span.size).toDouble();
+}
+
+qint64 toInt64(const Span &span)
+{
+    qint64 value = 0;
+    std::from_chars(span.data, span.data + span.size, value);
+    return value;
+}
+
+bool hasNumber(const AttributeValue &value)
+{
+    return value.type == AttributeValue::Number && value.text.size > 0;
+}
+
+bool tagItem(Scanner &s, SyncTagRecord *tag)
+{
+    bool hasHlc = false;
+    const bool ok = forEachMember(s, [&](const Span &name) {
+        AttributeValue value;
+        if (!attributeValue(s, &value))
+            return false;
+        if (is(name, "CloudId")) {
+            tag->cloudId = s.text(value.text);
+        } else if (is(name, "Name")) {
+            tag->name = s.text(value.text);
+        } else if (is(name, "UpdatedAt")) {
+            tag->updatedAt = s.text(value.text);
+        } else if (is(name, "Hlc")) {
+            hasHlc = hasNumber(value);
+            tag->hlc = toInt64(value.text);
+        } else if (is(name, "IsDeleted")) {
+            tag->isDeleted = value.flag;
+        }
+        return true;
+    });
+    // Items written by clients without the clock (the web app) carry none
+    if (!hasHlc)
+        tag->hlc = HybridClock::fromTimestamp(tag->updatedAt);
+    return ok;
+}
+
+bool sessionItem(Scanner &s, SyncSessionRecord *session)
+{
+    bool hasHlc = false;
+    const bool ok = forEachMember(s, [&](const Span &name) {
+        AttributeValue value;
+        if (!attributeValue(s, &value))
+            return false;
+        if (is(name, "CloudId")) {
+            session->cloudId = s.text(value.text);
+        } else if (is(name, "SessionDate")) {
+            session->sessionDate = s.text(value.text);
+        } else if (is(name, "TimeHours")) {
+            session->timeHours = toDouble(value.text);
+        } else if (is(name, "Description")) {
+            session->description = s.text(value.text);
+        } else if (is(name, "Notes")) {
+            session->notes = s.text(value.text);
+        } else if (is(name, "NextPlannedStage")) {
+            session->nextPlannedStage = s.text(value.text);
+        } else if (is(name, "TagCloudId")) {
+            session->tagCloudId = s.text(value.text);
+        } else if (is(name, "CreatedAt")) {
+            session->createdAt = s.text(value.text);
+        } else if (is(name, "UpdatedAt")) {
+            session->updatedAt = s.text(value.text);
+        } else if (is(name, "Hlc")) {
+            hasHlc = hasNumber(value);
+            session->hlc = toInt64(value.text);
+        } else if (is(name, "IsDeleted")) {
+            session->isDeleted = value.flag;
+        }
+        return true;
+    });
+    if (!hasHlc)
+        session->hlc = HybridClock::fromTimestamp(session->updatedAt);
+    return ok;
+}
+
+} // namespace
+
+DynamoDbDecoder::DynamoDbDecoder()
+{
+    // Reserving marks the capacity as kept when the buffer is emptied
+    m_scratch.reserve(ScratchBytes);
+}
+
+bool DynamoDbDecoder::decode(const QByteArray &data, Records records, Page *page)
+{
+    m_errorString.clear();
+    Scanner s(data.constData(), data.constData() + data.size(), &m_scratch);
+
+    auto items = [&]() {
+        return forEachElement(s, [&]() {
+            if (records == Records::Tags) {
+                page->tags.append(SyncTagRecord());
+                return tagItem(s, &page->tags.last());
+            }
+            page->sessions.append(SyncSessionRecord());
+            return sessionItem(s, &page->sessions.last());
+        });
+    };
+
+    bool ok = forEachMember(s, [&](const Span &key) {
+        if (is(key, "Count")) {
+            // Query responses put the count ahead of the items
+            s.skipSpace();
+            const char *begin = s.position();
+            if (!s.skipValue())
+                return false;
+            int count = 0;
+            std::from_chars(begin, s.position(), count);
+            count = qBound(0, count, MaxReservedItems);
+            if (records == Records::Tags)
+                page->tags.reserve(count);
+            else
+                page->sessions.reserve(count);
+            return true;
+        }
+        if (is(key, "Items"))
+            return items();
+        if (is(key, "Responses")) {
+            // BatchGetItem: one array of items per table
+            return forEachMember(s, [&](const Span &) {
+                return items();
+            });
+        }
+        if (is(key, "LastEvaluatedKey"))
+            return jsonObject(s, &page->lastEvaluatedKey);
+        if (is(key, "UnprocessedKeys")) {
+            QJsonObject unprocessed;
+            if (!jsonObject(s, &unprocessed))
+                return false;
+            for (const QJsonValue &table : unprocessed) {
+                const QJsonArray keys = table.toObject()[QStringLiteral("Keys")].toArray();
+                for (const QJsonValue &key : keys)
+                    page->unprocessedKeys.append(key);
+            }
+            return true;
+        }
+        return s.skipValue();
+    });
+    if (ok && !s.atEnd())
+        ok = s.fail("Trailing data");
+
+    if (!ok)
+        m_errorString = s.error();
+    return ok;
+}
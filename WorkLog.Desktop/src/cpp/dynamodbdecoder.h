@@ -0,0 +1,46 @@
+#ifndef DYNAMODBDECODER_H
+#define DYNAMODBDECODER_H
+
+#include "syncchangeset.h"
+
+#include <QByteArray>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+// Decodes the item pages of DynamoDB Query and BatchGetItem responses
+// straight into sync records. The page is scanned once and never becomes
+// a QJsonDocument: attribute names are matched in place, plain strings are
+// converted directly from the page, and escaped ones are unescaped in a
+// scratch buffer that is reset, not freed, for every page. Only the small
+// continuation keys are built as JSON.
+class DynamoDbDecoder
+{
+public:
+    enum class Records {
+        Tags,
+        Sessions
+    };
+
+    struct Page {
+        QVector<SyncTagRecord> tags;
+        QVector<SyncSessionRecord> sessions;
+        // Query: where the next page starts; empty on the last one
+        QJsonObject lastEvaluatedKey;
+        // BatchGetItem: keys the target left for another request
+        QJsonArray unprocessedKeys;
+    };
+
+    DynamoDbDecoder();
+
+    // False if data is not a well-formed response
+    bool decode(const QByteArray &data, Records records, Page *page);
+    QString errorString() const { return m_errorString; }
+
+private:
+    QByteArray m_scratch;
+    QString m_errorString;
+};
+
+#endif // DYNAMODBDECODER_H
@@ -0,0 +1,117 @@
+#include "exportmanager.h"
+#include "databasemanager.h"
+#include "sessionexporter.h"
+
+#include <QThread>
+#include <QStandardPaths>
+#include <QDebug>
+
+ExportManager::ExportManager(DatabaseManager *db, QObject *parent)
+    : QObject(parent)
+    , m_database(db)
+{
+}
+
+ExportManager::~ExportManager()
+{
+    if (m_thread) {
+        if (m_exporter) {
+            m_exporter->cancel();
+        }
+        m_thread->quit();
+        m_thread->wait();
+    }
+}
+
+bool ExportManager::isExporting() const
+{
+    return m_isExporting;
+}
+
+qint64 ExportManager::rowsExported() const
+{
+    return m_rowsExported;
+}
+
+qint64 ExportManager::totalRows() const
+{
+    return m_totalRows;
+}
+
+QString ExportManager::defaultExportPath(const QString &format) const
+{
+    const QString suffix = SessionExporter::fileSuffix(SessionExporter::formatFromString(format));
+    return QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation)
+        + QStringLiteral("/worklog-sessions-%1.%2")
+              .arg(QDate::currentDate().toString(Qt::ISODate), suffix);
+}
+
+bool ExportManager::exportSessions(const QUrl &fileUrl, const QString &format,
+                                   const QDate &from, const QDate &to)
+{
+    if (isExporting()) {
+        emit errorOccurred(tr("Export already in progress"));
+        return false;
+    }
+
+    bool formatOk = false;
+    const SessionExporter::Format exportFormat = SessionExporter::formatFromString(format, &formatOk);
+    if (!formatOk) {
+        emit errorOccurred(tr("Unknown export format: %1").arg(format));
+        return false;
+    }
+
+    const QString outputPath = fileUrl.isLocalFile() ? fileUrl.toLocalFile() : fileUrl.toString();
+    if (outputPath.isEmpty()) {
+        emit errorOccurred(tr("No export file selected"));
+        return false;
+    }
+
+    auto *exporter = new SessionExporter(m_database->databasePath(), outputPath, exportFormat);
+    exporter->setDateRange(from, to);
+
+    auto *thread = new QThread(this);
+    thread->setObjectName(QStringLiteral("export"));
+    exporter->moveToThread(thread);
+
+    connect(thread, &QThread::started, exporter, &SessionExporter::run);
+    connect(exporter, &SessionExporter::progress, this, &ExportManager::onProgress);
+    connect(exporter, &SessionExporter::finished, this, &ExportManager::onFinished);
+    connect(exporter, &SessionExporter::finished, thread, &QThread::quit);
+    connect(thread, &QThread::finished, exporter, &QObject::deleteLater);
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+
+    m_exporter = exporter;
+    m_thread = thread;
+    m_isExporting = true;
+    m_rowsExported = 0;
+    m_totalRows = 0;
+
+    thread->start(QThread::LowPriority);
+
+    emit exportingChanged();
+    emit progressChanged();
+    return true;
+}
+
+void ExportManager::cancel()
+{
+    if (m_exporter) {
+        m_exporter->cancel();
+    }
+}
+
+void ExportManager::onProgress(qint64 rowsWritten, qint64 totalRows)
+{
+    m_rowsExported = rowsWritten;
+    m_totalRows = totalRows;
+    emit progressChanged();
+}
+
+void ExportManager::onFinished(bool success, const QString &message)
+{
+    m_isExporting = false;
+
+    emit exportingChanged();
+    emit exportCompleted(success, message);
+}
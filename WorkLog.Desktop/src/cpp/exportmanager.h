@@ -0,0 +1,52 @@
+#ifndef EXPORTMANAGER_H
+#define EXPORTMANAGER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QDate>
+#include <QUrl>
+
+class DatabaseManager;
+class SessionExporter;
+class QThread;
+
+class ExportManager : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool isExporting READ isExporting NOTIFY exportingChanged)
+    Q_PROPERTY(qint64 rowsExported READ rowsExported NOTIFY progressChanged)
+    Q_PROPERTY(qint64 totalRows READ totalRows NOTIFY progressChanged)
+
+public:
+    explicit ExportManager(DatabaseManager *db, QObject *parent = nullptr);
+    ~ExportManager();
+
+    bool isExporting() const;
+    qint64 rowsExported() const;
+    qint64 totalRows() const;
+
+    Q_INVOKABLE bool exportSessions(const QUrl &fileUrl, const QString &format,
+                                    const QDate &from = QDate(), const QDate &to = QDate());
+    Q_INVOKABLE void cancel();
+    Q_INVOKABLE QString defaultExportPath(const QString &format) const;
+
+signals:
+    void exportingChanged();
+    void progressChanged();
+    void exportCompleted(bool success, const QString &message);
+    void errorOccurred(const QString &error);
+
+private slots:
+    void onProgress(qint64 rowsWritten, qint64 totalRows);
+    void onFinished(bool success, const QString &message);
+
+private:
+    DatabaseManager *m_database;
+    QPointer<SessionExporter> m_exporter;
+    QPointer<QThread> m_thread;
+    bool m_isExporting = false;
+    qint64 m_rowsExported = 0;
+    qint64 m_totalRows = 0;
+};
+
+#endif // EXPORTMANAGER_H
@@ -1,5 +1,7 @@
 #include "hierarchymodel.h"
 #include "databasemanager.h"
+#include "diagnostics.h"
+#include "connectionpool.h"
 #include <QLocale>
 #include <QDate>
 
@@ -8,51 +10,69 @@ HierarchyModel::HierarchyModel(DatabaseManager *db, QObject *parent)
     , m_database(db)
 {
     connect(m_database, &DatabaseManager::dataChanged, this, &HierarchyModel::onDataChanged);
-    refresh();
+    connect(m_database, &DatabaseManager::opened, this, &HierarchyModel::refresh);
+
+    // Until the database is open the snapshot answers every query
+    if (m_database->isOpen())
+        refresh();
+    else
+        m_years = m_database->snapshot().years();
 }
 
 void HierarchyModel::refresh()
 {
+    if (!m_database->isOpen())
+        return;
+
+    // The queries run on a pooled reader; only the result is applied on
+    // the GUI thread. A newer refresh supersedes any still in flight.
+    const quint64 generation = ++m_refreshGeneration;
     const int oldYear = m_selectedYear;
     const int oldMonth = m_selectedMonth;
     const int oldWeek = m_selectedWeek;
-
-    m_years = m_database->getYears();
-
-    auto monthListForYear = [this](int year) {
-        return m_database->getMonthsForYear(year);
-    };
-    auto weekListForMonth = [this](int year, int month) {
-        return m_database->getWeeksForMonth(year, month);
-    };
-
-    // Restore selection if still valid; otherwise collapse upwards.
-    // Note: -1 means "no selection", 0+ are valid week numbers
-    if (oldYear > 0 && m_years.contains(oldYear)) {
-        m_selectedYear = oldYear;
-
-        QVariantList months = monthListForYear(m_selectedYear);
-        if (oldMonth > 0 && months.contains(oldMonth)) {
-            m_selectedMonth = oldMonth;
-
-            QVariantList weeks = weekListForMonth(m_selectedYear, m_selectedMonth);
-            m_selectedWeek = (oldWeek >= 0 && weeks.contains(oldWeek)) ? oldWeek : -1;
-        } else {
-            m_selectedMonth = 0;
-            m_selectedWeek = -1;
+    DatabaseManager *database = m_database;
+
+    ConnectionPool::run([this, database, generation, oldYear, oldMonth, oldWeek]() {
+        const DiagnosticsTimer timer("model.HierarchyModel.refresh");
+        const QVariantList years = database->getYears();
+
+        // Restore selection if still valid; otherwise collapse upwards.
+        // Note: -1 means "no selection", 0+ are valid week numbers
+        int year = 0;
+        int month = 0;
+        int week = -1;
+        if (oldYear > 0 && years.contains(oldYear)) {
+            year = oldYear;
+
+            const QVariantList months = database->getMonthsForYear(year);
+            if (oldMonth > 0 && months.contains(oldMonth)) {
+                month = oldMonth;
+
+                const QVariantList weeks = database->getWeeksForMonth(year, month);
+                week = (oldWeek >= 0 && weeks.contains(oldWeek)) ? oldWeek : -1;
+            }
         }
-    } else {
-        m_selectedYear = 0;
-        m_selectedMonth = 0;
-        m_selectedWeek = -1;
-    }
 
-    m_refreshCounter++;
-    emit yearsChanged();
-    emit selectedYearChanged();
-    emit selectedMonthChanged();
-    emit selectedWeekChanged();
-    emit hierarchyChanged();
+        QMetaObject::invokeMethod(this, [=]() {
+            if (generation != m_refreshGeneration)
+                return;
+
+            m_years = years;
+            // Keep a selection the user made while the queries were running
+            if (m_selectedYear == oldYear && m_selectedMonth == oldMonth && m_selectedWeek == oldWeek) {
+                m_selectedYear = year;
+                m_selectedMonth = month;
+                m_selectedWeek = week;
+            }
+
+            m_refreshCounter++;
+            emit yearsChanged();
+            emit selectedYearChanged();
+            emit selectedMonthChanged();
+            emit selectedWeekChanged();
+            emit hierarchyChanged();
+        }, Qt::QueuedConnection);
+    });
 }
 
 void HierarchyModel::onDataChanged()
@@ -73,6 +93,9 @@ int HierarchyModel::selectedYear() const
 void HierarchyModel::setSelectedYear(int year)
 {
     if (m_selectedYear != year) {
+        // Expanding an archived year opens its archive
+        if (year > 0)
+            m_database->attachYears(year, year);
         m_selectedYear = year;
         m_selectedMonth = 0;
         m_selectedWeek = -1;
@@ -117,6 +140,8 @@ QVariantList HierarchyModel::getMonths() const
 {
     if (m_selectedYear == 0)
         return QVariantList();
+    if (!m_database->isOpen())
+        return m_database->snapshot().monthsForYear(m_selectedYear);
     return m_database->getMonthsForYear(m_selectedYear);
 }
 
@@ -124,6 +149,8 @@ QVariantList HierarchyModel::getWeeks() const
 {
     if (m_selectedYear == 0 || m_selectedMonth == 0)
         return QVariantList();
+    if (!m_database->isOpen())
+        return m_database->snapshot().weeksForMonth(m_selectedYear, m_selectedMonth);
     return m_database->getWeeksForMonth(m_selectedYear, m_selectedMonth);
 }
 
@@ -133,6 +160,11 @@ QVariantList HierarchyModel::getDays() const
         return QVariantList();
 
     // -1 means no week selected, 0+ are valid week numbers
+    if (!m_database->isOpen()) {
+        const HierarchySnapshot &snapshot = m_database->snapshot();
+        return m_selectedWeek >= 0 ? snapshot.daysForWeek(m_selectedYear, m_selectedWeek)
+                                   : snapshot.daysForMonth(m_selectedYear, m_selectedMonth);
+    }
     if (m_selectedWeek >= 0) {
         return m_database->getDaysForWeek(m_selectedYear, m_selectedWeek);
     }
@@ -153,6 +185,8 @@ double HierarchyModel::weekTotalHours(int week) const
 {
     if (m_selectedYear == 0 || week <= 0)
         return 0.0;
+    if (!m_database->isOpen())
+        return m_database->snapshot().totalHoursForWeek(m_selectedYear, week);
     return m_database->getTotalHoursForWeek(m_selectedYear, week);
 }
 
@@ -160,6 +194,8 @@ double HierarchyModel::monthTotalHours(int month) const
 {
     if (m_selectedYear == 0 || month <= 0)
         return 0.0;
+    if (!m_database->isOpen())
+        return m_database->snapshot().totalHoursForMonth(m_selectedYear, month);
     return m_database->getTotalHoursForMonth(m_selectedYear, month);
 }
 
@@ -167,6 +203,8 @@ double HierarchyModel::yearTotalHours(int year) const
 {
     if (year <= 0)
         return 0.0;
+    if (!m_database->isOpen())
+        return m_database->snapshot().totalHoursForYear(year);
     return m_database->getTotalHoursForYear(year);
 }
 
@@ -174,6 +212,8 @@ double HierarchyModel::dayTotalHours(const QDate &date) const
 {
     if (!date.isValid())
         return 0.0;
+    if (!m_database->isOpen())
+        return m_database->snapshot().totalHoursForDate(date);
     return m_database->getTotalHoursForDate(date);
 }
 
@@ -181,6 +221,8 @@ double HierarchyModel::yearAverageHoursPerWeek(int year) const
 {
     if (year <= 0)
         return 0.0;
+    if (!m_database->isOpen())
+        return m_database->snapshot().averageHoursPerWeekForYear(year);
     return m_database->getAverageHoursPerWeekForYear(year);
 }
 
@@ -188,19 +230,22 @@ double HierarchyModel::monthAverageHoursPerWeek(int month) const
 {
     if (m_selectedYear == 0 || month <= 0)
         return 0.0;
+    if (!m_database->isOpen())
+        return m_database->snapshot().averageHoursPerWeekForMonth(m_selectedYear, month);
     return m_database->getAverageHoursPerWeekForMonth(m_selectedYear, month);
 }
 
 QVariantList HierarchyModel::getTagTotalsForSelectedWeek() const
 {
-    if (m_selectedYear == 0 || m_selectedWeek < 0)
+    // Tag totals are not in the snapshot
+    if (m_selectedYear == 0 || m_selectedWeek < 0 || !m_database->isOpen())
         return QVariantList();
     return m_database->getTagTotalsForWeek(m_selectedYear, m_selectedWeek);
 }
 
 QVariantList HierarchyModel::getTagTotalsForDay(const QDate &date) const
 {
-    if (!date.isValid())
+    if (!date.isValid() || !m_database->isOpen())
         return QVariantList();
     return m_database->getTagTotalsForDay(date);
 }
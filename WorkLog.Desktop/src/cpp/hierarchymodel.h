@@ -60,6 +60,7 @@ private:
     int m_selectedMonth = 0;
     int m_selectedWeek = -1;  // -1 means no selection, 0+ are valid week numbers
     int m_refreshCounter = 0;
+    quint64 m_refreshGeneration = 0;
 };
 
 #endif // HIERARCHYMODEL_H
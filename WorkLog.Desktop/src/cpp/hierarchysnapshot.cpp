@@ -0,0 +1,411 @@
+#include "hierarchysnapshot.h"
+#include "diagnostics.h"
+
+#include <QDateTime>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+#include <cstring>
+
+namespace {
+
+// File layout, native byte order: Header, DayEntry[dayCount] sorted by
+// day, SessionEntry[sessionCount] in display order, then the UTF-8 text
+// the sessions point into. Every field is naturally aligned.
+constexpr quint32 SnapshotMagic = 0x53534c57; // "WLSS"
+constexpr quint32 SnapshotVersion = 1;
+
+// Days whose sessions are kept, counting back from today
+constexpr int RecentDays = 14;
+
+struct Header {
+    quint32 magic;
+    quint32 version;
+    qint64 writtenAtMs;
+    // Julian day of the oldest day whose sessions are included
+    qint64 sessionsFrom;
+    quint32 dayCount;
+    quint32 sessionCount;
+    quint32 stringsSize;
+    quint32 reserved;
+};
+
+struct DayEntry {
+    qint64 julianDay;
+    double hours;
+};
+
+struct SessionEntry {
+    qint64 id;
+    qint64 julianDay;
+    double hours;
+    qint64 tagId;
+    quint32 description;
+    quint32 descriptionSize;
+    quint32 notes;
+    quint32 notesSize;
+    quint32 nextStage;
+    quint32 nextStageSize;
+    quint32 tagName;
+    quint32 tagNameSize;
+};
+
+static_assert(sizeof(Header) == 40, "snapshot header layout");
+static_assert(sizeof(DayEntry) == 16, "snapshot day layout");
+static_assert(sizeof(SessionEntry) == 64, "snapshot session layout");
+
+template<typename T>
+T readAt(const uchar *data, qint64 offset)
+{
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return value;
+}
+
+} // namespace
+
+HierarchySnapshot::~HierarchySnapshot()
+{
+    close();
+}
+
+QString HierarchySnapshot::pathForDatabase(const QString &databasePath)
+{
+    return databasePath + QStringLiteral(".snapshot");
+}
+
+int HierarchySnapshot::weekNumber(const QDate &date)
+{
+    return (date.dayOfYear() - 1 + 7 - (date.dayOfWeek() - 1)) / 7;
+}
+
+bool HierarchySnapshot::open(const QString &path)
+{
+    const DiagnosticsTimer timer("db.openSnapshot");
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = m_file.size();
+    uchar *data = size >= qint64(sizeof(Header)) ? m_file.map(0, size) : nullptr;
+    if (!data) {
+        m_file.close();
+        return false;
+    }
+
+    const Header header = readAt<Header>(data, 0);
+    const qint64 expectedSize = qint64(sizeof(Header))
+        + qint64(header.dayCount) * qint64(sizeof(DayEntry))
+        + qint64(header.sessionCount) * qint64(sizeof(SessionEntry))
+        + header.stringsSize;
+    if (header.magic != SnapshotMagic || header.version != SnapshotVersion || expectedSize != size) {
+        qWarning() << "Ignoring outdated or damaged snapshot" << path;
+        m_file.unmap(data);
+        m_file.close();
+        return false;
+    }
+
+    m_data = data;
+    m_dayCount = header.dayCount;
+    m_sessionCount = header.sessionCount;
+    m_stringsSize = header.stringsSize;
+    m_sessionsFrom = header.sessionsFrom;
+    return true;
+}
+
+void HierarchySnapshot::close()
+{
+    if (m_data)
+        m_file.unmap(m_data);
+    m_data = nullptr;
+    m_dayCount = 0;
+    m_sessionCount = 0;
+    m_stringsSize = 0;
+    m_sessionsFrom = 0;
+    m_file.close();
+}
+
+QVector<HierarchySnapshot::Day> HierarchySnapshot::daysBetween(const QDate &first, const QDate &last) const
+{
+    QVector<Day> days;
+    if (!m_data)
+        return days;
+
+    auto julianDayAt = [this](quint32 index) {
+        return readAt<qint64>(m_data, qint64(sizeof(Header)) + qint64(index) * qint64(sizeof(DayEntry)));
+    };
+
+    // Binary search for the first day in range; the entries are sorted
+    quint32 low = 0;
+    quint32 high = m_dayCount;
+    const qint64 firstDay = first.toJulianDay();
+    while (low < high) {
+        const quint32 middle = low + (high - low) / 2;
+        if (julianDayAt(middle) < firstDay)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    const qint64 lastDay = last.toJulianDay();
+    for (quint32 i = low; i < m_dayCount; ++i) {
+        const DayEntry entry = readAt<DayEntry>(m_data, qint64(sizeof(Header)) + qint64(i) * qint64(sizeof(DayEntry)));
+        if (entry.julianDay > lastDay)
+            break;
+        days.append({QDate::fromJulianDay(entry.julianDay), entry.hours});
+    }
+    return days;
+}
+
+QString HierarchySnapshot::stringAt(quint32 offset, quint32 size) const
+{
+    if (size == 0 || qint64(offset) + size > m_stringsSize)
+        return QString();
+    const qint64 stringsStart = qint64(sizeof(Header))
+        + qint64(m_dayCount) * qint64(sizeof(DayEntry))
+        + qint64(m_sessionCount) * qint64(sizeof(SessionEntry));
+    return QString::fromUtf8(reinterpret_cast<const char *>(m_data + stringsStart + offset), int(size));
+}
+
+QVariantList HierarchySnapshot::years() const
+{
+    QVariantList results;
+    if (m_dayCount == 0)
+        return results;
+
+    const QDate first = QDate::fromJulianDay(readAt<qint64>(m_data, sizeof(Header)));
+    const QDate last = QDate::fromJulianDay(readAt<qint64>(
+        m_data, qint64(sizeof(Header)) + qint64(m_dayCount - 1) * qint64(sizeof(DayEntry))));
+    for (int year = first.year(); year <= last.year(); ++year) {
+        if (!daysBetween(QDate(year, 1, 1), QDate(year, 12, 31)).isEmpty())
+            results.append(year);
+    }
+    return results;
+}
+
+QVariantList HierarchySnapshot::monthsForYear(int year) const
+{
+    QVariantList results;
+    for (const Day &day : daysBetween(QDate(year, 1, 1), QDate(year, 12, 31))) {
+        if (results.isEmpty() || results.last().toInt() != day.date.month())
+            results.append(day.date.month());
+    }
+    return results;
+}
+
+QVariantList HierarchySnapshot::weeksForMonth(int year, int month) const
+{
+    const QDate first(year, month, 1);
+    QVariantList results;
+    for (const Day &day : daysBetween(first, first.addMonths(1).addDays(-1))) {
+        const int week = weekNumber(day.date);
+        if (results.isEmpty() || results.last().toInt() != week)
+            results.append(week);
+    }
+    return results;
+}
+
+QVariantList HierarchySnapshot::daysForWeek(int year, int week) const
+{
+    QVariantList results;
+    for (const Day &day : daysBetween(QDate(year, 1, 1), QDate(year, 12, 31))) {
+        if (weekNumber(day.date) == week)
+            results.append(day.date);
+    }
+    return results;
+}
+
+QVariantList HierarchySnapshot::daysForMonth(int year, int month) const
+{
+    const QDate first(year, month, 1);
+    QVariantList results;
+    for (const Day &day : daysBetween(first, first.addMonths(1).addDays(-1)))
+        results.append(day.date);
+    return results;
+}
+
+double HierarchySnapshot::totalHoursForWeek(int year, int week) const
+{
+    double total = 0.0;
+    for (const Day &day : daysBetween(QDate(year, 1, 1), QDate(year, 12, 31))) {
+        if (weekNumber(day.date) == week)
+            total += day.hours;
+    }
+    return total;
+}
+
+double HierarchySnapshot::totalHoursForMonth(int year, int month) const
+{
+    const QDate first(year, month, 1);
+    double total = 0.0;
+    for (const Day &day : daysBetween(first, first.addMonths(1).addDays(-1)))
+        total += day.hours;
+    return total;
+}
+
+double HierarchySnapshot::totalHoursForYear(int year) const
+{
+    double total = 0.0;
+    for (const Day &day : daysBetween(QDate(year, 1, 1), QDate(year, 12, 31)))
+        total += day.hours;
+    return total;
+}
+
+double HierarchySnapshot::totalHoursForDate(const QDate &date) const
+{
+    const QVector<Day> days = daysBetween(date, date);
+    return days.isEmpty() ? 0.0 : days.first().hours;
+}
+
+double HierarchySnapshot::averageHoursPerWeekForYear(int year) const
+{
+    double total = 0.0;
+    QSet<int> weeks;
+    for (const Day &day : daysBetween(QDate(year, 1, 1), QDate(year, 12, 31))) {
+        total += day.hours;
+        weeks.insert(weekNumber(day.date));
+    }
+    return weeks.isEmpty() ? 0.0 : total / weeks.size();
+}
+
+double HierarchySnapshot::averageHoursPerWeekForMonth(int year, int month) const
+{
+    // Same definition as the database query: hours per day times seven
+    const QDate first(year, month, 1);
+    return totalHoursForMonth(year, month) / first.daysInMonth() * 7.0;
+}
+
+bool HierarchySnapshot::sessionsForDate(const QDate &date, QVariantList *sessions) const
+{
+    sessions->clear();
+    if (!m_data || date.toJulianDay() < m_sessionsFrom)
+        return false;
+
+    const qint64 sessionsStart = qint64(sizeof(Header)) + qint64(m_dayCount) * qint64(sizeof(DayEntry));
+    const qint64 julianDay = date.toJulianDay();
+    for (quint32 i = 0; i < m_sessionCount; ++i) {
+        const SessionEntry entry = readAt<SessionEntry>(m_data, sessionsStart + qint64(i) * qint64(sizeof(SessionEntry)));
+        if (entry.julianDay != julianDay)
+            continue;
+
+        // Empty optional text was NULL in the database
+        auto optional = [](const QString &text) {
+            return text.isEmpty() ? QVariant() : QVariant(text);
+        };
+
+        QVariantMap session;
+        session[QStringLiteral("id")] = entry.id;
+        session[QStringLiteral("date")] = date;
+        session[QStringLiteral("timeHours")] = entry.hours;
+        session[QStringLiteral("description")] = stringAt(entry.description, entry.descriptionSize);
+        session[QStringLiteral("notes")] = optional(stringAt(entry.notes, entry.notesSize));
+        session[QStringLiteral("nextPlannedStage")] = optional(stringAt(entry.nextStage, entry.nextStageSize));
+        session[QStringLiteral("tagId")] = entry.tagId > 0 ? QVariant(entry.tagId) : QVariant();
+        session[QStringLiteral("tagName")] = optional(stringAt(entry.tagName, entry.tagNameSize));
+        sessions->append(session);
+    }
+    return true;
+}
+
+bool HierarchySnapshot::write(const QString &path, QSqlDatabase db, QString *errorString)
+{
+    const DiagnosticsTimer timer("db.writeSnapshot");
+
+    // Writers queue up, so the last file in place holds the newest data
+    static QMutex mutex;
+    QMutexLocker locker(&mutex);
+
+    auto fail = [errorString](const QString &message) {
+        if (errorString)
+            *errorString = message;
+        return false;
+    };
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(QStringLiteral(R"(
+        SELECT SessionDate, SUM(Hours)
+        FROM (
+            SELECT SessionDate, TimeHours AS Hours FROM main.WorkSessions WHERE IsDeleted = 0
+            UNION ALL
+            SELECT SessionDate, TotalHours FROM ArchivedDays
+        )
+        GROUP BY SessionDate
+        ORDER BY SessionDate ASC
+    )"))) {
+        return fail(query.lastError().text());
+    }
+
+    QVector<DayEntry> days;
+    while (query.next()) {
+        const QDate date = QDate::fromString(query.value(0).toString(), Qt::ISODate);
+        if (date.isValid())
+            days.append({date.toJulianDay(), query.value(1).toDouble()});
+    }
+
+    const QDate sessionsFrom = QDate::currentDate().addDays(-(RecentDays - 1));
+    query.prepare(QStringLiteral(R"(
+        SELECT ws.Id, ws.SessionDate, ws.TimeHours, ws.Description, ws.Notes,
+               ws.NextPlannedStage, ws.TagId, t.Name
+        FROM WorkSessions ws
+        LEFT JOIN Tags t ON ws.TagId = t.Id
+        WHERE ws.SessionDate >= :from AND ws.IsDeleted = 0
+        ORDER BY ws.SessionDate ASC, ws.CreatedAt ASC
+    )"));
+    query.bindValue(QStringLiteral(":from"), sessionsFrom.toString(Qt::ISODate));
+    if (!query.exec())
+        return fail(query.lastError().text());
+
+    QVector<SessionEntry> sessions;
+    QByteArray strings;
+    auto addString = [&strings](const QVariant &value, quint32 *offset, quint32 *size) {
+        const QByteArray utf8 = value.toString().toUtf8();
+        *offset = quint32(strings.size());
+        *size = quint32(utf8.size());
+        strings += utf8;
+    };
+    while (query.next()) {
+        const QDate date = QDate::fromString(query.value(1).toString(), Qt::ISODate);
+        if (!date.isValid())
+            continue;
+
+        SessionEntry entry = {};
+        entry.id = query.value(0).toLongLong();
+        entry.julianDay = date.toJulianDay();
+        entry.hours = query.value(2).toDouble();
+        entry.tagId = query.value(6).toLongLong();
+        addString(query.value(3), &entry.description, &entry.descriptionSize);
+        addString(query.value(4), &entry.notes, &entry.notesSize);
+        addString(query.value(5), &entry.nextStage, &entry.nextStageSize);
+        addString(query.value(7), &entry.tagName, &entry.tagNameSize);
+        sessions.append(entry);
+    }
+
+    Header header = {};
+    header.magic = SnapshotMagic;
+    header.version = SnapshotVersion;
+    header.writtenAtMs = QDateTime::currentMSecsSinceEpoch();
+    header.sessionsFrom = sessionsFrom.toJulianDay();
+    header.dayCount = quint32(days.size());
+    header.sessionCount = quint32(sessions.size());
+    header.stringsSize = quint32(strings.size());
+
+    // Readers map the old file until they reopen; the rename is atomic
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(file.errorString());
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(days.constData()), qint64(days.size()) * qint64(sizeof(DayEntry)));
+    file.write(reinterpret_cast<const char *>(sessions.constData()), qint64(sessions.size()) * qint64(sizeof(SessionEntry)));
+    file.write(strings);
+    if (!file.commit())
+        return fail(file.errorString());
+    return true;
+}
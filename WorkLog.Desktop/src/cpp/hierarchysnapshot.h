@@ -0,0 +1,75 @@
+#ifndef HIERARCHYSNAPSHOT_H
+#define HIERARCHYSNAPSHOT_H
+
+#include <QDate>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVariantList>
+#include <QVector>
+
+// Read-only snapshot of what the hierarchy pane shows: the total hours of
+// every day with sessions, from which years, months, weeks and their
+// totals follow, plus the sessions of the most recent days. The file is
+// versioned, written atomically after commits and memory-mapped at
+// startup, so the first frame needs no SQLite at all. The answers match
+// the corresponding DatabaseManager queries as of the last write.
+class HierarchySnapshot
+{
+public:
+    HierarchySnapshot() = default;
+    ~HierarchySnapshot();
+    Q_DISABLE_COPY(HierarchySnapshot)
+
+    static QString pathForDatabase(const QString &databasePath);
+
+    // Week of the year as SQLite's strftime('%W') numbers it, which is
+    // what the hierarchy queries group by: weeks start on Monday, days
+    // before the first Monday of the year are week 0
+    static int weekNumber(const QDate &date);
+
+    // False (and invalid) when the file is missing, damaged or of another
+    // format version
+    bool open(const QString &path);
+    void close();
+    bool isValid() const { return m_data != nullptr; }
+
+    QVariantList years() const;
+    QVariantList monthsForYear(int year) const;
+    QVariantList weeksForMonth(int year, int month) const;
+    QVariantList daysForWeek(int year, int week) const;
+    QVariantList daysForMonth(int year, int month) const;
+
+    double totalHoursForWeek(int year, int week) const;
+    double totalHoursForMonth(int year, int month) const;
+    double totalHoursForYear(int year) const;
+    double totalHoursForDate(const QDate &date) const;
+    double averageHoursPerWeekForYear(int year) const;
+    double averageHoursPerWeekForMonth(int year, int month) const;
+
+    // Sessions in the getSessionsForDate() form. False when the date is
+    // older than the days whose sessions the snapshot keeps.
+    bool sessionsForDate(const QDate &date, QVariantList *sessions) const;
+
+    // Builds a snapshot from the database and replaces the file
+    static bool write(const QString &path, QSqlDatabase db, QString *errorString = nullptr);
+
+private:
+    struct Day {
+        QDate date;
+        double hours = 0.0;
+    };
+
+    // Days in [first, last], in date order
+    QVector<Day> daysBetween(const QDate &first, const QDate &last) const;
+    QString stringAt(quint32 offset, quint32 size) const;
+
+    QFile m_file;
+    uchar *m_data = nullptr;
+    quint32 m_dayCount = 0;
+    quint32 m_sessionCount = 0;
+    quint32 m_stringsSize = 0;
+    qint64 m_sessionsFrom = 0;
+};
+
+#endif // HIERARCHYSNAPSHOT_H
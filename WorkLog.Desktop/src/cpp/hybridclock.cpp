@@ -0,0 +1,45 @@
+#include "hybridclock.h"
+
+#include <QDateTime>
+
+#include <atomic>
+
+namespace {
+
+std::atomic<qint64> s_last{0};
+
+} // namespace
+
+qint64 HybridClock::now()
+{
+    const qint64 wall = QDateTime::currentMSecsSinceEpoch() << CounterBits;
+    qint64 last = s_last.load(std::memory_order_relaxed);
+    qint64 next;
+    do {
+        // Counter overflow simply carries into the millisecond bits
+        next = qMax(wall, last + 1);
+    } while (!s_last.compare_exchange_weak(last, next, std::memory_order_relaxed));
+    return next;
+}
+
+void HybridClock::observe(qint64 timestamp)
+{
+    qint64 last = s_last.load(std::memory_order_relaxed);
+    while (timestamp > last
+           && !s_last.compare_exchange_weak(last, timestamp, std::memory_order_relaxed)) {
+    }
+}
+
+qint64 HybridClock::fromTimestamp(const QString &updatedAt)
+{
+    QDateTime dateTime = QDateTime::fromString(updatedAt, QStringLiteral("yyyy-MM-dd HH:mm:ss"));
+    if (!dateTime.isValid())
+        dateTime = QDateTime::fromString(updatedAt, Qt::ISODate);
+    if (!dateTime.isValid())
+        return 0;
+
+    // SQLite's datetime('now') is UTC but carries no zone marker
+    if (dateTime.timeSpec() == Qt::LocalTime)
+        dateTime.setTimeSpec(Qt::UTC);
+    return dateTime.toMSecsSinceEpoch() << CounterBits;
+}
@@ -0,0 +1,30 @@
+#ifndef HYBRIDCLOCK_H
+#define HYBRIDCLOCK_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Hybrid logical clock used to order edits across machines. A timestamp
+// is one 64-bit integer: wall-clock milliseconds since the epoch in the
+// upper 48 bits and a logical counter in the lower 16. Timestamps issued
+// here are strictly increasing and always later than any timestamp seen
+// from another machine, so an edit made after a sync wins over the data
+// that sync brought in, whatever the two wall clocks say.
+class HybridClock
+{
+public:
+    static constexpr int CounterBits = 16;
+
+    // Timestamp for a local write
+    static qint64 now();
+    // Folds in a timestamp read from the database or another machine
+    static void observe(qint64 timestamp);
+
+    // Stand-in for rows written before the clock existed, derived from
+    // their UTC "yyyy-MM-dd HH:mm:ss" (or ISO 8601) UpdatedAt
+    static qint64 fromTimestamp(const QString &updatedAt);
+
+    static qint64 physicalMs(qint64 timestamp) { return timestamp >> CounterBits; }
+};
+
+#endif // HYBRIDCLOCK_H
@@ -0,0 +1,141 @@
+#include "importmanager.h"
+#include "databasemanager.h"
+#include "sessionimporter.h"
+
+#include <QThread>
+#include <QUrl>
+#include <QDebug>
+
+ImportManager::ImportManager(DatabaseManager *db, QObject *parent)
+    : QObject(parent)
+    , m_database(db)
+{
+}
+
+ImportManager::~ImportManager()
+{
+    if (m_thread) {
+        if (m_importer) {
+            m_importer->cancel();
+        }
+        m_thread->quit();
+        m_thread->wait();
+    }
+}
+
+bool ImportManager::isImporting() const
+{
+    return m_isImporting;
+}
+
+qint64 ImportManager::bytesRead() const
+{
+    return m_bytesRead;
+}
+
+qint64 ImportManager::totalBytes() const
+{
+    return m_totalBytes;
+}
+
+QStringList ImportManager::rowErrors() const
+{
+    return m_rowErrors;
+}
+
+bool ImportManager::importSessions(const QString &filePath, const QString &format, bool dryRun)
+{
+    if (m_isImporting) {
+        emit errorOccurred(tr("Import already in progress"));
+        return false;
+    }
+
+    // Accept both plain paths and file:// URLs coming from QML
+    const QUrl url(filePath);
+    const QString inputPath = url.isLocalFile() ? url.toLocalFile() : filePath;
+    if (inputPath.isEmpty()) {
+        emit errorOccurred(tr("No import file selected"));
+        return false;
+    }
+
+    bool formatOk = false;
+    const SessionImporter::Format importFormat = format.isEmpty()
+        ? SessionImporter::formatForPath(inputPath, &formatOk)
+        : SessionImporter::formatFromString(format, &formatOk);
+    if (!formatOk) {
+        emit errorOccurred(tr("Cannot tell the format of %1; use a .csv or .ndjson file").arg(inputPath));
+        return false;
+    }
+
+    auto *importer = new SessionImporter(m_database->databasePath(), inputPath, importFormat);
+    importer->setDryRun(dryRun);
+
+    auto *thread = new QThread(this);
+    thread->setObjectName(QStringLiteral("import"));
+    importer->moveToThread(thread);
+
+    connect(thread, &QThread::started, importer, &SessionImporter::run);
+    connect(importer, &SessionImporter::progress, this, &ImportManager::onProgress);
+    connect(importer, &SessionImporter::summaryReady, this, &ImportManager::onSummaryReady);
+    connect(importer, &SessionImporter::finished, this, &ImportManager::onFinished);
+    connect(importer, &SessionImporter::finished, thread, &QThread::quit);
+    connect(thread, &QThread::finished, importer, &QObject::deleteLater);
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+
+    m_importer = importer;
+    m_thread = thread;
+    m_isImporting = true;
+    m_dryRun = dryRun;
+    m_bytesRead = 0;
+    m_totalBytes = 0;
+    m_rowsImported = 0;
+    m_tagsCreated = 0;
+    m_rowErrors.clear();
+
+    thread->start(QThread::LowPriority);
+
+    emit importingChanged();
+    emit progressChanged();
+    return true;
+}
+
+void ImportManager::cancel()
+{
+    if (m_importer) {
+        m_importer->cancel();
+    }
+}
+
+void ImportManager::onProgress(qint64 bytesRead, qint64 totalBytes)
+{
+    m_bytesRead = bytesRead;
+    m_totalBytes = totalBytes;
+    emit progressChanged();
+}
+
+void ImportManager::onSummaryReady(qint64 rowsImported, int tagsCreated, const QStringList &rowErrors)
+{
+    m_rowsImported = rowsImported;
+    m_tagsCreated = tagsCreated;
+    m_rowErrors = rowErrors;
+}
+
+void ImportManager::onFinished(bool success, const QString &message)
+{
+    m_isImporting = false;
+    emit importingChanged();
+
+    // One notification for the whole import instead of one per row
+    if (success && !m_dryRun) {
+        // Tags were written on the importer's own connection
+        m_database->tagRegistry().invalidate();
+        if (m_tagsCreated > 0) {
+            m_database->notifyTagsChanged();
+        }
+        if (m_rowsImported > 0) {
+            m_database->notifyDataChanged();
+        }
+    }
+
+    emit importCompleted(success, message);
+}
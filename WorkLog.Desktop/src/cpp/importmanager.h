@@ -0,0 +1,58 @@
+#ifndef IMPORTMANAGER_H
+#define IMPORTMANAGER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+
+class DatabaseManager;
+class SessionImporter;
+class QThread;
+
+class ImportManager : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool isImporting READ isImporting NOTIFY importingChanged)
+    Q_PROPERTY(qint64 bytesRead READ bytesRead NOTIFY progressChanged)
+    Q_PROPERTY(qint64 totalBytes READ totalBytes NOTIFY progressChanged)
+    Q_PROPERTY(QStringList rowErrors READ rowErrors NOTIFY importCompleted)
+
+public:
+    explicit ImportManager(DatabaseManager *db, QObject *parent = nullptr);
+    ~ImportManager();
+
+    bool isImporting() const;
+    qint64 bytesRead() const;
+    qint64 totalBytes() const;
+    QStringList rowErrors() const;
+
+    Q_INVOKABLE bool importSessions(const QString &filePath,
+                                    const QString &format = QString(),
+                                    bool dryRun = false);
+    Q_INVOKABLE void cancel();
+
+signals:
+    void importingChanged();
+    void progressChanged();
+    void importCompleted(bool success, const QString &message);
+    void errorOccurred(const QString &error);
+
+private slots:
+    void onProgress(qint64 bytesRead, qint64 totalBytes);
+    void onSummaryReady(qint64 rowsImported, int tagsCreated, const QStringList &rowErrors);
+    void onFinished(bool success, const QString &message);
+
+private:
+    DatabaseManager *m_database;
+    QPointer<SessionImporter> m_importer;
+    QPointer<QThread> m_thread;
+    bool m_isImporting = false;
+    bool m_dryRun = false;
+    qint64 m_bytesRead = 0;
+    qint64 m_totalBytes = 0;
+    qint64 m_rowsImported = 0;
+    int m_tagsCreated = 0;
+    QStringList m_rowErrors;
+};
+
+#endif // IMPORTMANAGER_H
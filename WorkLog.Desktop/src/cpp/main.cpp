@@ -1,16 +1,26 @@
 #include <QApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QQuickWindow>
 #include <QIcon>
 #include <QQuickStyle>
+#include <QTimer>
 
 #include <KLocalizedContext>
 #include <KLocalizedString>
 
+#include "diagnostics.h"
+#include "tracer.h"
 #include "databasemanager.h"
 #include "worksessionmodel.h"
 #include "hierarchymodel.h"
 #include "tagmodel.h"
+#include "calendarheatmapmodel.h"
+#include "suggestionmodel.h"
+#include "exportmanager.h"
+#include "importmanager.h"
+#include "maintenancescheduler.h"
+#include "backupmanager.h"
 #ifdef ENABLE_SYNC
 #include "syncmanager.h"
 #endif
@@ -31,17 +41,37 @@ int main(int argc, char *argv[])
         QQuickStyle::setStyle(QStringLiteral("org.kde.desktop"));
     }
 
-    // Initialize database
+    // Created up front so it lives on the GUI thread
+    Diagnostics *diagnostics = Diagnostics::instance();
+    diagnostics->installExitDump();
+    Tracer::initializeFromEnvironment();
+
+    // The window first renders from the memory-mapped snapshot; SQLite
+    // opens once that frame is out (see below)
     DatabaseManager *dbManager = new DatabaseManager(&app);
-    if (!dbManager->initialize()) {
-        qCritical() << "Failed to initialize database";
-        return 1;
+    dbManager->openSnapshot();
+
+    // Mark change notifications so refresh spans can be traced to their cause
+    if (Tracer::isEnabled()) {
+        QObject::connect(dbManager, &DatabaseManager::dataChanged, []() {
+            Tracer::instant("db.dataChanged");
+        });
+        QObject::connect(dbManager, &DatabaseManager::tagsChanged, []() {
+            Tracer::instant("db.tagsChanged");
+        });
     }
 
     // Create models
     WorkSessionModel *sessionModel = new WorkSessionModel(dbManager, &app);
     HierarchyModel *hierarchyModel = new HierarchyModel(dbManager, &app);
     TagModel *tagModel = new TagModel(dbManager, &app);
+    CalendarHeatmapModel *heatmapModel = new CalendarHeatmapModel(dbManager, &app);
+    SuggestionModel *suggestionModel = new SuggestionModel(dbManager, &app);
+    ExportManager *exportManager = new ExportManager(dbManager, &app);
+    ImportManager *importManager = new ImportManager(dbManager, &app);
+    BackupManager *backupManager = new BackupManager(dbManager, &app);
+    // Analyzes, vacuums and checks the database while the app is idle
+    new MaintenanceScheduler(dbManager, &app);
 #ifdef ENABLE_SYNC
     SyncManager *syncManager = new SyncManager(dbManager, &app);
 #endif
@@ -53,6 +83,12 @@ int main(int argc, char *argv[])
     qmlRegisterSingletonInstance("org.worklog", 1, 0, "SessionModel", sessionModel);
     qmlRegisterSingletonInstance("org.worklog", 1, 0, "HierarchyModel", hierarchyModel);
     qmlRegisterSingletonInstance("org.worklog", 1, 0, "TagModel", tagModel);
+    qmlRegisterSingletonInstance("org.worklog", 1, 0, "HeatmapModel", heatmapModel);
+    qmlRegisterSingletonInstance("org.worklog", 1, 0, "Suggestions", suggestionModel);
+    qmlRegisterSingletonInstance("org.worklog", 1, 0, "Exporter", exportManager);
+    qmlRegisterSingletonInstance("org.worklog", 1, 0, "Importer", importManager);
+    qmlRegisterSingletonInstance("org.worklog", 1, 0, "Backups", backupManager);
+    qmlRegisterSingletonInstance("org.worklog", 1, 0, "Diagnostics", diagnostics);
 #ifdef ENABLE_SYNC
     qmlRegisterSingletonInstance("org.worklog", 1, 0, "SyncManager", syncManager);
 #endif
@@ -65,5 +101,26 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    // Initialize database
+    auto openDatabase = [&app, dbManager]() {
+        // Only the first of the two triggers below opens it
+        if (!dbManager->databasePath().isEmpty())
+            return;
+        if (!dbManager->initialize()) {
+            qCritical() << "Failed to initialize database";
+            app.exit(1);
+        }
+    };
+    if (auto *window = qobject_cast<QQuickWindow *>(engine.rootObjects().constFirst())) {
+        // Deleting the context ends the connection after the first frame
+        auto *firstFrame = new QObject(dbManager);
+        QObject::connect(window, &QQuickWindow::frameSwapped, firstFrame, [firstFrame, openDatabase]() {
+            firstFrame->deleteLater();
+            openDatabase();
+        }, Qt::QueuedConnection);
+    }
+    // Also when no frame comes, e.g. the window starts minimized
+    QTimer::singleShot(500, dbManager, openDatabase);
+
     return app.exec();
 }
@@ -0,0 +1,323 @@
+#include "maintenancescheduler.h"
+#include "connectionpool.h"
+#include "databasemanager.h"
+#include "diagnostics.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QThread>
+#include <QDebug>
+
+#include <functional>
+
+namespace {
+
+// Quiet time after opening or the last change before a run starts
+constexpr int IdleDelayMs = 2 * 60 * 1000;
+// While the app stays open, tasks falling due are looked for this often
+constexpr int RecheckMs = 60 * 60 * 1000;
+// Between two steps, so the writer never queues behind a whole run
+constexpr int StepPauseMs = 250;
+constexpr int BusyTimeoutMs = 5000;
+
+// Pages one incremental vacuum step hands back, and the fewest worth a run
+constexpr int VacuumPagesPerStep = 256;
+constexpr qint64 MinFreePages = 64;
+// Largest file rebuilt for incremental auto-vacuum when it opens
+constexpr qint64 MaxConvertBytes = 32 * 1024 * 1024;
+// Index entries ANALYZE samples, which bounds it on large tables
+constexpr int AnalysisLimit = 400;
+
+constexpr qint64 AnalyzeIntervalSecs = 24 * 60 * 60;
+constexpr qint64 QuickCheckIntervalSecs = 7 * 24 * 60 * 60;
+
+// Gives the step a writable connection of its own on the calling thread
+void withConnection(const QString &path, const std::function<void(QSqlDatabase &)> &work)
+{
+    const QString name = QStringLiteral("worklog-maintenance-%1")
+        .arg(reinterpret_cast<quintptr>(QThread::currentThreadId()), 0, 16);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), name);
+        db.setDatabaseName(path);
+        db.setConnectOptions(QStringLiteral("QSQLITE_BUSY_TIMEOUT=%1").arg(BusyTimeoutMs));
+        if (db.open()) {
+            work(db);
+            db.close();
+        } else {
+            qWarning() << "Failed to open maintenance connection:" << db.lastError().text();
+        }
+    }
+    QSqlDatabase::removeDatabase(name);
+}
+
+qint64 pragmaValue(QSqlQuery &query, const char *name)
+{
+    if (!query.exec(QStringLiteral("PRAGMA %1").arg(QLatin1String(name))) || !query.next())
+        return -1;
+    const qint64 value = query.value(0).toLongLong();
+    query.finish();
+    return value;
+}
+
+void recordResult(QSqlDatabase &db, const QString &task, qint64 elapsedNs, const QString &result)
+{
+    QSqlQuery query(db);
+    query.prepare(QStringLiteral(R"(
+        INSERT INTO Maintenance (Task, FinishedAt, DurationMs, Result)
+        VALUES (:task, datetime('now'), :duration, :result)
+        ON CONFLICT(Task) DO UPDATE SET
+            FinishedAt = excluded.FinishedAt,
+            DurationMs = excluded.DurationMs,
+            Result = excluded.Result
+    )"));
+    query.bindValue(QStringLiteral(":task"), task);
+    query.bindValue(QStringLiteral(":duration"), elapsedNs / 1000000.0);
+    query.bindValue(QStringLiteral(":result"), result);
+    if (!query.exec())
+        qWarning() << "Failed to record maintenance result:" << query.lastError().text();
+}
+
+} // namespace
+
+MaintenanceScheduler::MaintenanceScheduler(DatabaseManager *db, QObject *parent)
+    : QObject(parent)
+    , m_database(db)
+{
+    m_idleTimer.setSingleShot(true);
+    m_idleTimer.setInterval(IdleDelayMs);
+    connect(&m_idleTimer, &QTimer::timeout, this, &MaintenanceScheduler::start);
+
+    connect(m_database, &DatabaseManager::opened, this, &MaintenanceScheduler::onDataChanged);
+    connect(m_database, &DatabaseManager::dataChanged, this, &MaintenanceScheduler::onDataChanged);
+    connect(m_database, &DatabaseManager::tagsChanged, this, &MaintenanceScheduler::onDataChanged);
+    if (m_database->isOpen())
+        m_idleTimer.start();
+}
+
+void MaintenanceScheduler::convert(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    const qint64 mode = pragmaValue(query, "auto_vacuum");
+    if (mode < 0 || mode == 2)
+        return;
+    // Tried before, whether it worked or not
+    if (!query.exec(QStringLiteral("SELECT 1 FROM Maintenance WHERE Task = 'convert'")) || query.next())
+        return;
+    query.finish();
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    QString result;
+    const qint64 size = QFileInfo(db.databaseName()).size();
+    if (size > MaxConvertBytes) {
+        result = QStringLiteral("skipped, %1 MiB is too large to rebuild").arg(size / (1024 * 1024));
+    } else {
+        const DiagnosticsTimer timer("maintenance.convert");
+        // The setting only takes hold when VACUUM rebuilds the file
+        if (query.exec(QStringLiteral("PRAGMA auto_vacuum=INCREMENTAL")) && query.exec(QStringLiteral("VACUUM"))) {
+            result = QStringLiteral("incremental auto-vacuum enabled");
+        } else {
+            result = query.lastError().text();
+            qWarning() << "Failed to enable incremental auto-vacuum:" << result;
+            Diagnostics::instance()->add("maintenance.failures");
+        }
+    }
+    query.finish();
+    recordResult(db, QStringLiteral("convert"), elapsed.nsecsElapsed(), result);
+}
+
+void MaintenanceScheduler::runNow()
+{
+    m_idleTimer.stop();
+    start();
+}
+
+void MaintenanceScheduler::onDataChanged()
+{
+    // A run in progress stops after its current step and waits for the
+    // next quiet spell
+    if (m_running)
+        m_interrupted = true;
+    else
+        m_idleTimer.start(IdleDelayMs);
+}
+
+void MaintenanceScheduler::start()
+{
+    if (m_running || !m_database->isOpen())
+        return;
+
+    m_running = true;
+    m_interrupted = false;
+    emit runningChanged();
+    Diagnostics::instance()->add("maintenance.runs");
+
+    const QString path = m_database->databasePath();
+    ConnectionPool::run([this, path]() {
+        const QVector<Step> steps = plan(path);
+        QMetaObject::invokeMethod(this, [this, steps]() {
+            m_steps = steps;
+            runNextStep();
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MaintenanceScheduler::runNextStep()
+{
+    if (m_interrupted || m_steps.isEmpty()) {
+        finish();
+        return;
+    }
+
+    const Step step = m_steps.takeFirst();
+    const QString path = m_database->databasePath();
+    ConnectionPool::run([this, path, step]() {
+        const StepResult result = runStep(path, step);
+        QMetaObject::invokeMethod(this, [this, step, result]() {
+            if (result.again)
+                m_steps.prepend(step);
+            QTimer::singleShot(StepPauseMs, this, &MaintenanceScheduler::runNextStep);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MaintenanceScheduler::finish()
+{
+    const bool interrupted = m_interrupted;
+    m_steps.clear();
+    m_running = false;
+    m_interrupted = false;
+    emit runningChanged();
+
+    m_idleTimer.start(interrupted ? IdleDelayMs : RecheckMs);
+}
+
+QVector<MaintenanceScheduler::Step> MaintenanceScheduler::plan(const QString &databasePath)
+{
+    const DiagnosticsTimer timer("maintenance.plan");
+    QVector<Step> steps;
+
+    withConnection(databasePath, [&steps](QSqlDatabase &db) {
+        QSqlQuery query(db);
+        QHash<QString, qint64> lastRun;
+        if (query.exec(QStringLiteral("SELECT Task, CAST(strftime('%s', FinishedAt) AS INTEGER) FROM Maintenance"))) {
+            while (query.next())
+                lastRun.insert(query.value(0).toString(), query.value(1).toLongLong());
+        }
+        const qint64 now = QDateTime::currentSecsSinceEpoch();
+        auto due = [&lastRun, now](const QString &task, qint64 intervalSecs) {
+            return !lastRun.contains(task) || now - lastRun.value(task) >= intervalSecs;
+        };
+
+        // Databases left unconverted (see convert()) keep their free pages
+        const bool incremental = pragmaValue(query, "auto_vacuum") == 2;
+        if (due(QStringLiteral("analyze"), AnalyzeIntervalSecs))
+            steps.append({Task::Analyze, QString()});
+        if (incremental && pragmaValue(query, "freelist_count") >= MinFreePages)
+            steps.append({Task::IncrementalVacuum, QString()});
+
+        // Read-only, so they go last
+        if (query.exec(QStringLiteral(
+                "SELECT name FROM sqlite_master WHERE type = 'table' AND name NOT LIKE 'sqlite_%' ORDER BY name"))) {
+            while (query.next()) {
+                const QString table = query.value(0).toString();
+                if (due(QStringLiteral("quick_check:") + table, QuickCheckIntervalSecs))
+                    steps.append({Task::QuickCheck, table});
+            }
+        }
+    });
+    return steps;
+}
+
+MaintenanceScheduler::StepResult MaintenanceScheduler::runStep(const QString &databasePath, const Step &step)
+{
+    StepResult stepResult;
+
+    withConnection(databasePath, [&step, &stepResult](QSqlDatabase &db) {
+        QElapsedTimer elapsed;
+        elapsed.start();
+        QSqlQuery query(db);
+        QString task;
+        QString error;
+
+        switch (step.task) {
+        case Task::Analyze: {
+            const DiagnosticsTimer timer("maintenance.analyze");
+            task = QStringLiteral("analyze");
+            // A bounded ANALYZE rather than PRAGMA optimize, which on a fresh
+            // connection has seen no queries to decide from
+            query.exec(QStringLiteral("PRAGMA analysis_limit=%1").arg(AnalysisLimit));
+            stepResult.ok = query.exec(QStringLiteral("ANALYZE"));
+            stepResult.result = QStringLiteral("statistics refreshed");
+            break;
+        }
+        case Task::IncrementalVacuum: {
+            const DiagnosticsTimer timer("maintenance.incrementalVacuum");
+            task = QStringLiteral("incremental_vacuum");
+            const qint64 before = pragmaValue(query, "freelist_count");
+            if (before < 0 || !db.transaction()) {
+                error = db.lastError().text();
+                break;
+            }
+            // Each step of the pragma frees one page, and QSqlQuery only
+            // ever takes the first, so the slice is one page per statement
+            const int slice = int(qMin<qint64>(before, VacuumPagesPerStep));
+            bool ok = true;
+            for (int i = 0; ok && i < slice; ++i)
+                ok = query.exec(QStringLiteral("PRAGMA incremental_vacuum(1)"));
+            if (!ok)
+                error = query.lastError().text();
+            query.finish();
+            if (ok && !db.commit()) {
+                error = db.lastError().text();
+                ok = false;
+            }
+            if (!ok) {
+                db.rollback();
+                break;
+            }
+
+            const qint64 after = pragmaValue(query, "freelist_count");
+            Diagnostics::instance()->add("maintenance.pagesFreed", before - after);
+            stepResult.ok = true;
+            stepResult.again = after > 0 && after < before;
+            stepResult.result = QStringLiteral("%1 pages freed, %2 left").arg(before - after).arg(after);
+            break;
+        }
+        case Task::QuickCheck: {
+            const DiagnosticsTimer timer("maintenance.quickCheck");
+            task = QStringLiteral("quick_check:") + step.table;
+            stepResult.ok = query.exec(QStringLiteral("PRAGMA quick_check(\"%1\")").arg(step.table));
+            QStringList problems;
+            while (stepResult.ok && query.next()) {
+                const QString line = query.value(0).toString();
+                if (line != QLatin1String("ok"))
+                    problems.append(line);
+            }
+            if (!problems.isEmpty()) {
+                qWarning() << "Integrity check failed for" << step.table << ":" << problems;
+                Diagnostics::instance()->add("maintenance.integrityErrors", problems.size());
+            }
+            stepResult.result = problems.isEmpty() ? QStringLiteral("ok") : problems.join(QStringLiteral("; "));
+            break;
+        }
+        }
+
+        if (!stepResult.ok) {
+            if (error.isEmpty())
+                error = query.lastError().text();
+            qWarning() << "Maintenance step failed:" << task << error;
+            Diagnostics::instance()->add("maintenance.failures");
+            stepResult.result = error;
+        }
+        query.finish();
+        recordResult(db, task, elapsed.nsecsElapsed(), stepResult.result);
+    });
+    return stepResult;
+}
@@ -0,0 +1,84 @@
+#ifndef MAINTENANCESCHEDULER_H
+#define MAINTENANCESCHEDULER_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+class DatabaseManager;
+
+// Keeps the database in shape while the app sits idle: refreshes the
+// planner statistics, hands free pages back to the file system a slice at
+// a time, and quick-checks each table for corruption. The work is cut
+// into short steps that run one after another on the pool, each on a
+// writable connection of its own, and a run stops between two steps as
+// soon as the data changes.
+//
+// Every step is timed under "maintenance.*" in Diagnostics, and its
+// outcome is kept in the Maintenance table, which also decides when a
+// task is due again.
+//
+// Incremental vacuuming needs the database built for it. New databases
+// are; older ones are rebuilt once by convert() while the database opens,
+// as the VACUUM holds the write lock throughout and would stall any
+// writer queued behind it. Only files small enough to rebuild quickly are
+// converted, and the attempt is recorded so that it is made only once.
+class MaintenanceScheduler : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged)
+
+public:
+    explicit MaintenanceScheduler(DatabaseManager *db, QObject *parent = nullptr);
+
+    bool isRunning() const { return m_running; }
+
+    // Called with the writer before anything else uses it
+    static void convert(QSqlDatabase &db);
+
+    // Runs whatever is due without waiting for the app to go idle
+    Q_INVOKABLE void runNow();
+
+signals:
+    void runningChanged();
+
+private:
+    enum class Task {
+        Analyze,
+        IncrementalVacuum,
+        QuickCheck
+    };
+
+    struct Step {
+        Task task;
+        // QuickCheck: the table to check
+        QString table;
+    };
+
+    struct StepResult {
+        bool ok = false;
+        // IncrementalVacuum: free pages are left for another slice
+        bool again = false;
+        QString result;
+    };
+
+    void onDataChanged();
+    void start();
+    void runNextStep();
+    void finish();
+
+    // Run on the pool
+    static QVector<Step> plan(const QString &databasePath);
+    static StepResult runStep(const QString &databasePath, const Step &step);
+
+    DatabaseManager *m_database;
+    QTimer m_idleTimer;
+    QVector<Step> m_steps;
+    bool m_running = false;
+    // Data changed since the run started
+    bool m_interrupted = false;
+};
+
+#endif // MAINTENANCESCHEDULER_H
@@ -0,0 +1,439 @@
+#include "sessionexporter.h"
+#include "diagnostics.h"
+#include "yeararchive.h"
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSaveFile>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QVector>
+#include <QDebug>
+
+#include <cstring>
+
+namespace {
+
+// Bytes accumulated before handing a block to the file
+constexpr int BufferCapacity = 64 * 1024;
+// Minimum delay between two progress notifications
+constexpr qint64 ProgressIntervalMs = 100;
+
+// Binary layout: magic, version, then length-prefixed records,
+// terminated by a zero length and the total row count.
+constexpr char BinaryMagic[] = {'W', 'L', 'E', 'X'};
+constexpr quint16 BinaryVersion = 1;
+constexpr quint32 BinaryNullString = 0xFFFFFFFFu;
+
+enum Column {
+    IdColumn = 0,
+    DateColumn,
+    HoursColumn,
+    DescriptionColumn,
+    NotesColumn,
+    NextStageColumn,
+    TagColumn,
+    CreatedAtColumn,
+    UpdatedAtColumn
+};
+
+const char *const FieldNames[] = {
+    "id", "date", "hours", "description", "notes",
+    "nextPlannedStage", "tag", "createdAt", "updatedAt"
+};
+constexpr int FieldCount = sizeof(FieldNames) / sizeof(FieldNames[0]);
+
+void appendCsvField(QByteArray &out, const QByteArray &value)
+{
+    bool needsQuotes = false;
+    for (const char c : value) {
+        if (c == ',' || c == '"' || c == '\n' || c == '\r') {
+            needsQuotes = true;
+            break;
+        }
+    }
+
+    if (!needsQuotes) {
+        out.append(value);
+        return;
+    }
+
+    out.append('"');
+    for (const char c : value) {
+        if (c == '"')
+            out.append('"');
+        out.append(c);
+    }
+    out.append('"');
+}
+
+void appendJsonString(QByteArray &out, const QByteArray &value)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out.append('"');
+    for (const char c : value) {
+        switch (c) {
+        case '"':  out.append("\\\"", 2); break;
+        case '\\': out.append("\\\\", 2); break;
+        case '\n': out.append("\\n", 2); break;
+        case '\r': out.append("\\r", 2); break;
+        case '\t': out.append("\\t", 2); break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out.append("\\u00", 4);
+                out.append(hex[(c >> 4) & 0xF]);
+                out.append(hex[c & 0xF]);
+            } else {
+                out.append(c);
+            }
+        }
+    }
+    out.append('"');
+}
+
+template <typename T>
+void appendLittleEndian(QByteArray &out, T value)
+{
+    const T le = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char *>(&le), sizeof(le));
+}
+
+void appendBinaryString(QByteArray &out, const QVariant &value)
+{
+    if (value.isNull()) {
+        appendLittleEndian<quint32>(out, BinaryNullString);
+        return;
+    }
+    const QByteArray utf8 = value.toString().toUtf8();
+    appendLittleEndian<quint32>(out, quint32(utf8.size()));
+    out.append(utf8);
+}
+
+QByteArray formatHours(double hours)
+{
+    return QByteArray::number(hours, 'g', 12);
+}
+
+} // namespace
+
+SessionExporter::SessionExporter(const QString &databasePath, const QString &outputPath,
+                                 Format format, QObject *parent)
+    : QObject(parent)
+    , m_databasePath(databasePath)
+    , m_outputPath(outputPath)
+    , m_format(format)
+{
+}
+
+void SessionExporter::setDateRange(const QDate &from, const QDate &to)
+{
+    m_from = from;
+    m_to = to;
+}
+
+void SessionExporter::cancel()
+{
+    m_cancelled.storeRelaxed(1);
+}
+
+qint64 SessionExporter::rowsWritten() const
+{
+    return m_rowsWritten;
+}
+
+QString SessionExporter::errorString() const
+{
+    return m_errorString;
+}
+
+SessionExporter::Format SessionExporter::formatFromString(const QString &name, bool *ok)
+{
+    const QString lower = name.trimmed().toLower();
+    if (ok)
+        *ok = true;
+
+    if (lower == QLatin1String("csv"))
+        return Csv;
+    if (lower == QLatin1String("ndjson") || lower == QLatin1String("jsonl") || lower == QLatin1String("json"))
+        return NdJson;
+    if (lower == QLatin1String("binary") || lower == QLatin1String("wlex"))
+        return Binary;
+
+    if (ok)
+        *ok = false;
+    return Csv;
+}
+
+QString SessionExporter::fileSuffix(Format format)
+{
+    switch (format) {
+    case NdJson:
+        return QStringLiteral("ndjson");
+    case Binary:
+        return QStringLiteral("wlex");
+    case Csv:
+    default:
+        return QStringLiteral("csv");
+    }
+}
+
+bool SessionExporter::run()
+{
+    const DiagnosticsTimer timer("export.run");
+    m_rowsWritten = 0;
+    m_errorString.clear();
+
+    // Each run gets a private connection; QSqlDatabase handles may only be
+    // used on the thread that opened them.
+    const QString connectionName = QStringLiteral("worklog-export-%1")
+        .arg(reinterpret_cast<quintptr>(this), 0, 16);
+
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
+        db.setDatabaseName(m_databasePath);
+        db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
+
+        if (db.open()) {
+            ok = exportFrom(db);
+            db.close();
+        } else {
+            ok = fail(tr("Failed to open database: %1").arg(db.lastError().text()));
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    YearArchive::release(connectionName);
+
+    const QString message = ok
+        ? tr("Exported %1 sessions to %2").arg(m_rowsWritten).arg(m_outputPath)
+        : m_errorString;
+    emit finished(ok, message);
+    return ok;
+}
+
+QString SessionExporter::whereClause(const QDate &from, const QDate &to)
+{
+    QString where = QStringLiteral(" WHERE ws.IsDeleted = 0");
+    if (from.isValid())
+        where += QStringLiteral(" AND ws.SessionDate >= :from");
+    if (to.isValid())
+        where += QStringLiteral(" AND ws.SessionDate <= :to");
+    return where;
+}
+
+bool SessionExporter::exportFrom(QSqlDatabase &db)
+{
+    // Only the archived years inside the range are opened, a few at a
+    // time; the parts follow each other in date order
+    struct Part {
+        int firstYear;
+        int lastYear;
+        QDate from;
+        QDate to;
+    };
+    QVector<Part> parts;
+    const QList<QPair<int, int>> ranges = YearArchive::splitRange(m_from.isValid() ? m_from.year() : 0,
+                                                                  m_to.isValid() ? m_to.year() : 9999);
+    for (int i = 0; i < ranges.size(); ++i) {
+        const QPair<int, int> &range = ranges.at(i);
+        parts.append({range.first, range.second,
+                      i == 0 ? m_from : QDate(range.first, 1, 1),
+                      i == ranges.size() - 1 ? m_to : QDate(range.second, 12, 31)});
+    }
+
+    auto prepare = [this, &db](QSqlQuery &query, const Part &part, const QString &select, const QString &order) {
+        QString error;
+        if (!YearArchive::applyRange(db, part.firstYear, part.lastYear, &error))
+            return fail(tr("Failed to open archived years: %1").arg(error));
+        query.prepare(select + whereClause(part.from, part.to) + order);
+        if (part.from.isValid())
+            query.bindValue(QStringLiteral(":from"), part.from.toString(Qt::ISODate));
+        if (part.to.isValid())
+            query.bindValue(QStringLiteral(":to"), part.to.toString(Qt::ISODate));
+        return true;
+    };
+
+    qint64 totalRows = 0;
+    for (const Part &part : qAsConst(parts)) {
+        QSqlQuery countQuery(db);
+        if (!prepare(countQuery, part, QStringLiteral("SELECT COUNT(*) FROM WorkSessions ws"), QString()))
+            return false;
+        if (countQuery.exec() && countQuery.next()) {
+            totalRows += countQuery.value(0).toLongLong();
+        }
+    }
+
+    QSaveFile file(m_outputPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return fail(tr("Cannot write %1: %2").arg(m_outputPath, file.errorString()));
+    }
+
+    QByteArray buffer;
+    buffer.reserve(BufferCapacity + 4096);
+    QByteArray record;
+    record.reserve(1024);
+
+    writeHeader(buffer);
+
+    QElapsedTimer progressTimer;
+    progressTimer.start();
+    emit progress(0, totalRows);
+
+    for (const Part &part : qAsConst(parts)) {
+        // Forward-only keeps QSqlQuery from caching rows it has already visited
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        const bool prepared = prepare(query, part, QStringLiteral(R"(
+            SELECT ws.Id, ws.SessionDate, ws.TimeHours, ws.Description, ws.Notes,
+                   ws.NextPlannedStage, t.Name, ws.CreatedAt, ws.UpdatedAt
+            FROM WorkSessions ws
+            LEFT JOIN Tags t ON ws.TagId = t.Id
+        )"), QStringLiteral(" ORDER BY ws.SessionDate ASC, ws.Id ASC"));
+        if (!prepared) {
+            file.cancelWriting();
+            return false;
+        }
+
+        if (!query.exec()) {
+            file.cancelWriting();
+            return fail(tr("Failed to read sessions: %1").arg(query.lastError().text()));
+        }
+
+        while (query.next()) {
+            if (m_cancelled.loadRelaxed()) {
+                file.cancelWriting();
+                return fail(tr("Export cancelled"));
+            }
+
+            switch (m_format) {
+            case Csv:
+                for (int column = 0; column < FieldCount; ++column) {
+                    if (column > 0)
+                        buffer.append(',');
+                    if (column == HoursColumn)
+                        buffer.append(formatHours(query.value(column).toDouble()));
+                    else
+                        appendCsvField(buffer, query.value(column).toString().toUtf8());
+                }
+                buffer.append('\n');
+                break;
+
+            case NdJson:
+                buffer.append('{');
+                for (int column = 0; column < FieldCount; ++column) {
+                    const QVariant value = query.value(column);
+                    if (column > 0)
+                        buffer.append(',');
+                    buffer.append('"').append(FieldNames[column]).append("\":", 2);
+                    if (value.isNull())
+                        buffer.append("null", 4);
+                    else if (column == IdColumn)
+                        buffer.append(QByteArray::number(value.toLongLong()));
+                    else if (column == HoursColumn)
+                        buffer.append(formatHours(value.toDouble()));
+                    else
+                        appendJsonString(buffer, value.toString().toUtf8());
+                }
+                buffer.append("}\n", 2);
+                break;
+
+            case Binary: {
+                record.resize(0);
+                appendLittleEndian<qint64>(record, query.value(IdColumn).toLongLong());
+                const QDate date = QDate::fromString(query.value(DateColumn).toString(), Qt::ISODate);
+                appendLittleEndian<qint64>(record, date.toJulianDay());
+                const double hours = query.value(HoursColumn).toDouble();
+                quint64 hoursBits;
+                std::memcpy(&hoursBits, &hours, sizeof(hoursBits));
+                appendLittleEndian<quint64>(record, hoursBits);
+                for (int column = DescriptionColumn; column < FieldCount; ++column)
+                    appendBinaryString(record, query.value(column));
+
+                appendLittleEndian<quint32>(buffer, quint32(record.size()));
+                buffer.append(record);
+                break;
+            }
+            }
+
+            ++m_rowsWritten;
+
+            if (buffer.size() >= BufferCapacity && !flush(buffer, &file)) {
+                file.cancelWriting();
+                return false;
+            }
+
+            if ((m_rowsWritten & 0xFF) == 0 && progressTimer.elapsed() >= ProgressIntervalMs) {
+                emit progress(m_rowsWritten, totalRows);
+                progressTimer.restart();
+            }
+        }
+
+        if (query.lastError().isValid()) {
+            file.cancelWriting();
+            return fail(tr("Failed to read sessions: %1").arg(query.lastError().text()));
+        }
+    }
+
+    writeTrailer(buffer);
+    if (!flush(buffer, &file)) {
+        file.cancelWriting();
+        return false;
+    }
+
+    if (!file.commit()) {
+        return fail(tr("Cannot write %1: %2").arg(m_outputPath, file.errorString()));
+    }
+
+    emit progress(m_rowsWritten, totalRows);
+    return true;
+}
+
+void SessionExporter::writeHeader(QByteArray &buffer) const
+{
+    switch (m_format) {
+    case Csv:
+        for (int column = 0; column < FieldCount; ++column) {
+            if (column > 0)
+                buffer.append(',');
+            buffer.append(FieldNames[column]);
+        }
+        buffer.append('\n');
+        break;
+    case Binary:
+        buffer.append(BinaryMagic, sizeof(BinaryMagic));
+        appendLittleEndian<quint16>(buffer, BinaryVersion);
+        appendLittleEndian<quint16>(buffer, 0); // flags, reserved
+        break;
+    case NdJson:
+        break;
+    }
+}
+
+void SessionExporter::writeTrailer(QByteArray &buffer) const
+{
+    if (m_format == Binary) {
+        appendLittleEndian<quint32>(buffer, 0);
+        appendLittleEndian<quint64>(buffer, quint64(m_rowsWritten));
+    }
+}
+
+bool SessionExporter::flush(QByteArray &buffer, QIODevice *device)
+{
+    if (buffer.isEmpty())
+        return true;
+
+    if (device->write(buffer) != buffer.size()) {
+        return fail(tr("Write failed: %1").arg(device->errorString()));
+    }
+    buffer.resize(0);
+    return true;
+}
+
+bool SessionExporter::fail(const QString &message)
+{
+    qWarning() << "Session export failed:" << message;
+    m_errorString = message;
+    return false;
+}
@@ -0,0 +1,65 @@
+#ifndef SESSIONEXPORTER_H
+#define SESSIONEXPORTER_H
+
+#include <QObject>
+#include <QDate>
+#include <QAtomicInt>
+
+class QSqlDatabase;
+class QIODevice;
+
+// Streams WorkSessions (joined with their tag name) from a forward-only
+// SQLite cursor into a file. Rows are never collected in memory, so the
+// footprint stays constant no matter how large the table is.
+//
+// run() is synchronous and opens its own connection, so it can be called
+// directly (CLI) or from a worker thread (ExportManager).
+class SessionExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        Csv,
+        NdJson,
+        Binary
+    };
+    Q_ENUM(Format)
+
+    SessionExporter(const QString &databasePath, const QString &outputPath,
+                    Format format, QObject *parent = nullptr);
+
+    void setDateRange(const QDate &from, const QDate &to);
+
+    bool run();
+    void cancel();
+
+    qint64 rowsWritten() const;
+    QString errorString() const;
+
+    static Format formatFromString(const QString &name, bool *ok = nullptr);
+    static QString fileSuffix(Format format);
+
+signals:
+    void progress(qint64 rowsWritten, qint64 totalRows);
+    void finished(bool success, const QString &message);
+
+private:
+    bool exportFrom(QSqlDatabase &db);
+    static QString whereClause(const QDate &from, const QDate &to);
+    void writeHeader(QByteArray &buffer) const;
+    void writeTrailer(QByteArray &buffer) const;
+    bool flush(QByteArray &buffer, QIODevice *device);
+    bool fail(const QString &message);
+
+    QString m_databasePath;
+    QString m_outputPath;
+    Format m_format;
+    QDate m_from;
+    QDate m_to;
+    QAtomicInt m_cancelled;
+    qint64 m_rowsWritten = 0;
+    QString m_errorString;
+};
+
+#endif // SESSIONEXPORTER_H
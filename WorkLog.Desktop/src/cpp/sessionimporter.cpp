@@ -0,0 +1,554 @@
+#include "sessionimporter.h"
+#include "diagnostics.h"
+#include "hybridclock.h"
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QFile>
+#include <QFileInfo>
+#include <QDate>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <QDebug>
+
+namespace {
+
+// 9 bound columns per row keeps a full batch below SQLite's default
+// limit of 999 host parameters per statement.
+constexpr int BatchRows = 100;
+constexpr int MaxReportedErrors = 50;
+constexpr qint64 ProgressIntervalMs = 100;
+
+QString batchInsertSql(int rows)
+{
+    const QString tuple = QStringLiteral(
+        "(?, ?, ?, ?, ?, ?, COALESCE(?, datetime('now')), COALESCE(?, datetime('now')), ?)");
+
+    QString sql = QStringLiteral(
+        "INSERT INTO WorkSessions (SessionDate, TimeHours, Description, Notes, "
+        "NextPlannedStage, TagId, CreatedAt, UpdatedAt, Hlc) VALUES ");
+    sql.reserve(sql.size() + rows * (tuple.size() + 2));
+    for (int i = 0; i < rows; ++i) {
+        if (i > 0)
+            sql += QStringLiteral(", ");
+        sql += tuple;
+    }
+    return sql;
+}
+
+QVariant nullIfEmpty(const QString &value)
+{
+    return value.isEmpty() ? QVariant() : value;
+}
+
+} // namespace
+
+SessionImporter::SessionImporter(const QString &databasePath, const QString &inputPath,
+                                 Format format, QObject *parent)
+    : QObject(parent)
+    , m_databasePath(databasePath)
+    , m_inputPath(inputPath)
+    , m_format(format)
+{
+}
+
+void SessionImporter::setDryRun(bool dryRun)
+{
+    m_dryRun = dryRun;
+}
+
+bool SessionImporter::isDryRun() const
+{
+    return m_dryRun;
+}
+
+void SessionImporter::cancel()
+{
+    m_cancelled.storeRelaxed(1);
+}
+
+qint64 SessionImporter::rowsImported() const
+{
+    return m_rowsImported;
+}
+
+qint64 SessionImporter::rowsRejected() const
+{
+    return m_rowsRejected;
+}
+
+int SessionImporter::tagsCreated() const
+{
+    return m_tagsCreated;
+}
+
+QStringList SessionImporter::rowErrors() const
+{
+    return m_rowErrors;
+}
+
+QString SessionImporter::errorString() const
+{
+    return m_errorString;
+}
+
+SessionImporter::Format SessionImporter::formatFromString(const QString &name, bool *ok)
+{
+    const QString lower = name.trimmed().toLower();
+    if (ok)
+        *ok = true;
+
+    if (lower == QLatin1String("csv"))
+        return Csv;
+    if (lower == QLatin1String("ndjson") || lower == QLatin1String("jsonl") || lower == QLatin1String("json"))
+        return NdJson;
+
+    if (ok)
+        *ok = false;
+    return Csv;
+}
+
+SessionImporter::Format SessionImporter::formatForPath(const QString &path, bool *ok)
+{
+    return formatFromString(QFileInfo(path).suffix(), ok);
+}
+
+int SessionImporter::fieldForName(const QString &name)
+{
+    static const QHash<QString, int> fields = {
+        {QStringLiteral("date"), DateField},
+        {QStringLiteral("sessiondate"), DateField},
+        {QStringLiteral("hours"), HoursField},
+        {QStringLiteral("timehours"), HoursField},
+        {QStringLiteral("description"), DescriptionField},
+        {QStringLiteral("notes"), NotesField},
+        {QStringLiteral("nextplannedstage"), NextStageField},
+        {QStringLiteral("nextstage"), NextStageField},
+        {QStringLiteral("tag"), TagField},
+        {QStringLiteral("tagname"), TagField},
+        {QStringLiteral("createdat"), CreatedAtField},
+        {QStringLiteral("updatedat"), UpdatedAtField}
+    };
+
+    QString key = name.trimmed().toLower();
+    key.remove(QLatin1Char('_'));
+    key.remove(QLatin1Char('-'));
+    key.remove(QLatin1Char(' '));
+    return fields.value(key, -1);
+}
+
+QString SessionImporter::normalizeTimestamp(const QString &value, bool *ok)
+{
+    *ok = true;
+    const QString trimmed = value.trimmed();
+    if (trimmed.isEmpty())
+        return QString();
+
+    QDateTime dateTime = QDateTime::fromString(trimmed, Qt::ISODate);
+    if (!dateTime.isValid())
+        dateTime = QDateTime::fromString(trimmed, QStringLiteral("yyyy-MM-dd HH:mm:ss"));
+    if (!dateTime.isValid()) {
+        *ok = false;
+        return QString();
+    }
+
+    // Stored the same way SQLite's datetime('now') writes it
+    if (dateTime.timeSpec() != Qt::LocalTime)
+        dateTime = dateTime.toUTC();
+    return dateTime.toString(QStringLiteral("yyyy-MM-dd HH:mm:ss"));
+}
+
+bool SessionImporter::run()
+{
+    const DiagnosticsTimer timer("import.run");
+    m_lineNumber = 0;
+    m_rowsImported = 0;
+    m_rowsRejected = 0;
+    m_tagsCreated = 0;
+    m_nextDryRunTagId = -1;
+    m_rowErrors.clear();
+    m_errorString.clear();
+    m_batch.clear();
+    m_tagIds.clear();
+    m_deletedTagIds.clear();
+
+    bool ok = false;
+    QFile input(m_inputPath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        ok = fail(tr("Cannot read %1: %2").arg(m_inputPath, input.errorString()));
+    } else {
+        const QString connectionName = QStringLiteral("worklog-import-%1")
+            .arg(reinterpret_cast<quintptr>(this), 0, 16);
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
+            db.setDatabaseName(m_databasePath);
+            db.setConnectOptions(m_dryRun ? QStringLiteral("QSQLITE_OPEN_READONLY")
+                                          : QStringLiteral("QSQLITE_BUSY_TIMEOUT=30000"));
+
+            if (db.open()) {
+                ok = importFrom(db, &input);
+                db.close();
+            } else {
+                ok = fail(tr("Failed to open database: %1").arg(db.lastError().text()));
+            }
+        }
+        QSqlDatabase::removeDatabase(connectionName);
+    }
+
+    QString message;
+    if (!ok) {
+        message = m_errorString;
+    } else if (m_dryRun) {
+        message = tr("Validation finished: %1 valid rows, %2 rejected, %3 new tags.")
+            .arg(m_rowsImported).arg(m_rowsRejected).arg(m_tagsCreated);
+    } else {
+        message = tr("Imported %1 sessions (%2 rejected, %3 new tags).")
+            .arg(m_rowsImported).arg(m_rowsRejected).arg(m_tagsCreated);
+    }
+
+    emit summaryReady(ok ? m_rowsImported : 0, ok ? m_tagsCreated : 0, m_rowErrors);
+    emit finished(ok, message);
+    return ok;
+}
+
+bool SessionImporter::importFrom(QSqlDatabase &db, QIODevice *input)
+{
+    if (!loadTags(db))
+        return false;
+
+    if (!m_dryRun && !db.transaction()) {
+        return fail(tr("Failed to start transaction: %1").arg(db.lastError().text()));
+    }
+    const TraceSpan transactionSpan("import.transaction");
+
+    auto rollbackWith = [this, &db](const QString &message) {
+        if (!m_dryRun)
+            db.rollback();
+        return message.isEmpty() ? false : fail(message);
+    };
+
+    QSqlQuery batchQuery(db);
+    if (!m_dryRun && !batchQuery.prepare(batchInsertSql(BatchRows))) {
+        return rollbackWith(tr("Failed to prepare insert: %1").arg(batchQuery.lastError().text()));
+    }
+
+    m_batch.reserve(BatchRows);
+
+    const qint64 totalBytes = input->size();
+    QElapsedTimer progressTimer;
+    progressTimer.start();
+    emit progress(0, totalBytes);
+
+    QList<QByteArray> fields;
+    if (m_format == Csv) {
+        if (!readCsvRecord(input, fields))
+            return rollbackWith(tr("The file is empty"));
+        if (!mapCsvHeader(fields))
+            return rollbackWith(tr("The CSV header must name the date, hours and description columns"));
+    }
+
+    QString values[FieldCount];
+    while (true) {
+        if (m_cancelled.loadRelaxed())
+            return rollbackWith(tr("Import cancelled"));
+
+        for (QString &value : values)
+            value.clear();
+
+        if (m_format == Csv) {
+            if (!readCsvRecord(input, fields))
+                break;
+            if (fields.size() == 1 && fields.first().isEmpty())
+                continue;
+
+            const int columns = qMin(fields.size(), m_csvColumns.size());
+            for (int column = 0; column < columns; ++column) {
+                const int field = m_csvColumns.at(column);
+                if (field >= 0)
+                    values[field] = QString::fromUtf8(fields.at(column));
+            }
+        } else {
+            const QByteArray line = input->readLine();
+            if (line.isEmpty())
+                break;
+            ++m_lineNumber;
+
+            const QByteArray trimmed = line.trimmed();
+            if (trimmed.isEmpty())
+                continue;
+
+            QJsonParseError parseError;
+            const QJsonDocument doc = QJsonDocument::fromJson(trimmed, &parseError);
+            if (!doc.isObject()) {
+                rejectRow(tr("invalid JSON (%1)").arg(parseError.errorString()));
+                continue;
+            }
+
+            const QJsonObject object = doc.object();
+            for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+                const int field = fieldForName(it.key());
+                if (field < 0)
+                    continue;
+                if (it.value().isDouble())
+                    values[field] = QString::number(it.value().toDouble(), 'g', 12);
+                else if (it.value().isString())
+                    values[field] = it.value().toString();
+            }
+        }
+
+        Row row;
+        if (!validateRow(values, row))
+            continue;
+        if (!resolveTag(db, row.tag, &row.tagId))
+            return rollbackWith(QString());
+
+        if (m_dryRun) {
+            ++m_rowsImported;
+        } else {
+            m_batch.append(row);
+            if (m_batch.size() == BatchRows && !flushBatch(batchQuery))
+                return rollbackWith(QString());
+        }
+
+        if (progressTimer.elapsed() >= ProgressIntervalMs) {
+            emit progress(input->pos(), totalBytes);
+            progressTimer.restart();
+        }
+    }
+
+    if (!m_dryRun) {
+        if (!m_batch.isEmpty()) {
+            QSqlQuery tailQuery(db);
+            if (!tailQuery.prepare(batchInsertSql(m_batch.size())))
+                return rollbackWith(tr("Failed to prepare insert: %1").arg(tailQuery.lastError().text()));
+            if (!flushBatch(tailQuery))
+                return rollbackWith(QString());
+        }
+
+        if (!db.commit())
+            return rollbackWith(tr("Failed to commit import: %1").arg(db.lastError().text()));
+    }
+
+    emit progress(totalBytes, totalBytes);
+    return true;
+}
+
+bool SessionImporter::readCsvRecord(QIODevice *input, QList<QByteArray> &fields)
+{
+    fields.clear();
+
+    QByteArray field;
+    bool inQuotes = false;
+    bool readAnything = false;
+
+    // A quoted field may span several physical lines
+    while (true) {
+        const QByteArray line = input->readLine();
+        if (line.isEmpty()) {
+            if (!readAnything)
+                return false;
+            fields.append(field);
+            return true;
+        }
+        ++m_lineNumber;
+        readAnything = true;
+
+        const int length = line.size();
+        for (int i = 0; i < length; ++i) {
+            const char c = line.at(i);
+            if (inQuotes) {
+                if (c == '"') {
+                    if (i + 1 < length && line.at(i + 1) == '"') {
+                        field.append('"');
+                        ++i;
+                    } else {
+                        inQuotes = false;
+                    }
+                } else {
+                    field.append(c);
+                }
+            } else if (c == '"') {
+                inQuotes = true;
+            } else if (c == ',') {
+                fields.append(field);
+                field.clear();
+            } else if (c == '\n') {
+                fields.append(field);
+                return true;
+            } else if (c != '\r') {
+                field.append(c);
+            }
+        }
+
+        if (!inQuotes) {
+            // Last line of the file without a trailing newline
+            fields.append(field);
+            return true;
+        }
+    }
+}
+
+bool SessionImporter::mapCsvHeader(const QList<QByteArray> &header)
+{
+    m_csvColumns.clear();
+    QVector<bool> seen(FieldCount, false);
+
+    for (int column = 0; column < header.size(); ++column) {
+        QByteArray name = header.at(column);
+        if (column == 0 && name.startsWith("\xEF\xBB\xBF"))
+            name.remove(0, 3); // UTF-8 byte order mark
+
+        const int field = fieldForName(QString::fromUtf8(name));
+        m_csvColumns.append(field);
+        if (field >= 0)
+            seen[field] = true;
+    }
+
+    return seen.at(DateField) && seen.at(HoursField) && seen.at(DescriptionField);
+}
+
+bool SessionImporter::validateRow(const QString (&values)[FieldCount], Row &row)
+{
+    const QDate date = QDate::fromString(values[DateField].trimmed(), Qt::ISODate);
+    if (!date.isValid()) {
+        rejectRow(tr("invalid date \"%1\"").arg(values[DateField]));
+        return false;
+    }
+
+    bool hoursOk = false;
+    const double hours = values[HoursField].trimmed().toDouble(&hoursOk);
+    if (!hoursOk || hours <= 0.0 || hours > 24.0) {
+        rejectRow(tr("invalid hours \"%1\"").arg(values[HoursField]));
+        return false;
+    }
+
+    const QString description = values[DescriptionField].trimmed();
+    if (description.isEmpty()) {
+        rejectRow(tr("missing description"));
+        return false;
+    }
+
+    bool createdOk = false;
+    bool updatedOk = false;
+    row.createdAt = normalizeTimestamp(values[CreatedAtField], &createdOk);
+    row.updatedAt = normalizeTimestamp(values[UpdatedAtField], &updatedOk);
+    if (!createdOk || !updatedOk) {
+        rejectRow(tr("invalid timestamp"));
+        return false;
+    }
+
+    row.date = date.toString(Qt::ISODate);
+    row.hours = hours;
+    row.description = description;
+    row.notes = values[NotesField];
+    row.nextStage = values[NextStageField].trimmed();
+    row.tag = values[TagField].trimmed();
+    return true;
+}
+
+bool SessionImporter::loadTags(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(QStringLiteral("SELECT Id, Name, IsDeleted FROM Tags"))) {
+        return fail(tr("Failed to read tags: %1").arg(query.lastError().text()));
+    }
+
+    while (query.next()) {
+        const int id = query.value(0).toInt();
+        m_tagIds.insert(query.value(1).toString(), id);
+        if (query.value(2).toBool())
+            m_deletedTagIds.insert(id);
+    }
+    return true;
+}
+
+bool SessionImporter::resolveTag(QSqlDatabase &db, const QString &name, QVariant *tagId)
+{
+    *tagId = QVariant();
+    if (name.isEmpty())
+        return true;
+
+    const auto it = m_tagIds.constFind(name);
+    if (it != m_tagIds.constEnd()) {
+        const int id = it.value();
+        if (id <= 0)
+            return true; // placeholder created during a dry run
+
+        // A tag deleted through sync still owns its name; bring it back
+        if (!m_dryRun && m_deletedTagIds.contains(id)) {
+            QSqlQuery revive(db);
+            revive.prepare(QStringLiteral("UPDATE Tags SET IsDeleted = 0, UpdatedAt = datetime('now'), Hlc = :hlc WHERE Id = :id"));
+            revive.bindValue(QStringLiteral(":hlc"), HybridClock::now());
+            revive.bindValue(QStringLiteral(":id"), id);
+            if (!revive.exec())
+                return fail(tr("Failed to restore tag %1: %2").arg(name, revive.lastError().text()));
+            m_deletedTagIds.remove(id);
+        }
+        *tagId = id;
+        return true;
+    }
+
+    if (m_dryRun) {
+        ++m_tagsCreated;
+        m_tagIds.insert(name, m_nextDryRunTagId--);
+        return true;
+    }
+
+    // The rows would otherwise go in untagged; the whole import is undone
+    QSqlQuery insert(db);
+    insert.prepare(QStringLiteral("INSERT INTO Tags (Name, Hlc) VALUES (:name, :hlc)"));
+    insert.bindValue(QStringLiteral(":name"), name);
+    insert.bindValue(QStringLiteral(":hlc"), HybridClock::now());
+    if (!insert.exec())
+        return fail(tr("Failed to create tag %1: %2").arg(name, insert.lastError().text()));
+
+    const int id = insert.lastInsertId().toInt();
+    ++m_tagsCreated;
+    m_tagIds.insert(name, id);
+    *tagId = id;
+    return true;
+}
+
+bool SessionImporter::flushBatch(QSqlQuery &query)
+{
+    const DiagnosticsTimer timer("import.insertBatch");
+    int position = 0;
+    for (const Row &row : qAsConst(m_batch)) {
+        query.bindValue(position++, row.date);
+        query.bindValue(position++, row.hours);
+        query.bindValue(position++, row.description);
+        query.bindValue(position++, nullIfEmpty(row.notes));
+        query.bindValue(position++, nullIfEmpty(row.nextStage));
+        query.bindValue(position++, row.tagId);
+        query.bindValue(position++, nullIfEmpty(row.createdAt));
+        query.bindValue(position++, nullIfEmpty(row.updatedAt));
+        query.bindValue(position++, HybridClock::now());
+    }
+
+    if (!query.exec()) {
+        return fail(tr("Failed to insert sessions: %1").arg(query.lastError().text()));
+    }
+
+    m_rowsImported += m_batch.size();
+    m_batch.clear();
+    return true;
+}
+
+void SessionImporter::rejectRow(const QString &reason)
+{
+    ++m_rowsRejected;
+    if (m_rowErrors.size() < MaxReportedErrors) {
+        m_rowErrors.append(tr("Line %1: %2").arg(m_lineNumber).arg(reason));
+    }
+}
+
+bool SessionImporter::fail(const QString &message)
+{
+    qWarning() << "Session import failed:" << message;
+    m_errorString = message;
+    return false;
+}
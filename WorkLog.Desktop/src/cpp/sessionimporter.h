@@ -0,0 +1,116 @@
+#ifndef SESSIONIMPORTER_H
+#define SESSIONIMPORTER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+#include <QVariant>
+
+class QSqlDatabase;
+class QSqlQuery;
+class QIODevice;
+
+// Bulk-loads sessions from CSV or NDJSON. The input is parsed as a stream,
+// rows are inserted with multi-row INSERT statements inside one
+// transaction, and tag names are resolved through an in-memory map.
+// Column names match the ones written by SessionExporter, so an export
+// can be imported again unchanged.
+//
+// In dry-run mode every row is parsed and validated but nothing is written.
+class SessionImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        Csv,
+        NdJson
+    };
+    Q_ENUM(Format)
+
+    SessionImporter(const QString &databasePath, const QString &inputPath,
+                    Format format, QObject *parent = nullptr);
+
+    void setDryRun(bool dryRun);
+    bool isDryRun() const;
+
+    bool run();
+    void cancel();
+
+    qint64 rowsImported() const;
+    qint64 rowsRejected() const;
+    int tagsCreated() const;
+    QStringList rowErrors() const;
+    QString errorString() const;
+
+    static Format formatForPath(const QString &path, bool *ok = nullptr);
+    static Format formatFromString(const QString &name, bool *ok = nullptr);
+
+signals:
+    void progress(qint64 bytesRead, qint64 totalBytes);
+    void summaryReady(qint64 rowsImported, int tagsCreated, const QStringList &rowErrors);
+    void finished(bool success, const QString &message);
+
+private:
+    enum Field {
+        DateField = 0,
+        HoursField,
+        DescriptionField,
+        NotesField,
+        NextStageField,
+        TagField,
+        CreatedAtField,
+        UpdatedAtField,
+        FieldCount
+    };
+
+    struct Row {
+        QString date;
+        double hours = 0.0;
+        QString description;
+        QString notes;
+        QString nextStage;
+        QString tag;
+        QVariant tagId;
+        QString createdAt;
+        QString updatedAt;
+    };
+
+    bool importFrom(QSqlDatabase &db, QIODevice *input);
+    bool readCsvRecord(QIODevice *input, QList<QByteArray> &fields);
+    bool mapCsvHeader(const QList<QByteArray> &header);
+    bool validateRow(const QString (&values)[FieldCount], Row &row);
+    bool loadTags(QSqlDatabase &db);
+    // Fails (and the import is rolled back) when the tag cannot be written
+    bool resolveTag(QSqlDatabase &db, const QString &name, QVariant *tagId);
+    bool flushBatch(QSqlQuery &query);
+    void rejectRow(const QString &reason);
+    bool fail(const QString &message);
+
+    static int fieldForName(const QString &name);
+    static QString normalizeTimestamp(const QString &value, bool *ok);
+
+    QString m_databasePath;
+    QString m_inputPath;
+    Format m_format;
+    bool m_dryRun = false;
+    QAtomicInt m_cancelled;
+
+    QVector<int> m_csvColumns;
+    qint64 m_lineNumber = 0;
+    QVector<Row> m_batch;
+    QHash<QString, int> m_tagIds;
+    QSet<int> m_deletedTagIds;
+    int m_nextDryRunTagId = -1;
+
+    qint64 m_rowsImported = 0;
+    qint64 m_rowsRejected = 0;
+    int m_tagsCreated = 0;
+    QStringList m_rowErrors;
+    QString m_errorString;
+};
+
+#endif // SESSIONIMPORTER_H
@@ -0,0 +1,180 @@
+#include "suggestionindex.h"
+#include "diagnostics.h"
+
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+struct Use {
+    QString key;
+    QString text;
+    qint64 day;
+};
+
+} // namespace
+
+SuggestionIndex SuggestionIndex::build(const QHash<QDate, QStringList> &days)
+{
+    const DiagnosticsTimer timer("suggestions.build");
+    QVector<Use> uses;
+    for (auto day = days.cbegin(); day != days.cend(); ++day) {
+        for (const QString &text : day.value()) {
+            const QString simplified = text.simplified();
+            if (!simplified.isEmpty())
+                uses.append({simplified.toCaseFolded(), simplified, day.key().toJulianDay()});
+        }
+    }
+
+    // The newest use of each key comes last and gives the entry its text
+    std::sort(uses.begin(), uses.end(), [](const Use &a, const Use &b) {
+        return a.key < b.key || (a.key == b.key && a.day < b.day);
+    });
+
+    SuggestionIndex index;
+    for (int i = 0; i < uses.size();) {
+        Entry entry;
+        entry.key = uses.at(i).key;
+        int end = i;
+        while (end < uses.size() && uses.at(end).key == entry.key)
+            ++end;
+        entry.text = uses.at(end - 1).text;
+        entry.count = end - i;
+        entry.lastDay = uses.at(end - 1).day;
+
+        for (; i < end; ++i)
+            index.m_days[QDate::fromJulianDay(uses.at(i).day)].append(entry.key);
+        index.m_entries.append(entry);
+        index.m_ranks.append(rank(entry));
+    }
+    return index;
+}
+
+void SuggestionIndex::setDay(const QDate &date, const QStringList &texts)
+{
+    const QStringList previous = m_days.take(date);
+    for (const QString &key : previous)
+        removeUse(key);
+
+    QStringList keys;
+    for (const QString &text : texts) {
+        const QString simplified = text.simplified();
+        if (simplified.isEmpty())
+            continue;
+        keys.append(addUse(simplified, date.toJulianDay()));
+    }
+    if (!keys.isEmpty())
+        m_days.insert(date, keys);
+}
+
+void SuggestionIndex::clear()
+{
+    m_entries.clear();
+    m_ranks.clear();
+    m_days.clear();
+}
+
+QStringList SuggestionIndex::complete(const QString &prefix, int limit) const
+{
+    const DiagnosticsTimer timer("suggestions.complete");
+    QString key = fold(prefix);
+    // "fix " should not also match "fixed"
+    if (!key.isEmpty() && prefix.at(prefix.size() - 1).isSpace())
+        key += QLatin1Char(' ');
+    if (key.isEmpty() || limit <= 0)
+        return QStringList();
+
+    // Keys starting with key sort from key up to key with its last code
+    // unit raised by one
+    const int first = lowerBound(key);
+    int last = m_entries.size();
+    const ushort lastUnit = key.at(key.size() - 1).unicode();
+    if (lastUnit != 0xFFFF) {
+        QString bound = key;
+        bound[bound.size() - 1] = QChar(ushort(lastUnit + 1));
+        last = lowerBound(bound);
+    }
+
+    // Best first; a short prefix spans many entries, so only the ranks are
+    // looked at until an entry would make the cut
+    const Entry *entries = m_entries.constData();
+    const double *ranks = m_ranks.constData();
+    QVarLengthArray<int, 16> best;
+    for (int i = first; i < last; ++i) {
+        const double candidate = ranks[i];
+        if (best.size() == limit && candidate <= ranks[best.last()])
+            continue;
+        if (entries[i].key.size() == key.size())
+            continue;
+
+        int position = best.size();
+        while (position > 0 && ranks[best[position - 1]] < candidate)
+            --position;
+        best.insert(position, i);
+        if (best.size() > limit)
+            best.removeLast();
+    }
+
+    QStringList results;
+    results.reserve(best.size());
+    for (int i : best)
+        results.append(entries[i].text);
+    return results;
+}
+
+QString SuggestionIndex::fold(const QString &text)
+{
+    return text.simplified().toCaseFolded();
+}
+
+double SuggestionIndex::rank(const Entry &entry)
+{
+    return std::log2(double(entry.count)) + double(entry.lastDay) / HalfLifeDays;
+}
+
+int SuggestionIndex::lowerBound(const QString &key) const
+{
+    const auto it = std::lower_bound(m_entries.cbegin(), m_entries.cend(), key,
+                                     [](const Entry &entry, const QString &value) {
+        return entry.key < value;
+    });
+    return int(it - m_entries.cbegin());
+}
+
+QString SuggestionIndex::addUse(const QString &text, qint64 day)
+{
+    const QString key = text.toCaseFolded();
+    const int i = lowerBound(key);
+    if (i == m_entries.size() || m_entries.at(i).key != key) {
+        Entry entry;
+        entry.key = key;
+        m_entries.insert(i, entry);
+        m_ranks.insert(i, 0.0);
+    }
+
+    Entry &entry = m_entries[i];
+    ++entry.count;
+    if (day >= entry.lastDay) {
+        entry.lastDay = day;
+        entry.text = text;
+    }
+    m_ranks[i] = rank(entry);
+    return entry.key;
+}
+
+void SuggestionIndex::removeUse(const QString &key)
+{
+    const int i = lowerBound(key);
+    if (i == m_entries.size() || m_entries.at(i).key != key)
+        return;
+
+    Entry &entry = m_entries[i];
+    if (--entry.count <= 0) {
+        m_entries.remove(i);
+        m_ranks.remove(i);
+    } else {
+        m_ranks[i] = rank(entry);
+    }
+}
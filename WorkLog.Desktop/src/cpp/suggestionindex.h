@@ -0,0 +1,68 @@
+#ifndef SUGGESTIONINDEX_H
+#define SUGGESTIONINDEX_H
+
+#include <QDate>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Prefix completion over the texts of one session field. Texts are
+// deduplicated case-insensitively into a table sorted by that folded key,
+// so the matches for a prefix are one contiguous range found by two
+// binary searches. Each entry carries a rank that weighs how often the
+// text was used against how recently: log2(uses) + day / HalfLifeDays,
+// i.e. a use counts twice as much for every HalfLifeDays it is newer.
+// The rank does not depend on today's date, so it is computed once per
+// change and a lookup only compares numbers.
+//
+// What each day contributed is remembered, so an edited day can be
+// replaced without reloading the rest. Removing uses lowers the count but
+// keeps the last day, which may then be later than the newest remaining
+// use until the next build.
+class SuggestionIndex
+{
+public:
+    static constexpr double HalfLifeDays = 30.0;
+
+    // Builds the index from each day's texts in one sort; blank texts are
+    // left out
+    static SuggestionIndex build(const QHash<QDate, QStringList> &days);
+
+    // Replaces what the day contributed with texts
+    void setDay(const QDate &date, const QStringList &texts);
+    void clear();
+
+    // Distinct texts
+    int size() const { return m_entries.size(); }
+
+    // Up to limit texts starting with prefix, ignoring case and repeated
+    // whitespace, best first. A text the prefix already matches in full is
+    // not suggested.
+    QStringList complete(const QString &prefix, int limit) const;
+
+private:
+    struct Entry {
+        QString key;
+        // As last written
+        QString text;
+        int count = 0;
+        qint64 lastDay = 0;
+    };
+
+    static QString fold(const QString &text);
+    static double rank(const Entry &entry);
+    // First entry whose key is not less than key
+    int lowerBound(const QString &key) const;
+    // Takes simplified text; returns the entry's key
+    QString addUse(const QString &text, qint64 day);
+    void removeUse(const QString &key);
+
+    QVector<Entry> m_entries;
+    // Rank of each entry, apart so that scanning a range stays in cache
+    QVector<double> m_ranks;
+    // Folded keys each day contributed, shared with the entries
+    QHash<QDate, QStringList> m_days;
+};
+
+#endif // SUGGESTIONINDEX_H
@@ -0,0 +1,172 @@
+#include "suggestionmodel.h"
+#include "databasemanager.h"
+#include "diagnostics.h"
+#include "connectionpool.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+SuggestionModel::SuggestionModel(DatabaseManager *db, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_database(db)
+{
+    connect(m_database, &DatabaseManager::datesChanged, this, &SuggestionModel::onDatesChanged);
+    connect(m_database, &DatabaseManager::dataChanged, this, &SuggestionModel::onDataChanged);
+    connect(m_database, &DatabaseManager::opened, this, &SuggestionModel::refresh);
+    refresh();
+}
+
+int SuggestionModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_suggestions.size();
+}
+
+QVariant SuggestionModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_suggestions.size())
+        return QVariant();
+
+    switch (role) {
+    case TextRole:
+    case Qt::DisplayRole:
+        return m_suggestions.at(index.row());
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> SuggestionModel::roleNames() const
+{
+    return {
+        {TextRole, "text"}
+    };
+}
+
+void SuggestionModel::complete(Field field, const QString &prefix)
+{
+    const SuggestionIndex &index = field == NextPlannedStage ? m_nextStages : m_descriptions;
+    setSuggestions(index.complete(prefix, MaxSuggestions));
+}
+
+void SuggestionModel::clear()
+{
+    setSuggestions(QStringList());
+}
+
+QString SuggestionModel::get(int index) const
+{
+    return m_suggestions.value(index);
+}
+
+void SuggestionModel::setSuggestions(const QStringList &suggestions)
+{
+    if (suggestions == m_suggestions)
+        return;
+
+    const bool resized = suggestions.size() != m_suggestions.size();
+    beginResetModel();
+    m_suggestions = suggestions;
+    endResetModel();
+    if (resized)
+        emit countChanged();
+}
+
+void SuggestionModel::refresh()
+{
+    const quint64 generation = ++m_refreshGeneration;
+    if (!m_database->isOpen()) {
+        m_descriptions.clear();
+        m_nextStages.clear();
+        m_loading = false;
+        return;
+    }
+
+    // Reading and sorting a long history takes a while; the texts stay
+    // usable (if stale) until the new indexes replace them
+    m_loading = true;
+    m_changedWhileLoading.clear();
+
+    ConnectionPool::run([this, generation]() {
+        const DiagnosticsTimer timer("model.SuggestionModel.refresh");
+        QHash<QDate, QStringList> descriptions;
+        QHash<QDate, QStringList> nextStages;
+
+        QSqlQuery query(ConnectionPool::reader());
+        query.setForwardOnly(true);
+        if (query.exec(QStringLiteral(R"(
+            SELECT SessionDate, Description, NextPlannedStage
+            FROM main.WorkSessions
+            WHERE IsDeleted = 0
+        )"))) {
+            while (query.next()) {
+                const QDate date = QDate::fromString(query.value(0).toString(), Qt::ISODate);
+                descriptions[date].append(query.value(1).toString());
+                nextStages[date].append(query.value(2).toString());
+            }
+        } else {
+            qWarning() << "Failed to load suggestions:" << query.lastError().text();
+        }
+
+        const SuggestionIndex descriptionIndex = SuggestionIndex::build(descriptions);
+        const SuggestionIndex nextStageIndex = SuggestionIndex::build(nextStages);
+
+        QMetaObject::invokeMethod(this, [this, generation, descriptionIndex, nextStageIndex]() {
+            if (generation != m_refreshGeneration)
+                return;
+
+            m_descriptions = descriptionIndex;
+            m_nextStages = nextStageIndex;
+            m_loading = false;
+
+            const QSet<QDate> changed = m_changedWhileLoading;
+            m_changedWhileLoading.clear();
+            for (const QDate &date : changed)
+                updateDay(date);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void SuggestionModel::updateDay(const QDate &date)
+{
+    QStringList descriptions;
+    QStringList nextStages;
+    const QVariantList sessions = m_database->getSessionsForDate(date);
+    for (const QVariant &value : sessions) {
+        const QVariantMap session = value.toMap();
+        descriptions.append(session.value(QStringLiteral("description")).toString());
+        nextStages.append(session.value(QStringLiteral("nextPlannedStage")).toString());
+    }
+    m_descriptions.setDay(date, descriptions);
+    m_nextStages.setDay(date, nextStages);
+}
+
+void SuggestionModel::onDatesChanged(const QList<QDate> &dates)
+{
+    m_datesHandled = true;
+    if (!m_database->isOpen())
+        return;
+
+    // The day cache was just invalidated for these dates, so this reads
+    // the committed sessions (and leaves them cached for the list)
+    const DiagnosticsTimer timer("model.SuggestionModel.updateDates");
+    for (const QDate &date : dates) {
+        if (!date.isValid())
+            continue;
+        if (m_loading)
+            m_changedWhileLoading.insert(date);
+        updateDay(date);
+    }
+}
+
+void SuggestionModel::onDataChanged()
+{
+    // Changes without dates (import, sync) need everything again
+    if (m_datesHandled) {
+        m_datesHandled = false;
+        return;
+    }
+    refresh();
+}
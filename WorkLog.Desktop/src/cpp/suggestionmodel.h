@@ -0,0 +1,73 @@
+#ifndef SUGGESTIONMODEL_H
+#define SUGGESTIONMODEL_H
+
+#include <QAbstractListModel>
+#include <QDate>
+#include <QSet>
+#include <QStringList>
+
+#include "suggestionindex.h"
+
+class DatabaseManager;
+
+// Completions for the session editor's description and next planned stage,
+// from every earlier session in the live table (archived years are left
+// out). Both indexes are built on a pooled reader when the database opens;
+// after that, edits replace only the days they touched, and changes
+// without dates (import, sync) rebuild them. The rows are the
+// suggestions for the last complete() call.
+class SuggestionModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    enum Field {
+        Description,
+        NextPlannedStage
+    };
+    Q_ENUM(Field)
+
+    enum Roles {
+        TextRole = Qt::UserRole + 1
+    };
+
+    static constexpr int MaxSuggestions = 6;
+
+    explicit SuggestionModel(DatabaseManager *db, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int count() const { return m_suggestions.size(); }
+
+    Q_INVOKABLE void complete(Field field, const QString &prefix);
+    Q_INVOKABLE void clear();
+    Q_INVOKABLE QString get(int index) const;
+    Q_INVOKABLE void refresh();
+
+signals:
+    void countChanged();
+
+private slots:
+    void onDatesChanged(const QList<QDate> &dates);
+    void onDataChanged();
+
+private:
+    void setSuggestions(const QStringList &suggestions);
+    void updateDay(const QDate &date);
+
+    DatabaseManager *m_database;
+    SuggestionIndex m_descriptions;
+    SuggestionIndex m_nextStages;
+    QStringList m_suggestions;
+    quint64 m_refreshGeneration = 0;
+    // Days edited while a build was in flight, applied on top of it
+    QSet<QDate> m_changedWhileLoading;
+    bool m_loading = false;
+    // The dataChanged() that follows datesChanged() is already handled
+    bool m_datesHandled = false;
+};
+
+#endif // SUGGESTIONMODEL_H
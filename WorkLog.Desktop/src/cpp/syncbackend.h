@@ -0,0 +1,114 @@
+#ifndef SYNCBACKEND_H
+#define SYNCBACKEND_H
+
+#include "syncchangeset.h"
+#include "syncdigest.h"
+
+#include <QObject>
+#include <QString>
+
+struct SyncConfig {
+    // "dynamodb" (default) or "directory"
+    QString backend;
+
+    QString awsAccessKeyId;
+    QString awsSecretAccessKey;
+    QString awsRegion;
+    // Optional DynamoDB-compatible endpoint, e.g. http://localhost:8000
+    QString endpoint;
+    QString profileId;
+    QString sessionsTableName;
+    QString tagsTableName;
+    // Compact mode stores compressed changesets in one table instead of
+    // one item per record; meant for self-hosted targets where every
+    // client is configured the same way
+    bool compactPayload = false;
+    QString changesetsTableName;
+    // Digest reconciliation: the item format also keeps per-day, -month
+    // and -year digests on the target so a sync fetches only the days that
+    // differ. Every client must maintain them, which the web app does not.
+    bool digestReconciliation = false;
+
+    // Shared folder used by the directory backend
+    QString syncDirectory;
+
+    bool isDirectory() const {
+        return backend == QLatin1String("directory");
+    }
+
+    bool isValid() const {
+        if (isDirectory())
+            return !syncDirectory.isEmpty() && !profileId.isEmpty();
+        return !awsAccessKeyId.isEmpty() &&
+               !awsSecretAccessKey.isEmpty() &&
+               !profileId.isEmpty();
+    }
+};
+
+// Storage side of a sync. SyncManager owns the merge; a backend only moves
+// records: fetch() delivers everything the target holds, upload() stores
+// the records that changed locally. Both complete asynchronously.
+class SyncBackend : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SyncBackend(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+    // Changeset-based targets fold their history into a single changeset
+    // once this many have accumulated
+    static constexpr int CompactionThreshold = 16;
+
+    virtual void testConnection() = 0;
+
+    // Emits tagsReceived/sessionsReceived one or more times, then fetchFinished.
+    // Targets that fetch tags apart from sessions emit tagsFetched once the
+    // last tag is in, so tags can merge while sessions still arrive.
+    virtual void fetch() = 0;
+    // Emits uploadFinished once every record is stored
+    virtual void upload(const SyncChangeset &changes) = 0;
+    // Drops the fetch and upload in flight; they report nothing further
+    virtual void abort() = 0;
+    // Whether upload() may run while a fetch() is still in flight, each
+    // then finishing on its own
+    virtual bool canUploadDuringFetch() const { return false; }
+
+    // Digest reconciliation, for targets that keep a SyncDigestTree of
+    // their own. Given the local tree before fetch(), the target delivers
+    // only the sessions of the days whose digests differ and names those
+    // days with fetchScope() before fetchFinished. Without a fetchScope()
+    // the fetch was complete; verify forces that. Given the merged tree
+    // before upload(), the target stores its digests once the upload
+    // succeeds. Targets without digests ignore both.
+    virtual void reconcileWith(const SyncDigestTree &local, bool verify)
+    {
+        Q_UNUSED(local)
+        Q_UNUSED(verify)
+    }
+    virtual void publishDigests(const SyncDigestTree &merged)
+    {
+        Q_UNUSED(merged)
+    }
+
+signals:
+    void connectionTested(bool success, const QString &message);
+    void tagsReceived(const QVector<SyncTagRecord> &tags);
+    void tagsFetched();
+    void sessionsReceived(const QVector<SyncSessionRecord> &sessions);
+    void fetchScope(const QStringList &days);
+    void fetchFinished(bool success, const QString &errorMessage);
+    void uploadFinished(bool success, const QString &errorMessage);
+
+    // Progress: bytes moved since the last emission, and the running count
+    // of records stored by the current upload
+    void bytesTransferred(qint64 bytes);
+    void uploadProgress(int recordsStored);
+    // One uploaded record (identified by CloudId and clock) is durably
+    // stored, or superseded by a newer version already on the target
+    void recordStored(const QString &cloudId, qint64 hlc);
+};
+
+#endif // SYNCBACKEND_H
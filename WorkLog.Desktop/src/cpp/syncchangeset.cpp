@@ -0,0 +1,195 @@
+#include "syncchangeset.h"
+#include "hybridclock.h"
+
+#include <QCborArray>
+#include <QCborStreamWriter>
+#include <QCborValue>
+#include <QDateTime>
+#include <QHash>
+#include <QUuid>
+
+namespace {
+
+constexpr char Magic[] = {'W', 'L', 'C', 'S'};
+// Version 2 appends the hybrid logical clock to every record
+constexpr qint64 FormatVersion = 2;
+constexpr int CompressionLevel = 6;
+
+constexpr int TagFieldCount = 5;
+constexpr int SessionFieldCount = 11;
+constexpr int LegacyTagFieldCount = 4;
+constexpr int LegacySessionFieldCount = 10;
+
+void appendString(QCborStreamWriter &writer, const QString &value)
+{
+    writer.append(QStringView(value));
+}
+
+// Optional text fields are written as null rather than ""
+void appendOptionalString(QCborStreamWriter &writer, const QString &value)
+{
+    if (value.isEmpty())
+        writer.appendNull();
+    else
+        writer.append(QStringView(value));
+}
+
+template <typename Record>
+void foldRecords(QVector<Record> &into, const QVector<Record> &from)
+{
+    QHash<QString, int> indexByCloudId;
+    indexByCloudId.reserve(into.size() + from.size());
+    for (int i = 0; i < into.size(); ++i)
+        indexByCloudId.insert(into.at(i).cloudId, i);
+
+    for (const Record &record : from) {
+        const auto it = indexByCloudId.constFind(record.cloudId);
+        if (it == indexByCloudId.constEnd()) {
+            indexByCloudId.insert(record.cloudId, into.size());
+            into.append(record);
+        } else if (supersedes(record, into.at(it.value()))) {
+            into[it.value()] = record;
+        }
+    }
+}
+
+} // namespace
+
+bool SyncChangeset::isEmpty() const
+{
+    return tags.isEmpty() && sessions.isEmpty();
+}
+
+int SyncChangeset::recordCount() const
+{
+    return tags.size() + sessions.size();
+}
+
+void SyncChangeset::merge(const SyncChangeset &other)
+{
+    foldRecords(tags, other.tags);
+    foldRecords(sessions, other.sessions);
+}
+
+QString SyncChangeset::newChangesetId()
+{
+    return QDateTime::currentDateTimeUtc().toString(QStringLiteral("yyyyMMddTHHmmsszzz"))
+        + QLatin1Char('-') + QUuid::createUuid().toString(QUuid::Id128).left(8);
+}
+
+QByteArray SyncChangeset::encode() const
+{
+    QByteArray cbor;
+    {
+        QCborStreamWriter writer(&cbor);
+        writer.startArray(3);
+        writer.append(FormatVersion);
+
+        writer.startArray(quint64(tags.size()));
+        for (const SyncTagRecord &tag : tags) {
+            writer.startArray(TagFieldCount);
+            appendString(writer, tag.cloudId);
+            appendString(writer, tag.name);
+            appendString(writer, tag.updatedAt);
+            writer.append(tag.isDeleted);
+            writer.append(tag.hlc);
+            writer.endArray();
+        }
+        writer.endArray();
+
+        writer.startArray(quint64(sessions.size()));
+        for (const SyncSessionRecord &session : sessions) {
+            writer.startArray(SessionFieldCount);
+            appendString(writer, session.cloudId);
+            appendString(writer, session.sessionDate);
+            writer.append(session.timeHours);
+            appendString(writer, session.description);
+            appendOptionalString(writer, session.notes);
+            appendOptionalString(writer, session.nextPlannedStage);
+            appendOptionalString(writer, session.tagCloudId);
+            appendString(writer, session.createdAt);
+            appendString(writer, session.updatedAt);
+            writer.append(session.isDeleted);
+            writer.append(session.hlc);
+            writer.endArray();
+        }
+        writer.endArray();
+
+        writer.endArray();
+    }
+
+    QByteArray data(Magic, sizeof(Magic));
+    data.append(qCompress(cbor, CompressionLevel));
+    return data;
+}
+
+bool SyncChangeset::decode(const QByteArray &data, SyncChangeset *changeset, QString *errorString)
+{
+    auto failWith = [errorString](const QString &message) {
+        if (errorString)
+            *errorString = message;
+        return false;
+    };
+
+    if (data.size() <= int(sizeof(Magic)) || !data.startsWith(QByteArray::fromRawData(Magic, sizeof(Magic))))
+        return failWith(QStringLiteral("Not a changeset"));
+
+    const QByteArray cbor = qUncompress(data.mid(sizeof(Magic)));
+    if (cbor.isEmpty())
+        return failWith(QStringLiteral("Changeset is corrupt"));
+
+    QCborParserError parseError;
+    const QCborArray root = QCborValue::fromCbor(cbor, &parseError).toArray();
+    if (parseError.error != QCborError::NoError || root.size() != 3)
+        return failWith(QStringLiteral("Changeset is corrupt: %1").arg(parseError.errorString()));
+
+    const qint64 version = root.at(0).toInteger();
+    if (version != 1 && version != FormatVersion)
+        return failWith(QStringLiteral("Unsupported changeset version %1").arg(version));
+    const bool legacy = version == 1;
+    const int tagFieldCount = legacy ? LegacyTagFieldCount : TagFieldCount;
+    const int sessionFieldCount = legacy ? LegacySessionFieldCount : SessionFieldCount;
+
+    SyncChangeset result;
+
+    const QCborArray tags = root.at(1).toArray();
+    result.tags.reserve(int(tags.size()));
+    for (const QCborValue &value : tags) {
+        const QCborArray fields = value.toArray();
+        if (fields.size() < tagFieldCount)
+            return failWith(QStringLiteral("Changeset has a malformed tag"));
+
+        SyncTagRecord tag;
+        tag.cloudId = fields.at(0).toString();
+        tag.name = fields.at(1).toString();
+        tag.updatedAt = fields.at(2).toString();
+        tag.isDeleted = fields.at(3).toBool();
+        tag.hlc = legacy ? HybridClock::fromTimestamp(tag.updatedAt) : fields.at(4).toInteger();
+        result.tags.append(tag);
+    }
+
+    const QCborArray sessions = root.at(2).toArray();
+    result.sessions.reserve(int(sessions.size()));
+    for (const QCborValue &value : sessions) {
+        const QCborArray fields = value.toArray();
+        if (fields.size() < sessionFieldCount)
+            return failWith(QStringLiteral("Changeset has a malformed session"));
+
+        SyncSessionRecord session;
+        session.cloudId = fields.at(0).toString();
+        session.sessionDate = fields.at(1).toString();
+        session.timeHours = fields.at(2).toDouble();
+        session.description = fields.at(3).toString();
+        session.notes = fields.at(4).toString();
+        session.nextPlannedStage = fields.at(5).toString();
+        session.tagCloudId = fields.at(6).toString();
+        session.createdAt = fields.at(7).toString();
+        session.updatedAt = fields.at(8).toString();
+        session.isDeleted = fields.at(9).toBool();
+        session.hlc = legacy ? HybridClock::fromTimestamp(session.updatedAt) : fields.at(10).toInteger();
+        result.sessions.append(session);
+    }
+
+    *changeset = std::move(result);
+    return true;
+}
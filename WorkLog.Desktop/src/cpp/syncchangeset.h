@@ -0,0 +1,34 @@
+#ifndef SYNCCHANGESET_H
+#define SYNCCHANGESET_H
+
+#include "syncrecords.h"
+
+#include <QByteArray>
+#include <QString>
+
+// A batch of tag and session records in the compact wire format: the
+// "WLCS" magic followed by a zlib-compressed CBOR document in which every
+// record is a positional array, so field names and type wrappers are never
+// repeated per item.
+class SyncChangeset
+{
+public:
+    QVector<SyncTagRecord> tags;
+    QVector<SyncSessionRecord> sessions;
+
+    bool isEmpty() const;
+    int recordCount() const;
+
+    // Folds another changeset in. Per CloudId the record that supersedes
+    // the other wins (see supersedes() in syncrecords.h).
+    void merge(const SyncChangeset &other);
+
+    // Sortable, collision-free id: UTC timestamp plus a random suffix
+    static QString newChangesetId();
+
+    QByteArray encode() const;
+    static bool decode(const QByteArray &data, SyncChangeset *changeset,
+                       QString *errorString = nullptr);
+};
+
+#endif // SYNCCHANGESET_H
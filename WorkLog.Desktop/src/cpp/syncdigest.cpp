@@ -0,0 +1,122 @@
+#include "syncdigest.h"
+
+#include <QCryptographicHash>
+
+#include <algorithm>
+
+namespace {
+
+// Truncated SHA-256; collisions only need to be unlikely, not impossible
+// to construct, and the digests are stored once per period
+constexpr int DigestBytes = 16;
+
+QByteArray hashLines(const QByteArray &lines)
+{
+    return QCryptographicHash::hash(lines, QCryptographicHash::Sha256).left(DigestBytes).toHex();
+}
+
+// Distinct prefixes of the given length among the keys starting with
+// prefix, in order
+QStringList childPeriods(const QMap<QString, QStringList> &entriesByDay,
+                         const QString &prefix, int length)
+{
+    QStringList periods;
+    for (auto it = entriesByDay.lowerBound(prefix);
+         it != entriesByDay.constEnd() && it.key().startsWith(prefix); ++it) {
+        const QString period = it.key().left(length);
+        if (periods.isEmpty() || periods.constLast() != period)
+            periods.append(period);
+    }
+    return periods;
+}
+
+} // namespace
+
+void SyncDigestTree::add(const QString &sessionDate, const QString &cloudId, qint64 hlc)
+{
+    if (cloudId.isEmpty() || sessionDate.size() != 10)
+        return;
+    m_entriesByDay[sessionDate].append(entry(cloudId, hlc));
+}
+
+void SyncDigestTree::computeDigests()
+{
+    m_digests.clear();
+
+    QByteArray monthLines;
+    QByteArray yearLines;
+    QString month;
+    QString year;
+
+    auto closeMonth = [&]() {
+        if (month.isEmpty())
+            return;
+        const QByteArray digest = hashLines(monthLines);
+        m_digests.insert(month, digest);
+        yearLines += month.toLatin1() + ' ' + digest + '\n';
+        monthLines.clear();
+    };
+    auto closeYear = [&]() {
+        if (year.isEmpty())
+            return;
+        m_digests.insert(year, hashLines(yearLines));
+        yearLines.clear();
+    };
+
+    // Days come in date order, so each month and year closes once
+    for (auto it = m_entriesByDay.begin(); it != m_entriesByDay.end(); ++it) {
+        QStringList &entries = it.value();
+        std::sort(entries.begin(), entries.end());
+
+        const QString &day = it.key();
+        if (day.left(7) != month) {
+            closeMonth();
+            month = day.left(7);
+        }
+        if (day.left(4) != year) {
+            closeYear();
+            year = day.left(4);
+        }
+
+        const QByteArray digest = hashLines(entries.join(QLatin1Char('\n')).toUtf8());
+        m_digests.insert(day, digest);
+        monthLines += day.toLatin1() + ' ' + digest + '\n';
+    }
+    closeMonth();
+    closeYear();
+}
+
+QByteArray SyncDigestTree::digest(const QString &period) const
+{
+    return m_digests.value(period);
+}
+
+QStringList SyncDigestTree::entries(const QString &day) const
+{
+    return m_entriesByDay.value(day);
+}
+
+QStringList SyncDigestTree::years() const
+{
+    return childPeriods(m_entriesByDay, QString(), 4);
+}
+
+QStringList SyncDigestTree::months(const QString &year) const
+{
+    return childPeriods(m_entriesByDay, year + QLatin1Char('-'), 7);
+}
+
+QStringList SyncDigestTree::days(const QString &month) const
+{
+    return childPeriods(m_entriesByDay, month + QLatin1Char('-'), 10);
+}
+
+QString SyncDigestTree::entry(const QString &cloudId, qint64 hlc)
+{
+    return cloudId + QLatin1Char('@') + QString::number(hlc);
+}
+
+QString SyncDigestTree::cloudIdOfEntry(const QString &entry)
+{
+    return entry.left(entry.lastIndexOf(QLatin1Char('@')));
+}
@@ -0,0 +1,47 @@
+#ifndef SYNCDIGEST_H
+#define SYNCDIGEST_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+// Hash tree over the sessions one replica holds. A day's digest covers the
+// CloudId and clock of every session on it (tombstones included), a
+// month's the digests of its days and a year's those of its months. Two
+// replicas whose digests for a period agree hold the same versions of the
+// same sessions there, so comparing the years and descending only into
+// what differs finds every divergent day in a handful of lookups.
+//
+// Periods are named by their ISO date prefix: "2024", "2024-03" and
+// "2024-03-15". Sessions without a CloudId have no counterpart on the
+// target yet and are left out.
+class SyncDigestTree
+{
+public:
+    void add(const QString &sessionDate, const QString &cloudId, qint64 hlc);
+    // Must follow the last add() and precede any digest()
+    void computeDigests();
+
+    bool isEmpty() const { return m_entriesByDay.isEmpty(); }
+
+    // 32 hex digits, or empty for a period without sessions
+    QByteArray digest(const QString &period) const;
+    // "<CloudId>@<Hlc>" of each session on the day, sorted
+    QStringList entries(const QString &day) const;
+
+    QStringList years() const;
+    QStringList months(const QString &year) const;
+    QStringList days(const QString &month) const;
+
+    static QString entry(const QString &cloudId, qint64 hlc);
+    // The CloudId an entry names
+    static QString cloudIdOfEntry(const QString &entry);
+
+private:
+    QMap<QString, QStringList> m_entriesByDay;
+    QHash<QString, QByteArray> m_digests;
+};
+
+#endif // SYNCDIGEST_H
@@ -1,29 +1,107 @@
 #include "syncmanager.h"
 #include "databasemanager.h"
+#include "diagnostics.h"
+#include "hybridclock.h"
+#include "yeararchive.h"
+#include "directorysyncbackend.h"
+#include "dynamodbbackend.h"
 
 #include <QStandardPaths>
 #include <QDir>
 #include <QFile>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QJsonArray>
-#include <QNetworkRequest>
-#include <QMessageAuthenticationCode>
+#include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QUuid>
+#include <QHash>
 #include <QDebug>
 
 SyncManager::SyncManager(DatabaseManager *db, QObject *parent)
     : QObject(parent)
     , m_database(db)
-    , m_networkManager(new QNetworkAccessManager(this))
 {
-    connect(m_networkManager, &QNetworkAccessManager::finished,
-            this, &SyncManager::onSyncRequestFinished);
     loadConfiguration();
+    connect(m_database, &DatabaseManager::batchFinished, this, &SyncManager::onBatchFinished,
+            Qt::QueuedConnection);
 }
 
+namespace {
+
+// Minimum delay between two progress notifications
+constexpr qint64 ProgressIntervalMs = 100;
+
+// Confirmed outbox entries are deleted in transactions of this many
+constexpr int OutboxFlushBatch = 100;
+
+// Identifies one version of a record; replaying it is harmless
+QString idempotencyKey(const QString &cloudId, qint64 hlc)
+{
+    return cloudId + QLatin1Char('@') + QString::number(hlc);
+}
+
+// DirtyField bits of the fields in which two versions of a session differ
+int differingFields(const SyncSessionRecord &a, const SyncSessionRecord &b)
+{
+    int fields = 0;
+    if (a.sessionDate != b.sessionDate)
+        fields |= SyncSessionRecord::DateDirty;
+    if (a.timeHours != b.timeHours)
+        fields |= SyncSessionRecord::HoursDirty;
+    if (a.description != b.description)
+        fields |= SyncSessionRecord::DescriptionDirty;
+    if (a.notes != b.notes)
+        fields |= SyncSessionRecord::NotesDirty;
+    if (a.nextPlannedStage != b.nextPlannedStage)
+        fields |= SyncSessionRecord::NextStageDirty;
+    if (a.tagCloudId != b.tagCloudId)
+        fields |= SyncSessionRecord::TagDirty;
+    return fields;
+}
+
+// In the order tagFromRow() reads them
+constexpr char TagColumns[] = "Id, Name, CloudId, UpdatedAt, IsDeleted, Hlc";
+
+SyncTagRecord tagFromRow(const QSqlQuery &query)
+{
+    SyncTagRecord tag;
+    tag.localId = query.value(0).toLongLong();
+    tag.name = query.value(1).toString();
+    tag.cloudId = query.value(2).toString();
+    tag.updatedAt = query.value(3).toString();
+    tag.isDeleted = query.value(4).toBool();
+    tag.hlc = query.value(5).toLongLong();
+    return tag;
+}
+
+// In the order sessionFromRow() reads them
+constexpr char SessionColumns[] =
+    "Id, SessionDate, TimeHours, Description, Notes, NextPlannedStage, "
+    "CreatedAt, UpdatedAt, CloudId, IsDeleted, TagCloudId, Hlc, DirtyFields, TagId";
+
+SyncSessionRecord sessionFromRow(const QSqlQuery &query)
+{
+    SyncSessionRecord session;
+    session.localId = query.value(0).toLongLong();
+    session.sessionDate = query.value(1).toString();
+    session.timeHours = query.value(2).toDouble();
+    session.description = query.value(3).toString();
+    session.notes = query.value(4).toString();
+    session.nextPlannedStage = query.value(5).toString();
+    session.createdAt = query.value(6).toString();
+    session.updatedAt = query.value(7).toString();
+    session.cloudId = query.value(8).toString();
+    session.isDeleted = query.value(9).toBool();
+    session.tagCloudId = query.value(10).toString();
+    session.hlc = query.value(11).toLongLong();
+    session.dirtyFields = query.value(12).toInt();
+    session.tagId = query.value(13).toLongLong();
+    return session;
+}
+
+} // namespace
+
 QString SyncManager::configFilePath() const
 {
     QString configPath = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation);
@@ -39,10 +117,15 @@ void SyncManager::loadConfiguration()
     // Set defaults first
     m_config.sessionsTableName = QStringLiteral("WorkLog_Sessions");
     m_config.tagsTableName = QStringLiteral("WorkLog_Tags");
+    m_config.changesetsTableName = QStringLiteral("WorkLog_Changesets");
+    m_config.compactPayload = false;
+    m_config.digestReconciliation = false;
     m_config.awsRegion = QStringLiteral("us-east-1");
+    m_config.backend = QStringLiteral("dynamodb");
 
     QFile file(configFilePath());
     if (!file.open(QIODevice::ReadOnly)) {
+        createBackend();
         return;
     }
 
@@ -63,7 +146,19 @@ void SyncManager::loadConfiguration()
     if (obj.contains(QStringLiteral("TagsTableName")) && !obj[QStringLiteral("TagsTableName")].toString().isEmpty()) {
         m_config.tagsTableName = obj[QStringLiteral("TagsTableName")].toString();
     }
+    if (obj.contains(QStringLiteral("ChangesetsTableName")) && !obj[QStringLiteral("ChangesetsTableName")].toString().isEmpty()) {
+        m_config.changesetsTableName = obj[QStringLiteral("ChangesetsTableName")].toString();
+    }
+    m_config.compactPayload = obj[QStringLiteral("PayloadFormat")].toString() == QLatin1String("compact");
+    m_config.digestReconciliation = obj[QStringLiteral("Reconciliation")].toString() == QLatin1String("digests");
+
+    if (obj[QStringLiteral("Backend")].toString() == QLatin1String("directory")) {
+        m_config.backend = QStringLiteral("directory");
+    }
+    m_config.syncDirectory = obj[QStringLiteral("SyncDirectory")].toString();
+    m_config.endpoint = obj[QStringLiteral("Endpoint")].toString();
 
+    createBackend();
     emit configurationChanged();
 }
 
@@ -79,23 +174,87 @@ void SyncManager::saveConfiguration(const QString &accessKeyId,
     }
     m_config.awsRegion = region.isEmpty() ? QStringLiteral("us-east-1") : region;
     m_config.profileId = profileId;
+    m_config.backend = QStringLiteral("dynamodb");
+
+    writeConfiguration();
+}
 
+void SyncManager::saveDirectoryConfiguration(const QString &directory,
+                                             const QString &profileId)
+{
+    m_config.syncDirectory = QDir::cleanPath(directory);
+    m_config.profileId = profileId;
+    m_config.backend = QStringLiteral("directory");
+
+    writeConfiguration();
+}
+
+void SyncManager::writeConfiguration()
+{
     QJsonObject obj;
+    obj[QStringLiteral("Backend")] = m_config.backend;
     obj[QStringLiteral("AwsAccessKeyId")] = m_config.awsAccessKeyId;
     obj[QStringLiteral("AwsSecretAccessKey")] = m_config.awsSecretAccessKey;
     obj[QStringLiteral("AwsRegion")] = m_config.awsRegion;
     obj[QStringLiteral("ProfileId")] = m_config.profileId;
     obj[QStringLiteral("SessionsTableName")] = m_config.sessionsTableName;
     obj[QStringLiteral("TagsTableName")] = m_config.tagsTableName;
+    obj[QStringLiteral("ChangesetsTableName")] = m_config.changesetsTableName;
+    obj[QStringLiteral("PayloadFormat")] = m_config.compactPayload ? QStringLiteral("compact") : QStringLiteral("items");
+    obj[QStringLiteral("Reconciliation")] = m_config.digestReconciliation ? QStringLiteral("digests") : QStringLiteral("full");
+    if (!m_config.endpoint.isEmpty())
+        obj[QStringLiteral("Endpoint")] = m_config.endpoint;
+    if (!m_config.syncDirectory.isEmpty())
+        obj[QStringLiteral("SyncDirectory")] = m_config.syncDirectory;
 
     QFile file(configFilePath());
     if (file.open(QIODevice::WriteOnly)) {
         file.write(QJsonDocument(obj).toJson(QJsonDocument::Indented));
     }
 
+    createBackend();
     emit configurationChanged();
 }
 
+void SyncManager::createBackend()
+{
+    if (m_backend) {
+        m_backend->disconnect(this);
+        m_backend->deleteLater();
+        if (m_isSyncing) {
+            // The old target will never report back
+            m_currentResult.errorMessage = tr("Sync target changed");
+            finishSync();
+        }
+    }
+
+    if (m_config.isDirectory())
+        m_backend = new DirectorySyncBackend(m_config, this);
+    else
+        m_backend = new DynamoDbBackend(m_config, this);
+
+    connect(m_backend, &SyncBackend::connectionTested,
+            this, &SyncManager::connectionTestCompleted);
+    connect(m_backend, &SyncBackend::tagsReceived,
+            this, &SyncManager::onTagsReceived);
+    connect(m_backend, &SyncBackend::tagsFetched,
+            this, &SyncManager::onTagsFetched);
+    connect(m_backend, &SyncBackend::sessionsReceived,
+            this, &SyncManager::onSessionsReceived);
+    connect(m_backend, &SyncBackend::fetchScope,
+            this, &SyncManager::onFetchScope);
+    connect(m_backend, &SyncBackend::fetchFinished,
+            this, &SyncManager::onFetchFinished);
+    connect(m_backend, &SyncBackend::uploadFinished,
+            this, &SyncManager::onUploadFinished);
+    connect(m_backend, &SyncBackend::bytesTransferred,
+            this, &SyncManager::onBytesTransferred);
+    connect(m_backend, &SyncBackend::uploadProgress,
+            this, &SyncManager::onUploadProgress);
+    connect(m_backend, &SyncBackend::recordStored,
+            this, &SyncManager::onRecordStored);
+}
+
 bool SyncManager::isConfigured() const
 {
     return m_config.isValid();
@@ -116,6 +275,16 @@ QString SyncManager::lastSyncTime() const
     return QString();
 }
 
+QString SyncManager::getBackend() const
+{
+    return m_config.backend;
+}
+
+QString SyncManager::getSyncDirectory() const
+{
+    return m_config.syncDirectory;
+}
+
 QString SyncManager::getProfileId() const
 {
     return m_config.profileId;
@@ -137,6 +306,16 @@ bool SyncManager::hasSecretKey() const
 }
 
 void SyncManager::sync()
+{
+    startSync(false);
+}
+
+void SyncManager::verify()
+{
+    startSync(true);
+}
+
+void SyncManager::startSync(bool verify)
 {
     if (m_isSyncing) {
         emit errorOccurred(tr("Sync already in progress"));
@@ -149,554 +328,839 @@ void SyncManager::sync()
     }
 
     m_isSyncing = true;
+    m_verify = verify;
     emit syncingChanged();
 
-    m_currentResult = SyncResult();
-    m_pendingRequests = 0;
-    m_tagsDownloaded = false;
-    m_sessionsDownloaded = false;
-    m_cloudTags = QJsonArray();
-    m_cloudSessions = QJsonArray();
-
-    // Load local data
-    m_localTags.clear();
-    m_localSessions.clear();
+    m_syncTraceId = Tracer::nextAsyncId();
+    Tracer::asyncBegin(QByteArrayLiteral("sync.run"), m_syncTraceId);
 
-    QSqlQuery tagQuery;
-    tagQuery.exec(QStringLiteral("SELECT Id, Name, CloudId, UpdatedAt, IsDeleted FROM Tags"));
-    while (tagQuery.next()) {
-        QVariantMap tag;
-        tag[QStringLiteral("id")] = tagQuery.value(0);
-        tag[QStringLiteral("name")] = tagQuery.value(1);
-        tag[QStringLiteral("cloudId")] = tagQuery.value(2);
-        tag[QStringLiteral("updatedAt")] = tagQuery.value(3);
-        tag[QStringLiteral("isDeleted")] = tagQuery.value(4).toBool();
-        m_localTags.append(tag);
-    }
-
-    QSqlQuery sessionQuery;
-    sessionQuery.exec(QStringLiteral(R"(
-        SELECT Id, SessionDate, TimeHours, Description, Notes, NextPlannedStage,
-               TagId, CreatedAt, UpdatedAt, CloudId, IsDeleted, TagCloudId
-        FROM WorkSessions
-    )"));
-    while (sessionQuery.next()) {
-        QVariantMap session;
-        session[QStringLiteral("id")] = sessionQuery.value(0);
-        session[QStringLiteral("sessionDate")] = sessionQuery.value(1);
-        session[QStringLiteral("timeHours")] = sessionQuery.value(2);
-        session[QStringLiteral("description")] = sessionQuery.value(3);
-        session[QStringLiteral("notes")] = sessionQuery.value(4);
-        session[QStringLiteral("nextPlannedStage")] = sessionQuery.value(5);
-        session[QStringLiteral("tagId")] = sessionQuery.value(6);
-        session[QStringLiteral("createdAt")] = sessionQuery.value(7);
-        session[QStringLiteral("updatedAt")] = sessionQuery.value(8);
-        session[QStringLiteral("cloudId")] = sessionQuery.value(9);
-        session[QStringLiteral("isDeleted")] = sessionQuery.value(10).toBool();
-        session[QStringLiteral("tagCloudId")] = sessionQuery.value(11);
-        m_localSessions.append(session);
+    m_currentResult = SyncResult();
+    m_cloudTags.clear();
+    m_cloudSessions.clear();
+    m_outgoing = SyncChangeset();
+    m_bytesTransferred = 0;
+    m_storedKeys.clear();
+
+    // Records a cancelled or crashed run queued but never got confirmed
+    // go first, so the fetch sees them on the target
+    const SyncChangeset pending = loadOutbox();
+    if (!pending.isEmpty()) {
+        m_stage = Stage::Resuming;
+        m_currentResult.tagsUploaded += pending.tags.size();
+        m_currentResult.sessionsUploaded += pending.sessions.size();
+        setPhase(tr("Resuming upload"), pending.recordCount());
+        m_backend->upload(pending);
+        return;
     }
 
-    // Start by querying cloud data
-    queryTable(m_config.tagsTableName, QStringLiteral("tags"));
-    queryTable(m_config.sessionsTableName, QStringLiteral("sessions"));
+    startFetch();
 }
 
-void SyncManager::testConnection()
+void SyncManager::startFetch()
 {
-    if (!isConfigured()) {
-        emit connectionTestCompleted(false, tr("Sync not configured"));
+    if (waitForBatch(&SyncManager::startFetch))
+        return;
+
+    // Archived sessions are read as they are; only ones still to be
+    // uploaded need their year back in the hot table
+    if (!m_database->restoreArchivedYears(QStringLiteral("CloudId IS NULL OR DirtyFields != 0"))) {
+        m_currentResult.errorMessage = tr("Failed to restore archived sessions");
+        finishSync();
         return;
     }
 
-    // Try to describe the sessions table
-    QString host = QStringLiteral("dynamodb.%1.amazonaws.com").arg(m_config.awsRegion);
-    QUrl url(QStringLiteral("https://%1").arg(host));
-    QDateTime timestamp = QDateTime::currentDateTimeUtc();
-    QString amzTarget = QStringLiteral("DynamoDB_20120810.DescribeTable");
+    // Load local data. A session missed here would come back from the
+    // cloud as a duplicate.
+    loadLocalTags();
+    if (!loadLocalSessions()) {
+        finishSync();
+        return;
+    }
 
-    QJsonObject payload;
-    payload[QStringLiteral("TableName")] = m_config.sessionsTableName;
-    QByteArray payloadBytes = QJsonDocument(payload).toJson(QJsonDocument::Compact);
+    m_stage = Stage::Fetching;
+    m_pipeline = Pipeline();
+    m_cloudTags.clear();
+    m_cloudSessions.clear();
+    m_mergedCloudSessions = 0;
+    m_queuedTagIds.clear();
+    m_queuedSessionIds.clear();
+
+    m_scoped = false;
+    m_fetchScope.clear();
+    if (m_config.digestReconciliation) {
+        const DiagnosticsTimer timer("sync.digests.local");
+        SyncDigestTree local;
+        for (const SyncSessionRecord &session : qAsConst(m_localSessions))
+            local.add(session.sessionDate, session.cloudId, session.hlc);
+        local.computeDigests();
+        m_backend->reconcileWith(local, m_verify);
+    }
 
-    QNetworkRequest request(url);
-    request.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/x-amz-json-1.0"));
-    request.setRawHeader("X-Amz-Target", amzTarget.toLatin1());
-    request.setRawHeader("X-Amz-Date", timestamp.toString(QStringLiteral("yyyyMMddTHHmmssZ")).toLatin1());
-    request.setRawHeader("Host", host.toLatin1());
+    // Fetch the remote state; its size is not known up front
+    setPhase(tr("Downloading"), 0);
+    m_backend->fetch();
 
-    QString authHeader = signRequest(QStringLiteral("POST"), QStringLiteral("dynamodb"),
-                                     host, QStringLiteral("/"), QString::fromUtf8(payloadBytes), timestamp, amzTarget);
-    request.setRawHeader("Authorization", authHeader.toLatin1());
-    request.setAttribute(QNetworkRequest::User, QStringLiteral("test"));
+    if (m_backend->canUploadDuringFetch())
+        startEarlyUpload();
+}
 
-    m_networkManager->post(request, payloadBytes);
+void SyncManager::startEarlyUpload()
+{
+    if (waitForBatch(&SyncManager::startEarlyUpload))
+        return;
+    if (!runStage([this]() { return assignNewRecords(); })) {
+        failRun();
+        return;
+    }
+    m_pipeline.newRecordsQueued = true;
+
+    // A resumed upload has emptied the outbox, so it holds just these
+    const SyncChangeset early = loadOutbox();
+    if (early.isEmpty())
+        return;
+    m_pipeline.earlyUpload = true;
+    m_backend->upload(early);
 }
 
-void SyncManager::queryTable(const QString &tableName, const QString &operation)
+void SyncManager::advance()
 {
-    QString host = QStringLiteral("dynamodb.%1.amazonaws.com").arg(m_config.awsRegion);
-    QUrl url(QStringLiteral("https://%1").arg(host));
-    QDateTime timestamp = QDateTime::currentDateTimeUtc();
-    QString amzTarget = QStringLiteral("DynamoDB_20120810.Query");
+    // A stage that failed may have ended the run from within a signal
+    if (m_stage != Stage::Fetching || waitForBatch(&SyncManager::advance))
+        return;
 
-    QJsonObject payload;
-    payload[QStringLiteral("TableName")] = tableName;
-    payload[QStringLiteral("KeyConditionExpression")] = QStringLiteral("ProfileId = :profileId");
+    // Tags first: merged session rows resolve their tag through them
+    if (!m_pipeline.tagsMerged) {
+        if (!m_pipeline.tagsFetched && !m_pipeline.fetchDone)
+            return;
+        if (!runStage([this]() { return syncTags(); })) {
+            failRun();
+            return;
+        }
+        m_pipeline.tagsMerged = true;
+    }
 
-    QJsonObject expressionValues;
-    QJsonObject profileIdValue;
-    profileIdValue[QStringLiteral("S")] = m_config.profileId;
-    expressionValues[QStringLiteral(":profileId")] = profileIdValue;
-    payload[QStringLiteral("ExpressionAttributeValues")] = expressionValues;
+    if (m_mergedCloudSessions < m_cloudSessions.size()) {
+        if (!runStage([this]() { return mergeCloudSessions(); })) {
+            failRun();
+            return;
+        }
+    }
 
-    QByteArray payloadBytes = QJsonDocument(payload).toJson(QJsonDocument::Compact);
+    if (!m_pipeline.fetchDone)
+        return;
+
+    if (!m_pipeline.merged) {
+        setPhase(tr("Merging"), m_localSessions.size());
+        if (!runStage([this]() {
+                return (m_pipeline.newRecordsQueued || assignNewRecords()) && queueLocalSessions();
+            })) {
+            failRun();
+            return;
+        }
+        m_pipeline.merged = true;
+        m_cloudTags.clear();
+        m_cloudSessions.clear();
+        m_mergedCloudSessions = 0;
+
+        if (m_config.digestReconciliation) {
+            SyncDigestTree merged;
+            if (!loadDigestTree(&merged)) {
+                failRun();
+                return;
+            }
+            m_backend->publishDigests(merged);
+        }
+    }
+
+    // Reading the outbox waits for the early upload, whose entries would
+    // otherwise go twice
+    if (m_pipeline.earlyUpload)
+        return;
 
-    QNetworkRequest request(url);
-    request.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/x-amz-json-1.0"));
-    request.setRawHeader("X-Amz-Target", amzTarget.toLatin1());
-    request.setRawHeader("X-Amz-Date", timestamp.toString(QStringLiteral("yyyyMMddTHHmmssZ")).toLatin1());
-    request.setRawHeader("Host", host.toLatin1());
+    const SyncChangeset outgoing = loadOutbox();
+    m_stage = Stage::Uploading;
+    setPhase(tr("Uploading"), outgoing.recordCount());
+    m_backend->upload(outgoing);
+}
 
-    QString authHeader = signRequest(QStringLiteral("POST"), QStringLiteral("dynamodb"),
-                                     host, QStringLiteral("/"), QString::fromUtf8(payloadBytes), timestamp, amzTarget);
-    request.setRawHeader("Authorization", authHeader.toLatin1());
+bool SyncManager::runStage(const std::function<bool()> &stage)
+{
+    // All local writes of a stage commit together or not at all. Callers
+    // wait for a batch the UI has open, so this one is the outermost.
+    if (!m_database->beginBatch()) {
+        m_currentResult.errorMessage = QSqlDatabase::database().lastError().text();
+        return false;
+    }
+    const bool done = stage() && enqueueOutgoing();
+    m_outgoing = SyncChangeset();
+    if (!done)
+        m_database->rollbackBatch();
+    else if (m_database->commitBatch())
+        return true;
+
+    if (m_currentResult.errorMessage.isEmpty())
+        m_currentResult.errorMessage = QSqlDatabase::database().lastError().text();
+    return false;
+}
 
-    request.setAttribute(QNetworkRequest::User, operation);
-    m_pendingRequests++;
+bool SyncManager::waitForBatch(void (SyncManager::*step)())
+{
+    if (!m_database->inBatch())
+        return false;
+    if (!m_afterBatch.contains(step))
+        m_afterBatch.append(step);
+    return true;
+}
 
-    m_networkManager->post(request, payloadBytes);
+void SyncManager::onBatchFinished()
+{
+    flushStoredKeys();
+
+    const QVector<void (SyncManager::*)()> steps = m_afterBatch;
+    m_afterBatch.clear();
+    for (auto step : steps) {
+        if (!m_isSyncing)
+            break;
+        (this->*step)();
+    }
 }
 
-void SyncManager::putItem(const QString &tableName, const QJsonObject &item)
+void SyncManager::failRun()
 {
-    QString host = QStringLiteral("dynamodb.%1.amazonaws.com").arg(m_config.awsRegion);
-    QUrl url(QStringLiteral("https://%1").arg(host));
-    QDateTime timestamp = QDateTime::currentDateTimeUtc();
-    QString amzTarget = QStringLiteral("DynamoDB_20120810.PutItem");
+    // A fetch and the early upload may both still be running
+    m_backend->abort();
+    finishSync();
+}
 
-    QJsonObject payload;
-    payload[QStringLiteral("TableName")] = tableName;
-    payload[QStringLiteral("Item")] = item;
+void SyncManager::cancel()
+{
+    if (!m_isSyncing)
+        return;
 
-    QByteArray payloadBytes = QJsonDocument(payload).toJson(QJsonDocument::Compact);
+    // Each merge stage runs to completion within one event, so a cancel
+    // lands between stages: what merged so far stays, and the records not
+    // yet confirmed stay in the outbox and go next time
+    m_backend->abort();
+    m_currentResult.cancelled = true;
+    finishSync();
+}
 
-    QNetworkRequest request(url);
-    request.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/x-amz-json-1.0"));
-    request.setRawHeader("X-Amz-Target", amzTarget.toLatin1());
-    request.setRawHeader("X-Amz-Date", timestamp.toString(QStringLiteral("yyyyMMddTHHmmssZ")).toLatin1());
-    request.setRawHeader("Host", host.toLatin1());
+void SyncManager::loadLocalTags()
+{
+    m_localTags.clear();
 
-    QString authHeader = signRequest(QStringLiteral("POST"), QStringLiteral("dynamodb"),
-                                     host, QStringLiteral("/"), QString::fromUtf8(payloadBytes), timestamp, amzTarget);
-    request.setRawHeader("Authorization", authHeader.toLatin1());
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.exec(QStringLiteral("SELECT %1 FROM Tags").arg(QLatin1String(TagColumns)));
+    while (query.next())
+        m_localTags.append(tagFromRow(query));
+}
 
-    request.setAttribute(QNetworkRequest::User, QStringLiteral("put"));
-    m_pendingRequests++;
+bool SyncManager::reloadLocalTag(int index)
+{
+    QSqlQuery query;
+    query.prepare(QStringLiteral("SELECT %1 FROM Tags WHERE Id = :id").arg(QLatin1String(TagColumns)));
+    query.bindValue(QStringLiteral(":id"), m_localTags.at(index).localId);
+    if (!query.exec())
+        return failMerge(query);
+    if (query.next())
+        m_localTags[index] = tagFromRow(query);
+    return true;
+}
 
-    m_networkManager->post(request, payloadBytes);
+bool SyncManager::reloadLocalSession(int index, bool *found)
+{
+    QSqlQuery query;
+    query.prepare(QStringLiteral("SELECT %1 FROM main.WorkSessions WHERE Id = :id").arg(QLatin1String(SessionColumns)));
+    query.bindValue(QStringLiteral(":id"), m_localSessions.at(index).localId);
+    if (!query.exec())
+        return failMerge(query);
+    *found = query.next();
+    if (*found)
+        m_localSessions[index] = sessionFromRow(query);
+    return true;
 }
 
-void SyncManager::onSyncRequestFinished(QNetworkReply *reply)
+bool SyncManager::loadLocalSessions()
 {
-    QString operation = reply->request().attribute(QNetworkRequest::User).toString();
-    QByteArray responseData = reply->readAll();
+    m_localSessions.clear();
+    m_localSessionIndex.clear();
 
-    if (reply->error() != QNetworkReply::NoError) {
-        QString errorMsg = reply->errorString();
-        qWarning() << "Sync request failed:" << errorMsg << responseData;
+    auto add = [this](const QSqlQuery &query) {
+        const SyncSessionRecord session = sessionFromRow(query);
+        if (!session.cloudId.isEmpty())
+            m_localSessionIndex.insert(session.cloudId, m_localSessions.size());
+        m_localSessions.append(session);
+        return true;
+    };
 
-        if (operation == QStringLiteral("test")) {
-            emit connectionTestCompleted(false, tr("Connection failed: %1").arg(errorMsg));
-        } else {
-            m_currentResult.success = false;
-            m_currentResult.errorMessage = errorMsg;
-            m_pendingRequests--;
-            if (m_pendingRequests <= 0) {
-                finishSync();
-            }
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!query.exec(QStringLiteral("SELECT %1 FROM WorkSessions").arg(QLatin1String(SessionColumns)))) {
+        m_currentResult.errorMessage = query.lastError().text();
+        return false;
+    }
+    while (query.next())
+        add(query);
+
+    // Archives are read one year at a time; the writer attaches none
+    QSqlDatabase db = QSqlDatabase::database();
+    const QList<int> years = YearArchive::archivedYears();
+    for (int year : years) {
+        QString error;
+        if (!YearArchive::queryYear(db, year, QStringLiteral("SELECT %1 FROM WorkSessions").arg(QLatin1String(SessionColumns)),
+                                    QVariantMap(), add, &error)) {
+            qWarning() << "Failed to read archived sessions:" << year << error;
+            m_currentResult.errorMessage = error;
+            return false;
         }
-        reply->deleteLater();
+    }
+    return true;
+}
+
+void SyncManager::testConnection()
+{
+    if (!isConfigured()) {
+        emit connectionTestCompleted(false, tr("Sync not configured"));
         return;
     }
 
-    QJsonDocument doc = QJsonDocument::fromJson(responseData);
-    QJsonObject response = doc.object();
+    m_backend->testConnection();
+}
 
-    if (operation == QStringLiteral("test")) {
-        emit connectionTestCompleted(true, tr("Connection successful!"));
-    } else if (operation == QStringLiteral("tags")) {
-        m_cloudTags = response[QStringLiteral("Items")].toArray();
-        m_tagsDownloaded = true;
-        m_pendingRequests--;
-        if (m_tagsDownloaded && m_sessionsDownloaded) {
-            syncTags();
-        }
-    } else if (operation == QStringLiteral("sessions")) {
-        m_cloudSessions = response[QStringLiteral("Items")].toArray();
-        m_sessionsDownloaded = true;
-        m_pendingRequests--;
-        if (m_tagsDownloaded && m_sessionsDownloaded) {
-            syncTags();
-        }
-    } else if (operation == QStringLiteral("put")) {
-        m_pendingRequests--;
-        if (m_pendingRequests <= 0) {
-            finishSync();
-        }
-    }
+void SyncManager::onTagsReceived(const QVector<SyncTagRecord> &tags)
+{
+    m_cloudTags += tags;
+    m_itemsProcessed += tags.size();
+    reportProgress();
+}
 
-    reply->deleteLater();
+void SyncManager::onTagsFetched()
+{
+    m_pipeline.tagsFetched = true;
+    advance();
 }
 
-void SyncManager::syncTags()
+void SyncManager::onSessionsReceived(const QVector<SyncSessionRecord> &sessions)
 {
-    // Build lookup maps
-    QMap<QString, QJsonObject> cloudByCloudId;
-    for (const QJsonValue &val : m_cloudTags) {
-        QJsonObject obj = val.toObject();
-        QString cloudId = obj[QStringLiteral("CloudId")].toObject()[QStringLiteral("S")].toString();
-        cloudByCloudId[cloudId] = obj;
-    }
-
-    QMap<QString, QVariantMap> localByCloudId;
-    for (const QVariantMap &tag : m_localTags) {
-        QString cloudId = tag[QStringLiteral("cloudId")].toString();
-        if (!cloudId.isEmpty()) {
-            localByCloudId[cloudId] = tag;
-        }
-    }
+    m_cloudSessions += sessions;
+    m_itemsProcessed += sessions.size();
+    reportProgress();
+    advance();
+}
 
-    // Process cloud tags (download)
-    for (const QJsonValue &val : m_cloudTags) {
-        QJsonObject cloudTag = val.toObject();
-        QString cloudId = cloudTag[QStringLiteral("CloudId")].toObject()[QStringLiteral("S")].toString();
-        QString cloudName = cloudTag[QStringLiteral("Name")].toObject()[QStringLiteral("S")].toString();
-        QString cloudUpdatedAt = cloudTag[QStringLiteral("UpdatedAt")].toObject()[QStringLiteral("S")].toString();
-        bool cloudIsDeleted = cloudTag[QStringLiteral("IsDeleted")].toObject()[QStringLiteral("BOOL")].toBool();
-
-        if (localByCloudId.contains(cloudId)) {
-            // Exists locally - check timestamps
-            QVariantMap localTag = localByCloudId[cloudId];
-            QDateTime localUpdated = QDateTime::fromString(localTag[QStringLiteral("updatedAt")].toString(), Qt::ISODate);
-            QDateTime cloudUpdated = QDateTime::fromString(cloudUpdatedAt, Qt::ISODate);
+void SyncManager::onBytesTransferred(qint64 bytes)
+{
+    m_bytesTransferred += bytes;
+    reportProgress();
+}
 
-            if (cloudUpdated > localUpdated) {
-                // Cloud is newer - update local
-                QSqlQuery query;
-                query.prepare(QStringLiteral("UPDATE Tags SET Name = :name, UpdatedAt = :updated, IsDeleted = :deleted WHERE Id = :id"));
-                query.bindValue(QStringLiteral(":name"), cloudName);
-                query.bindValue(QStringLiteral(":updated"), cloudUpdatedAt);
-                query.bindValue(QStringLiteral(":deleted"), cloudIsDeleted ? 1 : 0);
-                query.bindValue(QStringLiteral(":id"), localTag[QStringLiteral("id")]);
-                query.exec();
-                m_currentResult.tagsDownloaded++;
-            }
-        } else if (!cloudIsDeleted) {
-            // New tag from cloud
-            QSqlQuery query;
-            query.prepare(QStringLiteral("INSERT INTO Tags (Name, CloudId, UpdatedAt, IsDeleted) VALUES (:name, :cloudId, :updated, 0)"));
-            query.bindValue(QStringLiteral(":name"), cloudName);
-            query.bindValue(QStringLiteral(":cloudId"), cloudId);
-            query.bindValue(QStringLiteral(":updated"), cloudUpdatedAt);
-            query.exec();
-            m_currentResult.tagsDownloaded++;
-        }
-    }
+void SyncManager::onUploadProgress(int recordsStored)
+{
+    // The early upload runs under the download's progress
+    if (m_stage == Stage::Fetching)
+        return;
+    m_itemsProcessed = recordsStored;
+    reportProgress();
+}
 
-    // Process local tags (upload)
-    for (QVariantMap &tag : m_localTags) {
-        QString cloudId = tag[QStringLiteral("cloudId")].toString();
-
-        if (cloudId.isEmpty()) {
-            // New local tag - assign CloudId and upload
-            cloudId = QUuid::createUuid().toString(QUuid::WithoutBraces);
-            QSqlQuery query;
-            query.prepare(QStringLiteral("UPDATE Tags SET CloudId = :cloudId WHERE Id = :id"));
-            query.bindValue(QStringLiteral(":cloudId"), cloudId);
-            query.bindValue(QStringLiteral(":id"), tag[QStringLiteral("id")]);
-            query.exec();
-            tag[QStringLiteral("cloudId")] = cloudId;
-            uploadTag(tag);
-            m_currentResult.tagsUploaded++;
-        } else if (cloudByCloudId.contains(cloudId)) {
-            // Check if local is newer
-            QJsonObject cloudTag = cloudByCloudId[cloudId];
-            QString cloudUpdatedAt = cloudTag[QStringLiteral("UpdatedAt")].toObject()[QStringLiteral("S")].toString();
-            QDateTime localUpdated = QDateTime::fromString(tag[QStringLiteral("updatedAt")].toString(), Qt::ISODate);
-            QDateTime cloudUpdated = QDateTime::fromString(cloudUpdatedAt, Qt::ISODate);
-
-            if (localUpdated > cloudUpdated) {
-                uploadTag(tag);
-                m_currentResult.tagsUploaded++;
-            }
-        } else {
-            // Has CloudId but not in cloud
-            uploadTag(tag);
-            m_currentResult.tagsUploaded++;
-        }
-    }
+void SyncManager::onRecordStored(const QString &cloudId, qint64 hlc)
+{
+    m_storedKeys.append(idempotencyKey(cloudId, hlc));
+    if (m_storedKeys.size() >= OutboxFlushBatch)
+        flushStoredKeys();
+}
 
-    // Update tag CloudIds in local sessions for reference
-    QSqlQuery updateTagCloudIds;
-    updateTagCloudIds.exec(QStringLiteral(R"(
-        UPDATE WorkSessions SET TagCloudId = (
-            SELECT CloudId FROM Tags WHERE Tags.Id = WorkSessions.TagId
-        ) WHERE TagId IS NOT NULL
-    )"));
+void SyncManager::onFetchScope(const QStringList &days)
+{
+    m_scoped = true;
+    m_fetchScope = QSet<QString>(days.cbegin(), days.cend());
+}
 
-    // Reload sessions to pick up updated TagCloudIds
-    m_localSessions.clear();
-    QSqlQuery sessionQuery;
-    sessionQuery.exec(QStringLiteral(R"(
-        SELECT Id, SessionDate, TimeHours, Description, Notes, NextPlannedStage,
-               TagId, CreatedAt, UpdatedAt, CloudId, IsDeleted, TagCloudId
-        FROM WorkSessions
-    )"));
-    while (sessionQuery.next()) {
-        QVariantMap session;
-        session[QStringLiteral("id")] = sessionQuery.value(0);
-        session[QStringLiteral("sessionDate")] = sessionQuery.value(1);
-        session[QStringLiteral("timeHours")] = sessionQuery.value(2);
-        session[QStringLiteral("description")] = sessionQuery.value(3);
-        session[QStringLiteral("notes")] = sessionQuery.value(4);
-        session[QStringLiteral("nextPlannedStage")] = sessionQuery.value(5);
-        session[QStringLiteral("tagId")] = sessionQuery.value(6);
-        session[QStringLiteral("createdAt")] = sessionQuery.value(7);
-        session[QStringLiteral("updatedAt")] = sessionQuery.value(8);
-        session[QStringLiteral("cloudId")] = sessionQuery.value(9);
-        session[QStringLiteral("isDeleted")] = sessionQuery.value(10).toBool();
-        session[QStringLiteral("tagCloudId")] = sessionQuery.value(11);
-        m_localSessions.append(session);
+void SyncManager::onFetchFinished(bool success, const QString &errorMessage)
+{
+    if (m_stage != Stage::Fetching)
+        return;
+
+    if (!success) {
+        m_currentResult.errorMessage = errorMessage;
+        failRun();
+        return;
     }
 
-    // Now sync sessions
-    syncSessions();
+    m_pipeline.fetchDone = true;
+    advance();
 }
 
-void SyncManager::syncSessions()
+void SyncManager::onUploadFinished(bool success, const QString &errorMessage)
 {
-    // Build lookup maps
-    QMap<QString, QJsonObject> cloudByCloudId;
-    for (const QJsonValue &val : m_cloudSessions) {
-        QJsonObject obj = val.toObject();
-        QString cloudId = obj[QStringLiteral("CloudId")].toObject()[QStringLiteral("S")].toString();
-        cloudByCloudId[cloudId] = obj;
-    }
-
-    // Build tag lookup
-    QMap<QString, int> tagIdByCloudId;
-    QSqlQuery tagQuery;
-    tagQuery.exec(QStringLiteral("SELECT Id, CloudId FROM Tags WHERE CloudId IS NOT NULL"));
-    while (tagQuery.next()) {
-        tagIdByCloudId[tagQuery.value(1).toString()] = tagQuery.value(0).toInt();
-    }
-
-    QMap<QString, QVariantMap> localByCloudId;
-    for (const QVariantMap &session : m_localSessions) {
-        QString cloudId = session[QStringLiteral("cloudId")].toString();
-        if (!cloudId.isEmpty()) {
-            localByCloudId[cloudId] = session;
-        }
+    if (m_stage == Stage::Idle)
+        return;
+
+    flushStoredKeys();
+
+    if (!success) {
+        m_currentResult.errorMessage = errorMessage;
+        failRun();
+        return;
     }
 
-    // Process cloud sessions (download)
-    for (const QJsonValue &val : m_cloudSessions) {
-        QJsonObject cloudSession = val.toObject();
-        QString cloudId = cloudSession[QStringLiteral("CloudId")].toObject()[QStringLiteral("S")].toString();
-        QString cloudUpdatedAt = cloudSession[QStringLiteral("UpdatedAt")].toObject()[QStringLiteral("S")].toString();
-        bool cloudIsDeleted = cloudSession[QStringLiteral("IsDeleted")].toObject()[QStringLiteral("BOOL")].toBool();
+    switch (m_stage) {
+    case Stage::Resuming:
+        startFetch();
+        return;
+    case Stage::Fetching:
+        m_pipeline.earlyUpload = false;
+        advance();
+        return;
+    default:
+        finishSync();
+        return;
+    }
+}
 
-        if (localByCloudId.contains(cloudId)) {
-            // Exists locally - check timestamps
-            QVariantMap localSession = localByCloudId[cloudId];
-            QDateTime localUpdated = QDateTime::fromString(localSession[QStringLiteral("updatedAt")].toString(), Qt::ISODate);
-            QDateTime cloudUpdated = QDateTime::fromString(cloudUpdatedAt, Qt::ISODate);
+bool SyncManager::loadDigestTree(SyncDigestTree *tree)
+{
+    const DiagnosticsTimer timer("sync.digests.merged");
 
-            if (cloudUpdated > localUpdated) {
-                // Cloud is newer - update local
-                QString tagCloudId = cloudSession[QStringLiteral("TagCloudId")].toObject()[QStringLiteral("S")].toString();
-                QVariant tagId = tagIdByCloudId.contains(tagCloudId) ? QVariant(tagIdByCloudId[tagCloudId]) : QVariant();
-
-                QSqlQuery query;
-                query.prepare(QStringLiteral(R"(
-                    UPDATE WorkSessions SET
-                        SessionDate = :date, TimeHours = :hours, Description = :desc,
-                        Notes = :notes, NextPlannedStage = :next, TagId = :tagId,
-                        TagCloudId = :tagCloudId, UpdatedAt = :updated, IsDeleted = :deleted
-                    WHERE Id = :id
-                )"));
-                query.bindValue(QStringLiteral(":date"), cloudSession[QStringLiteral("SessionDate")].toObject()[QStringLiteral("S")].toString());
-                query.bindValue(QStringLiteral(":hours"), cloudSession[QStringLiteral("TimeHours")].toObject()[QStringLiteral("N")].toString().toDouble());
-                query.bindValue(QStringLiteral(":desc"), cloudSession[QStringLiteral("Description")].toObject()[QStringLiteral("S")].toString());
-                query.bindValue(QStringLiteral(":notes"), cloudSession[QStringLiteral("Notes")].toObject()[QStringLiteral("S")].toString());
-                query.bindValue(QStringLiteral(":next"), cloudSession[QStringLiteral("NextPlannedStage")].toObject()[QStringLiteral("S")].toString());
-                query.bindValue(QStringLiteral(":tagId"), tagId);
-                query.bindValue(QStringLiteral(":tagCloudId"), tagCloudId);
-                query.bindValue(QStringLiteral(":updated"), cloudUpdatedAt);
-                query.bindValue(QStringLiteral(":deleted"), cloudIsDeleted ? 1 : 0);
-                query.bindValue(QStringLiteral(":id"), localSession[QStringLiteral("id")]);
-                query.exec();
-                m_currentResult.sessionsDownloaded++;
-            }
-        } else if (!cloudIsDeleted) {
-            // New session from cloud
-            QString tagCloudId = cloudSession[QStringLiteral("TagCloudId")].toObject()[QStringLiteral("S")].toString();
-            QVariant tagId = tagIdByCloudId.contains(tagCloudId) ? QVariant(tagIdByCloudId[tagCloudId]) : QVariant();
-
-            QSqlQuery query;
-            query.prepare(QStringLiteral(R"(
-                INSERT INTO WorkSessions (SessionDate, TimeHours, Description, Notes, NextPlannedStage,
-                    TagId, TagCloudId, CreatedAt, UpdatedAt, CloudId, IsDeleted)
-                VALUES (:date, :hours, :desc, :notes, :next, :tagId, :tagCloudId, :created, :updated, :cloudId, 0)
-            )"));
-            query.bindValue(QStringLiteral(":date"), cloudSession[QStringLiteral("SessionDate")].toObject()[QStringLiteral("S")].toString());
-            query.bindValue(QStringLiteral(":hours"), cloudSession[QStringLiteral("TimeHours")].toObject()[QStringLiteral("N")].toString().toDouble());
-            query.bindValue(QStringLiteral(":desc"), cloudSession[QStringLiteral("Description")].toObject()[QStringLiteral("S")].toString());
-            query.bindValue(QStringLiteral(":notes"), cloudSession[QStringLiteral("Notes")].toObject()[QStringLiteral("S")].toString());
-            query.bindValue(QStringLiteral(":next"), cloudSession[QStringLiteral("NextPlannedStage")].toObject()[QStringLiteral("S")].toString());
-            query.bindValue(QStringLiteral(":tagId"), tagId);
-            query.bindValue(QStringLiteral(":tagCloudId"), tagCloudId);
-            query.bindValue(QStringLiteral(":created"), cloudSession[QStringLiteral("CreatedAt")].toObject()[QStringLiteral("S")].toString());
-            query.bindValue(QStringLiteral(":updated"), cloudUpdatedAt);
-            query.bindValue(QStringLiteral(":cloudId"), cloudId);
-            query.exec();
-            m_currentResult.sessionsDownloaded++;
+    auto add = [tree](const QSqlQuery &query) {
+        tree->add(query.value(0).toString(), query.value(1).toString(), query.value(2).toLongLong());
+        return true;
+    };
+    const QString sql = QStringLiteral("SELECT SessionDate, CloudId, Hlc FROM WorkSessions WHERE CloudId IS NOT NULL");
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!query.exec(sql)) {
+        m_currentResult.errorMessage = query.lastError().text();
+        return false;
+    }
+    while (query.next())
+        add(query);
+
+    QSqlDatabase db = QSqlDatabase::database();
+    const QList<int> years = YearArchive::archivedYears();
+    for (int year : years) {
+        QString error;
+        if (!YearArchive::queryYear(db, year, sql, QVariantMap(), add, &error)) {
+            qWarning() << "Failed to read archived digests:" << year << error;
+            m_currentResult.errorMessage = error;
+            return false;
         }
     }
+    tree->computeDigests();
+    return true;
+}
 
-    // Process local sessions (upload)
-    for (QVariantMap &session : m_localSessions) {
-        QString cloudId = session[QStringLiteral("cloudId")].toString();
-
-        if (cloudId.isEmpty()) {
-            // New local session - assign CloudId and upload
-            cloudId = QUuid::createUuid().toString(QUuid::WithoutBraces);
-            QSqlQuery query;
-            query.prepare(QStringLiteral("UPDATE WorkSessions SET CloudId = :cloudId WHERE Id = :id"));
-            query.bindValue(QStringLiteral(":cloudId"), cloudId);
-            query.bindValue(QStringLiteral(":id"), session[QStringLiteral("id")]);
-            query.exec();
-            session[QStringLiteral("cloudId")] = cloudId;
-            uploadSession(session);
-            m_currentResult.sessionsUploaded++;
-        } else if (cloudByCloudId.contains(cloudId)) {
-            // Check if local is newer
-            QJsonObject cloudSession = cloudByCloudId[cloudId];
-            QString cloudUpdatedAt = cloudSession[QStringLiteral("UpdatedAt")].toObject()[QStringLiteral("S")].toString();
-            QDateTime localUpdated = QDateTime::fromString(session[QStringLiteral("updatedAt")].toString(), Qt::ISODate);
-            QDateTime cloudUpdated = QDateTime::fromString(cloudUpdatedAt, Qt::ISODate);
-
-            if (localUpdated > cloudUpdated) {
-                uploadSession(session);
-                m_currentResult.sessionsUploaded++;
-            }
-        } else {
-            // Has CloudId but not in cloud
-            uploadSession(session);
-            m_currentResult.sessionsUploaded++;
-        }
+bool SyncManager::enqueueOutgoing()
+{
+    const DiagnosticsTimer timer("sync.outbox.enqueue");
+
+    // One entry per record; a newer version replaces a queued older one,
+    // and the edited fields add up unless either side sends everything
+    QSqlQuery query;
+    query.prepare(QStringLiteral(R"(
+        INSERT INTO SyncOutbox (IdempotencyKey, CloudId, DirtyFields, Payload)
+        VALUES (:key, :cloudId, :dirtyFields, :payload)
+        ON CONFLICT(CloudId) DO UPDATE SET
+            IdempotencyKey = excluded.IdempotencyKey,
+            DirtyFields = CASE WHEN SyncOutbox.DirtyFields = 0 OR excluded.DirtyFields = 0
+                               THEN 0 ELSE SyncOutbox.DirtyFields | excluded.DirtyFields END,
+            Payload = excluded.Payload
+    )"));
+
+    for (const SyncTagRecord &tag : qAsConst(m_outgoing.tags)) {
+        SyncChangeset entry;
+        entry.tags.append(tag);
+        query.bindValue(QStringLiteral(":key"), idempotencyKey(tag.cloudId, tag.hlc));
+        query.bindValue(QStringLiteral(":cloudId"), tag.cloudId);
+        query.bindValue(QStringLiteral(":dirtyFields"), 0);
+        query.bindValue(QStringLiteral(":payload"), entry.encode());
+        if (!query.exec())
+            return failMerge(query);
     }
 
-    if (m_pendingRequests <= 0) {
-        finishSync();
+    for (const SyncSessionRecord &session : qAsConst(m_outgoing.sessions)) {
+        SyncChangeset entry;
+        entry.sessions.append(session);
+        query.bindValue(QStringLiteral(":key"), idempotencyKey(session.cloudId, session.hlc));
+        query.bindValue(QStringLiteral(":cloudId"), session.cloudId);
+        query.bindValue(QStringLiteral(":dirtyFields"), session.dirtyFields);
+        query.bindValue(QStringLiteral(":payload"), entry.encode());
+        if (!query.exec())
+            return failMerge(query);
     }
+    return true;
 }
 
-void SyncManager::uploadTag(const QVariantMap &tag)
+SyncChangeset SyncManager::loadOutbox()
 {
-    QJsonObject item;
+    SyncChangeset pending;
 
-    QJsonObject profileIdAttr;
-    profileIdAttr[QStringLiteral("S")] = m_config.profileId;
-    item[QStringLiteral("ProfileId")] = profileIdAttr;
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.exec(QStringLiteral("SELECT Payload, DirtyFields FROM SyncOutbox ORDER BY Id"));
+    while (query.next()) {
+        SyncChangeset entry;
+        QString errorString;
+        if (!SyncChangeset::decode(query.value(0).toByteArray(), &entry, &errorString)) {
+            qWarning() << "Skipping unreadable outbox entry:" << errorString;
+            continue;
+        }
+        // The wire format does not carry the dirty bits
+        for (SyncSessionRecord &session : entry.sessions)
+            session.dirtyFields = query.value(1).toInt();
+        pending.tags += entry.tags;
+        pending.sessions += entry.sessions;
+    }
+    return pending;
+}
 
-    QJsonObject cloudIdAttr;
-    cloudIdAttr[QStringLiteral("S")] = tag[QStringLiteral("cloudId")].toString();
-    item[QStringLiteral("CloudId")] = cloudIdAttr;
+void SyncManager::flushStoredKeys()
+{
+    if (m_storedKeys.isEmpty())
+        return;
 
-    QJsonObject nameAttr;
-    nameAttr[QStringLiteral("S")] = tag[QStringLiteral("name")].toString();
-    item[QStringLiteral("Name")] = nameAttr;
+    // Kept for when the UI's batch ends; a rollback of it would bring the
+    // entries back
+    if (m_database->inBatch())
+        return;
 
-    QJsonObject updatedAtAttr;
-    updatedAtAttr[QStringLiteral("S")] = tag[QStringLiteral("updatedAt")].toString();
-    item[QStringLiteral("UpdatedAt")] = updatedAtAttr;
+    const DiagnosticsTimer timer("sync.outbox.flush");
 
-    QJsonObject isDeletedAttr;
-    isDeletedAttr[QStringLiteral("BOOL")] = tag[QStringLiteral("isDeleted")].toBool();
-    item[QStringLiteral("IsDeleted")] = isDeletedAttr;
+    // Left for the next flush, or sent again (harmlessly) by the next run
+    if (!m_database->beginBatch())
+        return;
+    QSqlQuery query;
+    query.prepare(QStringLiteral("DELETE FROM SyncOutbox WHERE IdempotencyKey = :key"));
+    for (const QString &key : qAsConst(m_storedKeys)) {
+        query.bindValue(QStringLiteral(":key"), key);
+        if (!query.exec())
+            qWarning() << "Failed to clear outbox entry:" << query.lastError().text();
+    }
+    if (m_database->commitBatch())
+        m_storedKeys.clear();
+}
 
-    putItem(m_config.tagsTableName, item);
+bool SyncManager::failMerge(const QSqlQuery &query)
+{
+    qWarning() << "Sync merge failed:" << query.lastError().text();
+    m_currentResult.errorMessage = query.lastError().text();
+    return false;
 }
 
-void SyncManager::uploadSession(const QVariantMap &session)
+bool SyncManager::syncTags()
 {
-    QJsonObject item;
+    const DiagnosticsTimer timer("sync.syncTags");
 
-    QJsonObject profileIdAttr;
-    profileIdAttr[QStringLiteral("S")] = m_config.profileId;
-    item[QStringLiteral("ProfileId")] = profileIdAttr;
+    // Build lookup maps
+    QHash<QString, int> cloudIndexByCloudId;
+    cloudIndexByCloudId.reserve(m_cloudTags.size());
+    for (int i = 0; i < m_cloudTags.size(); ++i)
+        cloudIndexByCloudId.insert(m_cloudTags.at(i).cloudId, i);
+
+    QHash<QString, int> localIndexByCloudId;
+    localIndexByCloudId.reserve(m_localTags.size());
+    for (int i = 0; i < m_localTags.size(); ++i) {
+        if (!m_localTags.at(i).cloudId.isEmpty())
+            localIndexByCloudId.insert(m_localTags.at(i).cloudId, i);
+    }
 
-    QJsonObject cloudIdAttr;
-    cloudIdAttr[QStringLiteral("S")] = session[QStringLiteral("cloudId")].toString();
-    item[QStringLiteral("CloudId")] = cloudIdAttr;
+    QSqlQuery updateQuery;
+    // Only over the version the snapshot holds: a tag edited since keeps
+    // the edit, which goes up instead
+    updateQuery.prepare(QStringLiteral(R"(
+        UPDATE Tags SET Name = :name, UpdatedAt = :updated, Hlc = :hlc, IsDeleted = :deleted
+        WHERE Id = :id AND Hlc = :snapshotHlc
+    )"));
+    QSqlQuery insertQuery;
+    insertQuery.prepare(QStringLiteral("INSERT INTO Tags (Name, CloudId, UpdatedAt, Hlc, IsDeleted) VALUES (:name, :cloudId, :updated, :hlc, 0)"));
 
-    QJsonObject dateAttr;
-    dateAttr[QStringLiteral("S")] = session[QStringLiteral("sessionDate")].toString();
-    item[QStringLiteral("SessionDate")] = dateAttr;
+    TagRegistry &registry = m_database->tagRegistry();
 
-    QJsonObject hoursAttr;
-    hoursAttr[QStringLiteral("N")] = QString::number(session[QStringLiteral("timeHours")].toDouble());
-    item[QStringLiteral("TimeHours")] = hoursAttr;
+    // Process cloud tags (download)
+    for (const SyncTagRecord &cloudTag : qAsConst(m_cloudTags)) {
+        // Local edits made after this sync must order after what it saw
+        HybridClock::observe(cloudTag.hlc);
 
-    QJsonObject descAttr;
-    descAttr[QStringLiteral("S")] = session[QStringLiteral("description")].toString();
-    item[QStringLiteral("Description")] = descAttr;
+        const auto local = localIndexByCloudId.constFind(cloudTag.cloudId);
+        if (local != localIndexByCloudId.constEnd()) {
+            // Exists locally - check timestamps
+            const SyncTagRecord &localTag = m_localTags.at(local.value());
+            if (supersedes(cloudTag, localTag)) {
+                // Cloud is newer - update local
+                updateQuery.bindValue(QStringLiteral(":name"), cloudTag.name);
+                updateQuery.bindValue(QStringLiteral(":updated"), cloudTag.updatedAt);
+                updateQuery.bindValue(QStringLiteral(":hlc"), cloudTag.hlc);
+                updateQuery.bindValue(QStringLiteral(":deleted"), cloudTag.isDeleted ? 1 : 0);
+                updateQuery.bindValue(QStringLiteral(":id"), localTag.localId);
+                updateQuery.bindValue(QStringLiteral(":snapshotHlc"), localTag.hlc);
+                if (!updateQuery.exec())
+                    return failMerge(updateQuery);
+                if (updateQuery.numRowsAffected() == 0) {
+                    // Edited during the sync
+                    if (!reloadLocalTag(local.value()))
+                        return false;
+                    continue;
+                }
+                registry.insert(int(localTag.localId), cloudTag.name, cloudTag.cloudId, cloudTag.isDeleted);
+                m_currentResult.tagsDownloaded++;
+            }
+        } else if (!cloudTag.isDeleted) {
+            // New tag from cloud
+            insertQuery.bindValue(QStringLiteral(":name"), cloudTag.name);
+            insertQuery.bindValue(QStringLiteral(":cloudId"), cloudTag.cloudId);
+            insertQuery.bindValue(QStringLiteral(":updated"), cloudTag.updatedAt);
+            insertQuery.bindValue(QStringLiteral(":hlc"), cloudTag.hlc);
+            if (!insertQuery.exec())
+                return failMerge(insertQuery);
+            registry.insert(insertQuery.lastInsertId().toInt(), cloudTag.name, cloudTag.cloudId);
+            m_currentResult.tagsDownloaded++;
+        }
+    }
+
+    // Process local tags (upload); new ones go with assignNewRecords()
+    for (const SyncTagRecord &tag : qAsConst(m_localTags)) {
+        if (tag.cloudId.isEmpty() || m_queuedTagIds.contains(tag.localId))
+            continue;
+
+        const auto cloud = cloudIndexByCloudId.constFind(tag.cloudId);
+        if (cloud == cloudIndexByCloudId.constEnd()
+            || supersedes(tag, m_cloudTags.at(cloud.value()))) {
+            // Local is newer, or has a CloudId but is not in the cloud
+            m_outgoing.tags.append(tag);
+            m_currentResult.tagsUploaded++;
+        }
+    }
+    return true;
+}
 
-    if (!session[QStringLiteral("notes")].toString().isEmpty()) {
-        QJsonObject notesAttr;
-        notesAttr[QStringLiteral("S")] = session[QStringLiteral("notes")].toString();
-        item[QStringLiteral("Notes")] = notesAttr;
+bool SyncManager::assignNewRecords()
+{
+    const DiagnosticsTimer timer("sync.assignNewRecords");
+
+    TagRegistry &registry = m_database->tagRegistry();
+
+    QSqlQuery assignTagQuery;
+    assignTagQuery.prepare(QStringLiteral("UPDATE Tags SET CloudId = :cloudId WHERE Id = :id"));
+    for (SyncTagRecord &tag : m_localTags) {
+        if (!tag.cloudId.isEmpty())
+            continue;
+        // New local tag - assign CloudId and upload
+        tag.cloudId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+        assignTagQuery.bindValue(QStringLiteral(":cloudId"), tag.cloudId);
+        assignTagQuery.bindValue(QStringLiteral(":id"), tag.localId);
+        if (!assignTagQuery.exec())
+            return failMerge(assignTagQuery);
+        registry.setCloudId(int(tag.localId), tag.cloudId);
+        m_queuedTagIds.insert(tag.localId);
+        m_outgoing.tags.append(tag);
+        m_currentResult.tagsUploaded++;
     }
 
-    if (!session[QStringLiteral("nextPlannedStage")].toString().isEmpty()) {
-        QJsonObject nextAttr;
-        nextAttr[QStringLiteral("S")] = session[QStringLiteral("nextPlannedStage")].toString();
-        item[QStringLiteral("NextPlannedStage")] = nextAttr;
+    QSqlQuery assignSessionQuery;
+    assignSessionQuery.prepare(QStringLiteral("UPDATE WorkSessions SET CloudId = :cloudId WHERE Id = :id"));
+    for (SyncSessionRecord &session : m_localSessions) {
+        if (!session.cloudId.isEmpty())
+            continue;
+        // New local session - assign CloudId and upload
+        if (session.tagId > 0)
+            session.tagCloudId = registry.cloudIdForId(int(session.tagId));
+        session.cloudId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+        session.dirtyFields = 0;
+        assignSessionQuery.bindValue(QStringLiteral(":cloudId"), session.cloudId);
+        assignSessionQuery.bindValue(QStringLiteral(":id"), session.localId);
+        if (!assignSessionQuery.exec())
+            return failMerge(assignSessionQuery);
+        m_queuedSessionIds.insert(session.localId);
+        m_outgoing.sessions.append(session);
+        m_currentResult.sessionsUploaded++;
     }
+    return true;
+}
+
+bool SyncManager::mergeCloudSessions()
+{
+    const DiagnosticsTimer timer("sync.mergeCloudSessions");
+
+    const TagRegistry &registry = m_database->tagRegistry();
+    auto tagIdFor = [&registry](const QString &tagCloudId) {
+        const int tagId = registry.idForCloudId(tagCloudId);
+        return tagId > 0 ? QVariant(tagId) : QVariant();
+    };
+
+    QSqlQuery updateQuery;
+    updateQuery.prepare(QStringLiteral(R"(
+        UPDATE WorkSessions SET
+            SessionDate = :date, TimeHours = :hours, Description = :desc,
+            Notes = :notes, NextPlannedStage = :next, TagId = :tagId,
+            TagCloudId = :tagCloudId, UpdatedAt = :updated, Hlc = :hlc, IsDeleted = :deleted,
+            DirtyFields = 0
+        WHERE Id = :id AND Hlc = :snapshotHlc
+    )"));
+    QSqlQuery insertQuery;
+    insertQuery.prepare(QStringLiteral(R"(
+        INSERT INTO WorkSessions (SessionDate, TimeHours, Description, Notes, NextPlannedStage,
+            TagId, TagCloudId, CreatedAt, UpdatedAt, Hlc, CloudId, IsDeleted)
+        VALUES (:date, :hours, :desc, :notes, :next, :tagId, :tagCloudId, :created, :updated, :hlc, :cloudId, :deleted)
+    )"));
+
+    // Process the cloud sessions not merged yet (download)
+    for (; m_mergedCloudSessions < m_cloudSessions.size(); ++m_mergedCloudSessions) {
+        const SyncSessionRecord &cloudSession = m_cloudSessions.at(m_mergedCloudSessions);
+        HybridClock::observe(cloudSession.hlc);
 
-    if (!session[QStringLiteral("tagCloudId")].toString().isEmpty()) {
-        QJsonObject tagCloudIdAttr;
-        tagCloudIdAttr[QStringLiteral("S")] = session[QStringLiteral("tagCloudId")].toString();
-        item[QStringLiteral("TagCloudId")] = tagCloudIdAttr;
+        const auto local = m_localSessionIndex.constFind(cloudSession.cloudId);
+        if (local != m_localSessionIndex.constEnd()) {
+            // Exists locally - check timestamps
+            const SyncSessionRecord &localSession = m_localSessions.at(local.value());
+            if (supersedes(cloudSession, localSession)) {
+                // Cloud is newer - update local
+                updateQuery.bindValue(QStringLiteral(":date"), cloudSession.sessionDate);
+                updateQuery.bindValue(QStringLiteral(":hours"), cloudSession.timeHours);
+                updateQuery.bindValue(QStringLiteral(":desc"), cloudSession.description);
+                updateQuery.bindValue(QStringLiteral(":notes"), cloudSession.notes);
+                updateQuery.bindValue(QStringLiteral(":next"), cloudSession.nextPlannedStage);
+                updateQuery.bindValue(QStringLiteral(":tagId"), tagIdFor(cloudSession.tagCloudId));
+                updateQuery.bindValue(QStringLiteral(":tagCloudId"), cloudSession.tagCloudId);
+                updateQuery.bindValue(QStringLiteral(":updated"), cloudSession.updatedAt);
+                updateQuery.bindValue(QStringLiteral(":hlc"), cloudSession.hlc);
+                updateQuery.bindValue(QStringLiteral(":deleted"), cloudSession.isDeleted ? 1 : 0);
+                updateQuery.bindValue(QStringLiteral(":id"), localSession.localId);
+                updateQuery.bindValue(QStringLiteral(":snapshotHlc"), localSession.hlc);
+                if (!updateQuery.exec())
+                    return failMerge(updateQuery);
+                if (updateQuery.numRowsAffected() == 0) {
+                    // Edited during the sync: the snapshot takes the edit,
+                    // so queueLocalSessions() sends it up
+                    bool found = false;
+                    if (!reloadLocalSession(local.value(), &found))
+                        return false;
+                    if (found)
+                        continue;
+
+                    // The local copy is archived: its year comes back first
+                    const int year = QDate::fromString(localSession.sessionDate, Qt::ISODate).year();
+                    QSqlDatabase db = QSqlDatabase::database();
+                    QString error;
+                    if (!YearArchive::restoreYear(db, year, &error)) {
+                        qWarning() << "Sync merge failed:" << error;
+                        m_currentResult.errorMessage = error;
+                        return false;
+                    }
+                    m_archivesRestored = true;
+                    if (!updateQuery.exec())
+                        return failMerge(updateQuery);
+                }
+                m_currentResult.sessionsDownloaded++;
+            }
+        } else {
+            // New session from cloud. Tombstones are kept as well, so every
+            // replica holds the same records and digests can agree.
+            insertQuery.bindValue(QStringLiteral(":date"), cloudSession.sessionDate);
+            insertQuery.bindValue(QStringLiteral(":hours"), cloudSession.timeHours);
+            insertQuery.bindValue(QStringLiteral(":desc"), cloudSession.description);
+            insertQuery.bindValue(QStringLiteral(":notes"), cloudSession.notes);
+            insertQuery.bindValue(QStringLiteral(":next"), cloudSession.nextPlannedStage);
+            insertQuery.bindValue(QStringLiteral(":tagId"), tagIdFor(cloudSession.tagCloudId));
+            insertQuery.bindValue(QStringLiteral(":tagCloudId"), cloudSession.tagCloudId);
+            insertQuery.bindValue(QStringLiteral(":created"), cloudSession.createdAt);
+            insertQuery.bindValue(QStringLiteral(":updated"), cloudSession.updatedAt);
+            insertQuery.bindValue(QStringLiteral(":hlc"), cloudSession.hlc);
+            insertQuery.bindValue(QStringLiteral(":cloudId"), cloudSession.cloudId);
+            insertQuery.bindValue(QStringLiteral(":deleted"), cloudSession.isDeleted ? 1 : 0);
+            if (!insertQuery.exec())
+                return failMerge(insertQuery);
+            if (!cloudSession.isDeleted)
+                m_currentResult.sessionsDownloaded++;
+        }
     }
+    return true;
+}
 
-    QJsonObject createdAtAttr;
-    createdAtAttr[QStringLiteral("S")] = session[QStringLiteral("createdAt")].toString();
-    item[QStringLiteral("CreatedAt")] = createdAtAttr;
+bool SyncManager::queueLocalSessions()
+{
+    const DiagnosticsTimer timer("sync.queueLocalSessions");
 
-    QJsonObject updatedAtAttr;
-    updatedAtAttr[QStringLiteral("S")] = session[QStringLiteral("updatedAt")].toString();
-    item[QStringLiteral("UpdatedAt")] = updatedAtAttr;
+    // Build lookup maps
+    QHash<QString, int> cloudIndexByCloudId;
+    cloudIndexByCloudId.reserve(m_cloudSessions.size());
+    for (int i = 0; i < m_cloudSessions.size(); ++i)
+        cloudIndexByCloudId.insert(m_cloudSessions.at(i).cloudId, i);
+
+    // A local session's tag reference follows its TagId, whose CloudId may
+    // only just have been assigned by assignNewRecords(). The stored
+    // TagCloudId is what the cloud last sent and counts only while there
+    // is no TagId.
+    const TagRegistry &registry = m_database->tagRegistry();
+    for (SyncSessionRecord &session : m_localSessions) {
+        if (session.tagId > 0)
+            session.tagCloudId = registry.cloudIdForId(int(session.tagId));
+    }
 
-    QJsonObject isDeletedAttr;
-    isDeletedAttr[QStringLiteral("BOOL")] = session[QStringLiteral("isDeleted")].toBool();
-    item[QStringLiteral("IsDeleted")] = isDeletedAttr;
+    // Once queued for upload the edits are no longer pending; the outbox
+    // entry carries them until the target confirms the upload. Edits made
+    // since the snapshot changed the Hlc and stay pending.
+    QSqlQuery cleanQuery;
+    cleanQuery.prepare(QStringLiteral("UPDATE WorkSessions SET DirtyFields = 0 WHERE Id = :id AND Hlc = :hlc"));
+
+    // Process local sessions (upload); new ones go with assignNewRecords()
+    for (SyncSessionRecord &session : m_localSessions) {
+        if (session.cloudId.isEmpty() || m_queuedSessionIds.contains(session.localId))
+            continue;
+
+        // A scoped fetch says nothing about sessions dated elsewhere
+        if (m_scoped && !m_fetchScope.contains(session.sessionDate))
+            continue;
+
+        // What is stored is cleared below even when the whole record goes
+        const auto storedDirtyFields = session.dirtyFields;
+        const auto cloud = cloudIndexByCloudId.constFind(session.cloudId);
+        if (cloud == cloudIndexByCloudId.constEnd()) {
+            // Has a CloudId but is not in the cloud
+            session.dirtyFields = 0;
+        } else if (supersedes(session, m_cloudSessions.at(cloud.value()))) {
+            // Local is newer. Only the edited fields need to go, unless the
+            // cloud copy also differs elsewhere (then the whole record wins)
+            if (differingFields(session, m_cloudSessions.at(cloud.value())) & ~session.dirtyFields)
+                session.dirtyFields = 0;
+        } else {
+            continue;
+        }
 
-    putItem(m_config.sessionsTableName, item);
+        if (storedDirtyFields != 0) {
+            cleanQuery.bindValue(QStringLiteral(":id"), session.localId);
+            cleanQuery.bindValue(QStringLiteral(":hlc"), session.hlc);
+            if (!cleanQuery.exec())
+                return failMerge(cleanQuery);
+        }
+        m_outgoing.sessions.append(session);
+        m_currentResult.sessionsUploaded++;
+    }
+    return true;
 }
 
 void SyncManager::finishSync()
 {
-    updateLastSyncTime();
+    // Entries confirmed before a cancel or failure are done with
+    flushStoredKeys();
+    m_afterBatch.clear();
+    m_stage = Stage::Idle;
+    m_verify = false;
+    m_scoped = false;
 
-    m_currentResult.success = m_currentResult.errorMessage.isEmpty();
+    if (!m_currentResult.cancelled)
+        updateLastSyncTime();
+
+    m_currentResult.success = m_currentResult.errorMessage.isEmpty() && !m_currentResult.cancelled;
     m_isSyncing = false;
     emit syncingChanged();
+    setPhase(QString(), 0);
 
     QString message;
-    if (m_currentResult.success) {
+    if (m_currentResult.cancelled) {
+        message = tr("Sync cancelled");
+    } else if (m_currentResult.success) {
         message = tr("Sync completed! Uploaded: %1 sessions, %2 tags. Downloaded: %3 sessions, %4 tags.")
             .arg(m_currentResult.sessionsUploaded)
             .arg(m_currentResult.tagsUploaded)
@@ -709,76 +1173,74 @@ void SyncManager::finishSync()
     emit syncCompleted(m_currentResult.success, message);
     emit lastSyncTimeChanged();
 
+    // The writer reads archives moved back during the merge no more
+    if (m_archivesRestored) {
+        m_archivesRestored = false;
+        m_database->reloadArchives();
+    }
+
     // Refresh the UI
-    emit m_database->dataChanged();
-    emit m_database->tagsChanged();
+    m_database->notifyDataChanged();
+    m_database->notifyTagsChanged();
+
+    Tracer::asyncEnd(QByteArrayLiteral("sync.run"), m_syncTraceId);
 }
 
-void SyncManager::updateLastSyncTime()
+void SyncManager::setPhase(const QString &phase, qint64 totalItems)
 {
-    QString now = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
-    QSqlQuery query;
-    query.prepare(QStringLiteral("INSERT OR REPLACE INTO SyncMetadata (Key, Value) VALUES ('LastSync', :value)"));
-    query.bindValue(QStringLiteral(":value"), now);
-    query.exec();
+    m_phase = phase;
+    m_itemsProcessed = 0;
+    m_totalItems = totalItems;
+    m_phaseTimer.start();
+    reportProgress(true);
 }
 
-// AWS Signature Version 4 implementation
-QString SyncManager::signRequest(const QString &method, const QString &service,
-                                  const QString &host, const QString &canonicalUri,
-                                  const QString &payload, const QDateTime &timestamp,
-                                  const QString &amzTarget)
+void SyncManager::reportProgress(bool force)
 {
-    QString amzDate = timestamp.toString(QStringLiteral("yyyyMMddTHHmmssZ"));
-    QString dateStamp = timestamp.toString(QStringLiteral("yyyyMMdd"));
-
-    // Create canonical request
-    QString signedHeaders = QStringLiteral("content-type;host;x-amz-date;x-amz-target");
-    QString canonicalHeaders = QStringLiteral("content-type:application/x-amz-json-1.0\n")
-        + QStringLiteral("host:%1\n").arg(host)
-        + QStringLiteral("x-amz-date:%1\n").arg(amzDate)
-        + QStringLiteral("x-amz-target:%1\n").arg(amzTarget);
+    if (!force && m_progressTimer.isValid() && m_progressTimer.elapsed() < ProgressIntervalMs)
+        return;
+    m_progressTimer.start();
 
-    QString payloadHash = hashSha256(payload);
-    QString canonicalRequest = method + QStringLiteral("\n")
-        + canonicalUri + QStringLiteral("\n")
-        + QStringLiteral("\n")  // query string
-        + canonicalHeaders + QStringLiteral("\n")
-        + signedHeaders + QStringLiteral("\n")
-        + payloadHash;
+    // Extrapolate from the rate so far; unknown until something is done
+    m_etaSeconds = -1;
+    if (m_totalItems > 0 && m_itemsProcessed > 0 && m_itemsProcessed < m_totalItems) {
+        const qint64 remainingMs = m_phaseTimer.elapsed() * (m_totalItems - m_itemsProcessed) / m_itemsProcessed;
+        m_etaSeconds = int((remainingMs + 999) / 1000);
+    }
 
-    // Create string to sign
-    QString algorithm = QStringLiteral("AWS4-HMAC-SHA256");
-    QString credentialScope = dateStamp + QStringLiteral("/") + m_config.awsRegion + QStringLiteral("/") + service + QStringLiteral("/aws4_request");
-    QString stringToSign = algorithm + QStringLiteral("\n")
-        + amzDate + QStringLiteral("\n")
-        + credentialScope + QStringLiteral("\n")
-        + hashSha256(canonicalRequest);
+    emit progressChanged();
+}
 
-    // Create signing key
-    QByteArray kDate = hmacSha256(QStringLiteral("AWS4%1").arg(m_config.awsSecretAccessKey).toUtf8(), dateStamp.toUtf8());
-    QByteArray kRegion = hmacSha256(kDate, m_config.awsRegion.toUtf8());
-    QByteArray kService = hmacSha256(kRegion, service.toUtf8());
-    QByteArray kSigning = hmacSha256(kService, QByteArrayLiteral("aws4_request"));
+QString SyncManager::syncPhase() const
+{
+    return m_phase;
+}
 
-    // Create signature
-    QString signature = QString::fromLatin1(hmacSha256(kSigning, stringToSign.toUtf8()).toHex());
+qint64 SyncManager::itemsProcessed() const
+{
+    return m_itemsProcessed;
+}
 
-    // Create authorization header
-    QString authHeader = algorithm + QStringLiteral(" ")
-        + QStringLiteral("Credential=%1/%2, ").arg(m_config.awsAccessKeyId, credentialScope)
-        + QStringLiteral("SignedHeaders=%1, ").arg(signedHeaders)
-        + QStringLiteral("Signature=%1").arg(signature);
+qint64 SyncManager::totalItems() const
+{
+    return m_totalItems;
+}
 
-    return authHeader;
+qint64 SyncManager::bytesTransferred() const
+{
+    return m_bytesTransferred;
 }
 
-QByteArray SyncManager::hmacSha256(const QByteArray &key, const QByteArray &data)
+int SyncManager::etaSeconds() const
 {
-    return QMessageAuthenticationCode::hash(data, key, QCryptographicHash::Sha256);
+    return m_etaSeconds;
 }
 
-QString SyncManager::hashSha256(const QString &data)
+void SyncManager::updateLastSyncTime()
 {
-    return QString::fromLatin1(QCryptographicHash::hash(data.toUtf8(), QCryptographicHash::Sha256).toHex());
+    QString now = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    QSqlQuery query;
+    query.prepare(QStringLiteral("INSERT OR REPLACE INTO SyncMetadata (Key, Value) VALUES ('LastSync', :value)"));
+    query.bindValue(QStringLiteral(":value"), now);
+    query.exec();
 }
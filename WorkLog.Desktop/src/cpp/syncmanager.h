@@ -2,30 +2,19 @@
 #define SYNCMANAGER_H
 
 #include <QObject>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
-#include <QCryptographicHash>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
 
-class DatabaseManager;
+#include "syncbackend.h"
 
-struct SyncConfig {
-    QString awsAccessKeyId;
-    QString awsSecretAccessKey;
-    QString awsRegion;
-    QString profileId;
-    QString sessionsTableName;
-    QString tagsTableName;
-
-    bool isValid() const {
-        return !awsAccessKeyId.isEmpty() &&
-               !awsSecretAccessKey.isEmpty() &&
-               !profileId.isEmpty();
-    }
-};
+#include <functional>
+
+class DatabaseManager;
+class QSqlQuery;
 
 struct SyncResult {
     bool success = false;
@@ -34,6 +23,7 @@ struct SyncResult {
     int sessionsDownloaded = 0;
     int tagsUploaded = 0;
     int tagsDownloaded = 0;
+    bool cancelled = false;
 };
 
 class SyncManager : public QObject
@@ -42,6 +32,11 @@ class SyncManager : public QObject
     Q_PROPERTY(bool isConfigured READ isConfigured NOTIFY configurationChanged)
     Q_PROPERTY(bool isSyncing READ isSyncing NOTIFY syncingChanged)
     Q_PROPERTY(QString lastSyncTime READ lastSyncTime NOTIFY lastSyncTimeChanged)
+    Q_PROPERTY(QString syncPhase READ syncPhase NOTIFY progressChanged)
+    Q_PROPERTY(qint64 itemsProcessed READ itemsProcessed NOTIFY progressChanged)
+    Q_PROPERTY(qint64 totalItems READ totalItems NOTIFY progressChanged)
+    Q_PROPERTY(qint64 bytesTransferred READ bytesTransferred NOTIFY progressChanged)
+    Q_PROPERTY(int etaSeconds READ etaSeconds NOTIFY progressChanged)
 
 public:
     explicit SyncManager(DatabaseManager *db, QObject *parent = nullptr);
@@ -50,14 +45,30 @@ public:
     bool isSyncing() const;
     QString lastSyncTime() const;
 
+    // Progress of the running sync. totalItems is 0 while unknown (during
+    // the download) and etaSeconds is -1 until an estimate is possible.
+    QString syncPhase() const;
+    qint64 itemsProcessed() const;
+    qint64 totalItems() const;
+    qint64 bytesTransferred() const;
+    int etaSeconds() const;
+
     Q_INVOKABLE void loadConfiguration();
     Q_INVOKABLE void saveConfiguration(const QString &accessKeyId,
                                        const QString &secretAccessKey,
                                        const QString &region,
                                        const QString &profileId);
+    Q_INVOKABLE void saveDirectoryConfiguration(const QString &directory,
+                                                const QString &profileId);
     Q_INVOKABLE void sync();
+    // A sync that fetches everything regardless of digests, and rewrites
+    // any digest that turns out stale
+    Q_INVOKABLE void verify();
+    Q_INVOKABLE void cancel();
     Q_INVOKABLE void testConnection();
 
+    Q_INVOKABLE QString getBackend() const;
+    Q_INVOKABLE QString getSyncDirectory() const;
     Q_INVOKABLE QString getProfileId() const;
     Q_INVOKABLE QString getAwsRegion() const;
     Q_INVOKABLE QString getAwsAccessKeyId() const;
@@ -67,48 +78,128 @@ signals:
     void configurationChanged();
     void syncingChanged();
     void lastSyncTimeChanged();
+    void progressChanged();
     void syncCompleted(bool success, const QString &message);
     void connectionTestCompleted(bool success, const QString &message);
     void errorOccurred(const QString &error);
 
 private slots:
-    void onSyncRequestFinished(QNetworkReply *reply);
+    void onTagsReceived(const QVector<SyncTagRecord> &tags);
+    void onTagsFetched();
+    void onSessionsReceived(const QVector<SyncSessionRecord> &sessions);
+    void onFetchScope(const QStringList &days);
+    void onFetchFinished(bool success, const QString &errorMessage);
+    void onUploadFinished(bool success, const QString &errorMessage);
+    void onBatchFinished();
+    void onBytesTransferred(qint64 bytes);
+    void onUploadProgress(int recordsStored);
+    void onRecordStored(const QString &cloudId, qint64 hlc);
 
 private:
     QString configFilePath() const;
-    QString signRequest(const QString &method, const QString &service,
-                       const QString &host, const QString &canonicalUri,
-                       const QString &payload, const QDateTime &timestamp,
-                       const QString &amzTarget);
-    QByteArray hmacSha256(const QByteArray &key, const QByteArray &data);
-    QString hashSha256(const QString &data);
-
-    void syncTags();
-    void syncSessions();
-    void uploadTag(const QVariantMap &tag);
-    void uploadSession(const QVariantMap &session);
-    void downloadTags(const QJsonArray &items);
-    void downloadSessions(const QJsonArray &items);
-
-    void queryTable(const QString &tableName, const QString &operation);
-    void putItem(const QString &tableName, const QJsonObject &item);
+    void writeConfiguration();
+    void createBackend();
+    void startSync(bool verify);
+
+    void loadLocalTags();
+    // Hot and archived sessions; false if one could not be read
+    bool loadLocalSessions();
+    void startFetch();
+
+    // Runs whatever stage of the pipeline has its inputs ready
+    void advance();
+    // One merge stage in its own transaction, queueing m_outgoing with it
+    bool runStage(const std::function<bool()> &stage);
+    // True if the UI has a batch open on the writer, which a stage would
+    // join and share the fate of; step runs again once the batch ends
+    bool waitForBatch(void (SyncManager::*step)());
+    void failRun();
+    void startEarlyUpload();
+
+    // Merge stages
+    bool assignNewRecords();
+    bool syncTags();
+    bool mergeCloudSessions();
+    bool queueLocalSessions();
+    bool failMerge(const QSqlQuery &query);
+    // Re-read a snapshot record that was edited since it was loaded;
+    // *found is false for a session not in the hot table
+    bool reloadLocalTag(int index);
+    bool reloadLocalSession(int index, bool *found);
+    // Digests of the sessions as stored now, after the merge
+    bool loadDigestTree(SyncDigestTree *tree);
+
+    // Write-ahead outbox: outgoing records are queued in the merge
+    // transaction and removed once the target confirms them
+    bool enqueueOutgoing();
+    SyncChangeset loadOutbox();
+    void flushStoredKeys();
 
     void finishSync();
     void updateLastSyncTime();
+    void setPhase(const QString &phase, qint64 totalItems);
+    void reportProgress(bool force = false);
 
     DatabaseManager *m_database;
-    QNetworkAccessManager *m_networkManager;
+    SyncBackend *m_backend = nullptr;
+    quint64 m_syncTraceId = 0;
     SyncConfig m_config;
     bool m_isSyncing = false;
     SyncResult m_currentResult;
 
-    int m_pendingRequests = 0;
-    QList<QVariantMap> m_localTags;
-    QList<QVariantMap> m_localSessions;
-    QJsonArray m_cloudTags;
-    QJsonArray m_cloudSessions;
-    bool m_tagsDownloaded = false;
-    bool m_sessionsDownloaded = false;
+    // Stages of a run. A previous run's outbox goes first. The fetch then
+    // overlaps with the upload of new records, which cannot conflict with
+    // anything on the target. Tags merge as soon as all are in and session
+    // pages merge as they arrive after them. Local changes are queued once
+    // the fetch is complete, and the outbox goes once the early upload has
+    // settled, so nothing is sent twice.
+    enum class Stage {
+        Idle,
+        Resuming,
+        Fetching,
+        Uploading
+    };
+    struct Pipeline {
+        bool newRecordsQueued = false;
+        bool earlyUpload = false;
+        bool tagsFetched = false;
+        bool tagsMerged = false;
+        bool fetchDone = false;
+        bool merged = false;
+    };
+    Stage m_stage = Stage::Idle;
+    Pipeline m_pipeline;
+
+    QVector<SyncTagRecord> m_localTags;
+    QVector<SyncSessionRecord> m_localSessions;
+    QHash<QString, int> m_localSessionIndex;
+    QVector<SyncTagRecord> m_cloudTags;
+    QVector<SyncSessionRecord> m_cloudSessions;
+    // Cloud sessions before this index are merged
+    int m_mergedCloudSessions = 0;
+    // New records queued ahead of the merge, by local id
+    QSet<qint64> m_queuedTagIds;
+    QSet<qint64> m_queuedSessionIds;
+    SyncChangeset m_outgoing;
+    QStringList m_storedKeys;
+    // Steps waiting for the UI's batch to end, in order
+    QVector<void (SyncManager::*)()> m_afterBatch;
+
+    // Digest reconciliation: a verify run ignores the digests, and a
+    // scoped fetch only covers the sessions dated in m_fetchScope
+    bool m_verify = false;
+    bool m_scoped = false;
+    // A merge moved an archived year back into the hot table
+    bool m_archivesRestored = false;
+    QSet<QString> m_fetchScope;
+
+    QString m_phase;
+    qint64 m_itemsProcessed = 0;
+    qint64 m_totalItems = 0;
+    qint64 m_bytesTransferred = 0;
+    int m_etaSeconds = -1;
+    QElapsedTimer m_phaseTimer;
+    QElapsedTimer m_progressTimer;
 };
 
 #endif // SYNCMANAGER_H
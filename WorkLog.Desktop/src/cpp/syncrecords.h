@@ -0,0 +1,71 @@
+#ifndef SYNCRECORDS_H
+#define SYNCRECORDS_H
+
+#include <QString>
+#include <QVector>
+
+#include <tuple>
+
+// Typed sync records shared by the merge and the wire formats. Timestamps
+// keep the SQLite text form ("yyyy-MM-dd HH:mm:ss"); conflicts are decided
+// by hlc, a HybridClock timestamp. localId is the row id on this machine
+// and is 0 for records that came from the cloud.
+
+struct SyncTagRecord {
+    qint64 localId = 0;
+    QString cloudId;
+    QString name;
+    QString updatedAt;
+    qint64 hlc = 0;
+    bool isDeleted = false;
+};
+
+struct SyncSessionRecord {
+    // Bits of WorkSessions.DirtyFields: fields edited locally since the
+    // session was last uploaded. 0 means unknown, i.e. send everything.
+    enum DirtyField {
+        DateDirty = 0x01,
+        HoursDirty = 0x02,
+        DescriptionDirty = 0x04,
+        NotesDirty = 0x08,
+        NextStageDirty = 0x10,
+        TagDirty = 0x20
+    };
+
+    qint64 localId = 0;
+    QString cloudId;
+    QString sessionDate;
+    double timeHours = 0.0;
+    QString description;
+    QString notes;
+    QString nextPlannedStage;
+    // Local Tags.Id, 0 when untagged or not stored here
+    qint64 tagId = 0;
+    QString tagCloudId;
+    QString createdAt;
+    QString updatedAt;
+    qint64 hlc = 0;
+    bool isDeleted = false;
+    int dirtyFields = 0;
+};
+
+// True when a should replace b. The later clock wins; on equal clocks the
+// content decides, so every machine settles on the same record.
+inline bool supersedes(const SyncTagRecord &a, const SyncTagRecord &b)
+{
+    if (a.hlc != b.hlc)
+        return a.hlc > b.hlc;
+    return std::tie(a.isDeleted, a.name) > std::tie(b.isDeleted, b.name);
+}
+
+inline bool supersedes(const SyncSessionRecord &a, const SyncSessionRecord &b)
+{
+    if (a.hlc != b.hlc)
+        return a.hlc > b.hlc;
+    return std::tie(a.isDeleted, a.sessionDate, a.timeHours, a.description,
+                    a.notes, a.nextPlannedStage, a.tagCloudId)
+        > std::tie(b.isDeleted, b.sessionDate, b.timeHours, b.description,
+                   b.notes, b.nextPlannedStage, b.tagCloudId);
+}
+
+#endif // SYNCRECORDS_H
@@ -1,11 +1,13 @@
 #include "tagmodel.h"
 #include "databasemanager.h"
+#include "diagnostics.h"
 
 TagModel::TagModel(DatabaseManager *db, QObject *parent)
     : QAbstractListModel(parent)
     , m_database(db)
 {
     connect(m_database, &DatabaseManager::tagsChanged, this, &TagModel::onTagsChanged);
+    connect(m_database, &DatabaseManager::opened, this, &TagModel::refresh);
     refresh();
 }
 
@@ -48,8 +50,9 @@ int TagModel::count() const
 
 void TagModel::refresh()
 {
+    const DiagnosticsTimer timer("model.TagModel.reset");
     beginResetModel();
-    m_tags = m_database->getAllTags();
+    m_tags = m_database->isOpen() ? m_database->getAllTags() : QVariantList();
     endResetModel();
     emit countChanged();
 }
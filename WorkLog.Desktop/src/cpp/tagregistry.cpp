@@ -0,0 +1,140 @@
+#include "tagregistry.h"
+#include "diagnostics.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+void TagRegistry::invalidate()
+{
+    m_loaded = false;
+    m_entries.clear();
+    m_idByCloudId.clear();
+    m_idByName.clear();
+}
+
+QString TagRegistry::cloudIdForId(int id) const
+{
+    ensureLoaded();
+    return m_entries.value(id).cloudId;
+}
+
+QString TagRegistry::nameForId(int id) const
+{
+    ensureLoaded();
+    return m_entries.value(id).name;
+}
+
+int TagRegistry::idForCloudId(const QString &cloudId) const
+{
+    if (cloudId.isEmpty())
+        return -1;
+    ensureLoaded();
+    return m_idByCloudId.value(cloudId, -1);
+}
+
+int TagRegistry::idForName(const QString &name) const
+{
+    ensureLoaded();
+    return m_idByName.value(name.trimmed().toCaseFolded(), -1);
+}
+
+int TagRegistry::deletedIdForName(const QString &name) const
+{
+    ensureLoaded();
+    // Deleted names are not indexed; there are few of them
+    const QString key = name.trimmed().toCaseFolded();
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        if (it->isDeleted && it->name.toCaseFolded() == key)
+            return it.key();
+    }
+    return -1;
+}
+
+bool TagRegistry::isLive(int id) const
+{
+    ensureLoaded();
+    const auto it = m_entries.constFind(id);
+    return it != m_entries.constEnd() && !it->isDeleted;
+}
+
+void TagRegistry::insert(int id, const QString &name, const QString &cloudId, bool isDeleted)
+{
+    // Not loaded yet: the row is read with the rest on the next lookup
+    if (!m_loaded)
+        return;
+
+    unindex(id);
+    Entry entry;
+    entry.name = name;
+    entry.cloudId = cloudId;
+    entry.isDeleted = isDeleted;
+    index(id, entry);
+}
+
+void TagRegistry::remove(int id)
+{
+    if (m_loaded)
+        unindex(id);
+}
+
+void TagRegistry::setCloudId(int id, const QString &cloudId)
+{
+    if (!m_loaded)
+        return;
+
+    const auto it = m_entries.constFind(id);
+    if (it == m_entries.constEnd())
+        return;
+    Entry entry = it.value();
+    entry.cloudId = cloudId;
+    unindex(id);
+    index(id, entry);
+}
+
+void TagRegistry::ensureLoaded() const
+{
+    if (m_loaded)
+        return;
+
+    const DiagnosticsTimer timer("db.loadTagRegistry");
+    m_loaded = true;
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!query.exec(QStringLiteral("SELECT Id, Name, CloudId, IsDeleted FROM Tags"))) {
+        qWarning() << "Failed to load tags:" << query.lastError().text();
+        return;
+    }
+    while (query.next()) {
+        Entry entry;
+        entry.name = query.value(1).toString();
+        entry.cloudId = query.value(2).toString();
+        entry.isDeleted = query.value(3).toBool();
+        index(query.value(0).toInt(), entry);
+    }
+}
+
+void TagRegistry::index(int id, const Entry &entry) const
+{
+    m_entries.insert(id, entry);
+    if (!entry.cloudId.isEmpty())
+        m_idByCloudId.insert(entry.cloudId, id);
+    if (!entry.isDeleted)
+        m_idByName.insert(entry.name.toCaseFolded(), id);
+}
+
+void TagRegistry::unindex(int id) const
+{
+    const auto it = m_entries.constFind(id);
+    if (it == m_entries.constEnd())
+        return;
+
+    // Only drop index keys that still point at this tag
+    if (m_idByCloudId.value(it->cloudId, -1) == id)
+        m_idByCloudId.remove(it->cloudId);
+    const QString nameKey = it->name.toCaseFolded();
+    if (m_idByName.value(nameKey, -1) == id)
+        m_idByName.remove(nameKey);
+    m_entries.erase(it);
+}
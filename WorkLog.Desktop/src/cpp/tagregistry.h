@@ -0,0 +1,51 @@
+#ifndef TAGREGISTRY_H
+#define TAGREGISTRY_H
+
+#include <QHash>
+#include <QString>
+
+// In-memory index of the Tags table: local id, CloudId and name of every
+// tag, so lookups in any direction cost no query. It reads the writer
+// (default) connection. DatabaseManager keeps it in step with its tag
+// writes, the sync merge updates it alongside its own, and writers on other
+// connections (the importer) invalidate() it; the table is then read again
+// on the next lookup.
+class TagRegistry
+{
+public:
+    void invalidate();
+
+    // Empty or -1 when there is no such tag
+    QString cloudIdForId(int id) const;
+    QString nameForId(int id) const;
+    int idForCloudId(const QString &cloudId) const;
+    // Case-insensitive; deleted tags are not found by name
+    int idForName(const QString &name) const;
+    // The same among deleted tags only
+    int deletedIdForName(const QString &name) const;
+    // True for a tag that exists and is not deleted
+    bool isLive(int id) const;
+
+    void insert(int id, const QString &name, const QString &cloudId = QString(),
+                bool isDeleted = false);
+    void remove(int id);
+    void setCloudId(int id, const QString &cloudId);
+
+private:
+    struct Entry {
+        QString name;
+        QString cloudId;
+        bool isDeleted = false;
+    };
+
+    void ensureLoaded() const;
+    void index(int id, const Entry &entry) const;
+    void unindex(int id) const;
+
+    mutable bool m_loaded = false;
+    mutable QHash<int, Entry> m_entries;
+    mutable QHash<QString, int> m_idByCloudId;
+    mutable QHash<QString, int> m_idByName;
+};
+
+#endif // TAGREGISTRY_H
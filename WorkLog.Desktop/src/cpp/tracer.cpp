@@ -0,0 +1,210 @@
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QDebug>
+
+namespace {
+
+// Pending events are written out once this many bytes have accumulated
+constexpr int FlushThreshold = 256 * 1024;
+
+struct TraceState {
+    QMutex mutex;
+    QFile file;
+    QByteArray pending;
+    bool firstEvent = true;
+    QElapsedTimer clock;
+    QAtomicInt nextThreadId = 1;
+    QAtomicInteger<quint64> nextAsyncId = 1;
+    qint64 pid = 0;
+};
+
+TraceState &state()
+{
+    static TraceState traceState;
+    return traceState;
+}
+
+thread_local int t_threadId = 0;
+
+void appendJsonString(QByteArray &out, const QByteArray &value)
+{
+    out.append('"');
+    for (const char c : value) {
+        if (c == '"' || c == '\\')
+            out.append('\\');
+        if (static_cast<unsigned char>(c) >= 0x20)
+            out.append(c);
+    }
+    out.append('"');
+}
+
+QByteArray categoryOf(const QByteArray &name)
+{
+    const int dot = name.indexOf('.');
+    return dot > 0 ? name.left(dot) : QByteArrayLiteral("app");
+}
+
+void appendEventLocked(TraceState &traceState, const QByteArray &event)
+{
+    if (!traceState.firstEvent)
+        traceState.pending.append(",\n", 2);
+    traceState.firstEvent = false;
+    traceState.pending.append(event);
+
+    if (traceState.pending.size() >= FlushThreshold) {
+        traceState.file.write(traceState.pending);
+        traceState.pending.clear();
+    }
+}
+
+int currentThreadId()
+{
+    if (t_threadId != 0)
+        return t_threadId;
+
+    TraceState &traceState = state();
+    t_threadId = traceState.nextThreadId.fetchAndAddRelaxed(1);
+
+    // Name the track once, so Perfetto shows "main" or the QThread name
+    QString threadName = QThread::currentThread()->objectName();
+    if (threadName.isEmpty()) {
+        const bool isMain = QCoreApplication::instance()
+            && QThread::currentThread() == QCoreApplication::instance()->thread();
+        threadName = isMain ? QStringLiteral("main") : QStringLiteral("worker-%1").arg(t_threadId);
+    }
+
+    QByteArray event = "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":";
+    event += QByteArray::number(traceState.pid);
+    event += ",\"tid\":";
+    event += QByteArray::number(t_threadId);
+    event += ",\"args\":{\"name\":";
+    appendJsonString(event, threadName.toUtf8());
+    event += "}}";
+
+    QMutexLocker locker(&traceState.mutex);
+    appendEventLocked(traceState, event);
+    return t_threadId;
+}
+
+} // namespace
+
+QAtomicInt Tracer::s_enabled;
+
+void Tracer::initializeFromEnvironment()
+{
+    const QString path = qEnvironmentVariable("WORKLOG_TRACE_FILE");
+    if (path.isEmpty() || isEnabled())
+        return;
+
+    TraceState &traceState = state();
+    traceState.file.setFileName(path);
+    if (!traceState.file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot open trace file" << path << traceState.file.errorString();
+        return;
+    }
+
+    traceState.pid = QCoreApplication::applicationPid();
+    traceState.clock.start();
+    traceState.file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    s_enabled.storeRelease(1);
+
+    if (QCoreApplication::instance()) {
+        QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, &Tracer::finish);
+    }
+}
+
+void Tracer::finish()
+{
+    if (!isEnabled())
+        return;
+    s_enabled.storeRelease(0);
+
+    TraceState &traceState = state();
+    QMutexLocker locker(&traceState.mutex);
+    traceState.pending.append("\n]}\n");
+    traceState.file.write(traceState.pending);
+    traceState.pending.clear();
+    traceState.file.close();
+}
+
+qint64 Tracer::nowUs()
+{
+    return state().clock.nsecsElapsed() / 1000;
+}
+
+void Tracer::complete(const char *name, qint64 startUs, qint64 durationUs)
+{
+    if (!isEnabled())
+        return;
+    writeEvent('X', QByteArray::fromRawData(name, int(qstrlen(name))), startUs, durationUs, 0);
+}
+
+quint64 Tracer::nextAsyncId()
+{
+    return state().nextAsyncId.fetchAndAddRelaxed(1);
+}
+
+void Tracer::asyncBegin(const QByteArray &name, quint64 id)
+{
+    if (!isEnabled())
+        return;
+    writeEvent('b', name, nowUs(), 0, id);
+}
+
+void Tracer::asyncEnd(const QByteArray &name, quint64 id)
+{
+    if (!isEnabled())
+        return;
+    writeEvent('e', name, nowUs(), 0, id);
+}
+
+void Tracer::instant(const char *name)
+{
+    if (!isEnabled())
+        return;
+    writeEvent('i', QByteArray::fromRawData(name, int(qstrlen(name))), nowUs(), 0, 0);
+}
+
+void Tracer::writeEvent(char phase, const QByteArray &name,
+                        qint64 timestampUs, qint64 durationUs, quint64 id)
+{
+    TraceState &traceState = state();
+    const int tid = currentThreadId();
+
+    QByteArray event;
+    event.reserve(160);
+    event += "{\"ph\":\"";
+    event += phase;
+    event += "\",\"cat\":";
+    appendJsonString(event, categoryOf(name));
+    event += ",\"name\":";
+    appendJsonString(event, name);
+    event += ",\"ts\":";
+    event += QByteArray::number(timestampUs);
+    if (phase == 'X') {
+        event += ",\"dur\":";
+        event += QByteArray::number(durationUs);
+    } else if (phase == 'b' || phase == 'e') {
+        event += ",\"id\":\"0x";
+        event += QByteArray::number(id, 16);
+        event += '"';
+    } else if (phase == 'i') {
+        event += ",\"s\":\"t\"";
+    }
+    event += ",\"pid\":";
+    event += QByteArray::number(traceState.pid);
+    event += ",\"tid\":";
+    event += QByteArray::number(tid);
+    event += '}';
+
+    QMutexLocker locker(&traceState.mutex);
+    if (!isEnabled())
+        return; // finished while this event was being formatted
+    appendEventLocked(traceState, event);
+}
@@ -0,0 +1,61 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+
+// Optional timeline recorder writing Chrome trace_event JSON, which can be
+// opened in Perfetto or chrome://tracing. Enabled by setting
+// WORKLOG_TRACE_FILE=/path/to/trace.json before start-up.
+//
+// When disabled every entry point reduces to a relaxed atomic load, so
+// call sites do not need to be guarded.
+class Tracer
+{
+public:
+    static void initializeFromEnvironment();
+    static void finish();
+
+    static bool isEnabled() { return s_enabled.loadRelaxed() != 0; }
+    static qint64 nowUs();
+
+    // Complete span; the category is taken from the name up to the first '.'
+    static void complete(const char *name, qint64 startUs, qint64 durationUs);
+    // Spans that begin and end in different call stacks (network requests)
+    static quint64 nextAsyncId();
+    static void asyncBegin(const QByteArray &name, quint64 id);
+    static void asyncEnd(const QByteArray &name, quint64 id);
+    static void instant(const char *name);
+
+private:
+    static void writeEvent(char phase, const QByteArray &name,
+                           qint64 timestampUs, qint64 durationUs, quint64 id);
+
+    static QAtomicInt s_enabled;
+};
+
+// Records the enclosing scope as a complete span.
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name)
+        : m_name(name)
+        , m_startUs(Tracer::isEnabled() ? Tracer::nowUs() : -1)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (m_startUs >= 0)
+            Tracer::complete(m_name, m_startUs, Tracer::nowUs() - m_startUs);
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *m_name;
+    qint64 m_startUs;
+};
+
+#endif // TRACER_H
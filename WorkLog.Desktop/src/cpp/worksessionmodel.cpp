@@ -1,5 +1,6 @@
 #include "worksessionmodel.h"
 #include "databasemanager.h"
+#include "diagnostics.h"
 
 WorkSessionModel::WorkSessionModel(DatabaseManager *db, QObject *parent)
     : QAbstractListModel(parent)
@@ -7,6 +8,7 @@ WorkSessionModel::WorkSessionModel(DatabaseManager *db, QObject *parent)
     , m_currentDate(QDate::currentDate())
 {
     connect(m_database, &DatabaseManager::dataChanged, this, &WorkSessionModel::onDataChanged);
+    connect(m_database, &DatabaseManager::opened, this, &WorkSessionModel::refresh);
     refresh();
 }
 
@@ -68,6 +70,8 @@ QDate WorkSessionModel::currentDate() const
 void WorkSessionModel::setCurrentDate(const QDate &date)
 {
     if (m_currentDate != date) {
+        if (date.isValid())
+            m_database->attachYears(date.year(), date.year());
         m_currentDate = date;
         emit currentDateChanged();
         refresh();
@@ -81,12 +85,33 @@ int WorkSessionModel::count() const
 
 void WorkSessionModel::refresh()
 {
+    const DiagnosticsTimer timer("model.WorkSessionModel.reset");
     beginResetModel();
-    m_sessions = m_database->getSessionsForDate(m_currentDate);
+    if (m_database->isOpen()) {
+        m_sessions = m_database->getSessionsForDate(m_currentDate);
+        prefetchNeighbours();
+    } else {
+        // Days older than the snapshot keeps stay empty until it is open
+        m_database->snapshot().sessionsForDate(m_currentDate, &m_sessions);
+    }
     endResetModel();
     emit countChanged();
 }
 
+void WorkSessionModel::prefetchNeighbours()
+{
+    // Stepping to either side or through the rest of the week then finds
+    // the day cached
+    QList<QDate> dates{m_currentDate.addDays(-1), m_currentDate.addDays(1)};
+    const QDate monday = m_currentDate.addDays(1 - m_currentDate.dayOfWeek());
+    for (int i = 0; i < 7; ++i) {
+        const QDate date = monday.addDays(i);
+        if (date != m_currentDate && !dates.contains(date))
+            dates.append(date);
+    }
+    m_database->prefetchDays(dates);
+}
+
 void WorkSessionModel::onDataChanged()
 {
     refresh();
@@ -45,6 +45,8 @@ private slots:
     void onDataChanged();
 
 private:
+    void prefetchNeighbours();
+
     DatabaseManager *m_database;
     QDate m_currentDate;
     QVariantList m_sessions;
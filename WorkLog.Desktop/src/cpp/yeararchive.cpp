@@ -0,0 +1,432 @@
+#include "yeararchive.h"
+#include "diagnostics.h"
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QDebug>
+
+#include <algorithm>
+
+namespace {
+
+// Listed explicitly: the hot table gains columns by migration, archives
+// keep the ones they were written with
+constexpr char SessionColumns[] =
+    "Id, SessionDate, TimeHours, Description, Notes, NextPlannedStage, TagId, "
+    "CreatedAt, UpdatedAt, Hlc, DirtyFields, CloudId, IsDeleted, TagCloudId";
+
+struct ConnectionState {
+    QSet<int> attached;
+    quint64 version = 0;
+};
+
+QMutex s_mutex;
+QSet<int> s_archived;
+// Most recently asked for last
+QList<int> s_requiredYears;
+// Bumped whenever a connection may have to attach or detach
+quint64 s_version = 1;
+QHash<QString, ConnectionState> s_connections;
+QAtomicInt s_nextArchiveId = 1;
+
+QString schemaName(int year)
+{
+    return QStringLiteral("archive_%1").arg(year);
+}
+
+QString firstDay(int year)
+{
+    return QStringLiteral("%1-01-01").arg(year, 4, 10, QLatin1Char('0'));
+}
+
+QString lastDay(int year)
+{
+    return QStringLiteral("%1-12-31").arg(year, 4, 10, QLatin1Char('0'));
+}
+
+bool fail(QSqlQuery &query, QString *errorString)
+{
+    if (errorString)
+        *errorString = query.lastError().text();
+    return false;
+}
+
+// The archived years readers attach; called with s_mutex held
+QSet<int> readerYears()
+{
+    QSet<int> years;
+    for (int i = s_requiredYears.size() - 1; i >= 0 && years.size() < YearArchive::MaxAttached; --i) {
+        if (s_archived.contains(s_requiredYears.at(i)))
+            years.insert(s_requiredYears.at(i));
+    }
+    return years;
+}
+
+} // namespace
+
+QString YearArchive::pathForYear(const QString &databasePath, int year)
+{
+    const QFileInfo info(databasePath);
+    return info.dir().filePath(QStringLiteral("%1.%2.db").arg(info.completeBaseName()).arg(year));
+}
+
+void YearArchive::load(QSqlDatabase &writer)
+{
+    QSet<int> archived;
+    QSqlQuery query(writer);
+    if (!query.exec(QStringLiteral("SELECT Year FROM Archives"))) {
+        qWarning() << "Failed to read archives:" << query.lastError().text();
+        return;
+    }
+    while (query.next())
+        archived.insert(query.value(0).toInt());
+
+    {
+        QMutexLocker locker(&s_mutex);
+        if (archived != s_archived) {
+            s_archived = archived;
+            ++s_version;
+        }
+    }
+
+    // Left behind by a year moved back, or an archive run that stopped
+    // before the hot table let go of the year
+    const QFileInfo info(writer.databaseName());
+    const QStringList files = info.dir().entryList(
+        {QStringLiteral("%1.????.db").arg(info.completeBaseName())}, QDir::Files);
+    for (const QString &file : files) {
+        bool ok = false;
+        const int year = file.section(QLatin1Char('.'), -2, -2).toInt(&ok);
+        if (ok && !archived.contains(year) && pathForYear(writer.databaseName(), year) == info.dir().filePath(file))
+            QFile::remove(info.dir().filePath(file));
+    }
+}
+
+QList<int> YearArchive::archivedYears()
+{
+    QMutexLocker locker(&s_mutex);
+    QList<int> years = s_archived.values();
+    std::sort(years.begin(), years.end());
+    return years;
+}
+
+bool YearArchive::isArchived(int year)
+{
+    QMutexLocker locker(&s_mutex);
+    return s_archived.contains(year);
+}
+
+bool YearArchive::requireYears(int first, int last)
+{
+    QMutexLocker locker(&s_mutex);
+    const QSet<int> before = readerYears();
+    for (int year = first; year <= last; ++year) {
+        s_requiredYears.removeOne(year);
+        s_requiredYears.append(year);
+    }
+    const QSet<int> after = readerYears();
+    if (after == before)
+        return false;
+    ++s_version;
+    return !(after - before).isEmpty();
+}
+
+void YearArchive::applyReader(QSqlDatabase &db)
+{
+    QSet<int> years;
+    quint64 version = 0;
+    {
+        QMutexLocker locker(&s_mutex);
+        version = s_version;
+        if (s_connections.value(db.connectionName()).version == version)
+            return;
+        years = readerYears();
+    }
+    // Views have no way to report it; the year reads as empty
+    QString error;
+    if (!apply(db, years, version, &error))
+        qWarning() << "Failed to attach archives:" << error;
+}
+
+bool YearArchive::applyRange(QSqlDatabase &db, int first, int last, QString *errorString)
+{
+    QSet<int> years;
+    quint64 version = 0;
+    {
+        QMutexLocker locker(&s_mutex);
+        version = s_version;
+        for (int year : qAsConst(s_archived)) {
+            if (year >= first && year <= last)
+                years.insert(year);
+        }
+    }
+    if (years.size() > MaxAttached) {
+        if (errorString)
+            *errorString = QStringLiteral("%1 archived years between %2 and %3, more than %4 can be attached")
+                               .arg(years.size()).arg(first).arg(last).arg(MaxAttached);
+        return false;
+    }
+    return apply(db, years, version, errorString);
+}
+
+QList<QPair<int, int>> YearArchive::splitRange(int first, int last)
+{
+    QList<int> years;
+    const QList<int> archived = archivedYears();
+    for (int year : archived) {
+        if (year >= first && year <= last)
+            years.append(year);
+    }
+
+    QList<QPair<int, int>> ranges;
+    int start = first;
+    for (int i = MaxAttached; i < years.size(); i += MaxAttached) {
+        ranges.append({start, years.at(i) - 1});
+        start = years.at(i);
+    }
+    ranges.append({start, last});
+    return ranges;
+}
+
+void YearArchive::release(const QString &connectionName)
+{
+    QMutexLocker locker(&s_mutex);
+    s_connections.remove(connectionName);
+}
+
+bool YearArchive::apply(QSqlDatabase &db, const QSet<int> &years, quint64 version, QString *errorString)
+{
+    const DiagnosticsTimer timer("db.archive.attach");
+    ConnectionState state;
+    {
+        QMutexLocker locker(&s_mutex);
+        state = s_connections.value(db.connectionName());
+    }
+
+    QSqlQuery query(db);
+    // The view names the schemas, so it goes before they do
+    query.exec(QStringLiteral("DROP VIEW IF EXISTS temp.WorkSessions"));
+
+    const QSet<int> attached = state.attached;
+    for (int year : attached) {
+        if (years.contains(year))
+            continue;
+        if (query.exec(QStringLiteral("DETACH DATABASE %1").arg(schemaName(year))))
+            state.attached.remove(year);
+        else
+            qWarning() << "Failed to detach archive:" << year << query.lastError().text();
+    }
+    bool ok = true;
+    for (int year : years) {
+        if (state.attached.contains(year))
+            continue;
+        query.prepare(QStringLiteral("ATTACH DATABASE :path AS %1").arg(schemaName(year)));
+        query.bindValue(QStringLiteral(":path"), pathForYear(db.databaseName(), year));
+        if (query.exec()) {
+            state.attached.insert(year);
+        } else if (ok) {
+            ok = fail(query, errorString);
+        }
+    }
+
+    QList<int> sorted = state.attached.values();
+    std::sort(sorted.begin(), sorted.end());
+    QStringList selects{QStringLiteral("SELECT %1 FROM main.WorkSessions").arg(QLatin1String(SessionColumns))};
+    for (int year : qAsConst(sorted)) {
+        selects.append(QStringLiteral("SELECT %1 FROM %2.WorkSessions WHERE EXISTS (SELECT 1 FROM main.Archives WHERE Year = %3)")
+                           .arg(QLatin1String(SessionColumns), schemaName(year), QString::number(year)));
+    }
+
+    // Without archives the table itself is read
+    if (selects.size() > 1
+        && !query.exec(QStringLiteral("CREATE TEMP VIEW WorkSessions AS %1").arg(selects.join(QStringLiteral(" UNION ALL "))))
+        && ok) {
+        ok = fail(query, errorString);
+    }
+
+    state.version = version;
+    QMutexLocker locker(&s_mutex);
+    s_connections.insert(db.connectionName(), state);
+    return ok;
+}
+
+bool YearArchive::archiveYear(QSqlDatabase &writer, int year, QString *errorString)
+{
+    const DiagnosticsTimer timer("db.archive.archiveYear");
+    const QString path = pathForYear(writer.databaseName(), year);
+    QFile::remove(path);
+
+    QSqlQuery query(writer);
+    query.prepare(QStringLiteral("ATTACH DATABASE :path AS archive_staging"));
+    query.bindValue(QStringLiteral(":path"), path);
+    if (!query.exec())
+        return fail(query, errorString);
+
+    // The archive commits on its own first; until the hot table lets go of
+    // the year below, the file is not listed and nothing reads it
+    bool copied = query.exec(QStringLiteral(R"(
+        CREATE TABLE archive_staging.WorkSessions (
+            Id INTEGER PRIMARY KEY,
+            SessionDate TEXT NOT NULL,
+            TimeHours REAL NOT NULL,
+            Description TEXT NOT NULL,
+            Notes TEXT,
+            NextPlannedStage TEXT,
+            TagId INTEGER,
+            CreatedAt TEXT NOT NULL,
+            UpdatedAt TEXT NOT NULL,
+            Hlc INTEGER NOT NULL DEFAULT 0,
+            DirtyFields INTEGER NOT NULL DEFAULT 0,
+            CloudId TEXT,
+            IsDeleted INTEGER NOT NULL DEFAULT 0,
+            TagCloudId TEXT
+        )
+    )"));
+    copied = copied && query.exec(QStringLiteral(
+        "CREATE INDEX archive_staging.idx_worksessions_date ON WorkSessions(SessionDate)"));
+    copied = copied && query.exec(QStringLiteral(
+        "CREATE INDEX archive_staging.idx_worksessions_cloudid ON WorkSessions(CloudId)"));
+    if (copied) {
+        query.prepare(QStringLiteral(R"(
+            INSERT INTO archive_staging.WorkSessions (%1)
+            SELECT %1 FROM main.WorkSessions WHERE SessionDate BETWEEN :first AND :last
+        )").arg(QLatin1String(SessionColumns)));
+        query.bindValue(QStringLiteral(":first"), firstDay(year));
+        query.bindValue(QStringLiteral(":last"), lastDay(year));
+        copied = query.exec();
+    }
+    const int sessions = copied ? query.numRowsAffected() : 0;
+    const QString copyError = query.lastError().text();
+    query.exec(QStringLiteral("DETACH DATABASE archive_staging"));
+    if (!copied || sessions <= 0) {
+        QFile::remove(path);
+        if (!copied && errorString)
+            *errorString = copyError;
+        return copied;
+    }
+
+    if (!writer.transaction()) {
+        QFile::remove(path);
+        if (errorString)
+            *errorString = writer.lastError().text();
+        return false;
+    }
+
+    query.prepare(QStringLiteral("INSERT INTO Archives (Year, Sessions) VALUES (:year, :sessions)"));
+    query.bindValue(QStringLiteral(":year"), year);
+    query.bindValue(QStringLiteral(":sessions"), sessions);
+    bool moved = query.exec();
+    if (moved) {
+        query.prepare(QStringLiteral(R"(
+            INSERT INTO ArchivedDays (SessionDate, TotalHours)
+            SELECT SessionDate, SUM(TimeHours) FROM main.WorkSessions
+            WHERE SessionDate BETWEEN :first AND :last AND IsDeleted = 0
+            GROUP BY SessionDate
+        )"));
+        query.bindValue(QStringLiteral(":first"), firstDay(year));
+        query.bindValue(QStringLiteral(":last"), lastDay(year));
+        moved = query.exec();
+    }
+    if (moved) {
+        query.prepare(QStringLiteral("DELETE FROM main.WorkSessions WHERE SessionDate BETWEEN :first AND :last"));
+        query.bindValue(QStringLiteral(":first"), firstDay(year));
+        query.bindValue(QStringLiteral(":last"), lastDay(year));
+        moved = query.exec();
+    }
+    if (moved && writer.commit())
+        return true;
+
+    if (errorString)
+        *errorString = moved ? writer.lastError().text() : query.lastError().text();
+    writer.rollback();
+    QFile::remove(path);
+    return false;
+}
+
+bool YearArchive::restoreYear(QSqlDatabase &writer, int year, QString *errorString)
+{
+    const DiagnosticsTimer timer("db.archive.restoreYear");
+    const int columns = QString::fromLatin1(SessionColumns).count(QLatin1Char(',')) + 1;
+    QStringList placeholders;
+    for (int i = 0; i < columns; ++i)
+        placeholders.append(QStringLiteral("?"));
+
+    // Ids were kept, and the hot table never hands them out again
+    QSqlQuery insert(writer);
+    insert.prepare(QStringLiteral("INSERT INTO main.WorkSessions (%1) VALUES (%2)")
+                       .arg(QLatin1String(SessionColumns), placeholders.join(QStringLiteral(", "))));
+    bool inserted = true;
+    const bool read = queryYear(writer, year,
+                                QStringLiteral("SELECT %1 FROM WorkSessions").arg(QLatin1String(SessionColumns)),
+                                QVariantMap(), [&](const QSqlQuery &row) {
+        for (int i = 0; i < columns; ++i)
+            insert.bindValue(i, row.value(i));
+        inserted = insert.exec();
+        return inserted;
+    }, errorString);
+    if (!inserted)
+        return fail(insert, errorString);
+    if (!read)
+        return false;
+
+    QSqlQuery query(writer);
+    query.prepare(QStringLiteral("DELETE FROM ArchivedDays WHERE SessionDate BETWEEN :first AND :last"));
+    query.bindValue(QStringLiteral(":first"), firstDay(year));
+    query.bindValue(QStringLiteral(":last"), lastDay(year));
+    if (!query.exec())
+        return fail(query, errorString);
+
+    query.prepare(QStringLiteral("DELETE FROM Archives WHERE Year = :year"));
+    query.bindValue(QStringLiteral(":year"), year);
+    if (!query.exec())
+        return fail(query, errorString);
+    return true;
+}
+
+bool YearArchive::queryYear(QSqlDatabase &writer, int year, const QString &sql,
+                            const QVariantMap &bindings,
+                            const std::function<bool(const QSqlQuery &row)> &onRow,
+                            QString *errorString)
+{
+    const DiagnosticsTimer timer("db.archive.queryYear");
+    {
+        // Moved back within the writer's transaction, or never archived
+        QSqlQuery listed(writer);
+        listed.prepare(QStringLiteral("SELECT 1 FROM Archives WHERE Year = :year"));
+        listed.bindValue(QStringLiteral(":year"), year);
+        if (!listed.exec())
+            return fail(listed, errorString);
+        if (!listed.next())
+            return true;
+    }
+
+    const QString connectionName = QStringLiteral("worklog-archive-%1").arg(s_nextArchiveId.fetchAndAddRelaxed(1));
+    bool ok = false;
+    {
+        QSqlDatabase archive = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
+        archive.setDatabaseName(pathForYear(writer.databaseName(), year));
+        archive.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
+        if (archive.open()) {
+            QSqlQuery query(archive);
+            query.setForwardOnly(true);
+            query.prepare(sql);
+            for (auto it = bindings.cbegin(); it != bindings.cend(); ++it)
+                query.bindValue(it.key(), it.value());
+            ok = query.exec() || fail(query, errorString);
+            while (ok && query.next())
+                ok = onRow(query);
+        } else if (errorString) {
+            *errorString = QStringLiteral("%1: %2").arg(archive.databaseName(), archive.lastError().text());
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    return ok;
+}
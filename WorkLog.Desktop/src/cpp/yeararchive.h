@@ -0,0 +1,87 @@
+#ifndef YEARARCHIVE_H
+#define YEARARCHIVE_H
+
+#include <QList>
+#include <QPair>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVariantMap>
+
+#include <functional>
+
+class QSqlQuery;
+
+// Closed years moved out of the hot database, one SQLite file per year
+// next to it ("worklog.2019.db"). An archive is written once and never
+// changed: the main database lists it in Archives and keeps its per-day
+// totals in ArchivedDays, which answer the year list, the year totals,
+// the heatmap and the snapshot without opening it. Editing an archived
+// session moves its whole year back first.
+//
+// Readers attach archives on demand. A reader attaches the archived ones
+// among the years asked for most recently (requireYears()), at most
+// MaxAttached of them, and gets a temporary WorkSessions view over the
+// hot table and those archives; temporary objects come first in name
+// resolution, so unqualified queries read through it unchanged. The view
+// skips archives no longer listed, so a year moved back inside a
+// transaction is not read twice before the connection catches up.
+//
+// The writer attaches nothing for long: SQLite allows only a few
+// attachments per connection, and one read inside a transaction cannot be
+// detached before it ends. It reads an archive through queryYear(), one
+// year at a time.
+class YearArchive
+{
+public:
+    // SQLite attaches at most ten databases by default; the rest are kept
+    // for archive_staging and other short attachments
+    static constexpr int MaxAttached = 8;
+
+    static QString pathForYear(const QString &databasePath, int year);
+
+    // Reads the Archives table and deletes files it no longer lists
+    static void load(QSqlDatabase &writer);
+    static QList<int> archivedYears();
+    static bool isArchived(int year);
+
+    // From the next reader query on, pushing out the archived years asked
+    // for longest ago beyond MaxAttached; true if an archived year was added
+    static bool requireYears(int first, int last);
+
+    // Brings a reader's attachments and view up to date. Must not run
+    // inside a transaction.
+    static void applyReader(QSqlDatabase &db);
+    // For a short-lived connection of its own, which reads the archived
+    // years in the range; release() it before it closes. Fails if the
+    // range holds more than MaxAttached of them (see splitRange()) or one
+    // cannot be attached.
+    static bool applyRange(QSqlDatabase &db, int first, int last, QString *errorString);
+    // Consecutive year ranges covering first..last, each holding at most
+    // MaxAttached archived years
+    static QList<QPair<int, int>> splitRange(int first, int last);
+    // Forgets a connection that is about to close
+    static void release(const QString &connectionName);
+
+    // Copies the year's sessions into a new archive, then drops them from
+    // the hot table in one transaction. Must not run inside a transaction.
+    static bool archiveYear(QSqlDatabase &writer, int year, QString *errorString);
+    // Moves the year back into the hot table. Only writes the main
+    // database, so it may run inside the caller's transaction; load()
+    // once that has committed.
+    static bool restoreYear(QSqlDatabase &writer, int year, QString *errorString);
+
+    // Runs sql against the year's archive on a read-only connection of its
+    // own, which works inside the writer's transaction. A year the writer
+    // no longer lists yields no rows. Stops early when onRow returns false,
+    // which fails without an errorString.
+    static bool queryYear(QSqlDatabase &writer, int year, const QString &sql,
+                          const QVariantMap &bindings,
+                          const std::function<bool(const QSqlQuery &row)> &onRow,
+                          QString *errorString);
+
+private:
+    static bool apply(QSqlDatabase &db, const QSet<int> &years, quint64 version, QString *errorString);
+};
+
+#endif // YEARARCHIVE_H
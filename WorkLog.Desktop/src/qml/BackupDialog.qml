@@ -0,0 +1,146 @@
+import QtQuick 2.15
+import QtQuick.Controls 2.15 as QQC2
+import QtQuick.Layouts 1.15
+import org.kde.kirigami 2.19 as Kirigami
+import org.worklog 1.0
+
+QQC2.Dialog {
+    id: backupDialog
+    title: i18n("Backups")
+    modal: true
+    anchors.centerIn: parent
+    width: Math.min(parent.width * 0.8, Kirigami.Units.gridUnit * 28)
+    standardButtons: QQC2.Dialog.Close
+
+    property string restorePath: ""
+
+    onOpened: resultLabel.visible = false
+
+    function showResult(success, message) {
+        resultLabel.text = message
+        resultLabel.color = success ? Kirigami.Theme.positiveTextColor : Kirigami.Theme.negativeTextColor
+        resultLabel.visible = true
+    }
+
+    Connections {
+        target: Backups
+        function onBackupCompleted(success, message) {
+            backupDialog.showResult(success, message)
+        }
+        function onRestoreStaged(success, message) {
+            backupDialog.showResult(success, message)
+        }
+        function onErrorOccurred(error) {
+            backupDialog.showResult(false, error)
+        }
+    }
+
+    contentItem: ColumnLayout {
+        spacing: Kirigami.Units.largeSpacing
+
+        QQC2.Label {
+            Layout.fillWidth: true
+            wrapMode: Text.Wrap
+            opacity: 0.7
+            text: i18n("A backup is made once a day; the newest seven are kept.")
+        }
+
+        ListView {
+            id: backupList
+            Layout.fillWidth: true
+            Layout.preferredHeight: Kirigami.Units.gridUnit * 10
+            clip: true
+            model: Backups.backups
+
+            delegate: QQC2.ItemDelegate {
+                width: ListView.view.width
+                highlighted: ListView.isCurrentItem
+                text: modelData.fileName
+                onClicked: backupList.currentIndex = index
+
+                QQC2.Label {
+                    anchors.right: parent.right
+                    anchors.rightMargin: Kirigami.Units.largeSpacing
+                    anchors.verticalCenter: parent.verticalCenter
+                    opacity: 0.7
+                    text: Math.max(1, Math.round(modelData.size / 1024)) + " KiB"
+                }
+            }
+
+            QQC2.Label {
+                anchors.centerIn: parent
+                visible: backupList.count === 0
+                opacity: 0.7
+                text: i18n("No backups yet")
+            }
+        }
+
+        QQC2.ProgressBar {
+            Layout.fillWidth: true
+            visible: Backups.isBackingUp || Backups.isRestoring
+            from: 0
+            to: Math.max(Backups.totalPages, 1)
+            value: Backups.pagesCopied
+            indeterminate: Backups.isRestoring || Backups.totalPages === 0
+        }
+
+        QQC2.Label {
+            id: resultLabel
+            visible: false
+            Layout.fillWidth: true
+            wrapMode: Text.Wrap
+            horizontalAlignment: Text.AlignHCenter
+        }
+
+        Row {
+            Layout.alignment: Qt.AlignHCenter
+            spacing: Kirigami.Units.largeSpacing
+
+            QQC2.Button {
+                text: i18n("Back Up Now")
+                icon.name: "document-save"
+                visible: !Backups.isBackingUp
+                enabled: !Backups.isRestoring
+                onClicked: {
+                    resultLabel.visible = false
+                    Backups.backupNow()
+                }
+            }
+
+            QQC2.Button {
+                text: i18n("Cancel Backup")
+                icon.name: "process-stop"
+                visible: Backups.isBackingUp
+                onClicked: Backups.cancel()
+            }
+
+            QQC2.Button {
+                text: i18n("Restore…")
+                icon.name: "document-revert"
+                enabled: backupList.currentIndex >= 0 && !Backups.isBackingUp && !Backups.isRestoring
+                onClicked: {
+                    backupDialog.restorePath = Backups.backups[backupList.currentIndex].path
+                    confirmRestoreDialog.open()
+                }
+            }
+        }
+    }
+
+    QQC2.Dialog {
+        id: confirmRestoreDialog
+        title: i18n("Restore Backup")
+        modal: true
+        anchors.centerIn: parent
+        standardButtons: QQC2.Dialog.Yes | QQC2.Dialog.No
+
+        contentItem: QQC2.Label {
+            wrapMode: Text.Wrap
+            text: i18n("Replace all sessions and tags with this backup the next time Work Log starts?")
+        }
+
+        onAccepted: {
+            resultLabel.visible = false
+            Backups.restoreBackup(backupDialog.restorePath)
+        }
+    }
+}
@@ -0,0 +1,111 @@
+import QtQuick 2.15
+import QtQuick.Controls 2.15 as QQC2
+import QtQuick.Layouts 1.15
+import org.kde.kirigami 2.19 as Kirigami
+import org.worklog 1.0
+
+QQC2.Dialog {
+    id: exportDialog
+    title: i18n("Export Sessions")
+    modal: true
+    anchors.centerIn: parent
+    width: Math.min(parent.width * 0.8, Kirigami.Units.gridUnit * 28)
+    standardButtons: QQC2.Dialog.Close
+
+    onOpened: {
+        resultLabel.visible = false
+        if (!Exporter.isExporting) {
+            pathField.text = Exporter.defaultExportPath(formatCombo.currentValue)
+        }
+    }
+
+    Connections {
+        target: Exporter
+        function onExportCompleted(success, message) {
+            resultLabel.text = message
+            resultLabel.color = success ? Kirigami.Theme.positiveTextColor : Kirigami.Theme.negativeTextColor
+            resultLabel.visible = true
+        }
+        function onErrorOccurred(error) {
+            resultLabel.text = error
+            resultLabel.color = Kirigami.Theme.negativeTextColor
+            resultLabel.visible = true
+        }
+    }
+
+    contentItem: ColumnLayout {
+        spacing: Kirigami.Units.largeSpacing
+
+        Kirigami.FormLayout {
+            Layout.fillWidth: true
+            enabled: !Exporter.isExporting
+
+            QQC2.ComboBox {
+                id: formatCombo
+                Kirigami.FormData.label: i18n("Format:")
+                model: [
+                    { text: i18n("CSV"), value: "csv" },
+                    { text: i18n("NDJSON (one JSON object per line)"), value: "ndjson" },
+                    { text: i18n("Compact binary"), value: "binary" }
+                ]
+                textRole: "text"
+                valueRole: "value"
+                onActivated: pathField.text = Exporter.defaultExportPath(currentValue)
+            }
+
+            QQC2.TextField {
+                id: pathField
+                Kirigami.FormData.label: i18n("File:")
+                Layout.fillWidth: true
+            }
+        }
+
+        QQC2.ProgressBar {
+            Layout.fillWidth: true
+            visible: Exporter.isExporting
+            from: 0
+            to: Math.max(Exporter.totalRows, 1)
+            value: Exporter.rowsExported
+            indeterminate: Exporter.totalRows === 0
+        }
+
+        QQC2.Label {
+            Layout.fillWidth: true
+            visible: Exporter.isExporting
+            horizontalAlignment: Text.AlignHCenter
+            text: i18n("%1 of %2 sessions", Exporter.rowsExported, Exporter.totalRows)
+            opacity: 0.7
+        }
+
+        QQC2.Label {
+            id: resultLabel
+            visible: false
+            Layout.fillWidth: true
+            wrapMode: Text.Wrap
+            horizontalAlignment: Text.AlignHCenter
+        }
+
+        Row {
+            Layout.alignment: Qt.AlignHCenter
+            spacing: Kirigami.Units.largeSpacing
+
+            QQC2.Button {
+                text: i18n("Export")
+                icon.name: "document-export"
+                visible: !Exporter.isExporting
+                enabled: pathField.text.trim().length > 0
+                onClicked: {
+                    resultLabel.visible = false
+                    Exporter.exportSessions(pathField.text.trim(), formatCombo.currentValue)
+                }
+            }
+
+            QQC2.Button {
+                text: i18n("Cancel Export")
+                icon.name: "process-stop"
+                visible: Exporter.isExporting
+                onClicked: Exporter.cancel()
+            }
+        }
+    }
+}
@@ -0,0 +1,98 @@
+import QtQuick 2.15
+import QtQuick.Controls 2.15 as QQC2
+import QtQuick.Layouts 1.15
+import org.kde.kirigami 2.19 as Kirigami
+import org.worklog 1.0
+
+QQC2.Dialog {
+    id: root
+
+    signal dateSelected(date date)
+
+    readonly property int cellSize: Kirigami.Units.gridUnit
+    readonly property int cellSpacing: 2
+
+    title: i18n("Year Heatmap")
+    modal: true
+    standardButtons: QQC2.Dialog.Close
+    width: Math.min(parent.width - Kirigami.Units.largeSpacing * 4,
+                    HeatmapModel.weekCount * (cellSize + cellSpacing) + Kirigami.Units.largeSpacing * 4)
+    anchors.centerIn: parent
+
+    function cellColor(level) {
+        if (level === 0)
+            return Qt.rgba(Kirigami.Theme.textColor.r, Kirigami.Theme.textColor.g, Kirigami.Theme.textColor.b, 0.08)
+        var c = Kirigami.Theme.highlightColor
+        return Qt.rgba(c.r, c.g, c.b, 0.25 + 0.1875 * level)
+    }
+
+    contentItem: ColumnLayout {
+        spacing: Kirigami.Units.smallSpacing
+
+        // Year selection
+        RowLayout {
+            Layout.alignment: Qt.AlignHCenter
+
+            QQC2.ToolButton {
+                icon.name: "go-previous"
+                onClicked: HeatmapModel.year = HeatmapModel.year - 1
+            }
+
+            Kirigami.Heading {
+                level: 3
+                text: HeatmapModel.year
+            }
+
+            QQC2.ToolButton {
+                icon.name: "go-next"
+                onClicked: HeatmapModel.year = HeatmapModel.year + 1
+            }
+        }
+
+        // One column per week, Monday at the top
+        GridView {
+            id: grid
+            Layout.fillWidth: true
+            Layout.preferredHeight: 7 * cellHeight
+            clip: true
+            flow: GridView.FlowTopToBottom
+            cellWidth: root.cellSize + root.cellSpacing
+            cellHeight: root.cellSize + root.cellSpacing
+            boundsBehavior: Flickable.StopAtBounds
+            model: HeatmapModel
+
+            delegate: Rectangle {
+                width: root.cellSize
+                height: root.cellSize
+                radius: 2
+                visible: model.inYear
+                color: root.cellColor(model.level)
+
+                QQC2.ToolTip.visible: model.inYear && cellMouse.containsMouse
+                QQC2.ToolTip.delay: Kirigami.Units.toolTipDelay
+                QQC2.ToolTip.text: model.inYear
+                                   ? i18n("%1: %2 hours", Qt.formatDate(model.date, Qt.DefaultLocaleLongDate),
+                                          model.hours.toFixed(1))
+                                   : ""
+
+                MouseArea {
+                    id: cellMouse
+                    anchors.fill: parent
+                    hoverEnabled: true
+                    onClicked: {
+                        root.dateSelected(model.date)
+                        root.close()
+                    }
+                }
+            }
+        }
+
+        QQC2.Label {
+            Layout.fillWidth: true
+            horizontalAlignment: Text.AlignHCenter
+            opacity: 0.7
+            text: i18n("%1 hours in total, busiest day %2 hours",
+                       HeatmapModel.totalHours.toFixed(1), HeatmapModel.maxHours.toFixed(1))
+        }
+    }
+}
@@ -0,0 +1,107 @@
+import QtQuick 2.15
+import QtQuick.Controls 2.15 as QQC2
+import QtQuick.Layouts 1.15
+import org.kde.kirigami 2.19 as Kirigami
+import org.worklog 1.0
+
+QQC2.Dialog {
+    id: importDialog
+    title: i18n("Import Sessions")
+    modal: true
+    anchors.centerIn: parent
+    width: Math.min(parent.width * 0.8, Kirigami.Units.gridUnit * 28)
+    standardButtons: QQC2.Dialog.Close
+
+    onOpened: resultLabel.visible = false
+
+    Connections {
+        target: Importer
+        function onImportCompleted(success, message) {
+            resultLabel.text = message
+            resultLabel.color = success ? Kirigami.Theme.positiveTextColor : Kirigami.Theme.negativeTextColor
+            resultLabel.visible = true
+        }
+        function onErrorOccurred(error) {
+            resultLabel.text = error
+            resultLabel.color = Kirigami.Theme.negativeTextColor
+            resultLabel.visible = true
+        }
+    }
+
+    contentItem: ColumnLayout {
+        spacing: Kirigami.Units.largeSpacing
+
+        Kirigami.FormLayout {
+            Layout.fillWidth: true
+            enabled: !Importer.isImporting
+
+            QQC2.TextField {
+                id: pathField
+                Kirigami.FormData.label: i18n("File:")
+                Layout.fillWidth: true
+                placeholderText: i18n("Path to a .csv or .ndjson file")
+            }
+
+            QQC2.CheckBox {
+                id: dryRunCheck
+                Kirigami.FormData.label: i18n("Mode:")
+                text: i18n("Validate only (dry run)")
+            }
+        }
+
+        QQC2.Label {
+            Layout.fillWidth: true
+            wrapMode: Text.Wrap
+            opacity: 0.7
+            text: i18n("Columns: date, hours, description, notes, nextPlannedStage, tag. Unknown tags are created.")
+        }
+
+        QQC2.ProgressBar {
+            Layout.fillWidth: true
+            visible: Importer.isImporting
+            from: 0
+            to: Math.max(Importer.totalBytes, 1)
+            value: Importer.bytesRead
+        }
+
+        QQC2.Label {
+            id: resultLabel
+            visible: false
+            Layout.fillWidth: true
+            wrapMode: Text.Wrap
+            horizontalAlignment: Text.AlignHCenter
+        }
+
+        QQC2.Label {
+            Layout.fillWidth: true
+            visible: resultLabel.visible && Importer.rowErrors.length > 0
+            wrapMode: Text.Wrap
+            font.family: "monospace"
+            opacity: 0.8
+            text: Importer.rowErrors.join("\n")
+        }
+
+        Row {
+            Layout.alignment: Qt.AlignHCenter
+            spacing: Kirigami.Units.largeSpacing
+
+            QQC2.Button {
+                text: dryRunCheck.checked ? i18n("Validate") : i18n("Import")
+                icon.name: "document-import"
+                visible: !Importer.isImporting
+                enabled: pathField.text.trim().length > 0
+                onClicked: {
+                    resultLabel.visible = false
+                    Importer.importSessions(pathField.text.trim(), "", dryRunCheck.checked)
+                }
+            }
+
+            QQC2.Button {
+                text: i18n("Cancel Import")
+                icon.name: "process-stop"
+                visible: Importer.isImporting
+                onClicked: Importer.cancel()
+            }
+        }
+    }
+}
@@ -218,6 +218,13 @@ QQC2.Dialog {
                     Layout.fillWidth: true
                     text: root.description
                     placeholderText: i18n("Describe the work you did...")
+                    onTextEdited: descriptionSuggestions.update()
+                    Keys.onPressed: descriptionSuggestions.handleKey(event)
+
+                    SuggestionPopup {
+                        id: descriptionSuggestions
+                        suggestionField: Suggestions.Description
+                    }
                 }
 
                 // Notes
@@ -247,8 +254,16 @@ QQC2.Dialog {
                         text: root.nextPlannedStage
                         placeholderText: i18n("What's planned next...")
                         wrapMode: TextEdit.Wrap
+                        // TextArea has no textEdited; update() skips changes made without focus
+                        onTextChanged: nextStageSuggestions.update()
+                        Keys.onPressed: nextStageSuggestions.handleKey(event)
                         Keys.onTabPressed: dateField.forceActiveFocus()
                         Keys.onBacktabPressed: notesField.forceActiveFocus()
+
+                        SuggestionPopup {
+                            id: nextStageSuggestions
+                            suggestionField: Suggestions.NextPlannedStage
+                        }
                     }
                 }
             }
@@ -0,0 +1,97 @@
+import QtQuick 2.15
+import QtQuick.Controls 2.15 as QQC2
+import org.worklog 1.0
+
+// Earlier texts starting with what was typed, shown under the text field
+// it is declared in. The field forwards its keys through handleKey().
+QQC2.Popup {
+    id: popup
+
+    property Item field: parent
+    property int suggestionField: Suggestions.Description
+    property bool applying: false
+
+    y: field.height
+    width: field.width
+    padding: 1
+    // Typing stays in the field
+    focus: false
+    closePolicy: QQC2.Popup.CloseOnEscape | QQC2.Popup.CloseOnPressOutsideParent
+
+    function update() {
+        if (applying || !field.activeFocus) {
+            return
+        }
+        Suggestions.complete(suggestionField, field.text)
+        suggestionList.currentIndex = -1
+        if (Suggestions.count > 0) {
+            open()
+        } else {
+            close()
+        }
+    }
+
+    function apply(index) {
+        if (index < 0 || index >= Suggestions.count) {
+            return
+        }
+        applying = true
+        field.text = Suggestions.get(index)
+        field.cursorPosition = field.length
+        applying = false
+        close()
+    }
+
+    function handleKey(event) {
+        if (!visible) {
+            return
+        }
+        switch (event.key) {
+        case Qt.Key_Down:
+            suggestionList.currentIndex = Math.min(suggestionList.currentIndex + 1, suggestionList.count - 1)
+            event.accepted = true
+            break
+        case Qt.Key_Up:
+            suggestionList.currentIndex = Math.max(suggestionList.currentIndex - 1, -1)
+            event.accepted = true
+            break
+        case Qt.Key_Return:
+        case Qt.Key_Enter:
+            if (suggestionList.currentIndex >= 0) {
+                apply(suggestionList.currentIndex)
+                event.accepted = true
+            }
+            break
+        case Qt.Key_Escape:
+            close()
+            event.accepted = true
+            break
+        }
+    }
+
+    Connections {
+        target: popup.field
+        function onActiveFocusChanged() {
+            if (!popup.field.activeFocus) {
+                popup.close()
+            }
+        }
+    }
+
+    contentItem: ListView {
+        id: suggestionList
+        implicitHeight: contentHeight
+        clip: true
+        currentIndex: -1
+        model: Suggestions
+
+        delegate: QQC2.ItemDelegate {
+            width: ListView.view.width
+            text: model.text
+            highlighted: ListView.isCurrentItem
+            // Clicking must not take focus from the field
+            focusPolicy: Qt.NoFocus
+            onClicked: popup.apply(index)
+        }
+    }
+}
@@ -13,6 +13,17 @@ QQC2.Dialog {
     standardButtons: QQC2.Dialog.Close
 
     property bool configMode: !SyncManager.isConfigured
+    readonly property bool directoryTarget: backendCombo.currentValue === "directory"
+
+    function progressText() {
+        var kib = Math.round(SyncManager.bytesTransferred / 1024)
+        var text = SyncManager.totalItems > 0
+            ? i18n("%1: %2 of %3 records, %4 KiB", SyncManager.syncPhase, SyncManager.itemsProcessed, SyncManager.totalItems, kib)
+            : i18n("%1: %2 records, %3 KiB", SyncManager.syncPhase, SyncManager.itemsProcessed, kib)
+        if (SyncManager.etaSeconds >= 0)
+            text += " " + i18n("(about %1 s left)", SyncManager.etaSeconds)
+        return text
+    }
 
     onOpened: {
         // Reset state on open to ensure proper layout
@@ -48,6 +59,12 @@ QQC2.Dialog {
                 color: SyncManager.isConfigured ? Kirigami.Theme.positiveTextColor : Kirigami.Theme.neutralTextColor
             }
 
+            QQC2.Label {
+                Kirigami.FormData.label: i18n("Target:")
+                text: SyncManager.getBackend() === "directory" ? i18n("Shared folder") : i18n("Amazon DynamoDB")
+                visible: SyncManager.isConfigured
+            }
+
             QQC2.Label {
                 Kirigami.FormData.label: i18n("Profile ID:")
                 text: SyncManager.getProfileId() || "-"
@@ -57,7 +74,14 @@ QQC2.Dialog {
             QQC2.Label {
                 Kirigami.FormData.label: i18n("AWS Region:")
                 text: SyncManager.getAwsRegion() || "-"
-                visible: SyncManager.isConfigured
+                visible: SyncManager.isConfigured && SyncManager.getBackend() !== "directory"
+            }
+
+            QQC2.Label {
+                Kirigami.FormData.label: i18n("Folder:")
+                text: SyncManager.getSyncDirectory() || "-"
+                visible: SyncManager.isConfigured && SyncManager.getBackend() === "directory"
+                elide: Text.ElideMiddle
             }
 
             QQC2.Label {
@@ -66,6 +90,25 @@ QQC2.Dialog {
             }
         }
 
+        // Progress of a running sync
+        QQC2.ProgressBar {
+            visible: SyncManager.isSyncing
+            width: parent.width
+            from: 0
+            to: Math.max(SyncManager.totalItems, 1)
+            value: SyncManager.itemsProcessed
+            indeterminate: SyncManager.totalItems === 0
+        }
+
+        QQC2.Label {
+            visible: SyncManager.isSyncing
+            width: parent.width
+            horizontalAlignment: Text.AlignHCenter
+            elide: Text.ElideRight
+            text: syncDialog.progressText()
+            opacity: 0.7
+        }
+
         // Result message
         QQC2.Label {
             id: resultLabel
@@ -91,6 +134,13 @@ QQC2.Dialog {
                 }
             }
 
+            QQC2.Button {
+                text: i18n("Cancel Sync")
+                icon.name: "process-stop"
+                visible: SyncManager.isSyncing
+                onClicked: SyncManager.cancel()
+            }
+
             QQC2.Button {
                 text: i18n("Test Connection")
                 icon.name: "network-connect"
@@ -122,6 +172,18 @@ QQC2.Dialog {
             visible: configMode
             width: parent.width
 
+            QQC2.ComboBox {
+                id: backendCombo
+                Kirigami.FormData.label: i18n("Sync Target:")
+                model: [
+                    { text: i18n("Amazon DynamoDB"), value: "dynamodb" },
+                    { text: i18n("Shared folder"), value: "directory" }
+                ]
+                textRole: "text"
+                valueRole: "value"
+                Component.onCompleted: currentIndex = SyncManager.getBackend() === "directory" ? 1 : 0
+            }
+
             QQC2.TextField {
                 id: profileIdField
                 Kirigami.FormData.label: i18n("Profile ID:")
@@ -129,8 +191,17 @@ QQC2.Dialog {
                 text: SyncManager.getProfileId()
             }
 
+            QQC2.TextField {
+                id: directoryField
+                Kirigami.FormData.label: i18n("Folder:")
+                visible: directoryTarget
+                placeholderText: i18n("e.g., /mnt/nas/worklog")
+                text: SyncManager.getSyncDirectory()
+            }
+
             QQC2.TextField {
                 id: accessKeyField
+                visible: !directoryTarget
                 Kirigami.FormData.label: i18n("AWS Access Key ID:")
                 placeholderText: i18n("Your AWS Access Key ID")
                 text: SyncManager.getAwsAccessKeyId()
@@ -138,6 +209,7 @@ QQC2.Dialog {
 
             QQC2.TextField {
                 id: secretKeyField
+                visible: !directoryTarget
                 Kirigami.FormData.label: i18n("AWS Secret Access Key:")
                 echoMode: TextInput.Password
                 placeholderText: SyncManager.hasSecretKey() ? i18n("(unchanged)") : i18n("Your secret key")
@@ -145,6 +217,7 @@ QQC2.Dialog {
 
             QQC2.ComboBox {
                 id: regionCombo
+                visible: !directoryTarget
                 Kirigami.FormData.label: i18n("AWS Region:")
                 model: [
                     { text: "US East (N. Virginia)", value: "us-east-1" },
@@ -178,12 +251,19 @@ QQC2.Dialog {
                     text: i18n("Save Configuration")
                     icon.name: "document-save"
                     onClicked: {
-                        SyncManager.saveConfiguration(
-                            accessKeyField.text,
-                            secretKeyField.text,
-                            regionCombo.currentValue,
-                            profileIdField.text
-                        )
+                        if (directoryTarget) {
+                            SyncManager.saveDirectoryConfiguration(
+                                directoryField.text,
+                                profileIdField.text
+                            )
+                        } else {
+                            SyncManager.saveConfiguration(
+                                accessKeyField.text,
+                                secretKeyField.text,
+                                regionCombo.currentValue,
+                                profileIdField.text
+                            )
+                        }
                         resultLabel.text = i18n("Configuration saved!")
                         resultLabel.visible = true
                         configMode = false
@@ -200,7 +280,7 @@ QQC2.Dialog {
 
         // Security notice
         QQC2.Label {
-            visible: configMode
+            visible: configMode && !directoryTarget
             width: parent.width
             wrapMode: Text.Wrap
             font.italic: true
@@ -63,6 +63,27 @@ QQC2.Dialog {
                     }
 
                     actions: [
+                        Kirigami.Action {
+                            icon.name: "edit-rename"
+                            text: i18n("Rename")
+                            onTriggered: {
+                                renameDialog.tagId = model.tagId
+                                renameDialog.tagName = model.tagName
+                                renameField.text = model.tagName
+                                renameDialog.open()
+                            }
+                        },
+                        Kirigami.Action {
+                            icon.name: "merge"
+                            text: i18n("Merge Into…")
+                            enabled: tagListView.count > 1
+                            onTriggered: {
+                                mergeDialog.tagId = model.tagId
+                                mergeDialog.tagName = model.tagName
+                                mergeTargetCombo.currentIndex = -1
+                                mergeDialog.open()
+                            }
+                        },
                         Kirigami.Action {
                             icon.name: "edit-delete"
                             text: i18n("Delete")
@@ -85,6 +106,71 @@ QQC2.Dialog {
         }
     }
 
+    QQC2.Dialog {
+        id: renameDialog
+
+        property int tagId: -1
+        property string tagName: ""
+
+        title: i18n("Rename Tag")
+        modal: true
+        standardButtons: QQC2.Dialog.Ok | QQC2.Dialog.Cancel
+        anchors.centerIn: parent
+
+        contentItem: QQC2.TextField {
+            id: renameField
+            onAccepted: renameDialog.accept()
+        }
+
+        onAccepted: {
+            var name = renameField.text.trim()
+            if (name.length > 0 && name !== tagName)
+                Database.renameTag(tagId, name)
+        }
+    }
+
+    // Moves every session of the tag to another one in a single step
+    QQC2.Dialog {
+        id: mergeDialog
+
+        property int tagId: -1
+        property string tagName: ""
+
+        title: i18n("Merge Tag")
+        modal: true
+        standardButtons: QQC2.Dialog.Ok | QQC2.Dialog.Cancel
+        anchors.centerIn: parent
+
+        contentItem: ColumnLayout {
+            QQC2.Label {
+                Layout.fillWidth: true
+                text: i18n("Move all sessions tagged \"%1\" to:", mergeDialog.tagName)
+                wrapMode: Text.Wrap
+            }
+
+            QQC2.ComboBox {
+                id: mergeTargetCombo
+                Layout.fillWidth: true
+                model: TagModel
+                textRole: "tagName"
+                valueRole: "tagId"
+            }
+
+            QQC2.Label {
+                Layout.fillWidth: true
+                text: i18n("\"%1\" is deleted afterwards.", mergeDialog.tagName)
+                wrapMode: Text.Wrap
+                opacity: 0.7
+            }
+        }
+
+        onAccepted: {
+            var targetId = mergeTargetCombo.currentValue
+            if (mergeTargetCombo.currentIndex >= 0 && targetId !== tagId)
+                Database.mergeTags([tagId], targetId)
+        }
+    }
+
     // Delete confirmation dialog
     QQC2.Dialog {
         id: deleteConfirmDialog
@@ -62,10 +62,30 @@ Kirigami.ApplicationWindow {
                     onTriggered: syncDialog.open()
                     visible: root.syncEnabled
                 },
+                Kirigami.Action {
+                    icon.name: "view-calendar"
+                    text: i18n("Year Heatmap")
+                    onTriggered: heatmapDialog.open()
+                },
                 Kirigami.Action {
                     icon.name: "tag"
                     text: i18n("Manage Tags")
                     onTriggered: tagDialog.open()
+                },
+                Kirigami.Action {
+                    icon.name: "document-import"
+                    text: i18n("Import Sessions")
+                    onTriggered: importDialog.open()
+                },
+                Kirigami.Action {
+                    icon.name: "document-export"
+                    text: i18n("Export Sessions")
+                    onTriggered: exportDialog.open()
+                },
+                Kirigami.Action {
+                    icon.name: "document-save-all"
+                    text: i18n("Backups")
+                    onTriggered: backupDialog.open()
                 }
             ]
 
@@ -207,10 +227,8 @@ Kirigami.ApplicationWindow {
 
         onAccepted: {
             if (session) {
+                // The models refresh on the database's notification
                 Database.deleteSession(session.id)
-                // refresh models and hierarchy
-                HierarchyModel.refresh()
-                SessionModel.refresh()
                 if (root.selectedSession && root.selectedSession.id === session.id) {
                     root.selectedSession = null
                 }
@@ -234,4 +252,25 @@ Kirigami.ApplicationWindow {
     TagManagementDialog {
         id: tagDialog
     }
+
+    ImportDialog {
+        id: importDialog
+    }
+
+    ExportDialog {
+        id: exportDialog
+    }
+
+    BackupDialog {
+        id: backupDialog
+    }
+
+    HeatmapDialog {
+        id: heatmapDialog
+        onDateSelected: {
+            root.selectedDate = date
+            SessionModel.currentDate = date
+            root.selectedSession = null
+        }
+    }
 }